@@ -4,6 +4,7 @@
 
 #include <sys/types.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cstdio>
 #include <cstdlib>
@@ -13,6 +14,7 @@
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/write_batch.h"
 #include "port/port.h"
 #include "util/crc32c.h"
@@ -34,6 +36,7 @@
 //      readreverse   -- read N times in reverse order
 //      readrandom    -- read N times in random order
 //      readmissing   -- read N missing keys in random order
+//      multireadrandom -- read N times in random order, in MultiGet batches
 //      readhot       -- read N times in random order from 1% section of DB
 //      seekrandom    -- N random seeks
 //      seekordered   -- N ordered seeks
@@ -70,6 +73,9 @@ static int FLAGS_num = 1000000;
 // Number of read operations to do.  If negative, do FLAGS_num reads.
 static int FLAGS_reads = -1;
 
+// Number of keys per DB::MultiGet() call in multireadrandom.
+static int FLAGS_multiget_batch = 100;
+
 // Number of concurrent threads to run.
 static int FLAGS_threads = 1;
 
@@ -90,10 +96,29 @@ static bool FLAGS_comparisons = false;
 // (initialized to default value by "main")
 static int FLAGS_write_buffer_size = 0;
 
+// Number of memtables that may be held in memory before writes stall
+// (initialized to default value by "main")
+static int FLAGS_max_write_buffer_number = 0;
+
 // Number of bytes written to each file.
 // (initialized to default value by "main")
 static int FLAGS_max_file_size = 0;
 
+// Target size of level-1, and the ratio between the sizes of adjacent levels.
+// (initialized to default value by "main")
+static int FLAGS_max_bytes_for_level_base = 0;
+static double FLAGS_max_bytes_for_level_multiplier = 0;
+
+// If true, derive the level sizes from the size of the last level.
+static bool FLAGS_dynamic_level_bytes = false;
+
+// If true, use universal compaction instead of leveled compaction.
+static bool FLAGS_universal = false;
+
+// Which file of a level to compact next: 0 in key order, 1 by smallest
+// overlap with the next level, 2 by most deletions.
+static int FLAGS_compaction_pri = 0;
+
 // Approximate size of user data packed per block (before compression.
 // (initialized to default value by "main")
 static int FLAGS_block_size = 0;
@@ -102,6 +127,25 @@ static int FLAGS_block_size = 0;
 // Negative means use default settings.
 static int FLAGS_cache_size = -1;
 
+// Number of bytes to use as a secondary cache of compressed blocks.
+// Zero or negative means no secondary cache.
+static int FLAGS_compressed_cache_size = 0;
+
+// If true, charge index and filter blocks to the block cache.
+static bool FLAGS_cache_index_and_filter_blocks = false;
+
+// If true, read tables with direct I/O, bypassing the page cache.
+static bool FLAGS_use_direct_reads = false;
+
+// If true, write flushed and compacted tables with direct I/O.
+static bool FLAGS_use_direct_io_for_flush_and_compaction = false;
+
+// If true, use CLOCK caches for blocks and open tables instead of LRU.
+static bool FLAGS_clock_cache = false;
+
+// If true, find the files that may hold a key with learned indexes.
+static bool FLAGS_learned_file_index = false;
+
 // Maximum number of files to keep open at the same time (use default if == 0)
 static int FLAGS_open_files = 0;
 
@@ -109,9 +153,16 @@ static int FLAGS_open_files = 0;
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// If true, the bloom filters confine the probes of a key to one cache line.
+static bool FLAGS_blocked_bloom = false;
+
 // Common key prefix length.
 static int FLAGS_key_prefix = 0;
 
+// Length of the key prefixes added to the bloom filters.  If positive,
+// seekrandom also seeks in prefix mode (ReadOptions::prefix_same_as_start).
+static int FLAGS_prefix_size = 0;
+
 // If true, do not destroy the existing database.  If you set this
 // flag and also specify a benchmark that wants a fresh database, that
 // benchmark will fail.
@@ -120,6 +171,9 @@ static bool FLAGS_use_existing_db = false;
 // If true, reuse existing log/MANIFEST files when re-opening a database.
 static bool FLAGS_reuse_logs = false;
 
+// If true, carve memtables from pooled huge-page regions.
+static bool FLAGS_memtable_huge_pages = false;
+
 // If true, use compression.
 static bool FLAGS_compression = true;
 
@@ -425,7 +479,9 @@ void Uncompress(
 class Benchmark {
  private:
   Cache* cache_;
+  Cache* compressed_cache_;
   const FilterPolicy* filter_policy_;
+  const SliceTransform* prefix_extractor_;
   DB* db_;
   int num_;
   int value_size_;
@@ -516,10 +572,20 @@ class Benchmark {
 
  public:
   Benchmark()
-      : cache_(FLAGS_cache_size >= 0 ? NewLRUCache(FLAGS_cache_size) : nullptr),
-        filter_policy_(FLAGS_bloom_bits >= 0
-                           ? NewBloomFilterPolicy(FLAGS_bloom_bits)
-                           : nullptr),
+      : cache_(FLAGS_cache_size < 0 ? nullptr
+               : FLAGS_clock_cache
+                   ? NewClockCache(FLAGS_cache_size, FLAGS_block_size)
+                   : NewLRUCache(FLAGS_cache_size)),
+        compressed_cache_(FLAGS_compressed_cache_size > 0
+                              ? NewLRUCache(FLAGS_compressed_cache_size)
+                              : nullptr),
+        filter_policy_(FLAGS_bloom_bits < 0 ? nullptr
+                       : FLAGS_blocked_bloom
+                           ? NewBlockedBloomFilterPolicy(FLAGS_bloom_bits)
+                           : NewBloomFilterPolicy(FLAGS_bloom_bits)),
+        prefix_extractor_(FLAGS_prefix_size > 0
+                              ? NewFixedPrefixTransform(FLAGS_prefix_size)
+                              : nullptr),
         db_(nullptr),
         num_(FLAGS_num),
         value_size_(FLAGS_value_size),
@@ -543,7 +609,9 @@ class Benchmark {
   ~Benchmark() {
     delete db_;
     delete cache_;
+    delete compressed_cache_;
     delete filter_policy_;
+    delete prefix_extractor_;
   }
 
   void Run() {
@@ -606,6 +674,8 @@ class Benchmark {
         method = &Benchmark::ReadReverse;
       } else if (name == Slice("readrandom")) {
         method = &Benchmark::ReadRandom;
+      } else if (name == Slice("multireadrandom")) {
+        method = &Benchmark::MultiReadRandom;
       } else if (name == Slice("readmissing")) {
         method = &Benchmark::ReadMissing;
       } else if (name == Slice("seekrandom")) {
@@ -792,15 +862,32 @@ class Benchmark {
     options.env = g_env;
     options.create_if_missing = !FLAGS_use_existing_db;
     options.block_cache = cache_;
+    options.compressed_block_cache = compressed_cache_;
+    options.cache_index_and_filter_blocks = FLAGS_cache_index_and_filter_blocks;
+    options.use_direct_reads = FLAGS_use_direct_reads;
+    options.use_direct_io_for_flush_and_compaction =
+        FLAGS_use_direct_io_for_flush_and_compaction;
     options.write_buffer_size = FLAGS_write_buffer_size;
+    options.max_write_buffer_number = FLAGS_max_write_buffer_number;
     options.max_file_size = FLAGS_max_file_size;
+    options.max_bytes_for_level_base = FLAGS_max_bytes_for_level_base;
+    options.max_bytes_for_level_multiplier =
+        FLAGS_max_bytes_for_level_multiplier;
+    options.level_compaction_dynamic_level_bytes = FLAGS_dynamic_level_bytes;
+    options.compaction_style =
+        FLAGS_universal ? kCompactionStyleUniversal : kCompactionStyleLevel;
+    options.compaction_pri = static_cast<CompactionPri>(FLAGS_compaction_pri);
     options.block_size = FLAGS_block_size;
     if (FLAGS_comparisons) {
       options.comparator = &count_comparator_;
     }
     options.max_open_files = FLAGS_open_files;
     options.filter_policy = filter_policy_;
+    options.learned_file_index = FLAGS_learned_file_index;
+    options.prefix_extractor = prefix_extractor_;
     options.reuse_logs = FLAGS_reuse_logs;
+    options.memtable_huge_pages = FLAGS_memtable_huge_pages;
+    options.clock_table_cache = FLAGS_clock_cache;
     options.compression =
         FLAGS_compression ? kSnappyCompression : kNoCompression;
     //设置键值长度
@@ -854,6 +941,13 @@ class Benchmark {
       }
     }
     thread->stats.AddBytes(bytes);
+
+    // Compactions that are still due when the writes end are not counted.
+    std::string write_amp;
+    if (thread->tid == 0 &&
+        db_->GetProperty("leveldb.write-amplification", &write_amp)) {
+      thread->stats.AddMessage("write-amp " + write_amp);
+    }
   }
 
   void ReadSequential(ThreadState* thread) {
@@ -900,6 +994,34 @@ class Benchmark {
     thread->stats.AddMessage(msg);
   }
 
+  void MultiReadRandom(ThreadState* thread) {
+    ReadOptions options;
+    std::vector<std::string> key_strings(FLAGS_multiget_batch);
+    std::vector<Slice> keys(FLAGS_multiget_batch);
+    std::vector<std::string> values;
+    int found = 0;
+    KeyBuffer key;
+    for (int i = 0; i < reads_; i += FLAGS_multiget_batch) {
+      const int n = std::min(FLAGS_multiget_batch, reads_ - i);
+      keys.resize(n);
+      for (int j = 0; j < n; j++) {
+        key.Set(thread->rand.Uniform(FLAGS_num));
+        key_strings[j] = key.slice().ToString();
+        keys[j] = key_strings[j];
+      }
+      std::vector<Status> statuses = db_->MultiGet(options, keys, &values);
+      for (int j = 0; j < n; j++) {
+        if (statuses[j].ok()) {
+          found++;
+        }
+        thread->stats.FinishedSingleOp();
+      }
+    }
+    char msg[100];
+    std::snprintf(msg, sizeof(msg), "(%d of %d found)", found, num_);
+    thread->stats.AddMessage(msg);
+  }
+
   void ReadMissing(ThreadState* thread) {
     ReadOptions options;
     std::string value;
@@ -928,6 +1050,7 @@ class Benchmark {
 
   void SeekRandom(ThreadState* thread) {
     ReadOptions options;
+    options.prefix_same_as_start = (prefix_extractor_ != nullptr);
     int found = 0;
     KeyBuffer key;
     for (int i = 0; i < reads_; i++) {
@@ -1056,7 +1179,12 @@ class Benchmark {
 
 int main(int argc, char** argv) {
   FLAGS_write_buffer_size = leveldb::Options().write_buffer_size;
+  FLAGS_max_write_buffer_number = leveldb::Options().max_write_buffer_number;
   FLAGS_max_file_size = leveldb::Options().max_file_size;
+  FLAGS_max_bytes_for_level_base =
+      leveldb::Options().max_bytes_for_level_base;
+  FLAGS_max_bytes_for_level_multiplier =
+      leveldb::Options().max_bytes_for_level_multiplier;
   FLAGS_block_size = leveldb::Options().block_size;
   FLAGS_open_files = leveldb::Options().max_open_files;
   std::string default_db_path;
@@ -1081,6 +1209,9 @@ int main(int argc, char** argv) {
     } else if (sscanf(argv[i], "--reuse_logs=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_reuse_logs = n;
+    } else if (sscanf(argv[i], "--memtable_huge_pages=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_memtable_huge_pages = n;
     } else if (sscanf(argv[i], "--compression=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_compression = n;
@@ -1088,22 +1219,69 @@ int main(int argc, char** argv) {
       FLAGS_num = n;
     } else if (sscanf(argv[i], "--reads=%d%c", &n, &junk) == 1) {
       FLAGS_reads = n;
+    } else if (sscanf(argv[i], "--multiget_batch=%d%c", &n, &junk) == 1 &&
+               n > 0) {
+      FLAGS_multiget_batch = n;
     } else if (sscanf(argv[i], "--threads=%d%c", &n, &junk) == 1) {
       FLAGS_threads = n;
     } else if (sscanf(argv[i], "--value_size=%d%c", &n, &junk) == 1) {
       FLAGS_value_size = n;
     } else if (sscanf(argv[i], "--write_buffer_size=%d%c", &n, &junk) == 1) {
       FLAGS_write_buffer_size = n;
+    } else if (sscanf(argv[i], "--max_write_buffer_number=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_max_write_buffer_number = n;
     } else if (sscanf(argv[i], "--max_file_size=%d%c", &n, &junk) == 1) {
       FLAGS_max_file_size = n;
+    } else if (sscanf(argv[i], "--max_bytes_for_level_base=%d%c", &n,
+                      &junk) == 1) {
+      FLAGS_max_bytes_for_level_base = n;
+    } else if (sscanf(argv[i], "--max_bytes_for_level_multiplier=%lf%c", &d,
+                      &junk) == 1) {
+      FLAGS_max_bytes_for_level_multiplier = d;
+    } else if (sscanf(argv[i], "--dynamic_level_bytes=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_dynamic_level_bytes = n;
+    } else if (sscanf(argv[i], "--universal=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_universal = n;
+    } else if (sscanf(argv[i], "--compaction_pri=%d%c", &n, &junk) == 1 &&
+               n >= 0 && n <= 2) {
+      FLAGS_compaction_pri = n;
     } else if (sscanf(argv[i], "--block_size=%d%c", &n, &junk) == 1) {
       FLAGS_block_size = n;
     } else if (sscanf(argv[i], "--key_prefix=%d%c", &n, &junk) == 1) {
       FLAGS_key_prefix = n;
     } else if (sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
       FLAGS_cache_size = n;
+    } else if (sscanf(argv[i], "--compressed_cache_size=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_compressed_cache_size = n;
+    } else if (sscanf(argv[i], "--cache_index_and_filter_blocks=%d%c", &n,
+                      &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_cache_index_and_filter_blocks = n;
+    } else if (sscanf(argv[i], "--use_direct_reads=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_use_direct_reads = n;
+    } else if (sscanf(argv[i],
+                      "--use_direct_io_for_flush_and_compaction=%d%c", &n,
+                      &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_use_direct_io_for_flush_and_compaction = n;
+    } else if (sscanf(argv[i], "--clock_cache=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_clock_cache = n;
     } else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
       FLAGS_bloom_bits = n;
+    } else if (sscanf(argv[i], "--blocked_bloom=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_blocked_bloom = n;
+    } else if (sscanf(argv[i], "--prefix_size=%d%c", &n, &junk) == 1) {
+      FLAGS_prefix_size = n;
+    } else if (sscanf(argv[i], "--learned_file_index=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_learned_file_index = n;
     } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
       FLAGS_open_files = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
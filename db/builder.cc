@@ -6,6 +6,7 @@
 
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "leveldb/db.h"
@@ -18,23 +19,33 @@
 namespace leveldb {
 
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta) {
+                  TableCache* table_cache, Iterator* iter, FileMetaData* meta,
+                  Iterator* range_del_iter) {
   Status s;
   meta->file_size = 0;
   iter->SeekToFirst();
+  bool has_range_deletions = false;
+  if (range_del_iter != nullptr) {
+    range_del_iter->SeekToFirst();
+    has_range_deletions = range_del_iter->Valid();
+  }
 
   std::string fname = TableFileName(dbname, meta->number);
-  if (iter->Valid()) {
+  if (iter->Valid() || has_range_deletions) {
     WritableFile* file;
-    s = env->NewWritableFile(fname, &file);
+    s = options.use_direct_io_for_flush_and_compaction
+            ? env->NewDirectWritableFile(fname, &file)
+            : env->NewWritableFile(fname, &file);
     if (!s.ok()) {
       return s;
     }
 
     //TableBuilder* builder = new TableBuilder(options, file);
     FixTableBuilder* builder = new FixTableBuilder(options, file);
-    meta->smallest.DecodeFrom(iter->key());
     Slice key;
+    if (iter->Valid()) {
+      meta->smallest.DecodeFrom(iter->key());
+    }
     for (; iter->Valid(); iter->Next()) {
       key = iter->key();
       builder->Add(key, iter->value());
@@ -43,10 +54,48 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
       meta->largest.DecodeFrom(key);
     }
 
+    // Widen the key range of the table to cover its tombstones, so that
+    // reads and compactions of the range find the table.
+    const Comparator* icmp = options.comparator;
+    bool has_bounds = !key.empty();
+    RangeTombstone t;
+    for (; has_range_deletions && range_del_iter->Valid();
+         range_del_iter->Next()) {
+      if (!ParseRangeTombstone(range_del_iter->key(), range_del_iter->value(),
+                               &t)) {
+        s = Status::Corruption("bad range tombstone");
+        break;
+      }
+      builder->AddRangeTombstone(range_del_iter->key(),
+                                 range_del_iter->value());
+      const InternalKey smallest = t.SmallestKey();
+      const InternalKey largest = t.LargestKey();
+      if (!has_bounds ||
+          icmp->Compare(smallest.Encode(), meta->smallest.Encode()) < 0) {
+        meta->smallest = smallest;
+      }
+      if (!has_bounds ||
+          icmp->Compare(largest.Encode(), meta->largest.Encode()) > 0) {
+        meta->largest = largest;
+      }
+      has_bounds = true;
+    }
+    if (has_range_deletions && s.ok()) {
+      s = range_del_iter->status();
+    }
+
     // Finish and check for builder errors
-    s = builder->Finish();
     if (s.ok()) {
+      s = builder->Finish();
+    } else {
+      builder->Abandon();
+    }
+    if (s.ok()) {
+      const TableProperties& props = builder->GetTableProperties();
       meta->file_size = builder->FileSize();
+      meta->num_entries = props.num_entries;
+      meta->num_deletions = props.num_deletions;
+      meta->num_range_deletions = props.num_range_deletions;
       assert(meta->file_size > 0);
     }
     delete builder;
@@ -62,9 +111,10 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
     file = nullptr;
 
     if (s.ok()) {
-      // Verify that the table is usable
+      // Verify that the table is usable.  Flushed tables almost always
+      // start out in level-0.
       Iterator* it = table_cache->NewIterator(ReadOptions(), meta->number,
-                                              meta->file_size);
+                                              meta->file_size, 0);
       s = it->status();
       delete it;
     }
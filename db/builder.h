@@ -17,13 +17,16 @@ class Iterator;
 class TableCache;
 class VersionEdit;
 
-// Build a Table file from the contents of *iter.  The generated file
-// will be named according to meta->number.  On success, the rest of
-// *meta will be filled with metadata about the generated table.
-// If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// Build a Table file from the contents of *iter and the range tombstones
+// of *range_del_iter, if not nullptr.  The generated file will be named
+// according to meta->number.  On success, the rest of *meta will be
+// filled with metadata about the generated table; its key range covers
+// the tombstones too.  If neither iterator yields anything,
+// meta->file_size will be set to zero, and no Table file will be
+// produced.
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+                  TableCache* table_cache, Iterator* iter, FileMetaData* meta,
+                  Iterator* range_del_iter = nullptr);
 
 }  // namespace leveldb
 
@@ -19,6 +19,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
@@ -36,6 +37,7 @@
 #include "util/mutexlock.h"
 
 //固定键值长度
+#include "merge_test/fix_table.h"
 #include "merge_test/fix_table_builder.h"
 
 namespace leveldb {
@@ -59,14 +61,19 @@ struct DBImpl::CompactionState {
   struct Output {
     uint64_t number;
     uint64_t file_size;
+    uint64_t num_entries;
+    uint64_t num_deletions;
+    uint64_t num_range_deletions;
     InternalKey smallest, largest;
   };
 
   Output* current_output() { return &outputs[outputs.size() - 1]; }
 
-  explicit CompactionState(Compaction* c)
+  CompactionState(Compaction* c, const Comparator* ucmp)
       : compaction(c),
         smallest_snapshot(0),
+        covering_tombstones(ucmp),
+        has_range_tombstone_lower(false),
         outfile(nullptr),
         builder(nullptr),
         total_bytes(0) {}
@@ -79,6 +86,17 @@ struct DBImpl::CompactionState {
   // we can drop all entries for the same key with sequence numbers < S.
   SequenceNumber smallest_snapshot;
 
+  // Range tombstones of the inputs that every snapshot sees.  The entries
+  // they hide are dropped.
+  RangeTombstoneList covering_tombstones;
+
+  // Range tombstones of the inputs that the outputs keep.  Each output
+  // stores their pieces between its first user key and the first user key
+  // of the next output, starting from range_tombstone_lower if set.
+  std::vector<RangeTombstone> range_tombstones;
+  bool has_range_tombstone_lower;
+  std::string range_tombstone_lower;
+
   std::vector<Output> outputs;
 
   // State kept for output being generated
@@ -104,7 +122,17 @@ Options SanitizeOptions(const std::string& dbname,
   ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
   ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
   ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
+  ClipToRange(&result.max_manifest_file_size, 1 << 10, 1 << 30);
+  ClipToRange(&result.max_bytes_for_level_base, 64 << 10, 1 << 30);
+  ClipToRange(&result.max_bytes_for_level_multiplier, 2.0, 1000.0);
+  ClipToRange(&result.universal_size_ratio, 0, 100);
+  ClipToRange(&result.universal_min_merge_width, 2,
+              config::kL0_CompactionTrigger);
+  ClipToRange(&result.universal_max_size_amplification_percent, 1, 1000000);
   ClipToRange(&result.block_size, 1 << 10, 4 << 20);
+  ClipToRange(&result.max_write_buffer_number, 2, 64);
+  ClipToRange(&result.preload_table_levels, 0, config::kNumLevels);
+  ClipToRange(&result.preload_table_threads, 1, 64);
   if (result.info_log == nullptr) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -118,9 +146,21 @@ Options SanitizeOptions(const std::string& dbname,
   if (result.block_cache == nullptr) {
     result.block_cache = NewLRUCache(8 << 20);
   }
+  if (result.compressed_block_cache == result.block_cache) {
+    // Blocks move to the compressed cache when the block cache evicts them,
+    // so the two must be different caches.
+    result.compressed_block_cache = nullptr;
+  }
   return result;
 }
 
+// Keep enough free regions around to rebuild every write buffer.
+static size_t MaxFreeArenaRegions(const Options& sanitized_options) {
+  const size_t regions_per_buffer =
+      sanitized_options.write_buffer_size / ArenaRegionPool::kRegionSize + 1;
+  return regions_per_buffer * sanitized_options.max_write_buffer_number;
+}
+
 static int TableCacheSize(const Options& sanitized_options) {
   // Reserve ten files or so for other uses and give the rest to TableCache.
   return sanitized_options.max_open_files - kNumNonTableCacheFiles;
@@ -129,28 +169,40 @@ static int TableCacheSize(const Options& sanitized_options) {
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
     : env_(raw_options.env),
       internal_comparator_(raw_options.comparator),
-      internal_filter_policy_(raw_options.filter_policy),
+      internal_filter_policy_(raw_options.filter_policy,
+                              raw_options.prefix_extractor),
       options_(SanitizeOptions(dbname, &internal_comparator_,
                                &internal_filter_policy_, raw_options)),
       owns_info_log_(options_.info_log != raw_options.info_log),
       owns_cache_(options_.block_cache != raw_options.block_cache),
       dbname_(dbname),
       table_cache_(new TableCache(dbname_, options_, TableCacheSize(options_))),
+      arena_pool_(options_.memtable_huge_pages
+                      ? new ArenaRegionPool(MaxFreeArenaRegions(options_))
+                      : nullptr),
       db_lock_(nullptr),
       shutting_down_(false),
       background_work_finished_signal_(&mutex_),
       mem_(nullptr),
-      imm_(nullptr),
       has_imm_(false),
       logfile_(nullptr),
       logfile_number_(0),
       log_(nullptr),
       seed_(0),
       tmp_batch_(new WriteBatch),
+      wal_sync_cv_(&mutex_),
+      wal_sync_done_cv_(&mutex_),
+      wal_sync_requested_seq_(0),
+      wal_synced_seq_(0),
+      wal_sync_in_progress_(false),
+      wal_sync_thread_running_(false),
+      write_controller_(options_.delayed_write_rate),
       background_compaction_scheduled_(false),
+      ingesting_(false),
       manual_compaction_(nullptr),
       versions_(new VersionSet(dbname_, &options_, table_cache_,
-                               &internal_comparator_)) {}
+                               &internal_comparator_)),
+      flushed_bytes_(0) {}
 
 DBImpl::~DBImpl() {
   // Wait for background work to finish.
@@ -159,6 +211,10 @@ DBImpl::~DBImpl() {
   while (background_compaction_scheduled_) {
     background_work_finished_signal_.Wait();
   }
+  wal_sync_cv_.Signal();
+  while (wal_sync_thread_running_) {
+    wal_sync_done_cv_.Wait();
+  }
   mutex_.Unlock();
 
   if (db_lock_ != nullptr) {
@@ -167,7 +223,10 @@ DBImpl::~DBImpl() {
 
   delete versions_;
   if (mem_ != nullptr) mem_->Unref();
-  if (imm_ != nullptr) imm_->Unref();
+  for (size_t i = 0; i < imm_.size(); i++) {
+    imm_[i].mem->Unref();
+  }
+  delete arena_pool_;
   delete tmp_batch_;
   delete log_;
   delete logfile_;
@@ -441,7 +500,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     WriteBatchInternal::SetContents(&batch, record);
 
     if (mem == nullptr) {
-      mem = new MemTable(internal_comparator_);
+      mem = new MemTable(internal_comparator_, arena_pool_);
       mem->Ref();
     }
     status = WriteBatchInternal::InsertInto(&batch, mem);
@@ -458,7 +517,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
       compactions++;
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      status = WriteLevel0Table(&mem, 1, edit, nullptr);
       mem->Unref();
       mem = nullptr;
       if (!status.ok()) {
@@ -487,7 +546,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
         mem = nullptr;
       } else {
         // mem can be nullptr if lognum exists but was empty.
-        mem_ = new MemTable(internal_comparator_);
+        mem_ = new MemTable(internal_comparator_, arena_pool_);
         mem_->Ref();
       }
     }
@@ -497,7 +556,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     // mem did not get reused; compact it.
     if (status.ok()) {
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      status = WriteLevel0Table(&mem, 1, edit, nullptr);
     }
     mem->Unref();
   }
@@ -505,21 +564,38 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
   return status;
 }
 
-Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
-                                Version* base) {
+Status DBImpl::WriteLevel0Table(MemTable* const* mems, int n,
+                                VersionEdit* edit, Version* base) {
   mutex_.AssertHeld();
+  assert(n > 0);
   const uint64_t start_micros = env_->NowMicros();
   FileMetaData meta;
   meta.number = versions_->NewFileNumber();
   pending_outputs_.insert(meta.number);
-  Iterator* iter = mem->NewIterator();
+  Iterator* iter;
+  Iterator* range_del_iter;
+  if (n == 1) {
+    iter = mems[0]->NewIterator();
+    range_del_iter = mems[0]->NewRangeTombstoneIterator();
+  } else {
+    std::vector<Iterator*> list;
+    std::vector<Iterator*> range_del_list;
+    for (int i = 0; i < n; i++) {
+      list.push_back(mems[i]->NewIterator());
+      range_del_list.push_back(mems[i]->NewRangeTombstoneIterator());
+    }
+    iter = NewMergingIterator(&internal_comparator_, &list[0], n);
+    range_del_iter =
+        NewMergingIterator(&internal_comparator_, &range_del_list[0], n);
+  }
   Log(options_.info_log, "Level-0 table #%llu: started",
       (unsigned long long)meta.number);
 
   Status s;
   {
     mutex_.Unlock();
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta,
+                   range_del_iter);
     mutex_.Lock();
   }
 
@@ -527,6 +603,7 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
       (unsigned long long)meta.number, (unsigned long long)meta.file_size,
       s.ToString().c_str());
   delete iter;
+  delete range_del_iter;
   pending_outputs_.erase(meta.number);
 
   // Note that if file_size is zero, the file has been deleted and
@@ -538,26 +615,35 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     if (base != nullptr) {
       level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
     }
-    edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
-                  meta.largest);
+    edit->AddFile(level, meta);
   }
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros;
   stats.bytes_written = meta.file_size;
   stats_[level].Add(stats);
+  flushed_bytes_ += meta.file_size;
+  write_controller_.RecordCompaction(stats.bytes_written, stats.micros);
   return s;
 }
 
 void DBImpl::CompactMemTable() {
   mutex_.AssertHeld();
-  assert(imm_ != nullptr);
+  assert(!imm_.empty());
 
-  // Save the contents of the memtable as a new Table
+  // Save the contents of every memtable queued so far as a single new
+  // Table.  Writers may retire more memtables while we work; those are
+  // left for the next round.
+  std::vector<MemTable*> mems;
+  for (size_t i = 0; i < imm_.size(); i++) {
+    mems.push_back(imm_[i].mem);
+  }
+  const uint64_t next_log_number = imm_.back().next_log_number;
   VersionEdit edit;
   Version* base = versions_->current();
   base->Ref();
-  Status s = WriteLevel0Table(imm_, &edit, base);
+  Status s = WriteLevel0Table(&mems[0], static_cast<int>(mems.size()), &edit,
+                              base);
   base->Unref();
 
   if (s.ok() && shutting_down_.load(std::memory_order_acquire)) {
@@ -567,15 +653,18 @@ void DBImpl::CompactMemTable() {
   // Replace immutable memtable with the generated Table
   if (s.ok()) {
     edit.SetPrevLogNumber(0);
-    edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
+    edit.SetLogNumber(next_log_number);  // Earlier logs no longer needed
     s = versions_->LogAndApply(&edit, &mutex_);
   }
 
   if (s.ok()) {
     // Commit to the new state
-    imm_->Unref();
-    imm_ = nullptr;
-    has_imm_.store(false, std::memory_order_release);
+    for (size_t i = 0; i < mems.size(); i++) {
+      assert(imm_.front().mem == mems[i]);
+      imm_.front().mem->Unref();
+      imm_.pop_front();
+    }
+    has_imm_.store(!imm_.empty(), std::memory_order_release);
     RemoveObsoleteFiles();
   } else {
     RecordBackgroundError(s);
@@ -644,10 +733,10 @@ Status DBImpl::TEST_CompactMemTable() {
   if (s.ok()) {
     // Wait until the compaction completes
     MutexLock l(&mutex_);
-    while (imm_ != nullptr && bg_error_.ok()) {
+    while (!imm_.empty() && bg_error_.ok()) {
       background_work_finished_signal_.Wait();
     }
-    if (imm_ != nullptr) {
+    if (!imm_.empty()) {
       s = bg_error_;
     }
   }
@@ -659,7 +748,134 @@ void DBImpl::RecordBackgroundError(const Status& s) {
   if (bg_error_.ok()) {
     bg_error_ = s;
     background_work_finished_signal_.SignalAll();
+    wal_sync_done_cv_.SignalAll();
+  }
+}
+
+Status DBImpl::AwaitWalSync(SequenceNumber seq) {
+  mutex_.AssertHeld();
+  if (seq > wal_sync_requested_seq_) {
+    wal_sync_requested_seq_ = seq;
+    wal_sync_cv_.Signal();
+  }
+  while (wal_synced_seq_ < seq && bg_error_.ok()) {
+    wal_sync_done_cv_.Wait();
+  }
+  return (wal_synced_seq_ >= seq) ? Status::OK() : bg_error_;
+}
+
+namespace {
+
+// The tables DBImpl::PreloadTables() opens, shared by its threads.
+struct PreloadState {
+  explicit PreloadState(TableCache* cache)
+      : table_cache(cache), done(&mu), next(0), running(0) {}
+
+  TableCache* const table_cache;
+  std::vector<std::pair<int, FileMetaData*>> files;  // (level, file)
+
+  port::Mutex mu;
+  port::CondVar done;  // Signalled when the last thread finishes
+  size_t next GUARDED_BY(mu);
+  int running GUARDED_BY(mu);
+  Status status GUARDED_BY(mu);
+};
+
+void PreloadThreadMain(void* arg) {
+  PreloadState* state = reinterpret_cast<PreloadState*>(arg);
+  MutexLock l(&state->mu);
+  while (state->next < state->files.size()) {
+    const int level = state->files[state->next].first;
+    const FileMetaData* f = state->files[state->next].second;
+    state->next++;
+    state->mu.Unlock();
+    Status s = state->table_cache->Preload(f->number, f->file_size, level);
+    state->mu.Lock();
+    if (state->status.ok()) {
+      state->status = s;
+    }
+  }
+  if (--state->running == 0) {
+    state->done.SignalAll();
+  }
+}
+
+}  // namespace
+
+Status DBImpl::PreloadTables() {
+  mutex_.AssertHeld();
+  Version* v = versions_->current();
+  v->Ref();
+  PreloadState state(table_cache_);
+  const size_t max_tables = TableCacheSize(options_);
+  for (int level = 0; level < options_.preload_table_levels; level++) {
+    std::vector<FileMetaData*> files;
+    v->GetOverlappingInputs(level, nullptr, nullptr, &files);
+    for (size_t i = 0; i < files.size() && state.files.size() < max_tables;
+         i++) {
+      state.files.push_back(std::make_pair(level, files[i]));
+    }
+  }
+  mutex_.Unlock();
+
+  const uint64_t start_micros = env_->NowMicros();
+  const int threads = static_cast<int>(std::min<size_t>(
+      options_.preload_table_threads, state.files.size()));
+  state.mu.Lock();
+  state.running = threads;
+  state.mu.Unlock();
+  for (int i = 0; i < threads; i++) {
+    env_->StartThread(&PreloadThreadMain, &state);
+  }
+  state.mu.Lock();
+  while (state.running > 0) {
+    state.done.Wait();
+  }
+  const Status s = state.status;
+  state.mu.Unlock();
+  Log(options_.info_log, "Preloaded %d tables in %llu micros: %s\n",
+      static_cast<int>(state.files.size()),
+      static_cast<unsigned long long>(env_->NowMicros() - start_micros),
+      s.ToString().c_str());
+
+  mutex_.Lock();
+  v->Unref();
+  return s;
+}
+
+void DBImpl::WalSyncThreadEntry(void* db) {
+  reinterpret_cast<DBImpl*>(db)->WalSyncThreadMain();
+}
+
+void DBImpl::WalSyncThreadMain() {
+  MutexLock l(&mutex_);
+  while (!shutting_down_.load(std::memory_order_acquire)) {
+    if (wal_synced_seq_ >= wal_sync_requested_seq_ || !bg_error_.ok()) {
+      wal_sync_cv_.Wait();
+      continue;
+    }
+
+    // Every record up to the requested sequence has already been appended
+    // and flushed to the current log file by its write group, so a single
+    // sync covers all writers that asked for one since the last sync.
+    const SequenceNumber target = wal_sync_requested_seq_;
+    WritableFile* file = logfile_;
+    wal_sync_in_progress_ = true;
+    mutex_.Unlock();
+    Status s = file->SyncFlushed();
+    mutex_.Lock();
+    wal_sync_in_progress_ = false;
+    if (s.ok()) {
+      wal_synced_seq_ = target;
+    } else {
+      // Same reasoning as a failed inline sync in Write(): the log is now
+      // in an indeterminate state, so fail all future writes.
+      RecordBackgroundError(s);
+    }
+    wal_sync_done_cv_.SignalAll();
   }
+  wal_sync_thread_running_ = false;
+  wal_sync_done_cv_.SignalAll();
 }
 
 void DBImpl::MaybeScheduleCompaction() {
@@ -670,7 +886,9 @@ void DBImpl::MaybeScheduleCompaction() {
     // DB is being deleted; no more background compactions
   } else if (!bg_error_.ok()) {
     // Already got an error; no more changes
-  } else if (imm_ == nullptr && manual_compaction_ == nullptr &&
+  } else if (ingesting_) {
+    // IngestExternalFile() schedules compactions once it is done
+  } else if (imm_.empty() && manual_compaction_ == nullptr &&
              !versions_->NeedsCompaction()) {
     // No work to be done
   } else {
@@ -705,7 +923,7 @@ void DBImpl::BackgroundCall() {
 void DBImpl::BackgroundCompaction() {
   mutex_.AssertHeld();
 
-  if (imm_ != nullptr) {
+  if (!imm_.empty()) {
     CompactMemTable();
     return;
   }
@@ -733,23 +951,22 @@ void DBImpl::BackgroundCompaction() {
   if (c == nullptr) {
     // Nothing to do
   } else if (!is_manual && c->IsTrivialMove()) {
-    // Move file to next level
+    // Move file to the output level
     assert(c->num_input_files(0) == 1);
     FileMetaData* f = c->input(0, 0);
     c->edit()->RemoveFile(c->level(), f->number);
-    c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
-                       f->largest);
+    c->edit()->AddFile(c->output_level(), *f);
     status = versions_->LogAndApply(c->edit(), &mutex_);
     if (!status.ok()) {
       RecordBackgroundError(status);
     }
     VersionSet::LevelSummaryStorage tmp;
     Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
-        static_cast<unsigned long long>(f->number), c->level() + 1,
+        static_cast<unsigned long long>(f->number), c->output_level(),
         static_cast<unsigned long long>(f->file_size),
         status.ToString().c_str(), versions_->LevelSummary(&tmp));
   } else {
-    CompactionState* compact = new CompactionState(c);
+    CompactionState* compact = new CompactionState(c, user_comparator());
     status = DoCompactionWork(compact);
     if (!status.ok()) {
       RecordBackgroundError(status);
@@ -810,6 +1027,9 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
     pending_outputs_.insert(file_number);
     CompactionState::Output out;
     out.number = file_number;
+    out.num_entries = 0;
+    out.num_deletions = 0;
+    out.num_range_deletions = 0;
     out.smallest.Clear();
     out.largest.Clear();
     compact->outputs.push_back(out);
@@ -818,7 +1038,9 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
 
   // Make the output file
   std::string fname = TableFileName(dbname_, file_number);
-  Status s = env_->NewWritableFile(fname, &compact->outfile);
+  Status s = options_.use_direct_io_for_flush_and_compaction
+                 ? env_->NewDirectWritableFile(fname, &compact->outfile)
+                 : env_->NewWritableFile(fname, &compact->outfile);
   if (s.ok()) {
     //compact->builder = new TableBuilder(options_, compact->outfile);
     compact->builder = new FixTableBuilder(options_, compact->outfile);
@@ -838,13 +1060,58 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   // Check for iterator errors
   Status s = input->status();
   const uint64_t current_entries = compact->builder->NumEntries();
+  if (s.ok() && !compact->range_tombstones.empty()) {
+    // Store the pieces of the tombstones up to the first user key of the
+    // next output, which is at or after the key "input" is positioned at,
+    // and widen the key range of the output to cover them.
+    const Comparator* ucmp = user_comparator();
+    const bool has_upper = input->Valid() && input->key().size() >= 8;
+    std::string upper;
+    if (has_upper) {
+      upper = ExtractUserKey(input->key()).ToString();
+    }
+    CompactionState::Output* out = compact->current_output();
+    bool has_bounds = current_entries > 0;
+    for (const RangeTombstone& t : compact->range_tombstones) {
+      RangeTombstone piece = t;
+      if (compact->has_range_tombstone_lower &&
+          ucmp->Compare(piece.begin, compact->range_tombstone_lower) < 0) {
+        piece.begin = compact->range_tombstone_lower;
+      }
+      if (has_upper && ucmp->Compare(piece.end, upper) > 0) {
+        piece.end = upper;
+      }
+      if (ucmp->Compare(piece.begin, piece.end) >= 0) {
+        continue;
+      }
+      compact->builder->AddRangeTombstone(piece.StartKey().Encode(),
+                                          piece.end);
+      const InternalKey smallest = piece.SmallestKey();
+      const InternalKey largest = piece.LargestKey();
+      if (!has_bounds || internal_comparator_.Compare(smallest,
+                                                      out->smallest) < 0) {
+        out->smallest = smallest;
+      }
+      if (!has_bounds ||
+          internal_comparator_.Compare(largest, out->largest) > 0) {
+        out->largest = largest;
+      }
+      has_bounds = true;
+    }
+    compact->has_range_tombstone_lower = has_upper;
+    compact->range_tombstone_lower = upper;
+  }
   if (s.ok()) {
     s = compact->builder->Finish();
   } else {
     compact->builder->Abandon();
   }
   const uint64_t current_bytes = compact->builder->FileSize();
+  const TableProperties& props = compact->builder->GetTableProperties();
   compact->current_output()->file_size = current_bytes;
+  compact->current_output()->num_entries = props.num_entries;
+  compact->current_output()->num_deletions = props.num_deletions;
+  compact->current_output()->num_range_deletions = props.num_range_deletions;
   compact->total_bytes += current_bytes;
   delete compact->builder;
   compact->builder = nullptr;
@@ -862,7 +1129,8 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   if (s.ok() && current_entries > 0) {
     // Verify that the table is usable
     Iterator* iter =
-        table_cache_->NewIterator(ReadOptions(), output_number, current_bytes);
+        table_cache_->NewIterator(ReadOptions(), output_number, current_bytes,
+                                  compact->compaction->output_level());
     s = iter->status();
     delete iter;
     if (s.ok()) {
@@ -879,16 +1147,24 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   mutex_.AssertHeld();
   Log(options_.info_log, "Compacted %d@%d + %d@%d files => %lld bytes",
       compact->compaction->num_input_files(0), compact->compaction->level(),
-      compact->compaction->num_input_files(1), compact->compaction->level() + 1,
+      compact->compaction->num_input_files(1),
+      compact->compaction->output_level(),
       static_cast<long long>(compact->total_bytes));
 
   // Add compaction outputs
   compact->compaction->AddInputDeletions(compact->compaction->edit());
-  const int level = compact->compaction->level();
+  const int level = compact->compaction->output_level();
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
-    compact->compaction->edit()->AddFile(level + 1, out.number, out.file_size,
-                                         out.smallest, out.largest);
+    FileMetaData f;
+    f.number = out.number;
+    f.file_size = out.file_size;
+    f.smallest = out.smallest;
+    f.largest = out.largest;
+    f.num_entries = out.num_entries;
+    f.num_deletions = out.num_deletions;
+    f.num_range_deletions = out.num_range_deletions;
+    compact->compaction->edit()->AddFile(level, f);
   }
   return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
 }
@@ -900,7 +1176,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   Log(options_.info_log, "Compacting %d@%d + %d@%d files",
       compact->compaction->num_input_files(0), compact->compaction->level(),
       compact->compaction->num_input_files(1),
-      compact->compaction->level() + 1);
+      compact->compaction->output_level());
 
   assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
   assert(compact->builder == nullptr);
@@ -911,23 +1187,37 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
   }
 
-  Iterator* input = versions_->MakeInputIterator(compact->compaction);
-
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
+  // Read the range tombstones first, so that the input files they hide
+  // entirely are not read at all.  A tombstone every snapshot sees can be
+  // dropped once no level below the output holds keys in its range.
+  std::vector<RangeTombstone> tombstones;
+  Status status = compact->compaction->ReadRangeTombstones(
+      compact->smallest_snapshot, &tombstones, &compact->covering_tombstones);
+  for (const RangeTombstone& t : tombstones) {
+    if (t.seq > compact->smallest_snapshot ||
+        !compact->compaction->IsBaseLevelForRange(t.begin, t.end)) {
+      compact->range_tombstones.push_back(t);
+    }
+  }
+
+  Iterator* input = status.ok()
+                        ? versions_->MakeInputIterator(compact->compaction)
+                        : NewErrorIterator(status);
   input->SeekToFirst();
-  Status status;
   ParsedInternalKey ikey;
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
+  bool finish_output = false;
   while (input->Valid() && !shutting_down_.load(std::memory_order_acquire)) {
     // Prioritize immutable compaction work
     if (has_imm_.load(std::memory_order_relaxed)) {
       const uint64_t imm_start = env_->NowMicros();
       mutex_.Lock();
-      if (imm_ != nullptr) {
+      if (!imm_.empty()) {
         CompactMemTable();
         // Wake up MakeRoomForWrite() if necessary.
         background_work_finished_signal_.SignalAll();
@@ -939,9 +1229,21 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     Slice key = input->key();
     if (compact->compaction->ShouldStopBefore(key) &&
         compact->builder != nullptr) {
-      status = FinishCompactionOutputFile(compact, input);
-      if (!status.ok()) {
-        break;
+      finish_output = true;
+    }
+    if (finish_output) {
+      // The outputs split the kept range tombstones at user key
+      // boundaries, so every entry for a user key must go to one output.
+      if (compact->range_tombstones.empty() ||
+          (key.size() >= 8 &&
+           user_comparator()->Compare(
+               ExtractUserKey(key),
+               compact->current_output()->largest.user_key()) != 0)) {
+        finish_output = false;
+        status = FinishCompactionOutputFile(compact, input);
+        if (!status.ok()) {
+          break;
+        }
       }
     }
 
@@ -976,6 +1278,11 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         //     few iterations of this loop (by rule (A) above).
         // Therefore this deletion marker is obsolete and can be dropped.
         drop = true;
+      } else if (!compact->covering_tombstones.empty() &&
+                 ikey.sequence < compact->covering_tombstones
+                                     .MaxCoveringSequence(ikey.user_key)) {
+        // Hidden by a range tombstone that every snapshot sees
+        drop = true;
       }
 
       last_sequence_for_key = ikey.sequence;
@@ -1004,13 +1311,10 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
       compact->current_output()->largest.DecodeFrom(key);
       compact->builder->Add(key, input->value());
 
-      // Close output file if it is big enough
+      // Close output file before the next user key if it is big enough
       if (compact->builder->FileSize() >=
           compact->compaction->MaxOutputFileSize()) {
-        status = FinishCompactionOutputFile(compact, input);
-        if (!status.ok()) {
-          break;
-        }
+        finish_output = true;
       }
     }
 
@@ -1020,6 +1324,18 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   if (status.ok() && shutting_down_.load(std::memory_order_acquire)) {
     status = Status::IOError("Deleting DB during compaction");
   }
+  if (status.ok() && compact->builder == nullptr) {
+    // Kept tombstones past the last output, or with no entries at all,
+    // still need an output of their own.
+    for (const RangeTombstone& t : compact->range_tombstones) {
+      if (!compact->has_range_tombstone_lower ||
+          user_comparator()->Compare(t.end,
+                                     compact->range_tombstone_lower) > 0) {
+        status = OpenCompactionOutputFile(compact);
+        break;
+      }
+    }
+  }
   if (status.ok() && compact->builder != nullptr) {
     status = FinishCompactionOutputFile(compact, input);
   }
@@ -1031,17 +1347,14 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros - imm_micros;
-  for (int which = 0; which < 2; which++) {
-    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
-      stats.bytes_read += compact->compaction->input(which, i)->file_size;
-    }
-  }
+  stats.bytes_read = compact->compaction->TotalInputSize();
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     stats.bytes_written += compact->outputs[i].file_size;
   }
 
   mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
+  stats_[compact->compaction->output_level()].Add(stats);
+  write_controller_.RecordCompaction(stats.bytes_written, stats.micros);
 
   if (status.ok()) {
     status = InstallCompactionResults(compact);
@@ -1060,17 +1373,19 @@ struct IterState {
   port::Mutex* const mu;
   Version* const version GUARDED_BY(mu);
   MemTable* const mem GUARDED_BY(mu);
-  MemTable* const imm GUARDED_BY(mu);
+  std::vector<MemTable*> imms GUARDED_BY(mu);
 
-  IterState(port::Mutex* mutex, MemTable* mem, MemTable* imm, Version* version)
-      : mu(mutex), version(version), mem(mem), imm(imm) {}
+  IterState(port::Mutex* mutex, MemTable* mem, Version* version)
+      : mu(mutex), version(version), mem(mem) {}
 };
 
 static void CleanupIteratorState(void* arg1, void* arg2) {
   IterState* state = reinterpret_cast<IterState*>(arg1);
   state->mu->Lock();
   state->mem->Unref();
-  if (state->imm != nullptr) state->imm->Unref();
+  for (size_t i = 0; i < state->imms.size(); i++) {
+    state->imms[i]->Unref();
+  }
   state->version->Unref();
   state->mu->Unlock();
   delete state;
@@ -1080,28 +1395,54 @@ static void CleanupIteratorState(void* arg1, void* arg2) {
 
 Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
                                       SequenceNumber* latest_snapshot,
-                                      uint32_t* seed) {
+                                      uint32_t* seed,
+                                      RangeTombstoneList* range_tombstones) {
   mutex_.Lock();
   *latest_snapshot = versions_->LastSequence();
 
+  if (range_tombstones != nullptr) {
+    std::vector<MemTable*> mems;
+    mems.push_back(mem_);
+    for (size_t i = 0; i < imm_.size(); i++) {
+      mems.push_back(imm_[i].mem);
+    }
+    for (MemTable* mem : mems) {
+      Iterator* iter = mem->NewRangeTombstoneIterator();
+      range_tombstones->AddFromIterator(iter);
+      delete iter;
+    }
+  }
+
   // Collect together all needed child iterators
+  Version* current = versions_->current();
+  IterState* cleanup = new IterState(&mutex_, mem_, current);
   std::vector<Iterator*> list;
   list.push_back(mem_->NewIterator());
   mem_->Ref();
-  if (imm_ != nullptr) {
-    list.push_back(imm_->NewIterator());
-    imm_->Ref();
+  for (size_t i = 0; i < imm_.size(); i++) {
+    list.push_back(imm_[i].mem->NewIterator());
+    imm_[i].mem->Ref();
+    cleanup->imms.push_back(imm_[i].mem);
   }
-  versions_->current()->AddIterators(options, &list);
+  current->AddIterators(options, &list);
   Iterator* internal_iter =
       NewMergingIterator(&internal_comparator_, &list[0], list.size());
-  versions_->current()->Ref();
+  current->Ref();
 
-  IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
   internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
 
   *seed = ++seed_;
   mutex_.Unlock();
+
+  // Reading the tombstones of the tables may do I/O, so it happens without
+  // the mutex.  The reference internal_iter holds keeps "current" alive.
+  if (range_tombstones != nullptr) {
+    Status s = current->AddRangeTombstones(options, range_tombstones);
+    if (!s.ok()) {
+      delete internal_iter;
+      return NewErrorIterator(s);
+    }
+  }
   return internal_iter;
 }
 
@@ -1116,6 +1457,11 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
   return versions_->MaxNextLevelOverlappingBytes();
 }
 
+std::string DBImpl::TEST_PickFileByPriority(int level) {
+  MutexLock l(&mutex_);
+  return versions_->PickFileByPriority(level)->smallest.user_key().ToString();
+}
+
 Status DBImpl::Get(const ReadOptions& options, const Slice& key,
                    std::string* value) {
   Status s;
@@ -1129,10 +1475,13 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
   }
 
   MemTable* mem = mem_;
-  MemTable* imm = imm_;
+  std::vector<MemTable*> imms;  // Newest first
   Version* current = versions_->current();
   mem->Ref();
-  if (imm != nullptr) imm->Ref();
+  for (size_t i = imm_.size(); i > 0; i--) {
+    imms.push_back(imm_[i - 1].mem);
+    imms.back()->Ref();
+  }
   current->Ref();
 
   bool have_stat_update = false;
@@ -1141,13 +1490,14 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
   // Unlock while reading from files and memtables
   {
     mutex_.Unlock();
-    // First look in the memtable, then in the immutable memtable (if any).
+    // First look in the memtable, then in the immutable memtables from
+    // newest to oldest.
     LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
-      // Done
-    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
-      // Done
-    } else {
+    bool done = mem->Get(lkey, value, &s);
+    for (size_t i = 0; !done && i < imms.size(); i++) {
+      done = imms[i]->Get(lkey, value, &s);
+    }
+    if (!done) {
       s = current->Get(options, lkey, value, &stats);
       have_stat_update = true;
     }
@@ -1158,21 +1508,132 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
     MaybeScheduleCompaction();
   }
   mem->Unref();
-  if (imm != nullptr) imm->Unref();
+  for (size_t i = 0; i < imms.size(); i++) {
+    imms[i]->Unref();
+  }
   current->Unref();
   return s;
 }
 
+std::vector<Status> DBImpl::MultiGet(const ReadOptions& options,
+                                     const std::vector<Slice>& keys,
+                                     std::vector<std::string>* values) {
+  const size_t n = keys.size();
+  std::vector<Status> statuses(n);
+  values->resize(n);
+  if (n == 1) {
+    // Nothing to batch; skip the bookkeeping.
+    statuses[0] = Get(options, keys[0], &(*values)[0]);
+    return statuses;
+  }
+
+  MutexLock l(&mutex_);
+  SequenceNumber snapshot;
+  if (options.snapshot != nullptr) {
+    snapshot =
+        static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  MemTable* mem = mem_;
+  std::vector<MemTable*> imms;  // Newest first
+  Version* current = versions_->current();
+  mem->Ref();
+  for (size_t i = imm_.size(); i > 0; i--) {
+    imms.push_back(imm_[i - 1].mem);
+    imms.back()->Ref();
+  }
+  current->Ref();
+
+  std::vector<Version::GetStats> stats;
+
+  // Unlock while reading from files and memtables
+  {
+    mutex_.Unlock();
+    // Keys the memtables cannot answer are looked up in the tables together,
+    // in key order so that each table is probed once for all of them.
+    std::vector<LookupKey*> lkeys;
+    std::vector<size_t> lindex;
+    for (size_t i = 0; i < n; i++) {
+      LookupKey* lkey = new LookupKey(keys[i], snapshot);
+      bool done = mem->Get(*lkey, &(*values)[i], &statuses[i]);
+      for (size_t j = 0; !done && j < imms.size(); j++) {
+        done = imms[j]->Get(*lkey, &(*values)[i], &statuses[i]);
+      }
+      if (done) {
+        delete lkey;
+      } else {
+        lkeys.push_back(lkey);
+        lindex.push_back(i);
+      }
+    }
+    if (!lkeys.empty()) {
+      const Comparator* ucmp = user_comparator();
+      std::vector<size_t> order(lkeys.size());
+      for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+      }
+      std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return ucmp->Compare(lkeys[a]->user_key(), lkeys[b]->user_key()) < 0;
+      });
+      std::vector<const LookupKey*> sorted_keys(order.size());
+      std::vector<std::string*> sorted_values(order.size());
+      for (size_t i = 0; i < order.size(); i++) {
+        sorted_keys[i] = lkeys[order[i]];
+        sorted_values[i] = &(*values)[lindex[order[i]]];
+      }
+      std::vector<Status> file_statuses;
+      current->MultiGet(options, sorted_keys, sorted_values, &file_statuses,
+                        &stats);
+      for (size_t i = 0; i < order.size(); i++) {
+        statuses[lindex[order[i]]] = file_statuses[i];
+      }
+      for (size_t i = 0; i < lkeys.size(); i++) {
+        delete lkeys[i];
+      }
+    }
+    mutex_.Lock();
+  }
+
+  bool compact = false;
+  for (size_t i = 0; i < stats.size(); i++) {
+    compact |= current->UpdateStats(stats[i]);
+  }
+  if (compact) {
+    MaybeScheduleCompaction();
+  }
+  mem->Unref();
+  for (size_t i = 0; i < imms.size(); i++) {
+    imms[i]->Unref();
+  }
+  current->Unref();
+  return statuses;
+}
+
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
   uint32_t seed;
-  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
-  return NewDBIterator(this, user_comparator(), iter,
-                       (options.snapshot != nullptr
-                            ? static_cast<const SnapshotImpl*>(options.snapshot)
-                                  ->sequence_number()
-                            : latest_snapshot),
-                       seed);
+  RangeTombstoneList* range_tombstones =
+      new RangeTombstoneList(user_comparator());
+  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed,
+                                       range_tombstones);
+  const SequenceNumber sequence =
+      (options.snapshot != nullptr
+           ? static_cast<const SnapshotImpl*>(options.snapshot)
+                 ->sequence_number()
+           : latest_snapshot);
+  range_tombstones->Finish(sequence);
+  if (range_tombstones->empty()) {
+    delete range_tombstones;
+    range_tombstones = nullptr;
+  }
+  return NewDBIterator(this, user_comparator(), iter, sequence, seed,
+                       options.iterate_lower_bound,
+                       options.iterate_upper_bound,
+                       options.prefix_same_as_start ? options_.prefix_extractor
+                                                    : nullptr,
+                       range_tombstones);
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1201,6 +1662,17 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
   return DB::Delete(options, key);
 }
 
+Status DBImpl::DeleteRange(const WriteOptions& options, const Slice& begin_key,
+                           const Slice& end_key) {
+  const int r = user_comparator()->Compare(begin_key, end_key);
+  if (r > 0) {
+    return Status::InvalidArgument("DeleteRange end key before begin key");
+  } else if (r == 0) {
+    return Status::OK();  // Empty range
+  }
+  return DB::DeleteRange(options, begin_key, end_key);
+}
+
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   Writer w(&mutex_);
   w.batch = updates;
@@ -1233,7 +1705,7 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
       mutex_.Unlock();
       status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
       bool sync_error = false;
-      if (status.ok() && options.sync) {
+      if (status.ok() && options.sync && !options_.background_wal_sync) {
         status = logfile_->Sync();
         if (!status.ok()) {
           sync_error = true;
@@ -1255,6 +1727,33 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     versions_->SetLastSequence(last_sequence);
   }
 
+  if (status.ok() && updates != nullptr && options.sync &&
+      options_.background_wal_sync) {
+    // Hand the write queue to the next group before waiting for the sync,
+    // so that it can append to the log while this group's records are
+    // being made durable.
+    std::vector<Writer*> group;
+    while (true) {
+      Writer* ready = writers_.front();
+      writers_.pop_front();
+      if (ready != &w) {
+        group.push_back(ready);
+      }
+      if (ready == last_writer) break;
+    }
+    if (!writers_.empty()) {
+      writers_.front()->cv.Signal();
+    }
+
+    status = AwaitWalSync(last_sequence);
+    for (Writer* ready : group) {
+      ready->status = status;
+      ready->done = true;
+      ready->cv.Signal();
+    }
+    return status;
+  }
+
   while (true) {
     Writer* ready = writers_.front();
     writers_.pop_front();
@@ -1274,6 +1773,15 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   return status;
 }
 
+static void AppendToGroup(WriteBatch* group, const WriteBatch* batch,
+                          bool pack) {
+  if (pack) {
+    WriteBatchInternal::AppendPacked(group, batch);
+  } else {
+    WriteBatchInternal::Append(group, batch);
+  }
+}
+
 // REQUIRES: Writer list must be non-empty
 // REQUIRES: First writer must have a non-null batch
 WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
@@ -1303,24 +1811,33 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
       break;
     }
 
-    if (w->batch != nullptr) {
-      size += WriteBatchInternal::ByteSize(w->batch);
-      if (size > max_size) {
-        // Do not make batch too big
-        break;
-      }
+    if (w->batch == nullptr) {
+      // Memtable switches and file ingestions do their work when they
+      // reach the front of the queue.
+      break;
+    }
 
-      // Append to *result
-      if (result == first->batch) {
-        // Switch to temporary batch instead of disturbing caller's batch
-        result = tmp_batch_;
-        assert(WriteBatchInternal::Count(result) == 0);
-        WriteBatchInternal::Append(result, first->batch);
-      }
-      WriteBatchInternal::Append(result, w->batch);
+    size += WriteBatchInternal::ByteSize(w->batch);
+    if (size > max_size) {
+      // Do not make batch too big
+      break;
     }
+
+    // Append to *result
+    if (result == first->batch) {
+      // Switch to temporary batch instead of disturbing caller's batch
+      result = tmp_batch_;
+      assert(WriteBatchInternal::Count(result) == 0);
+      AppendToGroup(result, first->batch, options_.pack_fixed_width_writes);
+    }
+    AppendToGroup(result, w->batch, options_.pack_fixed_width_writes);
     *last_writer = w;
   }
+  if (result == first->batch && options_.pack_fixed_width_writes) {
+    result = tmp_batch_;
+    assert(WriteBatchInternal::Count(result) == 0);
+    AppendToGroup(result, first->batch, options_.pack_fixed_width_writes);
+  }
   return result;
 }
 
@@ -1332,35 +1849,55 @@ Status DBImpl::MakeRoomForWrite(bool force) {
   bool allow_delay = !force;
   Status s;
   while (true) {
+    if (allow_delay) {
+      write_controller_.Update(versions_->NumLevelFiles(0),
+                               versions_->PendingCompactionBytes());
+    }
     if (!bg_error_.ok()) {
       // Yield previous error
       s = bg_error_;
       break;
-    } else if (allow_delay && versions_->NumLevelFiles(0) >=
-                                  config::kL0_SlowdownWritesTrigger) {
-      // We are getting close to hitting a hard limit on the number of
-      // L0 files.  Rather than delaying a single write by several
-      // seconds when we hit the hard limit, start delaying each
-      // individual write by 1ms to reduce latency variance.  Also,
-      // this delay hands over some CPU to the compaction thread in
-      // case it is sharing the same core as the writer.
-      mutex_.Unlock();
-      env_->SleepForMicroseconds(1000);
+    } else if (allow_delay && write_controller_.IsDelayed()) {
+      // Compactions are falling behind.  Rather than delaying a single
+      // write by several seconds when we hit the hard limit on L0
+      // files, pace each write so that the write rate tracks what
+      // compactions can absorb.  This also hands over some CPU to the
+      // compaction thread in case it is sharing the same core as the
+      // writer.
+      const uint64_t delay = write_controller_.GetDelay(
+          env_->NowMicros(),
+          WriteBatchInternal::ByteSize(writers_.front()->batch));
       allow_delay = false;  // Do not delay a single write more than once
-      mutex_.Lock();
+      if (delay > 0) {
+        mutex_.Unlock();
+        env_->SleepForMicroseconds(static_cast<int>(delay));
+        mutex_.Lock();
+        write_controller_.AddStallMicros(delay);
+      }
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
       break;
-    } else if (imm_ != nullptr) {
-      // We have filled up the current memtable, but the previous
-      // one is still being compacted, so we wait.
+    } else if (static_cast<int>(imm_.size()) >=
+               options_.max_write_buffer_number - 1) {
+      // We have filled up the current memtable, but as many previous
+      // ones as we are allowed to hold are still being compacted, so
+      // we wait.
       Log(options_.info_log, "Current memtable full; waiting...\n");
+      const uint64_t start_micros = env_->NowMicros();
       background_work_finished_signal_.Wait();
+      write_controller_.AddStallMicros(env_->NowMicros() - start_micros);
     } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
       // There are too many level-0 files.
       Log(options_.info_log, "Too many L0 files; waiting...\n");
+      const uint64_t start_micros = env_->NowMicros();
       background_work_finished_signal_.Wait();
+      write_controller_.AddStallMicros(env_->NowMicros() - start_micros);
+    } else if (wal_sync_in_progress_ ||
+               wal_synced_seq_ < wal_sync_requested_seq_) {
+      // The WAL sync thread still has work to do on the current log file;
+      // let it finish before the file is closed.
+      wal_sync_done_cv_.Wait();
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
@@ -1391,9 +1928,9 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       logfile_ = lfile;
       logfile_number_ = new_log_number;
       log_ = new log::Writer(lfile);
-      imm_ = mem_;
+      imm_.push_back(ImmutableMemTable{mem_, new_log_number});
       has_imm_.store(true, std::memory_order_release);
-      mem_ = new MemTable(internal_comparator_);
+      mem_ = new MemTable(internal_comparator_, arena_pool_);
       mem_->Ref();
       force = false;  // Do not force another compaction if have room
       MaybeScheduleCompaction();
@@ -1402,6 +1939,18 @@ Status DBImpl::MakeRoomForWrite(bool force) {
   return s;
 }
 
+double DBImpl::WriteAmplification() {
+  mutex_.AssertHeld();
+  if (flushed_bytes_ == 0) {
+    return 0;
+  }
+  uint64_t written = 0;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    written += stats_[level].bytes_written;
+  }
+  return static_cast<double>(written) / flushed_bytes_;
+}
+
 bool DBImpl::GetProperty(const Slice& property, std::string* value) {
   value->clear();
 
@@ -1442,17 +1991,44 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
         value->append(buf);
       }
     }
+    std::snprintf(buf, sizeof(buf), "Write amplification: %.2f\n",
+                  WriteAmplification());
+    value->append(buf);
     return true;
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
+  } else if (in == "num-immutable-memtables") {
+    char buf[50];
+    std::snprintf(buf, sizeof(buf), "%d", static_cast<int>(imm_.size()));
+    value->append(buf);
+    return true;
+  } else if (in == "delayed-write-rate") {
+    char buf[50];
+    std::snprintf(
+        buf, sizeof(buf), "%llu",
+        static_cast<unsigned long long>(write_controller_.delayed_write_rate()));
+    value->append(buf);
+    return true;
+  } else if (in == "write-amplification") {
+    char buf[50];
+    std::snprintf(buf, sizeof(buf), "%.2f", WriteAmplification());
+    value->append(buf);
+    return true;
+  } else if (in == "write-stall-micros") {
+    char buf[50];
+    std::snprintf(
+        buf, sizeof(buf), "%llu",
+        static_cast<unsigned long long>(write_controller_.stall_micros()));
+    value->append(buf);
+    return true;
   } else if (in == "approximate-memory-usage") {
     size_t total_usage = options_.block_cache->TotalCharge();
     if (mem_) {
       total_usage += mem_->ApproximateMemoryUsage();
     }
-    if (imm_) {
-      total_usage += imm_->ApproximateMemoryUsage();
+    for (size_t i = 0; i < imm_.size(); i++) {
+      total_usage += imm_[i].mem->ApproximateMemoryUsage();
     }
     char buf[50];
     std::snprintf(buf, sizeof(buf), "%llu",
@@ -1482,6 +2058,302 @@ void DBImpl::GetApproximateSizes(const Range* range, int n, uint64_t* sizes) {
   v->Unref();
 }
 
+Status DBImpl::GetPropertiesOfAllTables(TablePropertiesCollection* props) {
+  mutex_.Lock();
+  Version* v = versions_->current();
+  v->Ref();
+  mutex_.Unlock();
+
+  props->clear();
+  Status s = v->GetPropertiesOfAllTables(props);
+
+  mutex_.Lock();
+  v->Unref();
+  mutex_.Unlock();
+  return s;
+}
+
+namespace {
+
+// Yields the entries of an external table with every key given the
+// sequence number "seq".  Fails with a non-ok status() at the first key
+// of the wrong length or out of order.
+class IngestionIterator : public Iterator {
+ public:
+  IngestionIterator(const Comparator* user_comparator, size_t key_length,
+                    SequenceNumber seq, Iterator* iter)
+      : user_comparator_(user_comparator),
+        key_length_(key_length),
+        seq_(seq),
+        iter_(iter),
+        has_last_key_(false) {}
+
+  ~IngestionIterator() override { delete iter_; }
+
+  bool Valid() const override { return status_.ok() && iter_->Valid(); }
+  void SeekToFirst() override {
+    has_last_key_ = false;
+    iter_->SeekToFirst();
+    CheckEntry();
+  }
+  void SeekToLast() override {
+    has_last_key_ = false;
+    iter_->SeekToLast();
+    CheckEntry();
+  }
+  void Seek(const Slice& target) override {
+    has_last_key_ = false;
+    iter_->Seek(target);
+    CheckEntry();
+  }
+  void Next() override {
+    iter_->Next();
+    CheckEntry();
+  }
+  void Prev() override {
+    has_last_key_ = false;
+    iter_->Prev();
+    CheckEntry();
+  }
+  Slice key() const override { return key_; }
+  Slice value() const override { return iter_->value(); }
+  Status status() const override {
+    return status_.ok() ? iter_->status() : status_;
+  }
+
+ private:
+  void CheckEntry() {
+    if (!status_.ok() || !iter_->Valid()) {
+      return;
+    }
+    ParsedInternalKey ikey;
+    if (iter_->key().size() != key_length_ ||
+        !ParseInternalKey(iter_->key(), &ikey)) {
+      status_ = Status::Corruption("bad key in ingested file");
+      return;
+    }
+    if (has_last_key_ &&
+        user_comparator_->Compare(ikey.user_key, last_key_) <= 0) {
+      status_ = Status::InvalidArgument(
+          "ingested file has keys out of order or repeated");
+      return;
+    }
+    last_key_.assign(ikey.user_key.data(), ikey.user_key.size());
+    has_last_key_ = true;
+    key_.clear();
+    AppendInternalKey(&key_, ParsedInternalKey(ikey.user_key, seq_, ikey.type));
+  }
+
+  const Comparator* const user_comparator_;
+  const size_t key_length_;
+  const SequenceNumber seq_;
+  Iterator* const iter_;
+  Status status_;
+  std::string key_;       // Current key with its sequence number replaced
+  std::string last_key_;  // User key of the previous entry
+  bool has_last_key_;
+};
+
+// Returns true iff "mem" holds a key in the range of "f".
+bool MemTableOverlaps(MemTable* mem, const Comparator* user_comparator,
+                      const FileMetaData& f) {
+  Iterator* iter = mem->NewIterator();
+  InternalKey start(f.smallest.user_key(), kMaxSequenceNumber,
+                    kValueTypeForSeek);
+  iter->Seek(start.Encode());
+  bool overlaps =
+      iter->Valid() && user_comparator->Compare(ExtractUserKey(iter->key()),
+                                                f.largest.user_key()) <= 0;
+  delete iter;
+
+  // A lookup stops at a memtable whose range tombstone covers the key, so
+  // such a tombstone must not be left above the file either.
+  iter = mem->NewRangeTombstoneIterator();
+  RangeTombstone t;
+  for (iter->SeekToFirst(); !overlaps && iter->Valid(); iter->Next()) {
+    if (ParseRangeTombstone(iter->key(), iter->value(), &t) &&
+        user_comparator->Compare(t.begin, f.largest.user_key()) <= 0 &&
+        user_comparator->Compare(t.end, f.smallest.user_key()) > 0) {
+      overlaps = true;
+    }
+  }
+  delete iter;
+  return overlaps;
+}
+
+}  // namespace
+
+Status DBImpl::ImportTableFile(const std::string& fname, SequenceNumber seq,
+                               FileMetaData* meta) {
+  uint64_t file_size;
+  Status s = env_->GetFileSize(fname, &file_size);
+  if (!s.ok()) {
+    return s;
+  }
+  RandomAccessFile* file;
+  s = env_->NewRandomAccessFile(fname, &file);
+  if (!s.ok()) {
+    return s;
+  }
+  FixTable* table = nullptr;
+  s = FixTable::Open(options_, file, file_size, &table);
+  if (s.ok()) {
+    // Tables written before properties were recorded are still checked
+    // key by key below.
+    TableProperties props;
+    if (table->ReadProperties(&props).ok() &&
+        (props.key_length != options_.key_length ||
+         props.value_length != options_.value_length)) {
+      s = Status::InvalidArgument(
+          fname, "key or value length differs from the database's");
+    }
+  }
+  if (s.ok()) {
+    ReadOptions read_options;
+    read_options.verify_checksums = true;
+    read_options.fill_cache = false;
+    IngestionIterator iter(user_comparator(), options_.key_length, seq,
+                           table->NewIterator(read_options));
+    s = BuildTable(dbname_, env_, options_, table_cache_, &iter, meta);
+    if (s.ok() && meta->file_size == 0) {
+      s = Status::InvalidArgument(fname, "file is empty");
+    }
+  }
+  delete table;
+  delete file;
+  return s;
+}
+
+Status DBImpl::IngestExternalFile(const std::vector<std::string>& files) {
+  if (files.empty()) {
+    return Status::OK();
+  }
+
+  // Take the place of a write at the front of the queue, so that no
+  // writes go to the memtable or take sequence numbers meanwhile.
+  Writer w(&mutex_);
+  MutexLock l(&mutex_);
+  writers_.push_back(&w);
+  while (&w != writers_.front()) {
+    w.cv.Wait();
+  }
+
+  Status s = bg_error_;
+  const SequenceNumber seq = versions_->LastSequence() + 1;
+  // The files are copied under numbers of their own, and renumbered when
+  // they are added (see below).
+  std::vector<FileMetaData> metas(files.size());
+  std::vector<uint64_t> copy_numbers(files.size());
+  for (size_t i = 0; i < metas.size(); i++) {
+    copy_numbers[i] = metas[i].number = versions_->NewFileNumber();
+    pending_outputs_.insert(copy_numbers[i]);
+  }
+
+  // Copy the files into the database with their new sequence number.
+  if (s.ok()) {
+    mutex_.Unlock();
+    for (size_t i = 0; i < files.size() && s.ok(); i++) {
+      s = ImportTableFile(files[i], seq, &metas[i]);
+    }
+    if (s.ok()) {
+      std::vector<const FileMetaData*> sorted;
+      for (size_t i = 0; i < metas.size(); i++) {
+        sorted.push_back(&metas[i]);
+      }
+      const Comparator* ucmp = user_comparator();
+      std::sort(sorted.begin(), sorted.end(),
+                [ucmp](const FileMetaData* a, const FileMetaData* b) {
+                  return ucmp->Compare(a->smallest.user_key(),
+                                       b->smallest.user_key()) < 0;
+                });
+      for (size_t i = 1; i < sorted.size() && s.ok(); i++) {
+        if (ucmp->Compare(sorted[i - 1]->largest.user_key(),
+                          sorted[i]->smallest.user_key()) >= 0) {
+          s = Status::InvalidArgument("ingested files overlap");
+        }
+      }
+    }
+    mutex_.Lock();
+  }
+
+  // Unflushed writes to the same keys are older than the ingested files,
+  // so they must reach level-0 first.
+  if (s.ok()) {
+    bool mem_overlaps = false;
+    bool imm_overlaps = false;
+    for (size_t i = 0; i < metas.size(); i++) {
+      mem_overlaps |= MemTableOverlaps(mem_, user_comparator(), metas[i]);
+      for (size_t j = 0; j < imm_.size(); j++) {
+        imm_overlaps |=
+            MemTableOverlaps(imm_[j].mem, user_comparator(), metas[i]);
+      }
+    }
+    if (mem_overlaps) {
+      s = MakeRoomForWrite(true);
+    }
+    while (s.ok() && (mem_overlaps || imm_overlaps) && !imm_.empty()) {
+      background_work_finished_signal_.Wait();
+      s = bg_error_;
+    }
+  }
+
+  // Let the running compaction finish, so that no compaction output can
+  // land next to an ingested file, then add the files.
+  if (s.ok()) {
+    ingesting_ = true;
+    while (background_compaction_scheduled_) {
+      background_work_finished_signal_.Wait();
+    }
+    s = bg_error_;
+    if (s.ok()) {
+      // Level-0 files are ordered by number, so the files must be numbered
+      // after the memtables flushed above, whose writes they override.
+      for (size_t i = 0; i < metas.size(); i++) {
+        metas[i].number = versions_->NewFileNumber();
+        pending_outputs_.insert(metas[i].number);
+      }
+      mutex_.Unlock();
+      for (size_t i = 0; i < metas.size() && s.ok(); i++) {
+        s = env_->RenameFile(TableFileName(dbname_, copy_numbers[i]),
+                             TableFileName(dbname_, metas[i].number));
+        table_cache_->Evict(copy_numbers[i]);
+      }
+      mutex_.Lock();
+    }
+    if (s.ok()) {
+      VersionEdit edit;
+      Version* current = versions_->current();
+      for (size_t i = 0; i < metas.size(); i++) {
+        const int level = current->PickLevelForIngestedFile(
+            metas[i].smallest.user_key(), metas[i].largest.user_key());
+        edit.AddFile(level, metas[i]);
+        Log(options_.info_log, "Ingested %s as #%llu at level-%d",
+            files[i].c_str(), static_cast<unsigned long long>(metas[i].number),
+            level);
+      }
+      versions_->SetLastSequence(seq);
+      s = versions_->LogAndApply(&edit, &mutex_);
+    }
+    ingesting_ = false;
+  }
+
+  for (size_t i = 0; i < metas.size(); i++) {
+    pending_outputs_.erase(copy_numbers[i]);
+    pending_outputs_.erase(metas[i].number);
+    if (!s.ok()) {
+      env_->RemoveFile(TableFileName(dbname_, copy_numbers[i]));
+      env_->RemoveFile(TableFileName(dbname_, metas[i].number));
+    }
+  }
+  MaybeScheduleCompaction();
+
+  writers_.pop_front();
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+  return s;
+}
+
 // Default implementations of convenience methods that subclasses of DB
 // can call if they wish
 Status DB::Put(const WriteOptions& opt, const Slice& key, const Slice& value) {
@@ -1496,6 +2368,41 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+Status DB::DeleteRange(const WriteOptions& opt, const Slice& begin_key,
+                       const Slice& end_key) {
+  WriteBatch batch;
+  batch.DeleteRange(begin_key, end_key);
+  return Write(opt, &batch);
+}
+
+std::vector<Status> DB::MultiGet(const ReadOptions& options,
+                                 const std::vector<Slice>& keys,
+                                 std::vector<std::string>* values) {
+  ReadOptions opt = options;
+  const Snapshot* snapshot = nullptr;
+  if (opt.snapshot == nullptr) {
+    snapshot = GetSnapshot();
+    opt.snapshot = snapshot;
+  }
+  std::vector<Status> statuses(keys.size());
+  values->resize(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    statuses[i] = Get(opt, keys[i], &(*values)[i]);
+  }
+  if (snapshot != nullptr) {
+    ReleaseSnapshot(snapshot);
+  }
+  return statuses;
+}
+
+Status DB::GetPropertiesOfAllTables(TablePropertiesCollection* props) {
+  return Status::NotSupported("GetPropertiesOfAllTables");
+}
+
+Status DB::IngestExternalFile(const std::vector<std::string>& files) {
+  return Status::NotSupported("IngestExternalFile");
+}
+
 DB::~DB() = default;
 
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
@@ -1518,7 +2425,7 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
       impl->logfile_ = lfile;
       impl->logfile_number_ = new_log_number;
       impl->log_ = new log::Writer(lfile);
-      impl->mem_ = new MemTable(impl->internal_comparator_);
+      impl->mem_ = new MemTable(impl->internal_comparator_, impl->arena_pool_);
       impl->mem_->Ref();
     }
   }
@@ -1529,8 +2436,32 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
   }
   if (s.ok()) {
     impl->RemoveObsoleteFiles();
+  }
+  if (s.ok() && impl->options_.preload_table_levels > 0) {
+    // Tables that fail to open are otherwise only reported once read.
+    Status preload = impl->PreloadTables();
+    if (impl->options_.paranoid_checks) {
+      s = preload;
+    }
+  }
+  if (s.ok()) {
     impl->MaybeScheduleCompaction();
   }
+  if (s.ok() && impl->options_.background_wal_sync) {
+    // Check up front that the log file can be synced by the sync thread,
+    // instead of failing the DB on the first synced write.
+    s = impl->logfile_->SyncFlushed();
+    if (s.IsNotSupportedError()) {
+      s = Status::InvalidArgument(
+          "background_wal_sync requires WritableFile::SyncFlushed()");
+    }
+  }
+  if (s.ok() && impl->options_.background_wal_sync) {
+    impl->wal_synced_seq_ = impl->versions_->LastSequence();
+    impl->wal_sync_requested_seq_ = impl->wal_synced_seq_;
+    impl->wal_sync_thread_running_ = true;
+    impl->env_->StartThread(&DBImpl::WalSyncThreadEntry, impl);
+  }
   impl->mutex_.Unlock();
   if (s.ok()) {
     assert(impl->mem_ != nullptr);
@@ -13,6 +13,7 @@
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
+#include "db/write_controller.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "port/port.h"
@@ -20,7 +21,11 @@
 
 namespace leveldb {
 
+struct FileMetaData;
+
+class ArenaRegionPool;
 class MemTable;
+class RangeTombstoneList;
 class TableCache;
 class Version;
 class VersionEdit;
@@ -39,14 +44,21 @@ class DBImpl : public DB {
   Status Put(const WriteOptions&, const Slice& key,
              const Slice& value) override;
   Status Delete(const WriteOptions&, const Slice& key) override;
+  Status DeleteRange(const WriteOptions&, const Slice& begin_key,
+                     const Slice& end_key) override;
   Status Write(const WriteOptions& options, WriteBatch* updates) override;
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override;
+  std::vector<Status> MultiGet(const ReadOptions& options,
+                               const std::vector<Slice>& keys,
+                               std::vector<std::string>* values) override;
   Iterator* NewIterator(const ReadOptions&) override;
   const Snapshot* GetSnapshot() override;
   void ReleaseSnapshot(const Snapshot* snapshot) override;
   bool GetProperty(const Slice& property, std::string* value) override;
   void GetApproximateSizes(const Range* range, int n, uint64_t* sizes) override;
+  Status GetPropertiesOfAllTables(TablePropertiesCollection* props) override;
+  Status IngestExternalFile(const std::vector<std::string>& files) override;
   void CompactRange(const Slice* begin, const Slice* end) override;
 
   // Extra methods (for testing) that are not in the public DB interface
@@ -66,6 +78,11 @@ class DBImpl : public DB {
   // file at a level >= 1.
   int64_t TEST_MaxNextLevelOverlappingBytes();
 
+  // Return the smallest user key of the file of "level" that
+  // Options::compaction_pri would compact next.
+  // REQUIRES: level > 0 and the level holds at least one file
+  std::string TEST_PickFileByPriority(int level);
+
   // Record a sample of bytes read at the specified internal key.
   // Samples are taken approximately once every config::kReadBytesPeriod
   // bytes.
@@ -85,6 +102,14 @@ class DBImpl : public DB {
     InternalKey tmp_storage;   // Used to keep track of compaction progress
   };
 
+  // A memtable that is full and waiting to be flushed to a level-0 table.
+  struct ImmutableMemTable {
+    MemTable* mem;
+    // Log file started when "mem" was retired.  Once "mem" has been
+    // flushed, only this log and later ones are needed for recovery.
+    uint64_t next_log_number;
+  };
+
   // Per level compaction stats.  stats_[level] stores the stats for
   // compactions that produced data for the specified "level".
   struct CompactionStats {
@@ -101,9 +126,12 @@ class DBImpl : public DB {
     int64_t bytes_written;
   };
 
+  // If "range_tombstones" is not null, also adds the range tombstones of
+  // the memtables and files the result reads to it.
   Iterator* NewInternalIterator(const ReadOptions&,
                                 SequenceNumber* latest_snapshot,
-                                uint32_t* seed);
+                                uint32_t* seed,
+                                RangeTombstoneList* range_tombstones = nullptr);
 
   Status NewDB();
 
@@ -118,8 +146,8 @@ class DBImpl : public DB {
   // Delete any unneeded files and stale in-memory entries.
   void RemoveObsoleteFiles() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  // Compact the in-memory write buffer to disk.  Switches to a new
-  // log-file/memtable and writes a new descriptor iff successful.
+  // Compact the immutable memtables queued so far to a single level-0
+  // table and write a new descriptor iff successful.
   // Errors are recorded in bg_error_.
   void CompactMemTable() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -127,8 +155,9 @@ class DBImpl : public DB {
                         VersionEdit* edit, SequenceNumber* max_sequence)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
-      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Write the merged contents of mems[0,n-1] to a new table.
+  Status WriteLevel0Table(MemTable* const* mems, int n, VersionEdit* edit,
+                          Version* base) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   Status MakeRoomForWrite(bool force /* compact even if there is room? */)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -137,6 +166,21 @@ class DBImpl : public DB {
 
   void RecordBackgroundError(const Status& s);
 
+  // Ask the WAL sync thread to make the log durable up to sequence "seq"
+  // and wait until it has done so.
+  Status AwaitWalSync(SequenceNumber seq) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  static void WalSyncThreadEntry(void* db);
+  void WalSyncThreadMain();
+
+  // Opens the tables of the levels below Options::preload_table_levels
+  // into the table cache, on several threads, and returns the first error.
+  Status PreloadTables() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Rewrites the external table "fname" as table meta->number, giving
+  // every key the sequence number "seq", and fills in *meta.
+  Status ImportTableFile(const std::string& fname, SequenceNumber seq,
+                         FileMetaData* meta);
+
   void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   static void BGWork(void* db);
   void BackgroundCall();
@@ -151,6 +195,10 @@ class DBImpl : public DB {
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Returns the bytes written by flushes and compactions per byte flushed,
+  // or 0 before the first flush.
+  double WriteAmplification() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   const Comparator* user_comparator() const {
     return internal_comparator_.user_comparator();
   }
@@ -167,6 +215,10 @@ class DBImpl : public DB {
   // table_cache_ provides its own synchronization
   TableCache* const table_cache_;
 
+  // Source of memtable memory if options_.memtable_huge_pages, else null.
+  // Provides its own synchronization.
+  ArenaRegionPool* const arena_pool_;
+
   // Lock over the persistent DB state.  Non-null iff successfully acquired.
   FileLock* db_lock_;
 
@@ -175,8 +227,10 @@ class DBImpl : public DB {
   std::atomic<bool> shutting_down_;
   port::CondVar background_work_finished_signal_ GUARDED_BY(mutex_);
   MemTable* mem_;
-  MemTable* imm_ GUARDED_BY(mutex_);  // Memtable being compacted
-  std::atomic<bool> has_imm_;         // So bg thread can detect non-null imm_
+  // Memtables waiting to be compacted, oldest first.  Holds at most
+  // options_.max_write_buffer_number - 1 entries.
+  std::deque<ImmutableMemTable> imm_ GUARDED_BY(mutex_);
+  std::atomic<bool> has_imm_;  // So bg thread can detect non-empty imm_
   WritableFile* logfile_;
   uint64_t logfile_number_ GUARDED_BY(mutex_);
   log::Writer* log_;
@@ -186,6 +240,19 @@ class DBImpl : public DB {
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
   WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
 
+  // State of the WAL sync thread (only used if options_.background_wal_sync).
+  // Log records up to wal_synced_seq_ are durable; writers waiting for a
+  // sync raise wal_sync_requested_seq_ and wait on wal_sync_done_cv_.
+  port::CondVar wal_sync_cv_ GUARDED_BY(mutex_);
+  port::CondVar wal_sync_done_cv_ GUARDED_BY(mutex_);
+  SequenceNumber wal_sync_requested_seq_ GUARDED_BY(mutex_);
+  SequenceNumber wal_synced_seq_ GUARDED_BY(mutex_);
+  bool wal_sync_in_progress_ GUARDED_BY(mutex_);
+  bool wal_sync_thread_running_ GUARDED_BY(mutex_);
+
+  // Paces writes while compactions are behind.
+  WriteController write_controller_ GUARDED_BY(mutex_);
+
   SnapshotList snapshots_ GUARDED_BY(mutex_);
 
   // Set of table files to protect from deletion because they are
@@ -195,6 +262,10 @@ class DBImpl : public DB {
   // Has a background compaction been scheduled or is running?
   bool background_compaction_scheduled_ GUARDED_BY(mutex_);
 
+  // Are external files being added to the current version?  No
+  // compactions are scheduled meanwhile.
+  bool ingesting_ GUARDED_BY(mutex_);
+
   ManualCompaction* manual_compaction_ GUARDED_BY(mutex_);
 
   VersionSet* const versions_ GUARDED_BY(mutex_);
@@ -203,6 +274,10 @@ class DBImpl : public DB {
   Status bg_error_ GUARDED_BY(mutex_);
 
   CompactionStats stats_[config::kNumLevels] GUARDED_BY(mutex_);
+
+  // Bytes written by memtable flushes.  Everything written to stats_ is
+  // measured against this for the write amplification.
+  uint64_t flushed_bytes_ GUARDED_BY(mutex_);
 };
 
 // Sanitize db options.  The caller should delete result.info_log if
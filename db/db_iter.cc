@@ -7,8 +7,10 @@
 #include "db/db_impl.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_tombstone.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "leveldb/slice_transform.h"
 #include "port/port.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
@@ -46,11 +48,20 @@ class DBIter : public Iterator {
   enum Direction { kForward, kReverse };
 
   DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-         uint32_t seed)
+         uint32_t seed, const Slice* lower_bound, const Slice* upper_bound,
+         const SliceTransform* prefix_extractor,
+         RangeTombstoneList* range_tombstones)
       : db_(db),
         user_comparator_(cmp),
         iter_(iter),
         sequence_(s),
+        has_lower_bound_(lower_bound != nullptr),
+        has_upper_bound_(upper_bound != nullptr),
+        lower_bound_(has_lower_bound_ ? lower_bound->ToString() : ""),
+        upper_bound_(has_upper_bound_ ? upper_bound->ToString() : ""),
+        prefix_extractor_(prefix_extractor),
+        range_tombstones_(range_tombstones),
+        prefix_active_(false),
         direction_(kForward),
         valid_(false),
         rnd_(seed),
@@ -59,7 +70,10 @@ class DBIter : public Iterator {
   DBIter(const DBIter&) = delete;
   DBIter& operator=(const DBIter&) = delete;
 
-  ~DBIter() override { delete iter_; }
+  ~DBIter() override {
+    delete iter_;
+    delete range_tombstones_;
+  }
   bool Valid() const override { return valid_; }
   Slice key() const override {
     assert(valid_);
@@ -87,6 +101,27 @@ class DBIter : public Iterator {
   void FindNextUserEntry(bool skipping, std::string* skip);
   void FindPrevUserEntry();
   bool ParseKey(ParsedInternalKey* key);
+  void SeekTo(const Slice& target);
+
+  bool BeforeLowerBound(const Slice& user_key) const {
+    return has_lower_bound_ &&
+           user_comparator_->Compare(user_key, lower_bound_) < 0;
+  }
+  bool AtOrPastUpperBound(const Slice& user_key) const {
+    return has_upper_bound_ &&
+           user_comparator_->Compare(user_key, upper_bound_) >= 0;
+  }
+  bool OutsidePrefix(const Slice& user_key) const {
+    return prefix_active_ && (!prefix_extractor_->InDomain(user_key) ||
+                              prefix_extractor_->Transform(user_key) != prefix_);
+  }
+
+  // Returns true if a range tombstone hides the entry "ikey".
+  bool CoveredByTombstone(const ParsedInternalKey& ikey) const {
+    return range_tombstones_ != nullptr &&
+           range_tombstones_->MaxCoveringSequence(ikey.user_key) >
+               ikey.sequence;
+  }
 
   inline void SaveKey(const Slice& k, std::string* dst) {
     dst->assign(k.data(), k.size());
@@ -110,6 +145,15 @@ class DBIter : public Iterator {
   const Comparator* const user_comparator_;
   Iterator* const iter_;
   SequenceNumber const sequence_;
+  const bool has_lower_bound_;
+  const bool has_upper_bound_;
+  const std::string lower_bound_;  // Inclusive
+  const std::string upper_bound_;  // Exclusive
+  const SliceTransform* const prefix_extractor_;  // Null unless prefix seek
+  // Range tombstones visible at sequence_, or null if there are none.
+  RangeTombstoneList* const range_tombstones_;
+  bool prefix_active_;  // Keys are limited to prefix_ since the last Seek()
+  std::string prefix_;
   Status status_;
   std::string saved_key_;    // == current key when direction_==kReverse
   std::string saved_value_;  // == current raw value when direction_==kReverse
@@ -146,7 +190,15 @@ void DBIter::Next() {
     // iter_ is pointing just before the entries for this->key(),
     // so advance into the range of entries for this->key() and then
     // use the normal skipping code below.
-    if (!iter_->Valid()) {
+    if (!iter_->Valid() && has_lower_bound_) {
+      // Children may have stopped short of the entries before the lower
+      // bound, so start over from it rather than from the first entry.
+      std::string start;
+      AppendInternalKey(&start, ParsedInternalKey(lower_bound_,
+                                                  kMaxSequenceNumber,
+                                                  kValueTypeForSeek));
+      iter_->Seek(start);
+    } else if (!iter_->Valid()) {
       iter_->SeekToFirst();
     } else {
       iter_->Next();
@@ -180,7 +232,12 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   assert(direction_ == kForward);
   do {
     ParsedInternalKey ikey;
-    if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+    if (!ParseKey(&ikey)) {
+      // Skip corrupted entries, as below.
+    } else if (AtOrPastUpperBound(ikey.user_key) ||
+               OutsidePrefix(ikey.user_key)) {
+      break;
+    } else if (ikey.sequence <= sequence_) {
       switch (ikey.type) {
         case kTypeDeletion:
           // Arrange to skip all upcoming entries for this key since
@@ -192,12 +249,21 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
           if (skipping &&
               user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
             // Entry hidden
+          } else if (CoveredByTombstone(ikey)) {
+            // Older entries for this key are covered as well.
+            SaveKey(ikey.user_key, skip);
+            skipping = true;
           } else {
             valid_ = true;
             saved_key_.clear();
             return;
           }
           break;
+        case kTypeRangeDeletion:
+          // Range tombstones are kept apart from the point entries that
+          // iter_ yields; see range_tombstones_.
+          assert(false);
+          break;
       }
     }
     iter_->Next();
@@ -240,13 +306,22 @@ void DBIter::FindPrevUserEntry() {
   if (iter_->Valid()) {
     do {
       ParsedInternalKey ikey;
-      if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+      if (!ParseKey(&ikey)) {
+        // Skip corrupted entries, as below.
+      } else if (BeforeLowerBound(ikey.user_key) ||
+                 OutsidePrefix(ikey.user_key)) {
+        // Leave iter_ just before the entries for saved_key_, as if it
+        // had reached the start of the data.
+        break;
+      } else if (AtOrPastUpperBound(ikey.user_key)) {
+        // Skip entries past the bound that iter_ started from.
+      } else if (ikey.sequence <= sequence_) {
         if ((value_type != kTypeDeletion) &&
             user_comparator_->Compare(ikey.user_key, saved_key_) < 0) {
           // We encountered a non-deleted value in entries for previous keys,
           break;
         }
-        value_type = ikey.type;
+        value_type = CoveredByTombstone(ikey) ? kTypeDeletion : ikey.type;
         if (value_type == kTypeDeletion) {
           saved_key_.clear();
           ClearSavedValue();
@@ -276,12 +351,29 @@ void DBIter::FindPrevUserEntry() {
 }
 
 void DBIter::Seek(const Slice& target) {
+  prefix_active_ =
+      prefix_extractor_ != nullptr && prefix_extractor_->InDomain(target);
+  if (prefix_active_) {
+    Slice prefix = prefix_extractor_->Transform(target);
+    prefix_.assign(prefix.data(), prefix.size());
+  }
+  SeekTo(target);
+}
+
+void DBIter::SeekTo(const Slice& target) {
   direction_ = kForward;
   ClearSavedValue();
   saved_key_.clear();
-  AppendInternalKey(&saved_key_,
-                    ParsedInternalKey(target, sequence_, kValueTypeForSeek));
-  iter_->Seek(saved_key_);
+  AppendInternalKey(
+      &saved_key_,
+      ParsedInternalKey(BeforeLowerBound(target) ? Slice(lower_bound_) : target,
+                        sequence_, kValueTypeForSeek));
+  if (prefix_active_) {
+    // Only this seek may skip the tables without the prefix.
+    iter_->SeekForPrefix(saved_key_);
+  } else {
+    iter_->Seek(saved_key_);
+  }
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
   } else {
@@ -290,6 +382,11 @@ void DBIter::Seek(const Slice& target) {
 }
 
 void DBIter::SeekToFirst() {
+  prefix_active_ = false;
+  if (has_lower_bound_) {
+    SeekTo(lower_bound_);
+    return;
+  }
   direction_ = kForward;
   ClearSavedValue();
   iter_->SeekToFirst();
@@ -301,9 +398,24 @@ void DBIter::SeekToFirst() {
 }
 
 void DBIter::SeekToLast() {
+  prefix_active_ = false;
   direction_ = kReverse;
   ClearSavedValue();
-  iter_->SeekToLast();
+  if (has_upper_bound_) {
+    // Position iter_ at the last entry before the upper bound.
+    saved_key_.clear();
+    AppendInternalKey(&saved_key_, ParsedInternalKey(upper_bound_,
+                                                     kMaxSequenceNumber,
+                                                     kValueTypeForSeek));
+    iter_->Seek(saved_key_);
+    if (iter_->Valid()) {
+      iter_->Prev();
+    } else {
+      iter_->SeekToLast();
+    }
+  } else {
+    iter_->SeekToLast();
+  }
   FindPrevUserEntry();
 }
 
@@ -311,8 +423,13 @@ void DBIter::SeekToLast() {
 
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+                        uint32_t seed, const Slice* lower_bound,
+                        const Slice* upper_bound,
+                        const SliceTransform* prefix_extractor,
+                        RangeTombstoneList* range_tombstones) {
+  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed,
+                    lower_bound, upper_bound, prefix_extractor,
+                    range_tombstones);
 }
 
 }  // namespace leveldb
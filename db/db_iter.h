@@ -13,13 +13,22 @@
 namespace leveldb {
 
 class DBImpl;
+class RangeTombstoneList;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
+// into appropriate user keys, limited to the user keys in
+// ["*lower_bound", "*upper_bound") for each bound that is non-null.
+// If "prefix_extractor" is non-null, the keys after a Seek() are further
+// limited to those sharing the prefix of its target.  Entries covered by
+// "range_tombstones", which must be finished at "sequence" and is owned by
+// the result, are hidden; it may be null if there are none.
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed);
+                        uint32_t seed, const Slice* lower_bound = nullptr,
+                        const Slice* upper_bound = nullptr,
+                        const SliceTransform* prefix_extractor = nullptr,
+                        RangeTombstoneList* range_tombstones = nullptr);
 
 }  // namespace leveldb
 
@@ -6,6 +6,7 @@
 
 #include <atomic>
 #include <cinttypes>
+#include <set>
 #include <string>
 
 #include "gtest/gtest.h"
@@ -16,6 +17,8 @@
 #include "leveldb/cache.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
+#include "leveldb/sst_file_writer.h"
 #include "leveldb/table.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -123,6 +126,9 @@ class SpecialEnv : public EnvWrapper {
   // sstable/log Sync() calls return an error.
   std::atomic<bool> data_sync_error_;
 
+  // sstable/log SyncFlushed() calls return NotSupported.
+  std::atomic<bool> sync_flushed_unsupported_;
+
   // Simulate no-space errors while this pointer is non-null.
   std::atomic<bool> no_space_;
 
@@ -145,6 +151,7 @@ class SpecialEnv : public EnvWrapper {
       : EnvWrapper(base),
         delay_data_sync_(false),
         data_sync_error_(false),
+        sync_flushed_unsupported_(false),
         no_space_(false),
         non_writable_(false),
         manifest_sync_error_(false),
@@ -190,6 +197,18 @@ class SpecialEnv : public EnvWrapper {
         }
         return base_->Sync();
       }
+      Status SyncFlushed() {
+        if (env_->sync_flushed_unsupported_.load(std::memory_order_acquire)) {
+          return Status::NotSupported("SyncFlushed");
+        }
+        if (env_->data_sync_error_.load(std::memory_order_acquire)) {
+          return Status::IOError("simulated data sync error");
+        }
+        while (env_->delay_data_sync_.load(std::memory_order_acquire)) {
+          DelayMilliseconds(100);
+        }
+        return base_->SyncFlushed();
+      }
     };
     class ManifestFile : public WritableFile {
      private:
@@ -233,28 +252,38 @@ class SpecialEnv : public EnvWrapper {
   }
 
   Status NewRandomAccessFile(const std::string& f, RandomAccessFile** r) {
-    class CountingFile : public RandomAccessFile {
-     private:
-      RandomAccessFile* target_;
-      AtomicCounter* counter_;
-
-     public:
-      CountingFile(RandomAccessFile* target, AtomicCounter* counter)
-          : target_(target), counter_(counter) {}
-      ~CountingFile() override { delete target_; }
-      Status Read(uint64_t offset, size_t n, Slice* result,
-                  char* scratch) const override {
-        counter_->Increment();
-        return target_->Read(offset, n, result, scratch);
-      }
-    };
-
     Status s = target()->NewRandomAccessFile(f, r);
     if (s.ok() && count_random_reads_) {
       *r = new CountingFile(*r, &random_read_counter_);
     }
     return s;
   }
+
+  Status NewDirectRandomAccessFile(const std::string& f,
+                                   RandomAccessFile** r) {
+    Status s = target()->NewDirectRandomAccessFile(f, r);
+    if (s.ok() && count_random_reads_) {
+      *r = new CountingFile(*r, &random_read_counter_);
+    }
+    return s;
+  }
+
+ private:
+  class CountingFile : public RandomAccessFile {
+   private:
+    RandomAccessFile* target_;
+    AtomicCounter* counter_;
+
+   public:
+    CountingFile(RandomAccessFile* target, AtomicCounter* counter)
+        : target_(target), counter_(counter) {}
+    ~CountingFile() override { delete target_; }
+    Status Read(uint64_t offset, size_t n, Slice* result,
+                char* scratch) const override {
+      counter_->Increment();
+      return target_->Read(offset, n, result, scratch);
+    }
+  };
 };
 
 class DBTest : public testing::Test {
@@ -312,6 +341,25 @@ class DBTest : public testing::Test {
     return options;
   }
 
+  // Return the current options for a database of fixed-width tables holding
+  // the 8-byte keys of FixedKey() and values of "value_length" bytes.
+  Options FixedWidthOptions(size_t value_length = 100) {
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.create_if_missing = true;
+    options.key_length = 8 + 8;  // Internal keys
+    options.value_length = value_length;
+    return options;
+  }
+
+  // Return the 8-byte key of FixedWidthOptions() databases numbered "i",
+  // which must be in [0, 10^8).
+  static std::string FixedKey(int i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "%08d", i);
+    return std::string(buf);
+  }
+
   DBImpl* dbfull() { return reinterpret_cast<DBImpl*>(db_); }
 
   void Reopen(Options* options = nullptr) {
@@ -418,6 +466,7 @@ class DBTest : public testing::Test {
               result += iter->value().ToString();
               break;
             case kTypeDeletion:
+            case kTypeRangeDeletion:
               result += "DEL";
               break;
           }
@@ -637,6 +686,640 @@ TEST_F(DBTest, GetFromImmutableLayer) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, MultipleImmutableMemTables) {
+  Options options = FixedWidthOptions(1000);
+  options.write_buffer_size = 100000;
+  options.max_write_buffer_number = 4;
+  DestroyAndReopen(&options);
+
+  // Block flushes so that full memtables queue up instead of stalling.
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+  for (int i = 0; i < 180; i++) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(1000, 'a' + (i % 26))));
+  }
+  std::string num;
+  ASSERT_TRUE(db_->GetProperty("leveldb.num-immutable-memtables", &num));
+  ASSERT_EQ("2", num);
+  for (int i = 0; i < 180; i += 10) {
+    ASSERT_EQ(std::string(1000, 'a' + (i % 26)), Get(FixedKey(i)));
+  }
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_TRUE(db_->GetProperty("leveldb.num-immutable-memtables", &num));
+  ASSERT_EQ("0", num);
+  Reopen(&options);
+  for (int i = 0; i < 180; i++) {
+    ASSERT_EQ(std::string(1000, 'a' + (i % 26)), Get(FixedKey(i)));
+  }
+}
+
+TEST_F(DBTest, MemTableHugePages) {
+  Options options = FixedWidthOptions(1000);
+  options.memtable_huge_pages = true;
+  options.write_buffer_size = 100000;
+  DestroyAndReopen(&options);
+
+  for (int round = 0; round < 2; round++) {
+    // Several memtable generations, so regions get recycled.
+    for (int i = 0; i < 500; i++) {
+      const std::string key = FixedKey(i);
+      ASSERT_LEVELDB_OK(Put(key, std::string(1000, 'a' + (i + round) % 26)));
+    }
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  }
+  for (int i = 0; i < 500; i++) {
+    ASSERT_EQ(std::string(1000, 'a' + (i + 1) % 26), Get(FixedKey(i)));
+  }
+}
+
+TEST_F(DBTest, CacheIndexAndFilterBlocks) {
+  Cache* block_cache = NewLRUCache(1 << 20);
+  const FilterPolicy* filter_policy = NewBloomFilterPolicy(10);
+  Options options = FixedWidthOptions();
+  options.block_cache = block_cache;
+  options.filter_policy = filter_policy;
+  DestroyAndReopen(&options);
+
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'a' + i % 26)));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+
+  ReadOptions no_fill;
+  no_fill.fill_cache = false;
+  std::string value;
+  for (int pin_levels = 0; pin_levels <= 1; pin_levels++) {
+    for (int cached = 0; cached <= 1; cached++) {
+      options.cache_index_and_filter_blocks = cached;
+      options.pin_index_and_filter_levels = pin_levels * config::kNumLevels;
+      Reopen(&options);
+      block_cache->Prune();
+      ASSERT_EQ(0, block_cache->TotalCharge());
+
+      // Data blocks stay out of the cache, so anything charged to it is
+      // index and filter blocks.
+      for (int i = 0; i < 1000; i += 100) {
+        const std::string key = FixedKey(i);
+        ASSERT_LEVELDB_OK(db_->Get(no_fill, key, &value));
+        ASSERT_EQ(std::string(100, 'a' + i % 26), value);
+      }
+      ASSERT_TRUE(db_->Get(no_fill, "missing!", &value).IsNotFound());
+      if (cached) {
+        ASSERT_GT(block_cache->TotalCharge(), 0);
+      } else {
+        ASSERT_EQ(0, block_cache->TotalCharge());
+      }
+
+      // Pinned blocks survive pruning the cache.
+      block_cache->Prune();
+      if (cached && pin_levels) {
+        ASSERT_GT(block_cache->TotalCharge(), 0);
+      } else {
+        ASSERT_EQ(0, block_cache->TotalCharge());
+      }
+    }
+  }
+
+  // Tables first opened by a scan are pinned too.
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  Reopen(&options);
+  block_cache->Prune();
+  Iterator* iter = db_->NewIterator(no_fill);
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_LEVELDB_OK(iter->status());
+  ASSERT_EQ(1000, count);
+  delete iter;
+  block_cache->Prune();
+  ASSERT_GT(block_cache->TotalCharge(), 0);
+
+  Close();
+  delete filter_policy;
+  delete block_cache;
+}
+
+TEST_F(DBTest, MultiGet) {
+  Options options = FixedWidthOptions();
+  DestroyAndReopen(&options);
+
+  // Spread versions of the keys over several levels and the memtable.
+  for (int i = 0; i < 600; i++) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'a' + i % 26)));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  for (int i = 0; i < 600; i += 3) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'A' + i % 26)));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  const Snapshot* snapshot = db_->GetSnapshot();
+  for (int i = 0; i < 600; i += 7) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, '0' + i % 10)));
+  }
+  for (int i = 0; i < 600; i += 11) {
+    ASSERT_LEVELDB_OK(Delete(FixedKey(i)));
+  }
+
+  // Unsorted keys, with duplicates and keys that were never written.
+  std::vector<std::string> key_strings;
+  Random rnd(301);
+  for (int i = 0; i < 300; i++) {
+    key_strings.push_back(FixedKey(rnd.Uniform(700)));
+  }
+  key_strings.push_back(key_strings[0]);
+  std::vector<Slice> keys(key_strings.begin(), key_strings.end());
+
+  for (int use_snapshot = 0; use_snapshot <= 1; use_snapshot++) {
+    ReadOptions read_options;
+    read_options.snapshot = use_snapshot ? snapshot : nullptr;
+    std::vector<std::string> values;
+    std::vector<Status> statuses = db_->MultiGet(read_options, keys, &values);
+    ASSERT_EQ(keys.size(), statuses.size());
+    ASSERT_EQ(keys.size(), values.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      std::string expected;
+      Status s = db_->Get(read_options, keys[i], &expected);
+      ASSERT_EQ(s.ToString(), statuses[i].ToString()) << keys[i].ToString();
+      if (s.ok()) {
+        ASSERT_EQ(expected, values[i]) << keys[i].ToString();
+      }
+    }
+  }
+  db_->ReleaseSnapshot(snapshot);
+
+  std::vector<std::string> values;
+  ASSERT_TRUE(db_->MultiGet(ReadOptions(), std::vector<Slice>(), &values)
+                  .empty());
+  ASSERT_TRUE(values.empty());
+}
+
+TEST_F(DBTest, DirectIO) {
+  Options options = FixedWidthOptions();
+  options.use_direct_reads = true;
+  options.use_direct_io_for_flush_and_compaction = true;
+  DestroyAndReopen(&options);
+
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'a' + i % 26)));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  for (int i = 0; i < 2000; i += 2) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'A' + i % 26)));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+
+  for (int reopen = 0; reopen <= 1; reopen++) {
+    for (int i = 0; i < 2000; i++) {
+      const std::string key = FixedKey(i);
+      ASSERT_EQ(std::string(100, (i % 2 ? 'a' : 'A') + i % 26), Get(key));
+    }
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      count++;
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    ASSERT_EQ(2000, count);
+    delete iter;
+    Reopen(&options);
+  }
+}
+
+TEST_F(DBTest, PreloadTables) {
+  Options options = FixedWidthOptions();
+  options.write_buffer_size = 64 << 10;
+  DestroyAndReopen(&options);
+  for (int i = 0; i < 5000; i++) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'a' + i % 26)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  const int tables = TotalTableFiles();
+  ASSERT_GT(tables, 1);
+
+  // Tables are opened by their first read, or by DB::Open if asked to.
+  env_->count_random_reads_ = true;
+  for (int levels : {0, config::kNumLevels}) {
+    options.preload_table_levels = levels;
+    Reopen(&options);
+    const int opened = env_->random_read_counter_.Read();
+    if (levels == 0) {
+      ASSERT_EQ(0, opened);
+    } else {
+      // A footer and an index block for each table.
+      ASSERT_GE(opened, 2 * tables);
+    }
+    env_->random_read_counter_.Reset();
+    ASSERT_EQ(std::string(100, 'a' + 1234 % 26), Get("00001234"));
+    if (levels == 0) {
+      ASSERT_GT(env_->random_read_counter_.Read(), 0);
+    }
+    env_->random_read_counter_.Reset();
+  }
+  env_->count_random_reads_ = false;
+}
+
+TEST_F(DBTest, Readahead) {
+  env_->count_random_reads_ = true;
+  Options options = FixedWidthOptions();
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.use_direct_reads = true;       // Reads are not served from mmap
+  DestroyAndReopen(&options);
+
+  const int kNum = 10000;
+  for (int i = 0; i < kNum; i++) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'a' + i % 26)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+
+  // Each 4KB block holds about 35 entries.
+  const int blocks = kNum / 35;
+  for (size_t readahead_size : {0, 64 * 1024}) {
+    ReadOptions read_options;
+    read_options.readahead_size = readahead_size;
+    env_->random_read_counter_.Reset();
+    Iterator* iter = db_->NewIterator(read_options);
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      const std::string key = FixedKey(count);
+      ASSERT_EQ(key, iter->key().ToString());
+      ASSERT_EQ(std::string(100, 'a' + count % 26), iter->value().ToString());
+      count++;
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    ASSERT_EQ(kNum, count);
+    delete iter;
+    ASSERT_LE(env_->random_read_counter_.Read(), blocks / 5);
+  }
+
+  // Random reads are not read ahead.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < 100; i++) {
+    const std::string key = FixedKey((i * 7919) % kNum);
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    iter->Seek(key);
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(key, iter->key().ToString());
+    delete iter;
+  }
+  ASSERT_EQ(100, env_->random_read_counter_.Read());
+
+  // Readahead stops at the end of mmap'd tables, which reject reads past
+  // it, even when the whole table is smaller than the readahead.
+  options.use_direct_reads = false;
+  DestroyAndReopen(&options);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'a')));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ReadOptions read_options;
+  read_options.readahead_size = 64 * 1024;
+  Iterator* iter = db_->NewIterator(read_options);
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_LEVELDB_OK(iter->status());
+  ASSERT_EQ(100, count);
+  delete iter;
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST_F(DBTest, CompressedBlockCache) {
+  env_->count_random_reads_ = true;
+  Cache* compressed_cache = NewLRUCache(1 << 20);
+  for (bool use_direct_reads : {true, false}) {
+    Options options = FixedWidthOptions();
+    options.block_cache = NewLRUCache(0);  // Evict every block on release
+    options.compressed_block_cache = compressed_cache;
+    options.use_direct_reads = use_direct_reads;
+    DestroyAndReopen(&options);
+
+    const int kNum = 1000;
+    for (int i = 0; i < kNum; i++) {
+      ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'a' + i % 26)));
+    }
+    dbfull()->TEST_CompactMemTable();
+
+    int first_pass_reads = 0;
+    for (int pass = 0; pass < 2; pass++) {
+      env_->random_read_counter_.Reset();
+      Iterator* iter = db_->NewIterator(ReadOptions());
+      int count = 0;
+      for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        count++;
+      }
+      ASSERT_LEVELDB_OK(iter->status());
+      ASSERT_EQ(kNum, count);
+      delete iter;
+      if (pass == 0) {
+        first_pass_reads = env_->random_read_counter_.Read();
+      }
+    }
+    ASSERT_GT(first_pass_reads, 0);
+    if (use_direct_reads) {
+      // The blocks evicted from the block cache are rebuilt from the
+      // compressed block cache.
+      ASSERT_GT(compressed_cache->TotalCharge(), 0);
+      ASSERT_EQ(0, env_->random_read_counter_.Read());
+    } else {
+      // Blocks of mmap'd tables are already in memory, so none are kept.
+      ASSERT_EQ(0, compressed_cache->TotalCharge());
+      ASSERT_EQ(first_pass_reads, env_->random_read_counter_.Read());
+    }
+
+    Close();
+    delete options.block_cache;
+    compressed_cache->Prune();
+  }
+  delete compressed_cache;
+}
+
+TEST_F(DBTest, IterateBounds) {
+  Options options = FixedWidthOptions();
+  DestroyAndReopen(&options);
+
+  // Versions of the keys in the last level, level-0 and the memtable,
+  // with deletions in the memtable.
+  const int kNum = 3000;
+  for (int i = 0; i < kNum; i++) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'a' + i % 26)));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  for (int i = 0; i < kNum; i += 3) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'A' + i % 26)));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  for (int i = 0; i < kNum; i += 7) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, '0' + i % 10)));
+  }
+  for (int i = 0; i < kNum; i += 11) {
+    ASSERT_LEVELDB_OK(Delete(FixedKey(i)));
+  }
+  auto expected_value = [](int i) {
+    if (i % 11 == 0) return std::string();
+    if (i % 7 == 0) return std::string(100, '0' + i % 10);
+    if (i % 3 == 0) return std::string(100, 'A' + i % 26);
+    return std::string(100, 'a' + i % 26);
+  };
+
+  const int kBounds[][2] = {{0, kNum},   {1, 2},       {100, 1000},
+                            {121, 122},  {1500, 1501}, {2990, kNum + 10},
+                            {-1, 500},   {500, -1},    {-1, -1}};
+  for (const auto& bounds : kBounds) {
+    const std::string lower_key = FixedKey(bounds[0]);
+    const std::string upper_key = FixedKey(bounds[1]);
+    Slice lower(lower_key), upper(upper_key);
+    ReadOptions read_options;
+    read_options.iterate_lower_bound = (bounds[0] >= 0) ? &lower : nullptr;
+    read_options.iterate_upper_bound = (bounds[1] >= 0) ? &upper : nullptr;
+    const int lo = std::max(bounds[0], 0);
+    const int hi = (bounds[1] >= 0) ? std::min(bounds[1], kNum) : kNum;
+
+    std::string expected, forward, backward;
+    for (int i = lo; i < hi; i++) {
+      if (i % 11 != 0) {
+        expected += FixedKey(i) + ",";
+      }
+    }
+    Iterator* iter = db_->NewIterator(read_options);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      forward += iter->key().ToString() + ",";
+      ASSERT_EQ(expected_value(std::atoi(iter->key().ToString().c_str())),
+                iter->value().ToString());
+    }
+    ASSERT_EQ(expected, forward);
+    std::vector<std::string> keys;
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+      keys.push_back(iter->key().ToString());
+    }
+    for (auto it = keys.rbegin(); it != keys.rend(); ++it) {
+      backward += *it + ",";
+    }
+    ASSERT_EQ(expected, backward);
+
+    // Seeks clamp to the lower bound and stop at the upper bound.
+    iter->Seek("");
+    ASSERT_EQ(expected.empty(), !iter->Valid());
+    if (iter->Valid()) {
+      ASSERT_EQ(expected.substr(0, 8), iter->key().ToString());
+      iter->Prev();
+      ASSERT_TRUE(!iter->Valid());
+    }
+    iter->Seek("99999999");
+    ASSERT_TRUE(!iter->Valid());
+    ASSERT_LEVELDB_OK(iter->status());
+    delete iter;
+  }
+}
+
+TEST_F(DBTest, IterateBoundsReverse) {
+  Options options = FixedWidthOptions();
+  DestroyAndReopen(&options);
+
+  // Sparse keys, so that some bounds fall between the last key of a
+  // block and the shortened index key that separates it from the next.
+  const int kMax = 40000;
+  for (int i = 0; i < kMax; i += 20) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'x')));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+
+  for (int bound = 5; bound < kMax; bound += 10) {
+    const std::string lower_key = FixedKey(bound - 200);
+    const std::string upper_key = FixedKey(bound);
+    Slice lower(lower_key), upper(upper_key);
+    ReadOptions read_options;
+    read_options.iterate_upper_bound = &upper;
+    if (bound > 200) {
+      read_options.iterate_lower_bound = &lower;
+    }
+    const int first = (bound > 200) ? (bound - 200 + 19) / 20 * 20 : 0;
+    const int last = bound / 20 * 20;
+    Iterator* iter = db_->NewIterator(read_options);
+    iter->SeekToLast();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(FixedKey(last), iter->key().ToString());
+
+    // Switching directions keeps to the bounds as well.
+    iter->Seek(FixedKey(last));
+    ASSERT_TRUE(iter->Valid());
+    if (last > first) {
+      iter->Prev();
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(FixedKey(last - 20), iter->key().ToString());
+      iter->Next();
+      ASSERT_TRUE(iter->Valid());
+    }
+    ASSERT_EQ(FixedKey(last), iter->key().ToString());
+    iter->Next();
+    ASSERT_TRUE(!iter->Valid());
+
+    iter->Seek(FixedKey(first));
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(FixedKey(first), iter->key().ToString());
+    if (last > first) {
+      iter->Next();
+      iter->Prev();
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(FixedKey(first), iter->key().ToString());
+    }
+    iter->Prev();
+    ASSERT_TRUE(!iter->Valid());
+    ASSERT_LEVELDB_OK(iter->status());
+    delete iter;
+  }
+}
+
+TEST_F(DBTest, IterateBoundsSkipFiles) {
+  env_->count_random_reads_ = true;
+  Options options = FixedWidthOptions();
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.use_direct_reads = true;       // Reads are not served from mmap
+  DestroyAndReopen(&options);
+
+  // Three overlapping files, one per level, each with a key range of its
+  // own plus one key at the far end.
+  for (int file = 0; file < 3; file++) {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_LEVELDB_OK(Put(FixedKey(file * 100 + i), std::string(100, 'x')));
+    }
+    const std::string key = FixedKey(900 + file);
+    ASSERT_LEVELDB_OK(Put(key, std::string(100, 'x')));
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  }
+  ASSERT_EQ("1,1,1", FilesPerLevel());
+
+  Slice lower("00000120"), upper("00000150");
+  int unbounded_reads = 0;
+  for (int bounded = 0; bounded <= 1; bounded++) {
+    ReadOptions read_options;
+    if (bounded) {
+      read_options.iterate_lower_bound = &lower;
+      read_options.iterate_upper_bound = &upper;
+    }
+    env_->random_read_counter_.Reset();
+    Iterator* iter = db_->NewIterator(read_options);
+    int count = 0;
+    for (iter->Seek(lower); iter->Valid() && iter->key().compare(upper) < 0;
+         iter->Next()) {
+      count++;
+    }
+    ASSERT_EQ(30, count);
+    delete iter;
+    // The level-0 file, which starts past the upper bound, is not read
+    // with bounds.
+    const int reads = env_->random_read_counter_.Read();
+    if (bounded) {
+      ASSERT_LT(reads, unbounded_reads);
+    } else {
+      unbounded_reads = reads;
+    }
+  }
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST_F(DBTest, PrefixSeek) {
+  env_->count_random_reads_ = true;
+  Options options = FixedWidthOptions();
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.use_direct_reads = true;       // Reads are not served from mmap
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.prefix_extractor = NewFixedPrefixTransform(4);
+  DestroyAndReopen(&options);
+
+  // Three overlapping files, one per level, each holding ten prefixes of
+  // its own plus one key at the far end.
+  for (int file = 0; file < 3; file++) {
+    for (int i = 0; i < 100; i++) {
+      const std::string key = FixedKey((file * 10 + i / 10) * 10000 + i);
+      ASSERT_LEVELDB_OK(Put(key, std::string(100, 'x')));
+    }
+    const std::string key = FixedKey(99990000 + file);
+    ASSERT_LEVELDB_OK(Put(key, std::string(100, 'x')));
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  }
+  ASSERT_EQ("1,1,1", FilesPerLevel());
+
+  int total_reads = 0;
+  for (int prefix_seek = 0; prefix_seek <= 1; prefix_seek++) {
+    ReadOptions read_options;
+    read_options.prefix_same_as_start = prefix_seek;
+    env_->random_read_counter_.Reset();
+    Iterator* iter = db_->NewIterator(read_options);
+    int count = 0;
+    for (iter->Seek("0015"); iter->Valid() && iter->key().starts_with("0015");
+         iter->Next()) {
+      count++;
+    }
+    ASSERT_EQ(10, count);
+    if (prefix_seek) {
+      // The iterator stops at the end of the prefix by itself.
+      ASSERT_TRUE(!iter->Valid());
+      ASSERT_LEVELDB_OK(iter->status());
+      // The other files are skipped whole: only the one block of the file
+      // holding the prefix is read.
+      ASSERT_EQ(3, total_reads);
+      ASSERT_EQ(1, env_->random_read_counter_.Read());
+
+      iter->Seek("0035");
+      ASSERT_TRUE(!iter->Valid());
+      iter->Seek("00160000");
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ("00160060", iter->key().ToString());
+      iter->Prev();
+      ASSERT_TRUE(!iter->Valid());
+      iter->SeekToFirst();
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ("00000000", iter->key().ToString());
+    } else {
+      total_reads = env_->random_read_counter_.Read();
+    }
+    delete iter;
+  }
+
+  // The seeks for the iterate bounds and for changes of direction are not
+  // prefix seeks, so they see every file.
+  Slice lower("0000"), upper("0030");
+  ReadOptions read_options;
+  read_options.prefix_same_as_start = true;
+  read_options.iterate_lower_bound = &lower;
+  read_options.iterate_upper_bound = &upper;
+  Iterator* iter = db_->NewIterator(read_options);
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(300, count);
+  count = 0;
+  for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+    count++;
+  }
+  ASSERT_EQ(300, count);
+  for (iter->SeekToFirst(); iter->key().compare("00150050") < 0;
+       iter->Next()) {
+  }
+  iter->Prev();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("00140049", iter->key().ToString());
+  ASSERT_LEVELDB_OK(iter->status());
+  delete iter;
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+  delete options.prefix_extractor;
+}
+
 TEST_F(DBTest, GetFromVersions) {
   do {
     ASSERT_LEVELDB_OK(Put("foo", "v1"));
@@ -656,6 +1339,63 @@ TEST_F(DBTest, GetMemUsage) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, GetWriteStallProperties) {
+  Options options = FixedWidthOptions();
+  // Ingested files always go to level-0 under universal compaction.
+  options.compaction_style = kCompactionStyleUniversal;
+  options.delayed_write_rate = 64 * 1024;
+  DestroyAndReopen(&options);
+
+  ASSERT_LEVELDB_OK(Put("99999999", std::string(100, 'a')));
+  std::string val;
+  ASSERT_TRUE(db_->GetProperty("leveldb.delayed-write-rate", &val));
+  ASSERT_EQ("0", val);
+  ASSERT_TRUE(db_->GetProperty("leveldb.write-stall-micros", &val));
+  ASSERT_EQ("0", val);
+
+  // Hold the background thread so that no compaction drains level-0, and
+  // ingest enough files at once to reach the slowdown trigger.
+  std::atomic<bool> release(false);
+  env_->Schedule(
+      [](void* arg) {
+        std::atomic<bool>* release = reinterpret_cast<std::atomic<bool>*>(arg);
+        while (!release->load(std::memory_order_acquire)) {
+          Env::Default()->SleepForMicroseconds(1000);
+        }
+      },
+      &release);
+  std::vector<std::string> files;
+  for (int i = 0; i < config::kL0_SlowdownWritesTrigger; i++) {
+    files.push_back(dbname_ + "_stall" + NumberToString(i));
+    SstFileWriter writer(options);
+    ASSERT_LEVELDB_OK(writer.Open(files.back()));
+    for (int j = 0; j < 10; j++) {
+      const std::string key = FixedKey(10 * i + j);
+      ASSERT_LEVELDB_OK(writer.Put(key, std::string(100, 'a')));
+    }
+    ASSERT_LEVELDB_OK(writer.Finish());
+  }
+  ASSERT_LEVELDB_OK(db_->IngestExternalFile(files));
+  ASSERT_EQ(config::kL0_SlowdownWritesTrigger, NumTableFilesAtLevel(0));
+
+  // Writes are now paced, and the time they wait is recorded.
+  for (int i = 0; i < 10; i++) {
+    ASSERT_LEVELDB_OK(Put("99999999", std::string(100, 'b')));
+  }
+  ASSERT_TRUE(db_->GetProperty("leveldb.delayed-write-rate", &val));
+  ASSERT_NE("0", val);
+  ASSERT_LE(std::stoull(val), 64 * 1024);
+  ASSERT_TRUE(db_->GetProperty("leveldb.write-stall-micros", &val));
+  ASSERT_NE("0", val);
+
+  // The flush waits for the background thread to be released.
+  release.store(true, std::memory_order_release);
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  for (const std::string& fname : files) {
+    env_->RemoveFile(fname);
+  }
+}
+
 TEST_F(DBTest, GetSnapshot) {
   do {
     // Try with both a short key and a long key
@@ -803,6 +1543,39 @@ TEST_F(DBTest, GetEncountersEmptyLevel) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, GetAcrossOverlappingLevels) {
+  Options options = FixedWidthOptions();
+  DestroyAndReopen(&options);
+
+  // Five files in each of levels 3 to 6.  The files of a level are
+  // disjoint, but each one overlaps two files of the levels next to it,
+  // and every level holds its own keys.
+  const int kFiles = 5;
+  for (int level = config::kNumLevels - 1; level >= 3; level--) {
+    for (int t = 0; t < kFiles; t++) {
+      for (int j = 0; j < 100; j++) {
+        const int k = t * 1000 + level * 300 + j * 5 + level % 5;
+        ASSERT_LEVELDB_OK(Put(FixedKey(k), std::string(100, 'a' + level)));
+      }
+      dbfull()->TEST_CompactMemTable();
+      for (int l = 0; l < level; l++) {
+        dbfull()->TEST_CompactRange(l, nullptr, nullptr);
+      }
+    }
+  }
+  ASSERT_EQ("0,0,0,5,5,5,5", FilesPerLevel());
+
+  for (int k = 0; k < kFiles * 1000 + 2500; k++) {
+    const std::string key = FixedKey(k);
+    const int level = k % 5 + ((k % 5 < 2) ? 5 : 0);
+    const int offset = k - level * 300;
+    const bool written = level >= 3 && offset >= 0 && offset % 1000 < 500 &&
+                         offset / 1000 < kFiles;
+    ASSERT_EQ(written ? std::string(100, 'a' + level) : "NOT_FOUND", Get(key))
+        << key;
+  }
+}
+
 TEST_F(DBTest, IterEmpty) {
   Iterator* iter = db_->NewIterator(ReadOptions());
 
@@ -1154,6 +1927,153 @@ TEST_F(DBTest, CompactionsGenerateMultipleFiles) {
   }
 }
 
+TEST_F(DBTest, DynamicLevelBytes) {
+  Options options = FixedWidthOptions();
+  options.write_buffer_size = 64 << 10;
+  options.max_bytes_for_level_base = 64 << 10;
+  options.max_bytes_for_level_multiplier = 4;
+  options.level_compaction_dynamic_level_bytes = true;
+  DestroyAndReopen(&options);
+
+  // About 3.5MB of live data, which fixed level sizes would spread over
+  // levels 1 to 4.
+  Random rnd(301);
+  std::map<std::string, std::string> model;
+  for (int i = 0; i < 40000; i++) {
+    const std::string key = FixedKey(rnd.Uniform(30000));
+    model[key] = RandomString(&rnd, 100);
+    ASSERT_LEVELDB_OK(Put(key, model[key]));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Level-0 compacts straight into the lower levels, and the data builds
+  // up from the last level.
+  ASSERT_EQ(0, NumTableFilesAtLevel(1));
+  ASSERT_EQ(0, NumTableFilesAtLevel(2));
+  ASSERT_GT(NumTableFilesAtLevel(config::kNumLevels - 1), 0);
+  for (const auto& kv : model) {
+    ASSERT_EQ(kv.second, Get(kv.first));
+  }
+
+  std::string write_amp;
+  ASSERT_TRUE(db_->GetProperty("leveldb.write-amplification", &write_amp));
+  ASSERT_GT(std::stod(write_amp), 1.0);
+}
+
+TEST_F(DBTest, UniversalCompaction) {
+  Options options = FixedWidthOptions();
+  options.write_buffer_size = 64 << 10;
+  options.compaction_style = kCompactionStyleUniversal;
+  DestroyAndReopen(&options);
+
+  Random rnd(301);
+  std::map<std::string, std::string> model;
+  for (int i = 0; i < 40000; i++) {
+    const std::string key = FixedKey(rnd.Uniform(30000));
+    model[key] = RandomString(&rnd, 100);
+    ASSERT_LEVELDB_OK(Put(key, model[key]));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Level-0 files are merged into runs in the other levels, which fill up
+  // from the last level.
+  for (int i = 0; i < 1000; i++) {
+    if (NumTableFilesAtLevel(0) < config::kL0_CompactionTrigger) {
+      break;
+    }
+    DelayMilliseconds(10);
+  }
+  ASSERT_LT(NumTableFilesAtLevel(0), config::kL0_CompactionTrigger);
+  ASSERT_GT(NumTableFilesAtLevel(config::kNumLevels - 1), 0);
+  for (const auto& kv : model) {
+    ASSERT_EQ(kv.second, Get(kv.first));
+  }
+
+  // The runs are recovered in order.
+  Reopen(&options);
+  for (const auto& kv : model) {
+    ASSERT_EQ(kv.second, Get(kv.first));
+  }
+}
+
+TEST_F(DBTest, CompactionPriority) {
+  // Level-2 holds a large file over [0, 100) and a small one over
+  // [200, 210).  Level-1 holds a file of deletions overlapping the large
+  // one and a file of values overlapping the small one.
+  for (CompactionPri pri : {kMinOverlappingRatioPri, kTombstoneDensityPri}) {
+    Options options = FixedWidthOptions();
+    options.compaction_pri = pri;
+    DestroyAndReopen(&options);
+    for (int i = 0; i < 100; i++) {
+      ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'a')));
+    }
+    dbfull()->TEST_CompactMemTable();
+    for (int i = 200; i < 210; i++) {
+      ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'b')));
+    }
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+    dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+    ASSERT_EQ(2, NumTableFilesAtLevel(2));
+
+    for (int i = 50; i < 60; i++) {
+      ASSERT_LEVELDB_OK(Delete(FixedKey(i)));
+    }
+    dbfull()->TEST_CompactMemTable();
+    for (int i = 200; i < 206; i++) {
+      ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, 'c')));
+    }
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+    ASSERT_EQ(0, NumTableFilesAtLevel(0));
+    ASSERT_EQ(2, NumTableFilesAtLevel(1));
+    ASSERT_EQ(2, NumTableFilesAtLevel(2));
+
+    if (pri == kMinOverlappingRatioPri) {
+      // The values overlap far fewer bytes per byte of their own.
+      ASSERT_EQ("00000200", dbfull()->TEST_PickFileByPriority(1));
+    } else {
+      // The deletions win despite their larger overlap.
+      ASSERT_EQ("00000050", dbfull()->TEST_PickFileByPriority(1));
+    }
+  }
+}
+
+TEST_F(DBTest, GetPropertiesOfAllTables) {
+  Options options = FixedWidthOptions();
+  DestroyAndReopen(&options);
+
+  // Sequence numbers 1..200 for the values, 201..300 for the deletions.
+  Random rnd(301);
+  for (int i = 0; i < 200; i++) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), RandomString(&rnd, 100)));
+  }
+  for (int i = 200; i < 300; i++) {
+    ASSERT_LEVELDB_OK(Delete(FixedKey(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  for (int pass = 0; pass < 2; pass++) {
+    TablePropertiesCollection props;
+    ASSERT_LEVELDB_OK(db_->GetPropertiesOfAllTables(&props));
+    ASSERT_EQ(1, props.size());
+    ASSERT_NE(std::string::npos, props.begin()->first.find(dbname_));
+    const TableProperties& p = props.begin()->second;
+    ASSERT_EQ(300, p.num_entries);
+    ASSERT_EQ(100, p.num_deletions);
+    ASSERT_EQ(300 * 16, p.raw_key_size);
+    ASSERT_EQ(200 * 100, p.raw_value_size);
+    ASSERT_EQ(16, p.key_length);
+    ASSERT_EQ(100, p.value_length);
+    ASSERT_EQ(1, p.smallest_seqno);
+    ASSERT_EQ(300, p.largest_seqno);
+    ASSERT_GT(p.num_data_blocks, 0);
+    ASSERT_GE(p.data_size, 300 * 116);
+    ASSERT_GT(p.creation_time, 0);
+    Reopen(&options);
+  }
+}
+
 TEST_F(DBTest, RepeatedWritesToSameKey) {
   Options options = CurrentOptions();
   options.env = env_;
@@ -1846,6 +2766,122 @@ TEST_F(DBTest, WriteSyncError) {
   ASSERT_EQ("NOT_FOUND", Get("k3"));
 }
 
+namespace {
+
+struct WalSyncThread {
+  DB* db;
+  int id;
+  std::atomic<bool> done;
+};
+
+static void WalSyncThreadBody(void* arg) {
+  WalSyncThread* t = reinterpret_cast<WalSyncThread*>(arg);
+  WriteOptions w;
+  w.sync = true;
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(t->db->Put(w, DBTest::FixedKey(t->id * 1000000 + i),
+                                 DBTest::FixedKey(i)));
+  }
+  t->done.store(true, std::memory_order_release);
+}
+
+}  // namespace
+
+TEST_F(DBTest, BackgroundWalSync) {
+  Options options = FixedWidthOptions(8);
+  options.background_wal_sync = true;
+  DestroyAndReopen(&options);
+
+  static const int kThreads = 4;
+  WalSyncThread threads[kThreads];
+  for (int id = 0; id < kThreads; id++) {
+    threads[id].db = db_;
+    threads[id].id = id;
+    threads[id].done.store(false, std::memory_order_release);
+    env_->StartThread(WalSyncThreadBody, &threads[id]);
+  }
+  for (int id = 0; id < kThreads; id++) {
+    while (!threads[id].done.load(std::memory_order_acquire)) {
+      DelayMilliseconds(10);
+    }
+  }
+
+  Reopen(&options);
+  for (int id = 0; id < kThreads; id++) {
+    ASSERT_EQ("00000000", Get("0" + std::to_string(id) + "000000"));
+    ASSERT_EQ("00000099", Get("0" + std::to_string(id) + "000099"));
+  }
+}
+
+TEST_F(DBTest, BackgroundWalSyncError) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  options.background_wal_sync = true;
+  options.key_length = 2 + 8;  // Internal keys
+  options.value_length = 2;
+  DestroyAndReopen(&options);
+  env_->data_sync_error_.store(true, std::memory_order_release);
+
+  WriteOptions w;
+  ASSERT_LEVELDB_OK(db_->Put(w, "k1", "v1"));
+  w.sync = true;
+  ASSERT_TRUE(!db_->Put(w, "k2", "v2").ok());
+  env_->data_sync_error_.store(false, std::memory_order_release);
+
+  // The failed sync leaves the log in an unknown state, so later writes fail.
+  w.sync = false;
+  ASSERT_TRUE(!db_->Put(w, "k3", "v3").ok());
+  ASSERT_EQ("v1", Get("k1"));
+}
+
+TEST_F(DBTest, PackFixedWidthWrites) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  options.pack_fixed_width_writes = true;
+  options.key_length = 2 + 8;  // Internal keys
+  options.value_length = 2;
+  DestroyAndReopen(&options);
+
+  WriteBatch batch;
+  for (int i = 0; i < 50; i++) {
+    batch.Put(std::to_string(10 + i), std::to_string(50 + i));
+  }
+  batch.Delete("20");
+  ASSERT_LEVELDB_OK(db_->Write(WriteOptions(), &batch));
+  ASSERT_LEVELDB_OK(Put("99", "xx"));
+
+  // The packed log records are replayed at open.
+  Reopen(&options);
+  ASSERT_EQ("50", Get("10"));
+  ASSERT_EQ("NOT_FOUND", Get("20"));
+  ASSERT_EQ("99", Get("59"));
+  ASSERT_EQ("xx", Get("99"));
+}
+
+TEST_F(DBTest, BackgroundWalSyncUnsupported) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  options.background_wal_sync = true;
+  options.key_length = 2 + 8;  // Internal keys
+  options.value_length = 2;
+  DestroyAndReopen(&options);
+  ASSERT_LEVELDB_OK(Put("k1", "v1"));
+  Close();
+
+  // An Env whose log files cannot be synced by the sync thread is rejected
+  // at open rather than failing the first synced write.
+  env_->sync_flushed_unsupported_.store(true, std::memory_order_release);
+  Status s = TryReopen(&options);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  env_->sync_flushed_unsupported_.store(false, std::memory_order_release);
+
+  ASSERT_LEVELDB_OK(TryReopen(&options));
+  ASSERT_EQ("v1", Get("k1"));
+}
+
 TEST_F(DBTest, ManifestWriteError) {
   // Test for the following problem:
   // (a) Compaction produces file F
@@ -1886,6 +2922,359 @@ TEST_F(DBTest, ManifestWriteError) {
   }
 }
 
+TEST_F(DBTest, ManifestRollover) {
+  Options options = FixedWidthOptions();
+  options.max_manifest_file_size = 1 << 10;
+  DestroyAndReopen(&options);
+
+  // Every flush and compaction logs an edit, but the set of live files
+  // stays small, so the MANIFEST is replaced as it fills up.
+  std::set<std::string> manifests;
+  for (int i = 0; i < 300; i++) {
+    const std::string key = FixedKey(i % 10);
+    ASSERT_LEVELDB_OK(Put(key, std::string(100, 'a' + i % 26)));
+    dbfull()->TEST_CompactMemTable();
+    std::string current;
+    ASSERT_LEVELDB_OK(
+        ReadFileToString(env_, CurrentFileName(dbname_), &current));
+    manifests.insert(current);
+  }
+  ASSERT_GT(manifests.size(), 3);
+
+  // Only the live MANIFEST is kept, and it holds little more than the
+  // live files rather than the 30KB of edits logged so far.
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  int live_manifests = 0;
+  uint64_t number;
+  FileType type;
+  for (const std::string& filename : filenames) {
+    if (ParseFileName(filename, &number, &type) && type == kDescriptorFile) {
+      live_manifests++;
+      uint64_t size;
+      ASSERT_LEVELDB_OK(env_->GetFileSize(dbname_ + "/" + filename, &size));
+      ASSERT_LT(size, 4 << 10);
+    }
+  }
+  ASSERT_EQ(1, live_manifests);
+
+  Reopen(&options);
+  for (int i = 290; i < 300; i++) {
+    ASSERT_EQ(std::string(100, 'a' + i % 26), Get(FixedKey(i % 10)));
+  }
+}
+
+TEST_F(DBTest, IngestExternalFile) {
+  Options options = FixedWidthOptions();
+  DestroyAndReopen(&options);
+
+  // Writes keys [first,last] with values of "c", deleting "deleted".
+  auto write_file = [&](const std::string& fname, int first, int last, char c,
+                        int deleted) {
+    SstFileWriter writer(options);
+    ASSERT_LEVELDB_OK(writer.Open(fname));
+    for (int i = first; i <= last; i++) {
+      const std::string key = FixedKey(i);
+      if (i == deleted) {
+        ASSERT_LEVELDB_OK(writer.Delete(key));
+      } else {
+        ASSERT_LEVELDB_OK(writer.Put(key, std::string(100, c)));
+      }
+    }
+    ASSERT_LEVELDB_OK(writer.Finish());
+  };
+  const std::string file1 = dbname_ + "_ingest1";
+  const std::string file2 = dbname_ + "_ingest2";
+
+  // An empty database takes the file at the last level.
+  write_file(file1, 0, 99, 'a', -1);
+  ASSERT_LEVELDB_OK(db_->IngestExternalFile({file1}));
+  ASSERT_EQ(1, NumTableFilesAtLevel(config::kNumLevels - 1));
+  ASSERT_EQ(std::string(100, 'a'), Get("00000050"));
+
+  // A file over keys written since is newer than them, but not visible
+  // to earlier snapshots.
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(Put("00000005", std::string(100, 'm')));
+  write_file(file2, 0, 9, 'b', 3);
+  ASSERT_LEVELDB_OK(db_->IngestExternalFile({file2}));
+  ASSERT_EQ(std::string(100, 'b'), Get("00000001"));
+  ASSERT_EQ("NOT_FOUND", Get("00000003"));
+  ASSERT_EQ(std::string(100, 'b'), Get("00000005"));
+  ASSERT_EQ(std::string(100, 'a'), Get("00000050"));
+  ASSERT_EQ(std::string(100, 'a'), Get("00000003", snapshot));
+  ASSERT_EQ(std::string(100, 'a'), Get("00000005", snapshot));
+  db_->ReleaseSnapshot(snapshot);
+
+  // Later writes win over ingested keys.
+  ASSERT_LEVELDB_OK(Put("00000001", std::string(100, 'c')));
+  ASSERT_EQ(std::string(100, 'c'), Get("00000001"));
+
+  Reopen(&options);
+  ASSERT_EQ(std::string(100, 'c'), Get("00000001"));
+  ASSERT_EQ("NOT_FOUND", Get("00000003"));
+  ASSERT_EQ(std::string(100, 'b'), Get("00000005"));
+  ASSERT_EQ(std::string(100, 'a'), Get("00000050"));
+
+  // Files that overlap each other are rejected and change nothing.
+  write_file(file1, 10, 20, 'd', -1);
+  write_file(file2, 15, 25, 'd', -1);
+  ASSERT_TRUE(db_->IngestExternalFile({file1, file2}).IsInvalidArgument());
+  ASSERT_EQ(std::string(100, 'a'), Get("00000015"));
+  ASSERT_TRUE(!db_->IngestExternalFile({dbname_ + "_missing"}).ok());
+
+  // The writer rejects keys out of order or of the wrong size.
+  SstFileWriter writer(options);
+  ASSERT_LEVELDB_OK(writer.Open(file1));
+  ASSERT_LEVELDB_OK(writer.Put("00000002", std::string(100, 'e')));
+  ASSERT_TRUE(
+      writer.Put("00000001", std::string(100, 'e')).IsInvalidArgument());
+  ASSERT_TRUE(writer.Put("00000003", "e").IsInvalidArgument());
+  ASSERT_TRUE(writer.Delete("short").IsInvalidArgument());
+  ASSERT_LEVELDB_OK(writer.Finish());
+
+  env_->RemoveFile(file1);
+  env_->RemoveFile(file2);
+
+  // Under universal compaction or dynamic level sizes the file lands in
+  // level-0 next to the flushed memtable, and must still be the newer of
+  // the two, also after reopening.
+  for (int dynamic = 0; dynamic <= 1; dynamic++) {
+    options.compaction_style =
+        dynamic ? kCompactionStyleLevel : kCompactionStyleUniversal;
+    options.level_compaction_dynamic_level_bytes = dynamic;
+    DestroyAndReopen(&options);
+    ASSERT_LEVELDB_OK(Put("00000005", std::string(100, 'm')));
+    write_file(file2, 0, 9, 'b', 3);
+    ASSERT_LEVELDB_OK(db_->IngestExternalFile({file2}));
+    ASSERT_EQ(2, NumTableFilesAtLevel(0));
+    ASSERT_EQ(std::string(100, 'b'), Get("00000005"));
+    Reopen(&options);
+    ASSERT_EQ(std::string(100, 'b'), Get("00000005"));
+  }
+  env_->RemoveFile(file2);
+}
+
+TEST_F(DBTest, DeleteRange) {
+  Options options = FixedWidthOptions();
+  DestroyAndReopen(&options);
+
+  std::map<std::string, std::string> model;
+  auto put = [&](int i, char c) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(i), std::string(100, c)));
+    model[FixedKey(i)] = std::string(100, c);
+  };
+  auto delete_range = [&](int begin, int end) {
+    ASSERT_LEVELDB_OK(
+        db_->DeleteRange(WriteOptions(), FixedKey(begin), FixedKey(end)));
+    model.erase(model.lower_bound(FixedKey(begin)),
+                model.lower_bound(FixedKey(end)));
+  };
+  // Compares Get(), MultiGet() and both directions of iteration with the
+  // model.
+  auto check = [&]() {
+    std::vector<std::string> key_strings;
+    for (int i = 0; i < 1000; i += 7) {
+      key_strings.push_back(FixedKey(i));
+    }
+    std::vector<Slice> keys(key_strings.begin(), key_strings.end());
+    std::vector<std::string> values;
+    std::vector<Status> statuses = db_->MultiGet(ReadOptions(), keys, &values);
+    for (size_t i = 0; i < keys.size(); i++) {
+      auto it = model.find(key_strings[i]);
+      const std::string expected =
+          (it == model.end()) ? "NOT_FOUND" : it->second;
+      ASSERT_EQ(expected, Get(key_strings[i])) << key_strings[i];
+      ASSERT_EQ(expected, statuses[i].ok() ? values[i] : "NOT_FOUND")
+          << key_strings[i];
+    }
+
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    auto it = model.begin();
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++it) {
+      ASSERT_TRUE(it != model.end());
+      ASSERT_EQ(it->first, iter->key().ToString());
+      ASSERT_EQ(it->second, iter->value().ToString());
+    }
+    ASSERT_TRUE(it == model.end());
+    auto rit = model.rbegin();
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev(), ++rit) {
+      ASSERT_TRUE(rit != model.rend());
+      ASSERT_EQ(rit->first, iter->key().ToString());
+    }
+    ASSERT_TRUE(rit == model.rend());
+    iter->Seek(FixedKey(500));
+    auto sit = model.lower_bound(FixedKey(500));
+    ASSERT_EQ(sit == model.end(), !iter->Valid());
+    if (iter->Valid()) {
+      ASSERT_EQ(sit->first, iter->key().ToString());
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    delete iter;
+
+    // With iterate bounds, only the tables within them supply tombstones.
+    const std::string lower_key = FixedKey(250), upper_key = FixedKey(650);
+    Slice lower(lower_key), upper(upper_key);
+    ReadOptions bounded;
+    bounded.iterate_lower_bound = &lower;
+    bounded.iterate_upper_bound = &upper;
+    iter = db_->NewIterator(bounded);
+    auto bit = model.lower_bound(lower_key);
+    const auto bend = model.lower_bound(upper_key);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++bit) {
+      ASSERT_TRUE(bit != bend);
+      ASSERT_EQ(bit->first, iter->key().ToString());
+    }
+    ASSERT_TRUE(bit == bend);
+    ASSERT_LEVELDB_OK(iter->status());
+    delete iter;
+  };
+
+  for (int i = 0; i < 1000; i++) {
+    put(i, 'a');
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+
+  // Tombstones in the memtable hide keys in the tables below.
+  delete_range(100, 200);
+  put(150, 'b');
+  const Snapshot* snapshot = db_->GetSnapshot();
+  delete_range(140, 160);
+  delete_range(300, 350);
+  check();
+
+  // And keep hiding them once flushed.
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  check();
+  ASSERT_EQ(std::string(100, 'b'), Get(FixedKey(150), snapshot));
+  ASSERT_EQ(std::string(100, 'a'), Get(FixedKey(340), snapshot));
+  ASSERT_EQ("NOT_FOUND", Get(FixedKey(120), snapshot));
+
+  // Writes after a tombstone are visible.
+  put(310, 'c');
+  delete_range(600, 700);
+  check();
+
+  // Compactions keep what the snapshot sees.
+  db_->CompactRange(nullptr, nullptr);
+  check();
+  ASSERT_EQ(std::string(100, 'b'), Get(FixedKey(150), snapshot));
+  ASSERT_EQ(std::string(100, 'a'), Get(FixedKey(340), snapshot));
+  db_->ReleaseSnapshot(snapshot);
+
+  // Without snapshots they drop the entries and the tombstones.  Push
+  // everything through every level so that each table is rewritten.
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, nullptr, nullptr);
+  }
+  check();
+  ASSERT_EQ(TotalTableFiles(), NumTableFilesAtLevel(config::kNumLevels - 1));
+  ASSERT_EQ("[ ]", AllEntriesFor(FixedKey(120)));
+  ASSERT_EQ("[ ]", AllEntriesFor(FixedKey(340)));
+  ASSERT_EQ("[ " + std::string(100, 'c') + " ]", AllEntriesFor(FixedKey(310)));
+
+  // A range over everything leaves no tables behind.
+  delete_range(0, 100000);
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  check();
+  db_->CompactRange(nullptr, nullptr);
+  check();
+  ASSERT_EQ(0, TotalTableFiles());
+
+  // Tombstones survive recovery from the log and from tables.
+  put(5, 'd');
+  put(6, 'd');
+  put(7, 'd');
+  delete_range(6, 7);
+  Reopen(&options);
+  check();
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  Reopen(&options);
+  check();
+
+  // Empty ranges change nothing; reversed ones are rejected.
+  ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), FixedKey(5), FixedKey(5)));
+  ASSERT_TRUE(db_->DeleteRange(WriteOptions(), FixedKey(7), FixedKey(5))
+                  .IsInvalidArgument());
+  check();
+}
+
+TEST_F(DBTest, DeleteRangeRandomized) {
+  Options options = FixedWidthOptions();
+  options.write_buffer_size = 20000;
+  options.max_file_size = 8000;  // Split compaction outputs often
+  DestroyAndReopen(&options);
+
+  // Snapshots of the database with the model of their contents.
+  std::vector<std::pair<const Snapshot*, std::map<std::string, std::string>>>
+      snapshots;
+  std::map<std::string, std::string> model;
+  auto check = [&](const Snapshot* snapshot,
+                   const std::map<std::string, std::string>& expected) {
+    ReadOptions read_options;
+    read_options.snapshot = snapshot;
+    Iterator* iter = db_->NewIterator(read_options);
+    auto it = expected.begin();
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++it) {
+      ASSERT_TRUE(it != expected.end());
+      ASSERT_EQ(it->first, iter->key().ToString());
+      ASSERT_EQ(it->second, iter->value().ToString());
+    }
+    ASSERT_TRUE(it == expected.end());
+    ASSERT_LEVELDB_OK(iter->status());
+    delete iter;
+    for (int i = 0; i < 2000; i += 13) {
+      auto found = expected.find(FixedKey(i));
+      ASSERT_EQ(found == expected.end() ? "NOT_FOUND" : found->second,
+                Get(FixedKey(i), snapshot))
+          << FixedKey(i);
+    }
+  };
+
+  Random rnd(301);
+  for (int step = 0; step < 3000; step++) {
+    const int r = rnd.Uniform(100);
+    if (r < 80) {
+      const std::string k = FixedKey(rnd.Uniform(2000));
+      const std::string v(100, 'a' + rnd.Uniform(26));
+      ASSERT_LEVELDB_OK(Put(k, v));
+      model[k] = v;
+    } else if (r < 95) {
+      const int begin = rnd.Uniform(2000);
+      const int end = begin + rnd.Uniform(200);
+      ASSERT_LEVELDB_OK(
+          db_->DeleteRange(WriteOptions(), FixedKey(begin), FixedKey(end)));
+      model.erase(model.lower_bound(FixedKey(begin)),
+                  model.lower_bound(FixedKey(end)));
+    } else if (r < 97) {
+      ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+      dbfull()->TEST_CompactRange(rnd.Uniform(config::kNumLevels - 1),
+                                  nullptr, nullptr);
+    } else if (r < 99) {
+      if (snapshots.size() < 3) {
+        snapshots.emplace_back(db_->GetSnapshot(), model);
+      }
+    } else if (!snapshots.empty()) {
+      check(snapshots.front().first, snapshots.front().second);
+      db_->ReleaseSnapshot(snapshots.front().first);
+      snapshots.erase(snapshots.begin());
+    }
+  }
+  check(nullptr, model);
+  for (auto& s : snapshots) {
+    check(s.first, s.second);
+  }
+  db_->CompactRange(nullptr, nullptr);
+  check(nullptr, model);
+  for (auto& s : snapshots) {
+    check(s.first, s.second);
+    db_->ReleaseSnapshot(s.first);
+  }
+  Reopen(&options);
+  check(nullptr, model);
+}
+
 TEST_F(DBTest, MissingSSTFile) {
   ASSERT_LEVELDB_OK(Put("foo", "bar"));
   ASSERT_EQ("bar", Get("foo"));
@@ -1977,6 +3366,37 @@ TEST_F(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
+TEST_F(DBTest, BlockedBloomFilter) {
+  env_->count_random_reads_ = true;
+  Options options = FixedWidthOptions(8);
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBlockedBloomFilterPolicy(10);
+  DestroyAndReopen(&options);
+
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(FixedKey(2 * i), FixedKey(i).substr(0, 8)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+
+  // Lookup missing keys.  Should rarely read from the sstable.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(FixedKey(2 * i + 1)));
+  }
+  int reads = env_->random_read_counter_.Read();
+  std::fprintf(stderr, "%d missing => %d reads\n", N, reads);
+  ASSERT_LE(reads, 3 * N / 100);
+
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
 TEST_F(DBTest, LogCloseError) {
   // Regression test for bug where we could ignore log file
   // Close() error when switching to a new log file.
@@ -2153,6 +3573,11 @@ class ModelDB : public DB {
         (*map_)[key.ToString()] = value.ToString();
       }
       void Delete(const Slice& key) override { map_->erase(key.ToString()); }
+      void DeleteRange(const Slice& begin_key,
+                       const Slice& end_key) override {
+        map_->erase(map_->lower_bound(begin_key.ToString()),
+                    map_->lower_bound(end_key.ToString()));
+      }
     };
     Handler handler;
     handler.map_ = &map_;
@@ -6,6 +6,7 @@
 
 #include <cstdio>
 #include <sstream>
+#include <vector>
 
 #include "port/port.h"
 #include "util/coding.h"
@@ -14,7 +15,7 @@ namespace leveldb {
 
 static uint64_t PackSequenceAndType(uint64_t seq, ValueType t) {
   assert(seq <= kMaxSequenceNumber);
-  assert(t <= kValueTypeForSeek);
+  assert(t <= kTypeRangeDeletion);
   return (seq << 8) | t;
 }
 
@@ -96,7 +97,25 @@ void InternalKeyComparator::FindShortSuccessor(std::string* key) const {
   }
 }
 
-const char* InternalFilterPolicy::Name() const { return user_policy_->Name(); }
+InternalFilterPolicy::InternalFilterPolicy(
+    const FilterPolicy* p, const SliceTransform* prefix_extractor)
+    : user_policy_(p), prefix_extractor_(prefix_extractor) {
+  if (user_policy_ != nullptr) {
+    name_ = user_policy_->Name();
+    if (prefix_extractor_ != nullptr) {
+      // Filters holding prefixes must not be probed for prefixes by a
+      // database using another extractor, or none.
+      name_.append("+");
+      name_.append(prefix_extractor_->Name());
+    }
+  }
+}
+
+const char* InternalFilterPolicy::Name() const { return name_.c_str(); }
+
+bool InternalFilterPolicy::WholeTableFilter() const {
+  return user_policy_->WholeTableFilter();
+}
 
 void InternalFilterPolicy::CreateFilter(const Slice* keys, int n,
                                         std::string* dst) const {
@@ -107,7 +126,29 @@ void InternalFilterPolicy::CreateFilter(const Slice* keys, int n,
     mkey[i] = ExtractUserKey(keys[i]);
     // TODO(sanjay): Suppress dups?
   }
-  user_policy_->CreateFilter(keys, n, dst);
+  if (prefix_extractor_ == nullptr) {
+    user_policy_->CreateFilter(keys, n, dst);
+    return;
+  }
+
+  // Keys are sorted, so keys sharing a prefix are adjacent and each
+  // prefix is added once.
+  std::vector<Slice> with_prefixes(keys, keys + n);
+  Slice last_prefix;
+  bool has_prefix = false;
+  for (int i = 0; i < n; i++) {
+    if (!prefix_extractor_->InDomain(keys[i])) {
+      continue;
+    }
+    Slice prefix = prefix_extractor_->Transform(keys[i]);
+    if (!has_prefix || prefix != last_prefix) {
+      with_prefixes.push_back(prefix);
+      last_prefix = prefix;
+      has_prefix = true;
+    }
+  }
+  user_policy_->CreateFilter(with_prefixes.data(),
+                             static_cast<int>(with_prefixes.size()), dst);
 }
 
 bool InternalFilterPolicy::KeyMayMatch(const Slice& key, const Slice& f) const {
@@ -0,0 +1,144 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/file_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "db/version_set.h"
+
+namespace leveldb {
+
+// Levels with fewer files are searched about as fast without a model.
+static const size_t kMinFilesForIndex = 32;
+
+// Largest distance between the predicted and the actual position of the
+// files the model is built over.
+static const double kMaxError = 2;
+
+void FileIndex::Build(const std::vector<FileMetaData*>& files) {
+  num_files_ = files.size();
+  segments_.clear();
+  common_prefix_.clear();
+  if (files.size() < kMinFilesForIndex) {
+    return;
+  }
+
+  // Every key in the level lies between these two, so it shares the
+  // prefix they have in common, which carries no information.
+  const Slice first = files.front()->smallest.user_key();
+  const Slice last = files.back()->largest.user_key();
+  size_t shared = 0;
+  while (shared < first.size() && shared < last.size() &&
+         first[shared] == last[shared]) {
+    shared++;
+  }
+  common_prefix_.assign(first.data(), shared);
+
+  // Greedily fit segments: each one keeps the range of slopes that
+  // predict all of its points to within kMaxError, and ends at the first
+  // point that leaves no such slope.
+  size_t i = 0;
+  while (i < files.size()) {
+    Segment segment;
+    segment.start = KeyToPoint(files[i]->largest.user_key());
+    segment.base = i;
+    double min_slope = 0;
+    double max_slope = std::numeric_limits<double>::infinity();
+    size_t j = i + 1;
+    for (; j < files.size(); j++) {
+      const uint64_t x = KeyToPoint(files[j]->largest.user_key());
+      const double dy = static_cast<double>(j - i);
+      if (x == segment.start) {
+        if (dy > kMaxError) {
+          break;
+        }
+        continue;
+      }
+      const double dx = static_cast<double>(x - segment.start);
+      const double low = (dy - kMaxError) / dx;
+      const double high = (dy + kMaxError) / dx;
+      if (low > max_slope || high < min_slope) {
+        break;
+      }
+      min_slope = std::max(min_slope, low);
+      max_slope = std::min(max_slope, high);
+    }
+    segment.slope = std::isinf(max_slope) ? min_slope
+                                          : (min_slope + max_slope) / 2;
+    segments_.push_back(segment);
+    i = j;
+  }
+}
+
+uint64_t FileIndex::KeyToPoint(const Slice& user_key) const {
+  const size_t shared = common_prefix_.size();
+  const size_t compared = std::min(shared, user_key.size());
+  const int r = Slice(user_key.data(), compared)
+                    .compare(Slice(common_prefix_.data(), compared));
+  if (r < 0 || (r == 0 && user_key.size() < shared)) {
+    return 0;
+  } else if (r > 0) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  uint64_t x = 0;
+  for (size_t i = shared; i < shared + 8; i++) {
+    x <<= 8;
+    if (i < user_key.size()) {
+      x |= static_cast<uint8_t>(user_key[i]);
+    }
+  }
+  return x;
+}
+
+void FileIndex::Predict(const Slice& user_key, uint32_t* lo,
+                        uint32_t* hi) const {
+  const uint64_t x = KeyToPoint(user_key);
+  auto next = std::upper_bound(
+      segments_.begin(), segments_.end(), x,
+      [](uint64_t x, const Segment& s) { return x < s.start; });
+  const Segment& segment =
+      (next == segments_.begin()) ? segments_.front() : *(next - 1);
+  const double dx = (x >= segment.start)
+                        ? static_cast<double>(x - segment.start)
+                        : -static_cast<double>(segment.start - x);
+  const double position = segment.base + segment.slope * dx;
+
+  // The files before and after the answer are predicted to within
+  // kMaxError, so the answer is within kMaxError + 1 of the prediction.
+  const double low = std::floor(position - kMaxError);
+  const double high = std::ceil(position + kMaxError + 1);
+  *lo = (low <= 0) ? 0
+        : (low >= num_files_) ? num_files_
+                              : static_cast<uint32_t>(low);
+  *hi = (high <= *lo) ? *lo
+        : (high >= num_files_) ? num_files_
+                               : static_cast<uint32_t>(high);
+}
+
+uint32_t FileIndex::FindFile(const InternalKeyComparator& icmp,
+                             const std::vector<FileMetaData*>& files,
+                             const Slice& key) const {
+  assert(files.size() == num_files_);
+  uint32_t lo, hi;
+  Predict(ExtractUserKey(key), &lo, &hi);
+  const uint32_t right = FindFileInRange(icmp, files, key, lo, hi);
+  // An answer at either end of the window is only right if the file just
+  // outside the window agrees.  Segment boundaries and keys that share
+  // their leading bytes can throw the prediction off; search the whole
+  // level then.
+  if ((right == lo && lo > 0 &&
+       icmp.InternalKeyComparator::Compare(files[lo - 1]->largest.Encode(),
+                                           key) >= 0) ||
+      (right == hi && hi < num_files_ &&
+       icmp.InternalKeyComparator::Compare(files[hi]->largest.Encode(), key) <
+           0)) {
+    return leveldb::FindFile(icmp, files, key);
+  }
+  return right;
+}
+
+}  // namespace leveldb
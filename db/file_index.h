@@ -0,0 +1,68 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// FileIndex is a learned index over the files of one sorted level.  It maps
+// a key to the position of the file that may hold it with a piecewise
+// linear model over eight bytes of the key, so that finding the file takes
+// a few comparisons inside a small window instead of a binary search over
+// the whole level.  The model is built from the files' largest keys and
+// is only valid for the bytewise comparator.
+//
+// Immutable once built; safe for concurrent readers.
+
+#ifndef STORAGE_LEVELDB_DB_FILE_INDEX_H_
+#define STORAGE_LEVELDB_DB_FILE_INDEX_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "db/version_edit.h"
+
+namespace leveldb {
+
+class FileIndex {
+ public:
+  FileIndex() : num_files_(0) {}
+
+  // Builds the model over "files", which must be sorted and must not
+  // overlap.  Levels with too few files to benefit are left without a
+  // model.
+  void Build(const std::vector<FileMetaData*>& files);
+
+  // Returns true iff Build() made a model.
+  bool Ready() const { return !segments_.empty(); }
+
+  // Returns the same result as FindFile(icmp, files, key), where "files"
+  // are the files the index was built over.
+  // REQUIRES: Ready()
+  uint32_t FindFile(const InternalKeyComparator& icmp,
+                    const std::vector<FileMetaData*>& files,
+                    const Slice& key) const;
+
+ private:
+  // Points at or after "start" are predicted to be at position
+  // "base + slope * (x - start)".
+  struct Segment {
+    uint64_t start;
+    double base;
+    double slope;
+  };
+
+  // Maps a user key to the eight bytes that follow the prefix shared by
+  // every key in the level, preserving their order.
+  uint64_t KeyToPoint(const Slice& user_key) const;
+
+  // Returns the predicted position of "user_key" as a window [*lo, *hi].
+  void Predict(const Slice& user_key, uint32_t* lo, uint32_t* hi) const;
+
+  std::string common_prefix_;
+  std::vector<Segment> segments_;
+  uint32_t num_files_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_FILE_INDEX_H_
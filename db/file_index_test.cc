@@ -0,0 +1,136 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/file_index.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "gtest/gtest.h"
+#include "db/version_set.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+class FileIndexTest : public testing::Test {
+ public:
+  FileIndexTest() : icmp_(BytewiseComparator()) {}
+
+  ~FileIndexTest() {
+    for (size_t i = 0; i < files_.size(); i++) {
+      delete files_[i];
+    }
+  }
+
+  void Add(const std::string& smallest, const std::string& largest) {
+    FileMetaData* f = new FileMetaData;
+    f->number = files_.size() + 1;
+    f->smallest = InternalKey(smallest, 100, kTypeValue);
+    f->largest = InternalKey(largest, 100, kTypeValue);
+    files_.push_back(f);
+  }
+
+  // Checks that the index finds the same file as a binary search for
+  // "user_key" at a few sequence numbers.
+  void Check(const std::string& user_key) {
+    for (SequenceNumber seq : {SequenceNumber(1), SequenceNumber(100),
+                               kMaxSequenceNumber}) {
+      InternalKey target(user_key, seq, kTypeValue);
+      ASSERT_EQ(FindFile(icmp_, files_, target.Encode()),
+                index_.FindFile(icmp_, files_, target.Encode()))
+          << user_key << " @ " << seq;
+    }
+  }
+
+  void CheckBoundaries() {
+    for (size_t i = 0; i < files_.size(); i++) {
+      Check(files_[i]->smallest.user_key().ToString());
+      Check(files_[i]->largest.user_key().ToString());
+    }
+  }
+
+  InternalKeyComparator icmp_;
+  std::vector<FileMetaData*> files_;
+  FileIndex index_;
+};
+
+static std::string FixedKey(uint64_t k) {
+  char buf[17];
+  std::snprintf(buf, sizeof(buf), "%016llu", static_cast<unsigned long long>(k));
+  return std::string(buf, 16);
+}
+
+TEST_F(FileIndexTest, TooFewFiles) {
+  for (int i = 0; i < 4; i++) {
+    Add(FixedKey(10 * i), FixedKey(10 * i + 5));
+  }
+  index_.Build(files_);
+  ASSERT_TRUE(!index_.Ready());
+}
+
+TEST_F(FileIndexTest, Uniform) {
+  for (int i = 0; i < 1000; i++) {
+    Add(FixedKey(1000 * i), FixedKey(1000 * i + 999));
+  }
+  index_.Build(files_);
+  ASSERT_TRUE(index_.Ready());
+  CheckBoundaries();
+  Random rnd(301);
+  for (int i = 0; i < 10000; i++) {
+    Check(FixedKey(rnd.Uniform(1100000)));
+  }
+  Check("");
+  Check("0");
+  Check("1");
+  Check("\xff");
+}
+
+TEST_F(FileIndexTest, Skewed) {
+  // Files that get denser and denser towards the end of the key space,
+  // some of them sharing their leading bytes.
+  uint64_t k = 0;
+  for (int i = 0; i < 500; i++) {
+    const uint64_t width = (i < 250) ? 1000000000 : (i < 400) ? 1000 : 1;
+    Add(FixedKey(k), FixedKey(k + width - 1));
+    k += width;
+  }
+  index_.Build(files_);
+  ASSERT_TRUE(index_.Ready());
+  CheckBoundaries();
+  Random rnd(301);
+  for (int i = 0; i < 10000; i++) {
+    Check(FixedKey((static_cast<uint64_t>(rnd.Next()) << 8) % (k + 10)));
+    Check(FixedKey(k - rnd.Uniform(200000)));
+  }
+}
+
+TEST_F(FileIndexTest, VariableLength) {
+  Random rnd(301);
+  std::vector<std::string> keys;
+  for (int i = 0; i < 400; i++) {
+    std::string key = "user";
+    const int len = rnd.Uniform(12);
+    for (int j = 0; j < len; j++) {
+      key.push_back(static_cast<char>(' ' + rnd.Uniform(95)));
+    }
+    keys.push_back(key);
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  for (size_t i = 0; i + 1 < keys.size(); i += 2) {
+    Add(keys[i], keys[i + 1]);
+  }
+  index_.Build(files_);
+  ASSERT_TRUE(index_.Ready());
+  CheckBoundaries();
+  for (size_t i = 0; i < keys.size(); i++) {
+    Check(keys[i] + "!");
+    Check(keys[i].substr(0, keys[i].size() / 2));
+  }
+  Check("");
+  Check("use");
+  Check("usf");
+}
+
+}  // namespace leveldb
@@ -4,6 +4,7 @@
 
 #include "db/memtable.h"
 #include "db/dbformat.h"
+#include "db/range_tombstone.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
@@ -19,7 +20,15 @@ static Slice GetLengthPrefixedSlice(const char* data) {
 }
 
 MemTable::MemTable(const InternalKeyComparator& comparator)
-    : comparator_(comparator), refs_(0), table_(comparator_, &arena_) {}
+    : MemTable(comparator, nullptr) {}
+
+MemTable::MemTable(const InternalKeyComparator& comparator,
+                   ArenaRegionPool* pool)
+    : comparator_(comparator),
+      refs_(0),
+      arena_(pool),
+      table_(comparator_, &arena_),
+      range_del_table_(comparator_, &arena_) {}
 
 MemTable::~MemTable() { assert(refs_ == 0); }
 
@@ -73,6 +82,10 @@ class MemTableIterator : public Iterator {
 
 Iterator* MemTable::NewIterator() { return new MemTableIterator(&table_); }
 
+Iterator* MemTable::NewRangeTombstoneIterator() {
+  return new MemTableIterator(&range_del_table_);
+}
+
 void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
                    const Slice& value) {
   // Format of an entry is concatenation of:
@@ -96,10 +109,32 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   p = EncodeVarint32(p, val_size);
   std::memcpy(p, value.data(), val_size);
   assert(p + val_size == buf + encoded_len);
-  table_.Insert(buf);
+  if (type == kTypeRangeDeletion) {
+    range_del_table_.Insert(buf);
+  } else {
+    table_.Insert(buf);
+  }
 }
 
 bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+  const Comparator* ucmp = comparator_.comparator.user_comparator();
+
+  // Sequence number of the newest range tombstone that covers the key and
+  // is visible to the lookup.  Older memtables and the tables only hold
+  // entries older than it, so it settles the lookup here.
+  SequenceNumber covering = 0;
+  Table::Iterator range_iter(&range_del_table_);
+  range_iter.SeekToFirst();
+  if (range_iter.Valid()) {
+    const Slice ikey = key.internal_key();
+    const SequenceNumber snapshot =
+        DecodeFixed64(ikey.data() + ikey.size() - 8) >> 8;
+    MemTableIterator iter(&range_del_table_);
+    Status ignored;  // Our own encoding cannot be malformed
+    covering = MaxCoveringTombstoneSequence(&iter, ucmp, key.user_key(),
+                                            snapshot, &ignored);
+  }
+
   Slice memkey = key.memtable_key();
   Table::Iterator iter(&table_);
   iter.Seek(memkey.data());
@@ -116,10 +151,13 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
     const char* entry = iter.key();
     uint32_t key_length;
     const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
-    if (comparator_.comparator.user_comparator()->Compare(
-            Slice(key_ptr, key_length - 8), key.user_key()) == 0) {
+    if (ucmp->Compare(Slice(key_ptr, key_length - 8), key.user_key()) == 0) {
       // Correct user key
       const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+      if ((tag >> 8) < covering) {
+        *s = Status::NotFound(Slice());
+        return true;
+      }
       switch (static_cast<ValueType>(tag & 0xff)) {
         case kTypeValue: {
           Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
@@ -127,11 +165,16 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
           return true;
         }
         case kTypeDeletion:
+        case kTypeRangeDeletion:
           *s = Status::NotFound(Slice());
           return true;
       }
     }
   }
+  if (covering > 0) {
+    *s = Status::NotFound(Slice());
+    return true;
+  }
   return false;
 }
 
@@ -23,6 +23,10 @@ class MemTable {
   // is zero and the caller must call Ref() at least once.
   explicit MemTable(const InternalKeyComparator& comparator);
 
+  // Like above, but carves memory from regions of "pool", which must
+  // outlive the memtable.  "pool" may be nullptr.
+  MemTable(const InternalKeyComparator& comparator, ArenaRegionPool* pool);
+
   MemTable(const MemTable&) = delete;
   MemTable& operator=(const MemTable&) = delete;
 
@@ -50,14 +54,22 @@ class MemTable {
   // db/format.{h,cc} module.
   Iterator* NewIterator();
 
+  // Return an iterator over the range tombstones of the memtable, stored
+  // as described in db/range_tombstone.h.  The same liveness rule as for
+  // NewIterator() applies.
+  Iterator* NewRangeTombstoneIterator();
+
   // Add an entry into memtable that maps key to value at the
   // specified sequence number and with the specified type.
-  // Typically value will be empty if type==kTypeDeletion.
+  // Typically value will be empty if type==kTypeDeletion.  If
+  // type==kTypeRangeDeletion, the entry is a range tombstone from key to
+  // value.
   void Add(SequenceNumber seq, ValueType type, const Slice& key,
            const Slice& value);
 
   // If memtable contains a value for key, store it in *value and return true.
-  // If memtable contains a deletion for key, store a NotFound() error
+  // If memtable contains a deletion for key, or a range tombstone that
+  // covers it and is newer than any entry for it, store a NotFound() error
   // in *status and return true.
   // Else, return false.
   bool Get(const LookupKey& key, std::string* value, Status* s);
@@ -80,6 +92,7 @@ class MemTable {
   int refs_;
   Arena arena_;
   Table table_;
+  Table range_del_table_;
 };
 
 }  // namespace leveldb
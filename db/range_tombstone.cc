@@ -0,0 +1,161 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_tombstone.h"
+
+#include <algorithm>
+#include <cassert>
+#include <set>
+
+#include "util/coding.h"
+
+namespace leveldb {
+
+bool ParseRangeTombstone(const Slice& key, const Slice& value,
+                         RangeTombstone* tombstone) {
+  if (key.size() < 8) {
+    return false;
+  }
+  const uint64_t tag = DecodeFixed64(key.data() + key.size() - 8);
+  if ((tag & 0xff) != kTypeRangeDeletion) {
+    return false;
+  }
+  tombstone->begin.assign(key.data(), key.size() - 8);
+  tombstone->end.assign(value.data(), value.size());
+  tombstone->seq = tag >> 8;
+  return true;
+}
+
+SequenceNumber MaxCoveringTombstoneSequence(Iterator* iter,
+                                            const Comparator* ucmp,
+                                            const Slice& user_key,
+                                            SequenceNumber snapshot,
+                                            Status* s) {
+  SequenceNumber covering = 0;
+  RangeTombstone t;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    if (!ParseRangeTombstone(iter->key(), iter->value(), &t)) {
+      *s = Status::Corruption("bad range tombstone");
+      return 0;
+    }
+    if (ucmp->Compare(t.begin, user_key) > 0) {
+      break;  // This and all later tombstones start past user_key
+    }
+    if (t.seq <= snapshot && t.seq > covering &&
+        ucmp->Compare(user_key, t.end) < 0) {
+      covering = t.seq;
+    }
+  }
+  if (!iter->status().ok()) {
+    *s = iter->status();
+  }
+  return covering;
+}
+
+void RangeTombstoneList::Add(const RangeTombstone& tombstone) {
+  if (ucmp_->Compare(tombstone.begin, tombstone.end) < 0) {
+    tombstones_.push_back(tombstone);
+  }
+}
+
+Status RangeTombstoneList::AddFromIterator(Iterator* iter) {
+  RangeTombstone t;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    if (!ParseRangeTombstone(iter->key(), iter->value(), &t)) {
+      return Status::Corruption("bad range tombstone");
+    }
+    Add(t);
+  }
+  return iter->status();
+}
+
+void RangeTombstoneList::Finish(SequenceNumber snapshot) {
+  const Comparator* ucmp = ucmp_;
+  auto less = [ucmp](const std::string& a, const std::string& b) {
+    return ucmp->Compare(a, b) < 0;
+  };
+
+  std::vector<std::string> points;
+  for (const RangeTombstone& t : tombstones_) {
+    if (t.seq <= snapshot) {
+      points.push_back(t.begin);
+      points.push_back(t.end);
+    }
+  }
+  std::sort(points.begin(), points.end(), less);
+  points.erase(std::unique(points.begin(), points.end(),
+                           [ucmp](const std::string& a, const std::string& b) {
+                             return ucmp->Compare(a, b) == 0;
+                           }),
+               points.end());
+
+  // Sweep the points, keeping the sequence numbers of the tombstones that
+  // cover the fragment starting at each.
+  std::vector<std::vector<SequenceNumber>> starts(points.size());
+  std::vector<std::vector<SequenceNumber>> ends(points.size());
+  for (const RangeTombstone& t : tombstones_) {
+    if (t.seq <= snapshot) {
+      starts[std::lower_bound(points.begin(), points.end(), t.begin, less) -
+             points.begin()]
+          .push_back(t.seq);
+      ends[std::lower_bound(points.begin(), points.end(), t.end, less) -
+           points.begin()]
+          .push_back(t.seq);
+    }
+  }
+  std::multiset<SequenceNumber> active;
+  for (size_t i = 0; i < points.size(); i++) {
+    for (SequenceNumber seq : ends[i]) {
+      active.erase(active.find(seq));
+    }
+    for (SequenceNumber seq : starts[i]) {
+      active.insert(seq);
+    }
+    const SequenceNumber seq = active.empty() ? 0 : *active.rbegin();
+    if (seqs_.empty() ? seq != 0 : seq != seqs_.back()) {
+      points_.push_back(points[i]);
+      seqs_.push_back(seq);
+    }
+  }
+  assert(active.empty());
+  tombstones_.clear();
+}
+
+int RangeTombstoneList::FindFragment(const Slice& user_key) const {
+  // Index of the first point past user_key.
+  size_t left = 0;
+  size_t right = points_.size();
+  while (left < right) {
+    const size_t mid = (left + right) / 2;
+    if (ucmp_->Compare(points_[mid], user_key) <= 0) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return static_cast<int>(left) - 1;
+}
+
+SequenceNumber RangeTombstoneList::MaxCoveringSequence(
+    const Slice& user_key) const {
+  const int i = FindFragment(user_key);
+  return (i < 0) ? 0 : seqs_[i];
+}
+
+SequenceNumber RangeTombstoneList::MinCoveringSequence(
+    const Slice& begin, const Slice& last) const {
+  int i = FindFragment(begin);
+  if (i < 0) {
+    return 0;
+  }
+  SequenceNumber covering = seqs_[i];
+  for (i++; covering != 0 && i < static_cast<int>(points_.size()) &&
+            ucmp_->Compare(points_[i], last) <= 0;
+       i++) {
+    covering = std::min(covering, seqs_[i]);
+  }
+  return covering;
+}
+
+}  // namespace leveldb
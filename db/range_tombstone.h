@@ -0,0 +1,117 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A range tombstone deletes every key in [begin, end) that was written
+// before it.  Memtables and tables keep their tombstones apart from the
+// point entries, as entries whose key is the internal key
+// (begin, seq, kTypeRangeDeletion) and whose value is "end", sorted by
+// that key.
+
+#ifndef STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
+#define STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
+
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+struct RangeTombstone {
+  RangeTombstone() : seq(0) {}
+  RangeTombstone(const Slice& b, const Slice& e, SequenceNumber s)
+      : begin(b.ToString()), end(e.ToString()), seq(s) {}
+
+  // The key the tombstone is stored under.
+  InternalKey StartKey() const {
+    return InternalKey(begin, seq, kTypeRangeDeletion);
+  }
+
+  // Bounds for the file metadata of a table that holds the tombstone.
+  // Since "end" is exclusive, the largest bound sorts before every entry
+  // for "end".
+  InternalKey SmallestKey() const {
+    return InternalKey(begin, seq, kTypeDeletion);
+  }
+  InternalKey LargestKey() const {
+    return InternalKey(end, kMaxSequenceNumber, kValueTypeForSeek);
+  }
+
+  std::string begin;
+  std::string end;  // Exclusive
+  SequenceNumber seq;
+};
+
+// Decodes a tombstone stored as "key", "value".  Returns false if they are
+// not a well-formed tombstone.
+bool ParseRangeTombstone(const Slice& key, const Slice& value,
+                         RangeTombstone* tombstone);
+
+// Returns the sequence number of the newest tombstone among those of
+// "iter" that covers "user_key" and is visible at "snapshot", or 0 if there
+// is none.  "iter" must yield stored tombstones in order.  Sets *s to a
+// non-ok status if "iter" fails or yields a malformed tombstone.
+SequenceNumber MaxCoveringTombstoneSequence(Iterator* iter,
+                                            const Comparator* ucmp,
+                                            const Slice& user_key,
+                                            SequenceNumber snapshot,
+                                            Status* s);
+
+// A set of tombstones split into non-overlapping fragments, each with the
+// sequence number of the newest tombstone that covers it, for answering
+// many questions about the same tombstones.
+//
+// Not thread-safe while it is being built; immutable after Finish().
+class RangeTombstoneList {
+ public:
+  explicit RangeTombstoneList(const Comparator* ucmp) : ucmp_(ucmp) {}
+
+  RangeTombstoneList(const RangeTombstoneList&) = delete;
+  RangeTombstoneList& operator=(const RangeTombstoneList&) = delete;
+
+  // REQUIRES: Finish() has not been called.
+  void Add(const RangeTombstone& tombstone);
+
+  // Adds the stored tombstones "iter" yields.
+  // REQUIRES: Finish() has not been called.
+  Status AddFromIterator(Iterator* iter);
+
+  // Drops the tombstones that are not visible at "snapshot" and splits the
+  // others into fragments.
+  void Finish(SequenceNumber snapshot);
+
+  // REQUIRES: Finish() has been called.
+  bool empty() const { return points_.empty(); }
+
+  // Returns the sequence number of the newest tombstone that covers
+  // "user_key", or 0 if there is none.
+  // REQUIRES: Finish() has been called.
+  SequenceNumber MaxCoveringSequence(const Slice& user_key) const;
+
+  // Returns the smallest sequence number that the newest tombstone
+  // covering a key of [begin, last] has over all of those keys, or 0 if
+  // some of them are not covered.
+  // REQUIRES: Finish() has been called.
+  SequenceNumber MinCoveringSequence(const Slice& begin,
+                                     const Slice& last) const;
+
+ private:
+  // Index of the fragment that starts at or before "user_key", or -1.
+  int FindFragment(const Slice& user_key) const;
+
+  const Comparator* const ucmp_;
+  std::vector<RangeTombstone> tombstones_;  // Until Finish()
+
+  // Fragment i covers [points_[i], points_[i + 1]) with seqs_[i]; a
+  // sequence number of 0 marks a gap.  The last fragment is always a gap.
+  std::vector<std::string> points_;
+  std::vector<SequenceNumber> seqs_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
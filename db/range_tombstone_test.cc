@@ -0,0 +1,170 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_tombstone.h"
+
+#include "gtest/gtest.h"
+#include "db/memtable.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+class RangeTombstoneTest : public testing::Test {
+ public:
+  RangeTombstoneTest() : list_(BytewiseComparator()) {}
+
+  void Add(const std::string& begin, const std::string& end,
+           SequenceNumber seq) {
+    list_.Add(RangeTombstone(begin, end, seq));
+    tombstones_.push_back(RangeTombstone(begin, end, seq));
+  }
+
+  // Newest tombstone added so far that covers "user_key" at "snapshot",
+  // computed the slow way.
+  SequenceNumber Expected(const std::string& user_key,
+                          SequenceNumber snapshot) const {
+    SequenceNumber covering = 0;
+    for (const RangeTombstone& t : tombstones_) {
+      if (t.seq <= snapshot && t.begin <= user_key && user_key < t.end &&
+          t.seq > covering) {
+        covering = t.seq;
+      }
+    }
+    return covering;
+  }
+
+  RangeTombstoneList list_;
+  std::vector<RangeTombstone> tombstones_;
+};
+
+TEST_F(RangeTombstoneTest, Empty) {
+  list_.Finish(kMaxSequenceNumber);
+  ASSERT_TRUE(list_.empty());
+  ASSERT_EQ(0, list_.MaxCoveringSequence("a"));
+  ASSERT_EQ(0, list_.MinCoveringSequence("a", "z"));
+}
+
+TEST_F(RangeTombstoneTest, EmptyRangesAreIgnored) {
+  Add("b", "b", 5);
+  Add("c", "a", 6);
+  list_.Finish(kMaxSequenceNumber);
+  ASSERT_TRUE(list_.empty());
+}
+
+TEST_F(RangeTombstoneTest, Overlapping) {
+  Add("b", "f", 10);
+  Add("d", "h", 20);
+  Add("c", "e", 5);
+  list_.Finish(kMaxSequenceNumber);
+  ASSERT_TRUE(!list_.empty());
+  ASSERT_EQ(0, list_.MaxCoveringSequence("a"));
+  ASSERT_EQ(10, list_.MaxCoveringSequence("b"));
+  ASSERT_EQ(10, list_.MaxCoveringSequence("c"));
+  ASSERT_EQ(20, list_.MaxCoveringSequence("d"));
+  ASSERT_EQ(20, list_.MaxCoveringSequence("g"));
+  ASSERT_EQ(0, list_.MaxCoveringSequence("h"));
+  ASSERT_EQ(0, list_.MaxCoveringSequence("z"));
+
+  ASSERT_EQ(10, list_.MinCoveringSequence("b", "g"));
+  ASSERT_EQ(20, list_.MinCoveringSequence("d", "g"));
+  ASSERT_EQ(0, list_.MinCoveringSequence("a", "c"));
+  ASSERT_EQ(0, list_.MinCoveringSequence("b", "h"));
+}
+
+TEST_F(RangeTombstoneTest, Gap) {
+  Add("a", "c", 7);
+  Add("d", "f", 8);
+  list_.Finish(kMaxSequenceNumber);
+  ASSERT_EQ(7, list_.MinCoveringSequence("a", "b"));
+  ASSERT_EQ(0, list_.MinCoveringSequence("a", "d"));
+  ASSERT_EQ(8, list_.MinCoveringSequence("d", "e"));
+  ASSERT_EQ(0, list_.MaxCoveringSequence("c"));
+}
+
+TEST_F(RangeTombstoneTest, Snapshot) {
+  Add("a", "m", 10);
+  Add("f", "z", 30);
+  list_.Finish(20);
+  ASSERT_EQ(10, list_.MaxCoveringSequence("g"));
+  ASSERT_EQ(0, list_.MaxCoveringSequence("n"));
+}
+
+TEST_F(RangeTombstoneTest, Random) {
+  Random rnd(301);
+  for (int i = 0; i < 200; i++) {
+    const std::string begin(1, 'a' + rnd.Uniform(26));
+    const std::string end(1, 'a' + rnd.Uniform(26));
+    Add(begin, end, 1 + rnd.Uniform(1000));
+  }
+  const SequenceNumber snapshot = 600;
+  list_.Finish(snapshot);
+  for (char c = 'a' - 1; c <= 'z' + 1; c++) {
+    const std::string key(1, c);
+    ASSERT_EQ(Expected(key, snapshot), list_.MaxCoveringSequence(key)) << key;
+    ASSERT_EQ(Expected(key, snapshot), list_.MinCoveringSequence(key, key))
+        << key;
+  }
+}
+
+TEST_F(RangeTombstoneTest, MemTable) {
+  InternalKeyComparator cmp(BytewiseComparator());
+  MemTable* mem = new MemTable(cmp);
+  mem->Ref();
+  mem->Add(1, kTypeValue, "c", "v");
+  mem->Add(2, kTypeRangeDeletion, "b", "e");
+  mem->Add(3, kTypeRangeDeletion, "a", "c");
+
+  Iterator* iter = mem->NewRangeTombstoneIterator();
+  RangeTombstone t;
+  iter->SeekToFirst();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_TRUE(ParseRangeTombstone(iter->key(), iter->value(), &t));
+  ASSERT_EQ("a", t.begin);
+  ASSERT_EQ("c", t.end);
+  ASSERT_EQ(3, t.seq);
+  iter->Next();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_TRUE(ParseRangeTombstone(iter->key(), iter->value(), &t));
+  ASSERT_EQ("b", t.begin);
+  ASSERT_EQ("e", t.end);
+  ASSERT_EQ(2, t.seq);
+  iter->Next();
+  ASSERT_TRUE(!iter->Valid());
+
+  Status s;
+  ASSERT_EQ(2, MaxCoveringTombstoneSequence(iter, BytewiseComparator(), "d",
+                                            kMaxSequenceNumber, &s));
+  ASSERT_EQ(3, MaxCoveringTombstoneSequence(iter, BytewiseComparator(), "b",
+                                            kMaxSequenceNumber, &s));
+  ASSERT_EQ(2, MaxCoveringTombstoneSequence(iter, BytewiseComparator(), "b",
+                                            2, &s));
+  ASSERT_EQ(0, MaxCoveringTombstoneSequence(iter, BytewiseComparator(), "e",
+                                            kMaxSequenceNumber, &s));
+  ASSERT_TRUE(s.ok());
+  delete iter;
+
+  // The value at "c" is hidden from lookups that see the tombstone.
+  std::string value;
+  ASSERT_TRUE(mem->Get(LookupKey("c", kMaxSequenceNumber), &value, &s));
+  ASSERT_TRUE(s.IsNotFound());
+  s = Status::OK();
+  ASSERT_TRUE(mem->Get(LookupKey("c", 1), &value, &s));
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ("v", value);
+  mem->Unref();
+}
+
+TEST(ParseRangeTombstoneTest, Malformed) {
+  RangeTombstone t;
+  ASSERT_TRUE(!ParseRangeTombstone("short", "x", &t));
+  ASSERT_TRUE(!ParseRangeTombstone(
+      InternalKey("a", 5, kTypeValue).Encode(), "b", &t));
+  ASSERT_TRUE(ParseRangeTombstone(
+      InternalKey("a", 5, kTypeRangeDeletion).Encode(), "b", &t));
+  ASSERT_EQ("a", t.begin);
+  ASSERT_EQ("b", t.end);
+  ASSERT_EQ(5, t.seq);
+}
+
+}  // namespace leveldb
@@ -31,6 +31,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "db/write_batch_internal.h"
@@ -51,7 +52,7 @@ class Repairer {
       : dbname_(dbname),
         env_(options.env),
         icmp_(options.comparator),
-        ipolicy_(options.filter_policy),
+        ipolicy_(options.filter_policy, options.prefix_extractor),
         options_(SanitizeOptions(dbname, &icmp_, &ipolicy_, options)),
         owns_info_log_(options_.info_log != options.info_log),
         owns_cache_(options_.block_cache != options.block_cache),
@@ -206,8 +207,11 @@ class Repairer {
     FileMetaData meta;
     meta.number = next_file_number_++;
     Iterator* iter = mem->NewIterator();
-    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
+    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta,
+                        range_del_iter);
     delete iter;
+    delete range_del_iter;
     mem->Unref();
     mem = nullptr;
     if (status.ok()) {
@@ -232,7 +236,7 @@ class Repairer {
     // on checksum verification.
     ReadOptions r;
     r.verify_checksums = options_.paranoid_checks;
-    return table_cache_->NewIterator(r, meta.number, meta.file_size);
+    return table_cache_->NewIterator(r, meta.number, meta.file_size, -1);
   }
 
   void ScanTable(uint64_t number) {
@@ -284,6 +288,35 @@ class Repairer {
       status = iter->status();
     }
     delete iter;
+
+    // Widen the key range to cover the range tombstones, as BuildTable()
+    // does.
+    iter = table_cache_->NewRangeTombstoneIterator(t.meta.number,
+                                                   t.meta.file_size, -1);
+    RangeTombstone tombstone;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      if (!ParseRangeTombstone(iter->key(), iter->value(), &tombstone)) {
+        status = Status::Corruption("bad range tombstone");
+        break;
+      }
+      t.meta.num_range_deletions++;
+      const InternalKey smallest = tombstone.SmallestKey();
+      const InternalKey largest = tombstone.LargestKey();
+      if (empty || icmp_.Compare(smallest, t.meta.smallest) < 0) {
+        t.meta.smallest = smallest;
+      }
+      if (empty || icmp_.Compare(largest, t.meta.largest) > 0) {
+        t.meta.largest = largest;
+      }
+      empty = false;
+      if (tombstone.seq > t.max_sequence) {
+        t.max_sequence = tombstone.seq;
+      }
+    }
+    if (status.ok() && !iter->status().ok()) {
+      status = iter->status();
+    }
+    delete iter;
     Log(options_.info_log, "Table #%llu: %d entries %s",
         (unsigned long long)t.meta.number, counter, status.ToString().c_str());
 
@@ -316,6 +349,13 @@ class Repairer {
       counter++;
     }
     delete iter;
+    iter = table_cache_->NewRangeTombstoneIterator(t.meta.number,
+                                                   t.meta.file_size, -1);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      builder->AddRangeTombstone(iter->key(), iter->value());
+      counter++;
+    }
+    delete iter;
 
     ArchiveFile(src);
     if (counter == 0) {
@@ -372,8 +412,7 @@ class Repairer {
     for (size_t i = 0; i < tables_.size(); i++) {
       // TODO(opt): separate out into multiple levels
       const TableInfo& t = tables_[i];
-      edit_.AddFile(0, t.meta.number, t.meta.file_size, t.meta.smallest,
-                    t.meta.largest);
+      edit_.AddFile(0, t.meta);
     }
 
     // std::fprintf(stderr,
@@ -0,0 +1,115 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/sst_file_writer.h"
+
+#include "db/dbformat.h"
+#include "leveldb/env.h"
+#include "merge_test/fix_table_builder.h"
+
+namespace leveldb {
+
+struct SstFileWriter::Rep {
+  explicit Rep(const Options& opt)
+      : internal_comparator(opt.comparator),
+        internal_filter_policy(opt.filter_policy, opt.prefix_extractor),
+        options(opt),
+        file(nullptr),
+        builder(nullptr) {
+    options.comparator = &internal_comparator;
+    options.filter_policy =
+        (opt.filter_policy != nullptr) ? &internal_filter_policy : nullptr;
+  }
+
+  const InternalKeyComparator internal_comparator;
+  const InternalFilterPolicy internal_filter_policy;
+  Options options;
+  WritableFile* file;
+  FixTableBuilder* builder;
+  std::string last_key;  // User key of the last entry added
+  std::string key;       // Scratch space for the internal key
+};
+
+SstFileWriter::SstFileWriter(const Options& options)
+    : rep_(new Rep(options)) {}
+
+SstFileWriter::~SstFileWriter() {
+  if (rep_->builder != nullptr) {
+    rep_->builder->Abandon();
+    delete rep_->builder;
+  }
+  delete rep_->file;
+  delete rep_;
+}
+
+Status SstFileWriter::Open(const std::string& fname) {
+  if (rep_->file != nullptr) {
+    return Status::InvalidArgument("SstFileWriter is already open");
+  }
+  Status s = rep_->options.env->NewWritableFile(fname, &rep_->file);
+  if (s.ok()) {
+    rep_->builder = new FixTableBuilder(rep_->options, rep_->file);
+  }
+  return s;
+}
+
+Status SstFileWriter::Put(const Slice& key, const Slice& value) {
+  if (value.size() != rep_->options.value_length) {
+    return Status::InvalidArgument("value does not have value_length bytes");
+  }
+  return Add(key, value, false);
+}
+
+Status SstFileWriter::Delete(const Slice& key) {
+  return Add(key, Slice(), true);
+}
+
+Status SstFileWriter::Add(const Slice& key, const Slice& value,
+                          bool deletion) {
+  Rep* r = rep_;
+  if (r->builder == nullptr) {
+    return Status::InvalidArgument("SstFileWriter is not open");
+  }
+  if (key.size() + 8 != r->options.key_length) {
+    return Status::InvalidArgument("key does not have key_length - 8 bytes");
+  }
+  if (r->builder->NumEntries() > 0 &&
+      r->internal_comparator.user_comparator()->Compare(key, r->last_key) <=
+          0) {
+    return Status::InvalidArgument("keys must be added in increasing order");
+  }
+
+  // The database assigns the entries their sequence number when the file
+  // is ingested.
+  r->key.clear();
+  AppendInternalKey(&r->key, ParsedInternalKey(
+                                 key, 0, deletion ? kTypeDeletion : kTypeValue));
+  r->builder->Add(r->key, value);
+  r->last_key.assign(key.data(), key.size());
+  return r->builder->status();
+}
+
+Status SstFileWriter::Finish(uint64_t* file_size) {
+  Rep* r = rep_;
+  if (r->builder == nullptr) {
+    return Status::InvalidArgument("SstFileWriter is not open");
+  }
+  Status s = r->builder->Finish();
+  if (s.ok() && file_size != nullptr) {
+    *file_size = r->builder->FileSize();
+  }
+  delete r->builder;
+  r->builder = nullptr;
+  if (s.ok()) {
+    s = r->file->Sync();
+  }
+  if (s.ok()) {
+    s = r->file->Close();
+  }
+  delete r->file;
+  r->file = nullptr;
+  return s;
+}
+
+}  // namespace leveldb
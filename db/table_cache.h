@@ -9,6 +9,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "leveldb/cache.h"
@@ -37,20 +38,49 @@ class TableCache {
   // underlies the returned iterator.  The returned "*tableptr" object is owned
   // by the cache and should not be deleted, and is valid for as long as the
   // returned iterator is live.
+  //
+  // "level" is the level the file is at, or -1 if unknown.  It is used to
+  // apply Options::pin_index_and_filter_levels if the table is opened.
   Iterator* NewIterator(const ReadOptions& options, uint64_t file_number,
-                        uint64_t file_size, FixTable** tableptr = nullptr);
+                        uint64_t file_size, int level,
+                        FixTable** tableptr = nullptr);
+
+  // Return an iterator over the range tombstones of the specified file.
+  Iterator* NewRangeTombstoneIterator(uint64_t file_number, uint64_t file_size,
+                                      int level);
 
   // If a seek to internal key "k" in specified file finds an entry,
   // call (*handle_result)(arg, found_key, found_value).
   Status Get(const ReadOptions& options, uint64_t file_number,
-             uint64_t file_size, const Slice& k, void* arg,
+             uint64_t file_size, int level, const Slice& k, void* arg,
              void (*handle_result)(void*, const Slice&, const Slice&));
 
+  // Like Get() for each of "keys", which must be sorted, calling
+  // (*handle_result)(args[i], found_key, found_value) for keys[i].  Sets
+  // (*statuses)[i] to the status of the lookup of keys[i].
+  void MultiGet(const ReadOptions& options, uint64_t file_number,
+                uint64_t file_size, int level, const std::vector<Slice>& keys,
+                const std::vector<void*>& args,
+                void (*handle_result)(void*, const Slice&, const Slice&),
+                std::vector<Status>* statuses);
+
+  // Opens the specified file into the cache, if it is not there already,
+  // so that later reads of it need not.
+  Status Preload(uint64_t file_number, uint64_t file_size, int level);
+
+  // Reads the properties of the specified file into *props.
+  Status GetTableProperties(uint64_t file_number, uint64_t file_size,
+                            int level, TableProperties* props);
+
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
 
  private:
-  Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+  // Opens the table file "fname", with direct I/O if options_ ask for it.
+  Status OpenTableFile(const std::string& fname, RandomAccessFile** file);
+
+  Status FindTable(uint64_t file_number, uint64_t file_size, int level,
+                   Cache::Handle**);
 
   Env* const env_;
   const std::string dbname_;
@@ -16,7 +16,13 @@ namespace leveldb {
 class VersionSet;
 
 struct FileMetaData {
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) {}
+  FileMetaData()
+      : refs(0),
+        allowed_seeks(1 << 30),
+        file_size(0),
+        num_entries(0),
+        num_deletions(0),
+        num_range_deletions(0) {}
 
   int refs;
   int allowed_seeks;  // Seeks allowed until compaction
@@ -24,6 +30,9 @@ struct FileMetaData {
   uint64_t file_size;    // File size in bytes
   InternalKey smallest;  // Smallest internal key served by table
   InternalKey largest;   // Largest internal key served by table
+  uint64_t num_entries;    // Entries in table, or 0 if not known
+  uint64_t num_deletions;  // Deletion markers among the entries
+  uint64_t num_range_deletions;  // Range tombstones, not among the entries
 };
 
 class VersionEdit {
@@ -70,6 +79,20 @@ class VersionEdit {
     new_files_.push_back(std::make_pair(level, f));
   }
 
+  // Add the specified file, along with the entry and tombstone counts in
+  // "f".
+  void AddFile(int level, const FileMetaData& f) {
+    FileMetaData copy;
+    copy.number = f.number;
+    copy.file_size = f.file_size;
+    copy.smallest = f.smallest;
+    copy.largest = f.largest;
+    copy.num_entries = f.num_entries;
+    copy.num_deletions = f.num_deletions;
+    copy.num_range_deletions = f.num_range_deletions;
+    new_files_.push_back(std::make_pair(level, copy));
+  }
+
   // Delete the specified "file" from the specified "level".
   void RemoveFile(int level, uint64_t file) {
     deleted_files_.insert(std::make_pair(level, file));
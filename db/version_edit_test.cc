@@ -38,4 +38,45 @@ TEST(VersionEditTest, EncodeDecode) {
   TestEncodeDecode(edit);
 }
 
+TEST(VersionEditTest, EncodeDecodeFileStats) {
+  VersionEdit edit;
+  FileMetaData f;
+  f.number = 7;
+  f.file_size = 4096;
+  f.smallest = InternalKey("foo", 10, kTypeValue);
+  f.largest = InternalKey("zoo", 20, kTypeDeletion);
+  f.num_entries = 100;
+  f.num_deletions = 30;
+  edit.AddFile(2, f);
+  edit.AddFile(3, 8, 1024, InternalKey("a", 1, kTypeValue),
+               InternalKey("b", 2, kTypeValue));
+  TestEncodeDecode(edit);
+
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_TRUE(parsed.DecodeFrom(encoded).ok());
+  std::string debug = parsed.DebugString();
+  ASSERT_NE(debug.find("entries 100 deletions 30"), std::string::npos) << debug;
+}
+
+TEST(VersionEditTest, EncodeDecodeRangeDeletions) {
+  VersionEdit edit;
+  FileMetaData f;
+  f.number = 9;
+  f.file_size = 512;
+  f.smallest = InternalKey("a", 5, kTypeDeletion);
+  f.largest = InternalKey("m", kMaxSequenceNumber, kValueTypeForSeek);
+  f.num_range_deletions = 2;  // A file of range tombstones only
+  edit.AddFile(1, f);
+  TestEncodeDecode(edit);
+
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_TRUE(parsed.DecodeFrom(encoded).ok());
+  std::string debug = parsed.DebugString();
+  ASSERT_NE(debug.find("range deletions 2"), std::string::npos) << debug;
+}
+
 }  // namespace leveldb
@@ -11,6 +11,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "leveldb/env.h"
 #include "leveldb/table_builder.h"
@@ -27,8 +28,8 @@ static size_t TargetFileSize(const Options* options) {
   return options->max_file_size;
 }
 
-// Maximum bytes of overlaps in grandparent (i.e., level+2) before we
-// stop building a single file in a level->level+1 compaction.
+// Maximum bytes of overlaps in grandparent (i.e., output level+1) before
+// we stop building a single file in a compaction.
 static int64_t MaxGrandParentOverlapBytes(const Options* options) {
   return 10 * TargetFileSize(options);
 }
@@ -45,9 +46,9 @@ static double MaxBytesForLevel(const Options* options, int level) {
   // the level-0 compaction threshold based on number of files.
 
   // Result for both level-0 and level-1
-  double result = 10. * 1048576.0;
+  double result = options->max_bytes_for_level_base;
   while (level > 1) {
-    result *= 10;
+    result *= options->max_bytes_for_level_multiplier;
     level--;
   }
   return result;
@@ -88,8 +89,12 @@ Version::~Version() {
 
 int FindFile(const InternalKeyComparator& icmp,
              const std::vector<FileMetaData*>& files, const Slice& key) {
-  uint32_t left = 0;
-  uint32_t right = files.size();
+  return FindFileInRange(icmp, files, key, 0, files.size());
+}
+
+uint32_t FindFileInRange(const InternalKeyComparator& icmp,
+                         const std::vector<FileMetaData*>& files,
+                         const Slice& key, uint32_t left, uint32_t right) {
   while (left < right) {
     uint32_t mid = (left + right) / 2;
     const FileMetaData* f = files[mid];
@@ -141,7 +146,7 @@ bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
   }
 
   // Binary search over file list
-  uint32_t index = 0;
+  size_t index = 0;
   if (smallest_user_key != nullptr) {
     // Find the earliest possible internal key for smallest_user_key
     InternalKey small_key(*smallest_user_key, kMaxSequenceNumber,
@@ -160,13 +165,17 @@ bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
 // An internal iterator.  For a given version/level pair, yields
 // information about the files in the level.  For a given entry, key()
 // is the largest key that occurs in the file, and value() is an
-// 16-byte value containing the file number and file size, both
-// encoded using EncodeFixed64.
+// 20-byte value containing the file number and file size, both
+// encoded using EncodeFixed64, followed by the level encoded using
+// EncodeFixed32.
 class Version::LevelFileNumIterator : public Iterator {
  public:
   LevelFileNumIterator(const InternalKeyComparator& icmp,
-                       const std::vector<FileMetaData*>* flist)
-      : icmp_(icmp), flist_(flist), index_(flist->size()) {  // Marks as invalid
+                       const std::vector<FileMetaData*>* flist, int level)
+      : icmp_(icmp),
+        flist_(flist),
+        level_(level),
+        index_(flist->size()) {  // Marks as invalid
   }
   bool Valid() const override { return index_ < flist_->size(); }
   void Seek(const Slice& target) override {
@@ -196,6 +205,7 @@ class Version::LevelFileNumIterator : public Iterator {
     assert(Valid());
     EncodeFixed64(value_buf_, (*flist_)[index_]->number);
     EncodeFixed64(value_buf_ + 8, (*flist_)[index_]->file_size);
+    EncodeFixed32(value_buf_ + 16, static_cast<uint32_t>(level_));
     return Slice(value_buf_, sizeof(value_buf_));
   }
   Status status() const override { return Status::OK(); }
@@ -203,49 +213,128 @@ class Version::LevelFileNumIterator : public Iterator {
  private:
   const InternalKeyComparator icmp_;
   const std::vector<FileMetaData*>* const flist_;
+  const int level_;
   uint32_t index_;
 
-  // Backing store for value().  Holds the file number and size.
-  mutable char value_buf_[16];
+  // Backing store for value().  Holds the file number, size and level.
+  mutable char value_buf_[20];
 };
 
 static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
                                  const Slice& file_value) {
   TableCache* cache = reinterpret_cast<TableCache*>(arg);
-  if (file_value.size() != 16) {
+  if (file_value.size() != 20) {
     return NewErrorIterator(
         Status::Corruption("FileReader invoked with unexpected value"));
   } else {
-    return cache->NewIterator(options, DecodeFixed64(file_value.data()),
-                              DecodeFixed64(file_value.data() + 8));
+    return cache->NewIterator(
+        options, DecodeFixed64(file_value.data()),
+        DecodeFixed64(file_value.data() + 8),
+        static_cast<int>(DecodeFixed32(file_value.data() + 16)));
   }
 }
 
 Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
                                             int level) const {
   return NewTwoLevelIterator(
-      new LevelFileNumIterator(vset_->icmp_, &files_[level]), &GetFileIterator,
-      vset_->table_cache_, options);
+      new LevelFileNumIterator(vset_->icmp_, &files_[level], level),
+      &GetFileIterator, vset_->table_cache_, options, &vset_->icmp_);
+}
+
+// Returns true if the user key range of "f" overlaps the iterate bounds
+// of "options".
+static bool FileWithinBounds(const Comparator* ucmp, const FileMetaData* f,
+                             const ReadOptions& options) {
+  return (options.iterate_lower_bound == nullptr ||
+          ucmp->Compare(f->largest.user_key(), *options.iterate_lower_bound) >=
+              0) &&
+         (options.iterate_upper_bound == nullptr ||
+          ucmp->Compare(f->smallest.user_key(), *options.iterate_upper_bound) <
+              0);
+}
+
+// Like FileWithinBounds() for any of "files", which must be sorted and
+// disjoint.
+static bool SomeFileWithinBounds(const InternalKeyComparator& icmp,
+                                 const std::vector<FileMetaData*>& files,
+                                 const ReadOptions& options) {
+  // The first file that may hold keys at or after the lower bound.
+  size_t index = 0;
+  if (options.iterate_lower_bound != nullptr) {
+    InternalKey small_key(*options.iterate_lower_bound, kMaxSequenceNumber,
+                          kValueTypeForSeek);
+    index = FindFile(icmp, files, small_key.Encode());
+  }
+  return index < files.size() &&
+         FileWithinBounds(icmp.user_comparator(), files[index], options);
 }
 
 void Version::AddIterators(const ReadOptions& options,
                            std::vector<Iterator*>* iters) {
-  // Merge all level zero files together since they may overlap
+  const bool bounded = options.iterate_lower_bound != nullptr ||
+                       options.iterate_upper_bound != nullptr;
+
+  // Merge all level zero files together since they may overlap.  Files
+  // outside the iterate bounds are left out.
   for (size_t i = 0; i < files_[0].size(); i++) {
-    iters->push_back(vset_->table_cache_->NewIterator(
-        options, files_[0][i]->number, files_[0][i]->file_size));
+    FileMetaData* f = files_[0][i];
+    if (bounded && !FileWithinBounds(vset_->icmp_.user_comparator(), f,
+                                     options)) {
+      continue;
+    }
+    iters->push_back(
+        vset_->table_cache_->NewIterator(options, f->number, f->file_size, 0));
   }
 
   // For levels > 0, we can use a concatenating iterator that sequentially
   // walks through the non-overlapping files in the level, opening them
   // lazily.
   for (int level = 1; level < config::kNumLevels; level++) {
-    if (!files_[level].empty()) {
+    if (!files_[level].empty() &&
+        (!bounded ||
+         SomeFileWithinBounds(vset_->icmp_, files_[level], options))) {
       iters->push_back(NewConcatenatingIterator(options, level));
     }
   }
 }
 
+Status Version::AddRangeTombstones(const ReadOptions& options,
+                                  RangeTombstoneList* list) {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  for (int level = 0; level < config::kNumLevels; level++) {
+    const std::vector<FileMetaData*>& files = files_[level];
+    // The key range of a file covers its tombstones, so files outside the
+    // iterate bounds hold none that matter.  Past level-0, start at the
+    // first file reaching the lower bound and stop past the upper bound.
+    size_t i = 0;
+    if (level > 0 && options.iterate_lower_bound != nullptr) {
+      InternalKey small_key(*options.iterate_lower_bound, kMaxSequenceNumber,
+                            kValueTypeForSeek);
+      i = FindFile(vset_->icmp_, files, small_key.Encode());
+    }
+    for (; i < files.size(); i++) {
+      FileMetaData* f = files[i];
+      if (!FileWithinBounds(ucmp, f, options)) {
+        if (level > 0) {
+          break;
+        }
+        continue;
+      }
+      if (f->num_range_deletions == 0) {
+        continue;
+      }
+      Iterator* iter = vset_->table_cache_->NewRangeTombstoneIterator(
+          f->number, f->file_size, level);
+      Status s = list->AddFromIterator(iter);
+      delete iter;
+      if (!s.ok()) {
+        return s;
+      }
+    }
+  }
+  return Status::OK();
+}
+
 // Callback from TableCache::Get()
 namespace {
 enum SaverState {
@@ -259,6 +348,9 @@ struct Saver {
   const Comparator* ucmp;
   Slice user_key;
   std::string* value;
+  // Sequence number of the newest range tombstone of the file being
+  // searched that covers user_key, or 0.
+  SequenceNumber covering;
 };
 }  // namespace
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -268,7 +360,10 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     s->state = kCorrupt;
   } else {
     if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-      s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
+      s->state = (parsed_key.type == kTypeValue &&
+                  parsed_key.sequence >= s->covering)
+                     ? kFound
+                     : kDeleted;
       if (s->state == kFound) {
         s->value->assign(v.data(), v.size());
       }
@@ -276,10 +371,39 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
   }
 }
 
+// Sets saver->covering from the range tombstones that "tombstones" yields,
+// as visible to the lookup of internal key "ikey".
+static Status FindCoveringTombstone(Iterator* tombstones, const Slice& ikey,
+                                    Saver* saver) {
+  const SequenceNumber snapshot =
+      DecodeFixed64(ikey.data() + ikey.size() - 8) >> 8;
+  Status s;
+  saver->covering = MaxCoveringTombstoneSequence(
+      tombstones, saver->ucmp, saver->user_key, snapshot, &s);
+  return s;
+}
+
+// A lookup that finds no entry in a file whose tombstone covers the key is
+// settled: the levels below hold only older entries.
+static void ApplyCoveringTombstone(Saver* saver) {
+  if (saver->state == kNotFound && saver->covering > 0) {
+    saver->state = kDeleted;
+  }
+}
+
 static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
   return a->number > b->number;
 }
 
+uint32_t Version::FindFileInLevel(int level, const Slice& internal_key) const {
+  assert(level > 0);
+  const FileIndex& file_index = file_index_[level];
+  if (file_index.Ready()) {
+    return file_index.FindFile(vset_->icmp_, files_[level], internal_key);
+  }
+  return FindFile(vset_->icmp_, files_[level], internal_key);
+}
+
 void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
                                  bool (*func)(void*, int, FileMetaData*)) {
   const Comparator* ucmp = vset_->icmp_.user_comparator();
@@ -303,13 +427,30 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
     }
   }
 
-  // Search other levels.
+  // Search other levels.  After the first level with files, each search
+  // only covers the files that the cascade pointers of the level above
+  // leave.
+  int prev_level = -1;
+  uint32_t prev_index = 0;
   for (int level = 1; level < config::kNumLevels; level++) {
     size_t num_files = files_[level].size();
     if (num_files == 0) continue;
 
-    // Binary search to find earliest index whose largest key >= internal_key.
-    uint32_t index = FindFile(vset_->icmp_, files_[level], internal_key);
+    // Find earliest index whose largest key >= internal_key.
+    uint32_t index;
+    if (prev_level < 0) {
+      index = FindFileInLevel(level, internal_key);
+    } else {
+      assert(cascade_level_[prev_level] == level);
+      const std::vector<uint32_t>& cascade = cascade_[prev_level];
+      const uint32_t left = (prev_index == 0) ? 0 : cascade[prev_index - 1];
+      const uint32_t right =
+          (prev_index == cascade.size()) ? num_files : cascade[prev_index];
+      index = FindFileInRange(vset_->icmp_, files_[level], internal_key, left,
+                              right);
+    }
+    prev_level = level;
+    prev_index = index;
     if (index < num_files) {
       FileMetaData* f = files_[level][index];
       if (ucmp->Compare(user_key, f->smallest.user_key()) < 0) {
@@ -353,13 +494,27 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
       state->last_file_read = f;
       state->last_file_read_level = level;
 
-      state->s = state->vset->table_cache_->Get(*state->options, f->number,
-                                                f->file_size, state->ikey,
-                                                &state->saver, SaveValue);
+      TableCache* table_cache = state->vset->table_cache_;
+      state->saver.covering = 0;
+      if (f->num_range_deletions > 0) {
+        Iterator* tombstones = table_cache->NewRangeTombstoneIterator(
+            f->number, f->file_size, level);
+        state->s =
+            FindCoveringTombstone(tombstones, state->ikey, &state->saver);
+        delete tombstones;
+        if (!state->s.ok()) {
+          state->found = true;
+          return false;
+        }
+      }
+      state->s =
+          table_cache->Get(*state->options, f->number, f->file_size, level,
+                           state->ikey, &state->saver, SaveValue);
       if (!state->s.ok()) {
         state->found = true;
         return false;
       }
+      ApplyCoveringTombstone(&state->saver);
       switch (state->saver.state) {
         case kNotFound:
           return true;  // Keep searching in other files
@@ -395,13 +550,179 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
   state.saver.ucmp = vset_->icmp_.user_comparator();
   state.saver.user_key = k.user_key();
   state.saver.value = value;
+  state.saver.covering = 0;
 
   ForEachOverlapping(state.saver.user_key, state.ikey, &state, &State::Match);
 
   return state.found ? state.s : Status::NotFound(Slice());
 }
 
+void Version::MultiGet(const ReadOptions& options,
+                       const std::vector<const LookupKey*>& keys,
+                       const std::vector<std::string*>& values,
+                       std::vector<Status>* statuses,
+                       std::vector<GetStats>* stats) {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  const size_t n = keys.size();
+  statuses->assign(n, Status::NotFound(Slice()));
+
+  // Per-key state, as kept by the State of Get().
+  struct KeyState {
+    Saver saver;
+    GetStats stats;
+    FileMetaData* last_file_read;
+    int last_file_read_level;
+    bool done;
+  };
+  std::vector<KeyState> state(n);
+  for (size_t i = 0; i < n; i++) {
+    state[i].saver.state = kNotFound;
+    state[i].saver.ucmp = ucmp;
+    state[i].saver.user_key = keys[i]->user_key();
+    state[i].saver.value = values[i];
+    state[i].saver.covering = 0;
+    state[i].stats.seek_file = nullptr;
+    state[i].stats.seek_file_level = -1;
+    state[i].last_file_read = nullptr;
+    state[i].last_file_read_level = -1;
+    state[i].done = false;
+  }
+  size_t remaining = n;
+
+  // Looks up the keys in "batch" in file "f" and settles those it answers.
+  std::vector<size_t> batch;
+  std::vector<Slice> ikeys;
+  std::vector<void*> args;
+  std::vector<Status> file_statuses;
+  auto probe = [&](int level, FileMetaData* f) {
+    ikeys.clear();
+    args.clear();
+    for (size_t b = 0; b < batch.size(); b++) {
+      KeyState* ks = &state[batch[b]];
+      if (ks->stats.seek_file == nullptr && ks->last_file_read != nullptr) {
+        // We have had more than one seek for this read.  Charge the 1st file.
+        ks->stats.seek_file = ks->last_file_read;
+        ks->stats.seek_file_level = ks->last_file_read_level;
+      }
+      ks->last_file_read = f;
+      ks->last_file_read_level = level;
+      ikeys.push_back(keys[batch[b]]->internal_key());
+      args.push_back(&ks->saver);
+      ks->saver.covering = 0;
+    }
+    std::vector<Status> tombstone_statuses(batch.size());
+    if (f->num_range_deletions > 0) {
+      Iterator* tombstones = vset_->table_cache_->NewRangeTombstoneIterator(
+          f->number, f->file_size, level);
+      for (size_t b = 0; b < batch.size(); b++) {
+        tombstone_statuses[b] = FindCoveringTombstone(
+            tombstones, ikeys[b], &state[batch[b]].saver);
+      }
+      delete tombstones;
+    }
+    vset_->table_cache_->MultiGet(options, f->number, f->file_size, level,
+                                  ikeys, args, SaveValue, &file_statuses);
+    for (size_t b = 0; b < batch.size(); b++) {
+      const size_t i = batch[b];
+      KeyState* ks = &state[i];
+      if (!tombstone_statuses[b].ok()) {
+        (*statuses)[i] = tombstone_statuses[b];
+        ks->done = true;
+      } else if (!file_statuses[b].ok()) {
+        (*statuses)[i] = file_statuses[b];
+        ks->done = true;
+      } else {
+        ApplyCoveringTombstone(&ks->saver);
+        switch (ks->saver.state) {
+          case kNotFound:
+            break;  // Keep searching in other files
+          case kFound:
+            (*statuses)[i] = Status::OK();
+            ks->done = true;
+            break;
+          case kDeleted:
+            ks->done = true;
+            break;
+          case kCorrupt:
+            (*statuses)[i] =
+                Status::Corruption("corrupted key for ", ks->saver.user_key);
+            ks->done = true;
+            break;
+        }
+      }
+      if (ks->done) {
+        remaining--;
+      }
+    }
+  };
+
+  // Search level-0 in order from newest to oldest.
+  std::vector<FileMetaData*> tmp(files_[0]);
+  std::sort(tmp.begin(), tmp.end(), NewestFirst);
+  for (size_t f = 0; f < tmp.size() && remaining > 0; f++) {
+    batch.clear();
+    for (size_t i = 0; i < n; i++) {
+      if (!state[i].done &&
+          ucmp->Compare(state[i].saver.user_key,
+                        tmp[f]->smallest.user_key()) >= 0 &&
+          ucmp->Compare(state[i].saver.user_key, tmp[f]->largest.user_key()) <=
+              0) {
+        batch.push_back(i);
+      }
+    }
+    if (!batch.empty()) {
+      probe(0, tmp[f]);
+    }
+  }
+
+  // Search other levels.  Files do not overlap, so the sorted keys fall
+  // into the files in order.
+  for (int level = 1; level < config::kNumLevels && remaining > 0; level++) {
+    const std::vector<FileMetaData*>& files = files_[level];
+    size_t i = 0;
+    while (i < n) {
+      if (state[i].done) {
+        i++;
+        continue;
+      }
+      // Earliest file whose largest key >= the key.
+      const uint32_t index = FindFileInLevel(level, keys[i]->internal_key());
+      if (index >= files.size()) {
+        break;  // This and all later keys are past the last file
+      }
+      FileMetaData* f = files[index];
+      batch.clear();
+      for (; i < n; i++) {
+        if (state[i].done) {
+          continue;
+        }
+        if (vset_->icmp_.Compare(keys[i]->internal_key(),
+                                 f->largest.Encode()) > 0) {
+          break;
+        }
+        if (ucmp->Compare(state[i].saver.user_key, f->smallest.user_key()) >=
+            0) {
+          batch.push_back(i);
+        }
+      }
+      if (!batch.empty()) {
+        probe(level, f);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    if (state[i].stats.seek_file != nullptr) {
+      stats->push_back(state[i].stats);
+    }
+  }
+}
+
 bool Version::UpdateStats(const GetStats& stats) {
+  if (vset_->options_->compaction_style == kCompactionStyleUniversal) {
+    // Universal compaction only ever merges whole sorted runs.
+    return false;
+  }
   FileMetaData* f = stats.seek_file;
   if (f != nullptr) {
     f->allowed_seeks--;
@@ -469,9 +790,38 @@ bool Version::OverlapInLevel(int level, const Slice* smallest_user_key,
                                smallest_user_key, largest_user_key);
 }
 
+void Version::GetSortedRuns(std::vector<SortedRun>* runs) const {
+  runs->clear();
+  std::vector<FileMetaData*> files0 = files_[0];
+  std::sort(files0.begin(), files0.end(), NewestFirst);
+  for (size_t i = 0; i < files0.size(); i++) {
+    SortedRun run;
+    run.level = 0;
+    run.file = files0[i];
+    run.size = files0[i]->file_size;
+    runs->push_back(run);
+  }
+  for (int level = 1; level < config::kNumLevels; level++) {
+    if (!files_[level].empty()) {
+      SortedRun run;
+      run.level = level;
+      run.file = nullptr;
+      run.size = TotalFileSize(files_[level]);
+      runs->push_back(run);
+    }
+  }
+}
+
 int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
                                         const Slice& largest_user_key) {
   int level = 0;
+  if (vset_->options_->level_compaction_dynamic_level_bytes ||
+      vset_->options_->compaction_style == kCompactionStyleUniversal) {
+    // Levels above the base level must stay empty, and the base level
+    // moves as the database grows.  Universal compaction orders its runs
+    // by level, so new data must start out in level-0.
+    return level;
+  }
   if (!OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
     // Push to next level if there is no overlap in next level,
     // and the #bytes overlapping in the level after that are limited.
@@ -496,6 +846,25 @@ int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
   return level;
 }
 
+int Version::PickLevelForIngestedFile(const Slice& smallest_user_key,
+                                      const Slice& largest_user_key) {
+  if (vset_->options_->compaction_style == kCompactionStyleUniversal) {
+    return 0;
+  }
+  int level = 0;
+  if (!OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
+    while (level + 1 < config::kNumLevels &&
+           !OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key)) {
+      level++;
+    }
+  }
+  if (level < base_level_) {
+    // Levels between level-0 and the base level must stay empty.
+    return 0;
+  }
+  return level;
+}
+
 // Store in "*inputs" all files in "level" that overlap [begin,end]
 void Version::GetOverlappingInputs(int level, const InternalKey* begin,
                                    const InternalKey* end,
@@ -539,6 +908,22 @@ void Version::GetOverlappingInputs(int level, const InternalKey* begin,
   }
 }
 
+Status Version::GetPropertiesOfAllTables(TablePropertiesCollection* props) {
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (FileMetaData* f : files_[level]) {
+      TableProperties p;
+      Status s = vset_->table_cache_->GetTableProperties(
+          f->number, f->file_size, level, &p);
+      if (s.ok()) {
+        (*props)[TableFileName(vset_->dbname_, f->number)] = p;
+      } else if (!s.IsNotFound()) {
+        return s;
+      }
+    }
+  }
+  return Status::OK();
+}
+
 std::string Version::DebugString() const {
   std::string r;
   for (int level = 0; level < config::kNumLevels; level++) {
@@ -747,6 +1132,8 @@ VersionSet::VersionSet(const std::string& dbname, const Options* options,
       prev_log_number_(0),
       descriptor_file_(nullptr),
       descriptor_log_(nullptr),
+      manifest_size_(0),
+      manifest_snapshot_size_(0),
       dummy_versions_(this),
       current_(nullptr) {
   AppendVersion(new Version(this));
@@ -777,6 +1164,20 @@ void VersionSet::AppendVersion(Version* v) {
 }
 
 Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
+  // Once the descriptor log has grown past max_manifest_file_size, start a
+  // new one from a snapshot of the current version, so that recovery reads
+  // the live files rather than their whole history.  Requiring the log to
+  // be twice its snapshot keeps the snapshots from being rewritten on every
+  // edit when they alone exceed the limit.
+  const uint64_t old_manifest_file_number = manifest_file_number_;
+  const bool roll_manifest =
+      descriptor_log_ != nullptr &&
+      manifest_size_ >= options_->max_manifest_file_size &&
+      manifest_size_ >= 2 * manifest_snapshot_size_;
+  if (roll_manifest) {
+    manifest_file_number_ = NewFileNumber();
+  }
+
   if (edit->has_log_number_) {
     assert(edit->log_number_ >= log_number_);
     assert(edit->log_number_ < next_file_number_);
@@ -801,31 +1202,40 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
 
   // Initialize new descriptor log file if necessary by creating
   // a temporary file that contains a snapshot of the current version.
+  // The snapshot is encoded while *mu is held and written without it.
   std::string new_manifest_file;
-  Status s;
-  if (descriptor_log_ == nullptr) {
-    // No reason to unlock *mu here since we only hit this path in the
-    // first call to LogAndApply (when opening the database).
-    assert(descriptor_file_ == nullptr);
+  std::string snapshot;
+  if (descriptor_log_ == nullptr || roll_manifest) {
+    assert(roll_manifest || descriptor_file_ == nullptr);
     new_manifest_file = DescriptorFileName(dbname_, manifest_file_number_);
-    s = env_->NewWritableFile(new_manifest_file, &descriptor_file_);
-    if (s.ok()) {
-      descriptor_log_ = new log::Writer(descriptor_file_);
-      s = WriteSnapshot(descriptor_log_);
-    }
+    EncodeSnapshot(&snapshot);
   }
 
   // Unlock during expensive MANIFEST log write
+  Status s;
+  std::string record;
+  WritableFile* manifest_file = descriptor_file_;
+  log::Writer* manifest_log = descriptor_log_;
   {
     mu->Unlock();
 
+    if (!new_manifest_file.empty()) {
+      s = env_->NewWritableFile(new_manifest_file, &manifest_file);
+      if (s.ok()) {
+        manifest_log = new log::Writer(manifest_file);
+        s = manifest_log->AddRecord(snapshot);
+      } else {
+        manifest_file = nullptr;
+        manifest_log = nullptr;
+      }
+    }
+
     // Write new record to MANIFEST log
     if (s.ok()) {
-      std::string record;
       edit->EncodeTo(&record);
-      s = descriptor_log_->AddRecord(record);
+      s = manifest_log->AddRecord(record);
       if (s.ok()) {
-        s = descriptor_file_->Sync();
+        s = manifest_file->Sync();
       }
       if (!s.ok()) {
         Log(options_->info_log, "MANIFEST write: %s\n", s.ToString().c_str());
@@ -843,17 +1253,32 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
 
   // Install the new version
   if (s.ok()) {
+    if (!new_manifest_file.empty()) {
+      // The old descriptor log, if any, is removed with the other
+      // obsolete files.
+      delete descriptor_log_;
+      delete descriptor_file_;
+      descriptor_log_ = manifest_log;
+      descriptor_file_ = manifest_file;
+      manifest_size_ = snapshot.size();
+      manifest_snapshot_size_ = snapshot.size();
+      if (roll_manifest) {
+        Log(options_->info_log, "Rolled MANIFEST over to #%llu\n",
+            static_cast<unsigned long long>(manifest_file_number_));
+      }
+    }
+    manifest_size_ += record.size();
     AppendVersion(v);
     log_number_ = edit->log_number_;
     prev_log_number_ = edit->prev_log_number_;
   } else {
     delete v;
     if (!new_manifest_file.empty()) {
-      delete descriptor_log_;
-      delete descriptor_file_;
-      descriptor_log_ = nullptr;
-      descriptor_file_ = nullptr;
+      delete manifest_log;
+      delete manifest_file;
       env_->RemoveFile(new_manifest_file);
+      // Keep appending to the old descriptor log, if any.
+      manifest_file_number_ = old_manifest_file_number;
     }
   }
 
@@ -1021,6 +1446,7 @@ bool VersionSet::ReuseManifest(const std::string& dscname,
   Log(options_->info_log, "Reusing MANIFEST %s\n", dscname.c_str());
   descriptor_log_ = new log::Writer(descriptor_file_, manifest_size);
   manifest_file_number_ = manifest_number;
+  manifest_size_ = manifest_size;
   return true;
 }
 
@@ -1030,10 +1456,84 @@ void VersionSet::MarkFileNumberUsed(uint64_t number) {
   }
 }
 
+void VersionSet::SetLevelTargets(Version* v) {
+  const int last_level = config::kNumLevels - 1;
+  if (!options_->level_compaction_dynamic_level_bytes) {
+    v->base_level_ = 1;
+    for (int level = 0; level < config::kNumLevels; level++) {
+      v->max_bytes_[level] = MaxBytesForLevel(options_, level);
+    }
+    return;
+  }
+
+  const double base = options_->max_bytes_for_level_base;
+  const double multiplier = options_->max_bytes_for_level_multiplier;
+  int first_level = 0;  // First non-empty level after level-0
+  uint64_t max_level_bytes = 0;
+  for (int level = 1; level < config::kNumLevels; level++) {
+    const uint64_t level_bytes = TotalFileSize(v->files_[level]);
+    if (level_bytes > 0 && first_level == 0) {
+      first_level = level;
+    }
+    max_level_bytes = std::max(max_level_bytes, level_bytes);
+  }
+
+  // Scale the largest level's size up to first_level as if that level were
+  // the last one, then keep going up while the target is too large for a
+  // base level.  Data only ever moves down, so the base level must not be
+  // below first_level.
+  double target = base;
+  if (first_level == 0) {
+    v->base_level_ = last_level;
+  } else {
+    target = static_cast<double>(max_level_bytes);
+    for (int level = last_level; level > first_level; level--) {
+      target /= multiplier;
+    }
+    v->base_level_ = first_level;
+    while (v->base_level_ > 1 && target > base) {
+      v->base_level_--;
+      target /= multiplier;
+    }
+  }
+
+  // The levels above the base level are empty, and no level gets a target
+  // below the base size; otherwise a small database would keep every
+  // level-0 compaction cascading down to the bottom.
+  for (int level = 0; level < config::kNumLevels; level++) {
+    if (level < v->base_level_) {
+      v->max_bytes_[level] = base;
+    } else {
+      v->max_bytes_[level] = std::max(target, base);
+      target *= multiplier;
+    }
+  }
+}
+
+void VersionSet::FinalizeUniversal(Version* v) {
+  std::vector<Version::SortedRun> runs;
+  v->GetSortedRuns(&runs);
+  v->compaction_level_ = 0;
+  v->compaction_score_ = v->files_[0].size() /
+                         static_cast<double>(config::kL0_CompactionTrigger);
+
+  // Merging all runs into the oldest one would rewrite everything but it.
+  uint64_t pending_bytes = 0;
+  if (v->compaction_score_ >= 1) {
+    for (size_t i = 0; i + 1 < runs.size(); i++) {
+      pending_bytes += runs[i].size;
+    }
+  }
+  v->pending_compaction_bytes_ = pending_bytes;
+}
+
 void VersionSet::Finalize(Version* v) {
+  SetLevelTargets(v);
+
   // Precomputed best level for next compaction
   int best_level = -1;
   double best_score = -1;
+  uint64_t pending_bytes = 0;
 
   for (int level = 0; level < config::kNumLevels - 1; level++) {
     double score;
@@ -1051,11 +1551,17 @@ void VersionSet::Finalize(Version* v) {
       // overwrites/deletions).
       score = v->files_[level].size() /
               static_cast<double>(config::kL0_CompactionTrigger);
+      if (score >= 1) {
+        pending_bytes += TotalFileSize(v->files_[level]);
+      }
     } else {
       // Compute the ratio of current size to size limit.
       const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-      score =
-          static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
+      const double max_bytes = v->max_bytes_[level];
+      score = static_cast<double>(level_bytes) / max_bytes;
+      if (level_bytes > max_bytes) {
+        pending_bytes += level_bytes - static_cast<uint64_t>(max_bytes);
+      }
     }
 
     if (score > best_score) {
@@ -1066,9 +1572,48 @@ void VersionSet::Finalize(Version* v) {
 
   v->compaction_level_ = best_level;
   v->compaction_score_ = best_score;
+  v->pending_compaction_bytes_ = pending_bytes;
+  if (options_->compaction_style == kCompactionStyleUniversal) {
+    FinalizeUniversal(v);
+  }
+
+  // Link every level to the next one with files.  Both levels are sorted,
+  // so one merge pass finds all the pointers.
+  int level = config::kNumLevels - 1;
+  int next_level = -1;
+  for (; level > 0; level--) {
+    const std::vector<FileMetaData*>& files = v->files_[level];
+    v->cascade_[level].clear();
+    v->cascade_level_[level] = files.empty() ? -1 : next_level;
+    if (files.empty()) {
+      continue;
+    }
+    if (next_level >= 0) {
+      const std::vector<FileMetaData*>& next_files = v->files_[next_level];
+      v->cascade_[level].resize(files.size());
+      uint32_t j = 0;
+      for (size_t i = 0; i < files.size(); i++) {
+        while (j < next_files.size() &&
+               icmp_.Compare(next_files[j]->largest, files[i]->largest) < 0) {
+          j++;
+        }
+        v->cascade_[level][i] = j;
+      }
+    }
+    next_level = level;
+  }
+
+  // The learned indexes map keys by their bytes, which only matches the
+  // order of the bytewise comparator.
+  if (options_->learned_file_index &&
+      icmp_.user_comparator() == BytewiseComparator()) {
+    for (int level = 1; level < config::kNumLevels; level++) {
+      v->file_index_[level].Build(v->files_[level]);
+    }
+  }
 }
 
-Status VersionSet::WriteSnapshot(log::Writer* log) {
+void VersionSet::EncodeSnapshot(std::string* record) {
   // TODO: Break up into multiple records to reduce memory usage on recovery?
 
   // Save metadata
@@ -1089,13 +1634,11 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, *f);
     }
   }
 
-  std::string record;
-  edit.EncodeTo(&record);
-  return log->AddRecord(record);
+  edit.EncodeTo(record);
 }
 
 int VersionSet::NumLevelFiles(int level) const {
@@ -1137,7 +1680,8 @@ uint64_t VersionSet::ApproximateOffsetOf(Version* v, const InternalKey& ikey) {
         // approximate offset of "ikey" within the table.
         FixTable* tableptr;
         Iterator* iter = table_cache_->NewIterator(
-            ReadOptions(), files[i]->number, files[i]->file_size, &tableptr);
+            ReadOptions(), files[i]->number, files[i]->file_size, level,
+            &tableptr);
         if (tableptr != nullptr) {
           result += tableptr->ApproximateOffsetOf(ikey.Encode());
         }
@@ -1226,22 +1770,45 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   // Level-0 files have to be merged together.  For other levels,
   // we will make a concatenating iterator per level.
   // TODO(opt): use concatenating iterator for level-0 if there is no overlap
-  const int space = (c->level() == 0 ? c->inputs_[0].size() + 1 : 2);
+  int space = (c->level() == 0 ? c->inputs_[0].size() + 1 : 2);
+  for (int level = 0; level < config::kNumLevels; level++) {
+    if (!c->inner_inputs_[level].empty()) {
+      space++;
+    }
+  }
   Iterator** list = new Iterator*[space];
   int num = 0;
+  // Files hidden by a range tombstone, if any, are not read.
+  const bool skip_covered = !c->covered_inputs_.empty();
+  Iterator* (*file_iterator)(void*, const ReadOptions&, const Slice&) =
+      skip_covered ? &Compaction::GetInputFileIterator : &GetFileIterator;
+  void* file_iterator_arg =
+      skip_covered ? static_cast<void*>(c) : static_cast<void*>(table_cache_);
+  for (int level = 0; level < config::kNumLevels; level++) {
+    if (!c->inner_inputs_[level].empty()) {
+      list[num++] = NewTwoLevelIterator(
+          new Version::LevelFileNumIterator(icmp_, &c->inner_inputs_[level],
+                                            level),
+          file_iterator, file_iterator_arg, options);
+    }
+  }
   for (int which = 0; which < 2; which++) {
     if (!c->inputs_[which].empty()) {
       if (c->level() + which == 0) {
         const std::vector<FileMetaData*>& files = c->inputs_[which];
         for (size_t i = 0; i < files.size(); i++) {
+          if (c->covered_inputs_.count(files[i]->number) > 0) {
+            continue;
+          }
           list[num++] = table_cache_->NewIterator(options, files[i]->number,
-                                                  files[i]->file_size);
+                                                  files[i]->file_size, 0);
         }
       } else {
         // Create concatenating iterator for the files from this level
         list[num++] = NewTwoLevelIterator(
-            new Version::LevelFileNumIterator(icmp_, &c->inputs_[which]),
-            &GetFileIterator, table_cache_, options);
+            new Version::LevelFileNumIterator(icmp_, &c->inputs_[which],
+                                              c->level() + which),
+            file_iterator, file_iterator_arg, options);
       }
     }
   }
@@ -1251,7 +1818,114 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   return result;
 }
 
+Compaction* VersionSet::PickUniversalCompaction() {
+  if (current_->compaction_score_ < 1) {
+    return nullptr;
+  }
+  std::vector<Version::SortedRun> runs;
+  current_->GetSortedRuns(&runs);
+  const size_t n = runs.size();
+  assert(n >= 2);
+
+  // The output of a compaction cannot go to level-0, where it would read
+  // as newer than the level-0 files flushed after its inputs.  It goes
+  // right above the next older run instead, so merging level-0 files takes
+  // every older level-0 file along, and takes level-1 along too if that
+  // holds a run.
+  size_t num_level0_runs = 0;
+  while (num_level0_runs < n && runs[num_level0_runs].level == 0) {
+    num_level0_runs++;
+  }
+  const bool level1_free =
+      (num_level0_runs == n || runs[num_level0_runs].level > 1);
+
+  // Merge runs[first, last].  If the newer runs add up to too much
+  // compared to the oldest one, merge everything.
+  size_t first = 0;
+  size_t last = 0;
+  const uint64_t max_amp = options_->universal_max_size_amplification_percent;
+  const size_t min_width = options_->universal_min_merge_width;
+  uint64_t newer_bytes = 0;
+  for (size_t i = 0; i + 1 < n; i++) {
+    newer_bytes += runs[i].size;
+  }
+  if (newer_bytes * 100 > max_amp * runs[n - 1].size) {
+    last = n - 1;
+  } else {
+    // Otherwise, merge the newest runs of similar size.  While level-1 is
+    // taken, look past level-0 first: merging older runs makes room.
+    for (size_t start = level1_free ? 0 : num_level0_runs;
+         start < n && last == 0; start++) {
+      uint64_t candidate_bytes = runs[start].size;
+      size_t end = start + 1;
+      while (end < n &&
+             runs[end].size * 100 <=
+                 candidate_bytes * (100 + options_->universal_size_ratio)) {
+        candidate_bytes += runs[end].size;
+        end++;
+      }
+      if (end - start >= min_width) {
+        first = start;
+        last = end - 1;
+      }
+    }
+    if (last == 0) {
+      // Failing that, merge all of level-0.
+      last = num_level0_runs - 1;
+    }
+  }
+
+  if (first < num_level0_runs && last + 1 < num_level0_runs) {
+    last = num_level0_runs - 1;
+  }
+  while (last + 1 < n && runs[last + 1].level <= 1) {
+    last++;
+  }
+  const int level = runs[first].level;
+  const int output_level =
+      (last + 1 == n) ? config::kNumLevels - 1 : runs[last + 1].level - 1;
+  assert(output_level >= std::max(1, runs[last].level));
+
+  Compaction* c = new Compaction(options_, level, output_level);
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+  std::vector<FileMetaData*> all;
+  for (size_t i = first; i <= last; i++) {
+    const Version::SortedRun& run = runs[i];
+    std::vector<FileMetaData*>* inputs;
+    if (run.level == 0) {
+      c->inputs_[0].push_back(run.file);
+      all.push_back(run.file);
+      continue;
+    } else if (run.level == level) {
+      inputs = &c->inputs_[0];
+    } else if (run.level == output_level) {
+      inputs = &c->inputs_[1];
+    } else {
+      inputs = &c->inner_inputs_[run.level];
+    }
+    *inputs = current_->files_[run.level];
+    all.insert(all.end(), inputs->begin(), inputs->end());
+  }
+
+  if (output_level + 1 < config::kNumLevels) {
+    InternalKey smallest, largest;
+    GetRange(all, &smallest, &largest);
+    current_->GetOverlappingInputs(output_level + 1, &smallest, &largest,
+                                   &c->grandparents_);
+  }
+  Log(options_->info_log,
+      "Universal compaction of sorted runs %d to %d of %d into level-%d\n",
+      static_cast<int>(first), static_cast<int>(last), static_cast<int>(n),
+      output_level);
+  return c;
+}
+
 Compaction* VersionSet::PickCompaction() {
+  if (options_->compaction_style == kCompactionStyleUniversal) {
+    return PickUniversalCompaction();
+  }
+
   Compaction* c;
   int level;
 
@@ -1263,24 +1937,28 @@ Compaction* VersionSet::PickCompaction() {
     level = current_->compaction_level_;
     assert(level >= 0);
     assert(level + 1 < config::kNumLevels);
-    c = new Compaction(options_, level);
+    c = new Compaction(options_, level, current_->OutputLevel(level));
 
-    // Pick the first file that comes after compact_pointer_[level]
-    for (size_t i = 0; i < current_->files_[level].size(); i++) {
-      FileMetaData* f = current_->files_[level][i];
-      if (compact_pointer_[level].empty() ||
-          icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0) {
-        c->inputs_[0].push_back(f);
-        break;
+    if (level > 0 && options_->compaction_pri != kCompactPointerPri) {
+      c->inputs_[0].push_back(PickFileByPriority(level));
+    } else {
+      // Pick the first file that comes after compact_pointer_[level]
+      for (size_t i = 0; i < current_->files_[level].size(); i++) {
+        FileMetaData* f = current_->files_[level][i];
+        if (compact_pointer_[level].empty() ||
+            icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0) {
+          c->inputs_[0].push_back(f);
+          break;
+        }
+      }
+      if (c->inputs_[0].empty()) {
+        // Wrap-around to the beginning of the key space
+        c->inputs_[0].push_back(current_->files_[level][0]);
       }
-    }
-    if (c->inputs_[0].empty()) {
-      // Wrap-around to the beginning of the key space
-      c->inputs_[0].push_back(current_->files_[level][0]);
     }
   } else if (seek_compaction) {
     level = current_->file_to_compact_level_;
-    c = new Compaction(options_, level);
+    c = new Compaction(options_, level, current_->OutputLevel(level));
     c->inputs_[0].push_back(current_->file_to_compact_);
   } else {
     return nullptr;
@@ -1305,6 +1983,49 @@ Compaction* VersionSet::PickCompaction() {
   return c;
 }
 
+FileMetaData* VersionSet::PickFileByPriority(int level) {
+  const std::vector<FileMetaData*>& files = current_->files_[level];
+  const std::vector<FileMetaData*>& next =
+      current_->files_[current_->OutputLevel(level)];
+  const Comparator* user_cmp = icmp_.user_comparator();
+
+  // Both levels are sorted and disjoint, so the files of "next" that
+  // overlap each file of "level" start at or after those of the file
+  // before it.
+  FileMetaData* best = nullptr;
+  double best_density = 0;
+  double best_ratio = 0;
+  size_t first = 0;
+  for (FileMetaData* f : files) {
+    while (first < next.size() &&
+           user_cmp->Compare(next[first]->largest.user_key(),
+                             f->smallest.user_key()) < 0) {
+      first++;
+    }
+    uint64_t overlapping_bytes = 0;
+    for (size_t i = first;
+         i < next.size() && user_cmp->Compare(next[i]->smallest.user_key(),
+                                              f->largest.user_key()) <= 0;
+         i++) {
+      overlapping_bytes += next[i]->file_size;
+    }
+    const double ratio = static_cast<double>(overlapping_bytes) /
+                         std::max<uint64_t>(f->file_size, 1);
+    double density = 0;
+    if (options_->compaction_pri == kTombstoneDensityPri &&
+        f->num_entries > 0) {
+      density = static_cast<double>(f->num_deletions) / f->num_entries;
+    }
+    if (best == nullptr || density > best_density ||
+        (density == best_density && ratio < best_ratio)) {
+      best = f;
+      best_density = density;
+      best_ratio = ratio;
+    }
+  }
+  return best;
+}
+
 // Finds the largest key in a vector of files. Returns true if files is not
 // empty.
 bool FindLargestKey(const InternalKeyComparator& icmp,
@@ -1386,21 +2107,22 @@ void AddBoundaryInputs(const InternalKeyComparator& icmp,
 
 void VersionSet::SetupOtherInputs(Compaction* c) {
   const int level = c->level();
+  const int output_level = c->output_level();
   InternalKey smallest, largest;
 
   AddBoundaryInputs(icmp_, current_->files_[level], &c->inputs_[0]);
   GetRange(c->inputs_[0], &smallest, &largest);
 
-  current_->GetOverlappingInputs(level + 1, &smallest, &largest,
+  current_->GetOverlappingInputs(output_level, &smallest, &largest,
                                  &c->inputs_[1]);
-  AddBoundaryInputs(icmp_, current_->files_[level + 1], &c->inputs_[1]);
+  AddBoundaryInputs(icmp_, current_->files_[output_level], &c->inputs_[1]);
 
   // Get entire range covered by compaction
   InternalKey all_start, all_limit;
   GetRange2(c->inputs_[0], c->inputs_[1], &all_start, &all_limit);
 
   // See if we can grow the number of inputs in "level" without
-  // changing the number of "level+1" files we pick up.
+  // changing the number of "output_level" files we pick up.
   if (!c->inputs_[1].empty()) {
     std::vector<FileMetaData*> expanded0;
     current_->GetOverlappingInputs(level, &all_start, &all_limit, &expanded0);
@@ -1414,9 +2136,9 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
       InternalKey new_start, new_limit;
       GetRange(expanded0, &new_start, &new_limit);
       std::vector<FileMetaData*> expanded1;
-      current_->GetOverlappingInputs(level + 1, &new_start, &new_limit,
+      current_->GetOverlappingInputs(output_level, &new_start, &new_limit,
                                      &expanded1);
-      AddBoundaryInputs(icmp_, current_->files_[level + 1], &expanded1);
+      AddBoundaryInputs(icmp_, current_->files_[output_level], &expanded1);
       if (expanded1.size() == c->inputs_[1].size()) {
         Log(options_->info_log,
             "Expanding@%d %d+%d (%ld+%ld bytes) to %d+%d (%ld+%ld bytes)\n",
@@ -1433,9 +2155,9 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
   }
 
   // Compute the set of grandparent files that overlap this compaction
-  // (parent == level+1; grandparent == level+2)
-  if (level + 2 < config::kNumLevels) {
-    current_->GetOverlappingInputs(level + 2, &all_start, &all_limit,
+  // (parent == output_level; grandparent == output_level+1)
+  if (output_level + 1 < config::kNumLevels) {
+    current_->GetOverlappingInputs(output_level + 1, &all_start, &all_limit,
                                    &c->grandparents_);
   }
 
@@ -1472,7 +2194,7 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
     }
   }
 
-  Compaction* c = new Compaction(options_, level);
+  Compaction* c = new Compaction(options_, level, current_->OutputLevel(level));
   c->input_version_ = current_;
   c->input_version_->Ref();
   c->inputs_[0] = inputs;
@@ -1480,8 +2202,9 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
   return c;
 }
 
-Compaction::Compaction(const Options* options, int level)
+Compaction::Compaction(const Options* options, int level, int output_level)
     : level_(level),
+      output_level_(output_level),
       max_output_file_size_(MaxFileSizeForLevel(options, level)),
       input_version_(nullptr),
       grandparent_index_(0),
@@ -1503,6 +2226,11 @@ bool Compaction::IsTrivialMove() const {
   // Avoid a move if there is lots of overlapping grandparent data.
   // Otherwise, the move could create a parent file that will require
   // a very expensive merge later on.
+  for (int level = 0; level < config::kNumLevels; level++) {
+    if (!inner_inputs_[level].empty()) {
+      return false;
+    }
+  }
   return (num_input_files(0) == 1 && num_input_files(1) == 0 &&
           TotalFileSize(grandparents_) <=
               MaxGrandParentOverlapBytes(vset->options_));
@@ -1511,15 +2239,29 @@ bool Compaction::IsTrivialMove() const {
 void Compaction::AddInputDeletions(VersionEdit* edit) {
   for (int which = 0; which < 2; which++) {
     for (size_t i = 0; i < inputs_[which].size(); i++) {
-      edit->RemoveFile(level_ + which, inputs_[which][i]->number);
+      edit->RemoveFile(which == 0 ? level_ : output_level_,
+                       inputs_[which][i]->number);
+    }
+  }
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (size_t i = 0; i < inner_inputs_[level].size(); i++) {
+      edit->RemoveFile(level, inner_inputs_[level][i]->number);
     }
   }
 }
 
+int64_t Compaction::TotalInputSize() const {
+  int64_t sum = TotalFileSize(inputs_[0]) + TotalFileSize(inputs_[1]);
+  for (int level = 0; level < config::kNumLevels; level++) {
+    sum += TotalFileSize(inner_inputs_[level]);
+  }
+  return sum;
+}
+
 bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
   // Maybe use binary search to find right entry instead of linear search?
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
-  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
+  for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
     while (level_ptrs_[lvl] < files.size()) {
       FileMetaData* f = files[level_ptrs_[lvl]];
@@ -1537,6 +2279,97 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
   return true;
 }
 
+bool Compaction::IsBaseLevelForRange(const Slice& begin, const Slice& end) {
+  for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
+    // Treating "end" as inclusive errs on the safe side.
+    if (input_version_->OverlapInLevel(lvl, &begin, &end)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Status Compaction::ReadRangeTombstones(SequenceNumber snapshot,
+                                       std::vector<RangeTombstone>* tombstones,
+                                       RangeTombstoneList* covering) {
+  TableCache* table_cache = input_version_->vset_->table_cache_;
+  const Comparator* ucmp = input_version_->vset_->icmp_.user_comparator();
+  std::vector<std::pair<int, FileMetaData*>> files;
+  for (int which = 0; which < 2; which++) {
+    for (FileMetaData* f : inputs_[which]) {
+      files.push_back(std::make_pair(which == 0 ? level_ : output_level_, f));
+    }
+  }
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (FileMetaData* f : inner_inputs_[level]) {
+      files.push_back(std::make_pair(level, f));
+    }
+  }
+
+  Status s;
+  RangeTombstone t;
+  for (size_t i = 0; i < files.size() && s.ok(); i++) {
+    FileMetaData* f = files[i].second;
+    if (f->num_range_deletions == 0) {
+      continue;
+    }
+    Iterator* iter = table_cache->NewRangeTombstoneIterator(
+        f->number, f->file_size, files[i].first);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      if (!ParseRangeTombstone(iter->key(), iter->value(), &t)) {
+        s = Status::Corruption("bad range tombstone");
+        break;
+      }
+      if (ucmp->Compare(t.begin, t.end) < 0) {
+        tombstones->push_back(t);
+        covering->Add(t);
+      }
+    }
+    if (s.ok()) {
+      s = iter->status();
+    }
+    delete iter;
+  }
+  covering->Finish(snapshot);
+  if (!s.ok() || covering->empty()) {
+    return s;
+  }
+
+  // A file is hidden entirely if the tombstones over its key range are all
+  // newer than its newest entry.  Its own tombstones were read above.
+  for (size_t i = 0; i < files.size() && s.ok(); i++) {
+    FileMetaData* f = files[i].second;
+    const SequenceNumber seq = covering->MinCoveringSequence(
+        f->smallest.user_key(), f->largest.user_key());
+    if (seq == 0) {
+      continue;
+    }
+    TableProperties props;
+    Status ps = table_cache->GetTableProperties(f->number, f->file_size,
+                                                files[i].first, &props);
+    if (ps.IsNotFound()) {
+      continue;  // Written without properties; read it
+    } else if (!ps.ok()) {
+      s = ps;
+    } else if (props.num_entries == 0 || props.largest_seqno < seq) {
+      covered_inputs_.insert(f->number);
+    }
+  }
+  return s;
+}
+
+Iterator* Compaction::GetInputFileIterator(void* arg,
+                                           const ReadOptions& options,
+                                           const Slice& file_value) {
+  Compaction* c = reinterpret_cast<Compaction*>(arg);
+  if (file_value.size() == 20 &&
+      c->covered_inputs_.count(DecodeFixed64(file_value.data())) > 0) {
+    return NewEmptyIterator();
+  }
+  return GetFileIterator(c->input_version_->vset_->table_cache_, options,
+                         file_value);
+}
+
 bool Compaction::ShouldStopBefore(const Slice& internal_key) {
   const VersionSet* vset = input_version_->vset_;
   // Scan to find earliest grandparent file that contains key.
@@ -20,7 +20,9 @@
 #include <vector>
 
 #include "db/dbformat.h"
+#include "db/file_index.h"
 #include "db/version_edit.h"
+#include "leveldb/table_properties.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
 
@@ -33,6 +35,8 @@ class Writer;
 class Compaction;
 class Iterator;
 class MemTable;
+class RangeTombstoneList;
+struct RangeTombstone;
 class TableBuilder;
 class TableCache;
 class Version;
@@ -45,6 +49,13 @@ class WritableFile;
 int FindFile(const InternalKeyComparator& icmp,
              const std::vector<FileMetaData*>& files, const Slice& key);
 
+// Like FindFile(), but only searches files[left,right-1], returning
+// "right" if none of them qualifies.
+// REQUIRES: the result of FindFile() lies in [left,right].
+uint32_t FindFileInRange(const InternalKeyComparator& icmp,
+                         const std::vector<FileMetaData*>& files,
+                         const Slice& key, uint32_t left, uint32_t right);
+
 // Returns true iff some file in "files" overlaps the user key range
 // [*smallest,*largest].
 // smallest==nullptr represents a key smaller than all keys in the DB.
@@ -69,12 +80,27 @@ class Version {
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
   void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
+  // Add the range tombstones of the files of this Version to *list,
+  // leaving out the files outside the iterate bounds of "options".
+  Status AddRangeTombstones(const ReadOptions& options,
+                            RangeTombstoneList* list);
+
   // Lookup the value for key.  If found, store it in *val and
   // return OK.  Else return a non-OK status.  Fills *stats.
   // REQUIRES: lock is not held
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
              GetStats* stats);
 
+  // Look up each of "keys" as Get() would, storing the value of keys[i] in
+  // *values[i] and its status in (*statuses)[i].  Appends to *stats the
+  // stats of the lookups that should be charged to a file.  Each table is
+  // probed once for all the keys it may contain.
+  // REQUIRES: "keys" are sorted by user key
+  // REQUIRES: lock is not held
+  void MultiGet(const ReadOptions&, const std::vector<const LookupKey*>& keys,
+                const std::vector<std::string*>& values,
+                std::vector<Status>* statuses, std::vector<GetStats>* stats);
+
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
   // REQUIRES: lock is held
@@ -109,8 +135,19 @@ class Version {
   int PickLevelForMemTableOutput(const Slice& smallest_user_key,
                                  const Slice& largest_user_key);
 
+  // Return the level at which to place an ingested file that covers the
+  // range [smallest_user_key,largest_user_key] and holds newer data than
+  // every file of this version: the deepest level that neither it nor any
+  // level above overlaps.
+  int PickLevelForIngestedFile(const Slice& smallest_user_key,
+                               const Slice& largest_user_key);
+
   int NumFiles(int level) const { return files_[level].size(); }
 
+  // Adds the properties of every table of this version to *props, keyed
+  // by file name.  Tables written without properties are left out.
+  Status GetPropertiesOfAllTables(TablePropertiesCollection* props);
+
   // Return a human readable string that describes this version's contents.
   std::string DebugString() const;
 
@@ -128,7 +165,14 @@ class Version {
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {}
+        compaction_level_(-1),
+        pending_compaction_bytes_(0),
+        base_level_(1) {
+    for (int level = 0; level < config::kNumLevels; level++) {
+      cascade_level_[level] = -1;
+      max_bytes_[level] = 0;
+    }
+  }
 
   Version(const Version&) = delete;
   Version& operator=(const Version&) = delete;
@@ -137,6 +181,28 @@ class Version {
 
   Iterator* NewConcatenatingIterator(const ReadOptions&, int level) const;
 
+  // Returns the level a compaction of "level" writes to.
+  int OutputLevel(int level) const {
+    return (level == 0) ? base_level_ : level + 1;
+  }
+
+  // A sorted run of universal compaction: one level-0 file, or all the files
+  // of a level after level-0.
+  struct SortedRun {
+    int level;
+    FileMetaData* file;  // Only set for level-0 runs
+    uint64_t size;
+  };
+
+  // Stores the sorted runs of this version in *runs, newest first.
+  void GetSortedRuns(std::vector<SortedRun>* runs) const;
+
+  // Returns the index of the first file in "level" whose largest key is
+  // >= internal_key, as FindFile() does.  Uses the level's learned index
+  // where one was built.
+  // REQUIRES: level > 0
+  uint32_t FindFileInLevel(int level, const Slice& internal_key) const;
+
   // Call func(arg, level, f) for every file that overlaps user_key in
   // order from newest to oldest.  If an invocation of func returns
   // false, makes no more calls.
@@ -153,6 +219,20 @@ class Version {
   // List of files per level
   std::vector<FileMetaData*> files_[config::kNumLevels];
 
+  // Fractional cascading pointers for point lookups, initialized by
+  // Finalize().  For every level > 0 with files, cascade_level_ is the next
+  // level below it that has files (or -1), and cascade_[level][i] is the
+  // index in that level of the first file whose largest key is >= the
+  // largest key of files_[level][i].  The file a key falls into at one
+  // level thus narrows the search at the next to the files between two
+  // cascade pointers.
+  int cascade_level_[config::kNumLevels];
+  std::vector<uint32_t> cascade_[config::kNumLevels];
+
+  // Learned indexes over files_, see Options::learned_file_index.
+  // Initialized by Finalize() for levels > 0.
+  FileIndex file_index_[config::kNumLevels];
+
   // Next file to compact based on seek stats.
   FileMetaData* file_to_compact_;
   int file_to_compact_level_;
@@ -162,6 +242,17 @@ class Version {
   // are initialized by Finalize().
   double compaction_score_;
   int compaction_level_;
+
+  // Estimated bytes that must be compacted to bring every level back
+  // within its size limit.  Initialized by Finalize().
+  uint64_t pending_compaction_bytes_;
+
+  // Level that level-0 is compacted into, and the size limit of every level
+  // from there on.  Always 1 unless
+  // Options::level_compaction_dynamic_level_bytes is set, in which case the
+  // levels between 0 and base_level_ are empty.  Initialized by Finalize().
+  int base_level_;
+  double max_bytes_[config::kNumLevels];
 };
 
 class VersionSet {
@@ -244,6 +335,11 @@ class VersionSet {
   // file at a level >= 1.
   int64_t MaxNextLevelOverlappingBytes();
 
+  // Returns the file of "level" to compact next under
+  // Options::compaction_pri, which must not be kCompactPointerPri.
+  // REQUIRES: level > 0 and the level holds at least one file
+  FileMetaData* PickFileByPriority(int level);
+
   // Create an iterator that reads over the compaction inputs for "*c".
   // The caller should delete the iterator when no longer needed.
   Iterator* MakeInputIterator(Compaction* c);
@@ -254,6 +350,12 @@ class VersionSet {
     return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr);
   }
 
+  // Return the estimated number of bytes that must be compacted before the
+  // current version is back within its level size limits.
+  uint64_t PendingCompactionBytes() const {
+    return current_->pending_compaction_bytes_;
+  }
+
   // Add all files listed in any live version to *live.
   // May also mutate some internal state.
   void AddLiveFiles(std::set<uint64_t>* live);
@@ -277,6 +379,14 @@ class VersionSet {
 
   bool ReuseManifest(const std::string& dscname, const std::string& dscbase);
 
+  // Sets v->base_level_ and v->max_bytes_.
+  void SetLevelTargets(Version* v);
+
+  // Options::compaction_style == kCompactionStyleUniversal counterparts of
+  // Finalize() and PickCompaction().
+  void FinalizeUniversal(Version* v);
+  Compaction* PickUniversalCompaction();
+
   void Finalize(Version* v);
 
   void GetRange(const std::vector<FileMetaData*>& inputs, InternalKey* smallest,
@@ -288,8 +398,8 @@ class VersionSet {
 
   void SetupOtherInputs(Compaction* c);
 
-  // Save current contents to *log
-  Status WriteSnapshot(log::Writer* log);
+  // Encode the current contents as a single edit into *record
+  void EncodeSnapshot(std::string* record);
 
   void AppendVersion(Version* v);
 
@@ -307,6 +417,8 @@ class VersionSet {
   // Opened lazily
   WritableFile* descriptor_file_;
   log::Writer* descriptor_log_;
+  uint64_t manifest_size_;           // Bytes of edits in descriptor_log_
+  uint64_t manifest_snapshot_size_;  // Bytes of its initial snapshot
   Version dummy_versions_;  // Head of circular doubly-linked list of versions.
   Version* current_;        // == dummy_versions_.prev_
 
@@ -321,9 +433,15 @@ class Compaction {
   ~Compaction();
 
   // Return the level that is being compacted.  Inputs from "level"
-  // and "level+1" will be merged to produce a set of "level+1" files.
+  // and "output_level" will be merged to produce a set of "output_level"
+  // files.
   int level() const { return level_; }
 
+  // Return the level the compaction writes to.  This is "level+1", except
+  // that level-0 compacts into the version's base level, which may be
+  // further down (see Options::level_compaction_dynamic_level_bytes).
+  int output_level() const { return output_level_; }
+
   // Return the object that holds the edits to the descriptor done
   // by this compaction.
   VersionEdit* edit() { return &edit_; }
@@ -331,24 +449,44 @@ class Compaction {
   // "which" must be either 0 or 1
   int num_input_files(int which) const { return inputs_[which].size(); }
 
-  // Return the ith input file at "level()+which" ("which" must be 0 or 1).
+  // Return the ith input file at "level()" if "which" is 0, or at
+  // "output_level()" if "which" is 1.
   FileMetaData* input(int which, int i) const { return inputs_[which][i]; }
 
+  // Return the total size of the input files, including those of the levels
+  // between "level()" and "output_level()".
+  int64_t TotalInputSize() const;
+
   // Maximum size of files to build during this compaction.
   uint64_t MaxOutputFileSize() const { return max_output_file_size_; }
 
   // Is this a trivial compaction that can be implemented by just
-  // moving a single input file to the next level (no merging or splitting)
+  // moving a single input file to the output level (no merging or
+  // splitting)
   bool IsTrivialMove() const;
 
   // Add all inputs to this compaction as delete operations to *edit.
   void AddInputDeletions(VersionEdit* edit);
 
   // Returns true if the information we have available guarantees that
-  // the compaction is producing data in "level+1" for which no data exists
-  // in levels greater than "level+1".
+  // the compaction is producing data in "output_level" for which no data
+  // exists in levels greater than "output_level".
   bool IsBaseLevelForKey(const Slice& user_key);
 
+  // Like IsBaseLevelForKey() for the user keys in [begin, end).  Unlike
+  // it, may be called with ranges in any order.
+  bool IsBaseLevelForRange(const Slice& begin, const Slice& end);
+
+  // Stores the range tombstones of the input files in *tombstones and adds
+  // those visible at "snapshot" to *covering, which it finishes.  Input
+  // files whose every entry is hidden by a tombstone of *covering are left
+  // out of VersionSet::MakeInputIterator(), so that their data is dropped
+  // without being read.
+  // REQUIRES: lock is not held
+  Status ReadRangeTombstones(SequenceNumber snapshot,
+                             std::vector<RangeTombstone>* tombstones,
+                             RangeTombstoneList* covering);
+
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
   bool ShouldStopBefore(const Slice& internal_key);
@@ -361,18 +499,32 @@ class Compaction {
   friend class Version;
   friend class VersionSet;
 
-  Compaction(const Options* options, int level);
+  Compaction(const Options* options, int level, int output_level);
+
+  // Block function of the iterators over the input files, see
+  // VersionSet::MakeInputIterator().  "arg" is the compaction.
+  static Iterator* GetInputFileIterator(void* arg, const ReadOptions& options,
+                                        const Slice& file_value);
 
   int level_;
+  int output_level_;
   uint64_t max_output_file_size_;
   Version* input_version_;
   VersionEdit edit_;
 
-  // Each compaction reads inputs from "level_" and "level_+1"
+  // Each compaction reads inputs from "level_" and "output_level_"
   std::vector<FileMetaData*> inputs_[2];  // The two sets of inputs
 
+  // Universal compactions merge several sorted runs at once, and also read
+  // all the files of the levels strictly between "level_" and
+  // "output_level_" that hold a run.  Empty for leveled compactions.
+  std::vector<FileMetaData*> inner_inputs_[config::kNumLevels];
+
+  // Numbers of the input files that a range tombstone hides entirely.
+  std::set<uint64_t> covered_inputs_;
+
   // State used to check for number of overlapping grandparent files
-  // (parent == level_ + 1, grandparent == level_ + 2)
+  // (parent == output_level_, grandparent == output_level_ + 1)
   std::vector<FileMetaData*> grandparents_;
   size_t grandparent_index_;  // Index in grandparent_starts_
   bool seen_key_;             // Some output key has been seen
@@ -384,7 +536,7 @@ class Compaction {
   // level_ptrs_ holds indices into input_version_->levels_: our state
   // is that we are positioned at one of the file ranges for each
   // higher level than the ones involved in this compaction (i.e. for
-  // all L >= level_ + 2).
+  // all L > output_level_).
   size_t level_ptrs_[config::kNumLevels];
 };
 
@@ -5,13 +5,26 @@
 // WriteBatch::rep_ :=
 //    sequence: fixed64
 //    count: fixed32
-//    data: record[count]
+//    data: record*
 // record :=
 //    kTypeValue varstring varstring         |
-//    kTypeDeletion varstring
+//    kTypeDeletion varstring                |
+//    kTypeRangeDeletion varstring varstring |
+//    kTypeFixedRun key_width: varint32 value_width: varint32 n: fixed32
+//                  entry[n]
 // varstring :=
 //    len: varint32
 //    data: uint8[len]
+// entry :=
+//    key: uint8[key_width]
+//    value: uint8[value_width]
+//
+// When Options::pack_fixed_width_writes is set, the DB re-encodes each write
+// group so that consecutive Puts whose keys and values have the same widths
+// form a single kTypeFixedRun record, storing the widths once per run
+// instead of once per entry.  Batches built through the public interface
+// never contain runs.  "count" is the number of updates in the batch, with
+// a run of n entries counting as n.
 
 #include "leveldb/write_batch.h"
 
@@ -26,26 +39,31 @@ namespace leveldb {
 // WriteBatch header has an 8-byte sequence number followed by a 4-byte count.
 static const size_t kHeader = 12;
 
-WriteBatch::WriteBatch() { Clear(); }
-
-WriteBatch::~WriteBatch() = default;
-
-WriteBatch::Handler::~Handler() = default;
-
-void WriteBatch::Clear() {
-  rep_.clear();
-  rep_.resize(kHeader);
-}
+// Record tag for a run of Puts with identical key and value widths.  Only
+// appears in WriteBatch contents (and hence in log files), never in tables,
+// so it is kept well clear of the ValueType values.
+static const char kTypeFixedRun = 0x10;
 
-size_t WriteBatch::ApproximateSize() const { return rep_.size(); }
+namespace {
 
-Status WriteBatch::Iterate(Handler* handler) const {
-  Slice input(rep_);
-  if (input.size() < kHeader) {
-    return Status::Corruption("malformed WriteBatch (too small)");
+// Parses the header of a kTypeFixedRun record whose tag has already been
+// consumed from *input.  On success, *input points at the first entry.
+bool GetFixedRunHeader(Slice* input, uint32_t* key_width,
+                       uint32_t* value_width, uint32_t* n) {
+  if (GetVarint32(input, key_width) && GetVarint32(input, value_width) &&
+      input->size() >= 4) {
+    *n = DecodeFixed32(input->data());
+    input->remove_prefix(4);
+    return true;
   }
+  return false;
+}
 
-  input.remove_prefix(kHeader);
+// Feeds the records in "input" to "handler".  This is a template so that
+// InsertInto() can call the memtable inserter directly instead of going
+// through the virtual WriteBatch::Handler interface once per entry.
+template <typename HandlerType>
+Status IterateRecords(Slice input, int expected_count, HandlerType* handler) {
   Slice key, value;
   int found = 0;
   while (!input.empty()) {
@@ -68,17 +86,79 @@ Status WriteBatch::Iterate(Handler* handler) const {
           return Status::Corruption("bad WriteBatch Delete");
         }
         break;
+      case kTypeRangeDeletion:
+        if (GetLengthPrefixedSlice(&input, &key) &&
+            GetLengthPrefixedSlice(&input, &value)) {
+          handler->DeleteRange(key, value);
+        } else {
+          return Status::Corruption("bad WriteBatch DeleteRange");
+        }
+        break;
+      case kTypeFixedRun: {
+        uint32_t key_width, value_width, n;
+        if (!GetFixedRunHeader(&input, &key_width, &value_width, &n)) {
+          return Status::Corruption("bad WriteBatch fixed run");
+        }
+        // Check the run against the bytes and the count that are left
+        // before touching its entries, in 64 bits so that a corrupted
+        // header can neither overflow the checks nor loop without
+        // consuming input.
+        const uint64_t entry_size = static_cast<uint64_t>(key_width) +
+                                    value_width;
+        if (n == 0 || entry_size == 0 || input.size() / entry_size < n ||
+            static_cast<uint64_t>(found - 1) + n >
+                static_cast<uint64_t>(expected_count)) {
+          return Status::Corruption("bad WriteBatch fixed run");
+        }
+        const char* p = input.data();
+        for (uint32_t i = 0; i < n; i++) {
+          handler->Put(Slice(p, key_width), Slice(p + key_width, value_width));
+          p += entry_size;
+        }
+        input.remove_prefix(entry_size * n);
+        found += n - 1;
+        break;
+      }
       default:
         return Status::Corruption("unknown WriteBatch tag");
     }
   }
-  if (found != WriteBatchInternal::Count(this)) {
+  if (found != expected_count) {
     return Status::Corruption("WriteBatch has wrong count");
   } else {
     return Status::OK();
   }
 }
 
+}  // namespace
+
+WriteBatch::WriteBatch() { Clear(); }
+
+WriteBatch::~WriteBatch() = default;
+
+WriteBatch::Handler::~Handler() = default;
+
+void WriteBatch::Handler::DeleteRange(const Slice& begin_key,
+                                      const Slice& end_key) {}
+
+void WriteBatch::Clear() {
+  rep_.clear();
+  rep_.resize(kHeader);
+  last_record_ = 0;
+}
+
+size_t WriteBatch::ApproximateSize() const { return rep_.size(); }
+
+Status WriteBatch::Iterate(Handler* handler) const {
+  Slice input(rep_);
+  if (input.size() < kHeader) {
+    return Status::Corruption("malformed WriteBatch (too small)");
+  }
+
+  input.remove_prefix(kHeader);
+  return IterateRecords(input, WriteBatchInternal::Count(this), handler);
+}
+
 int WriteBatchInternal::Count(const WriteBatch* b) {
   return DecodeFixed32(b->rep_.data() + 8);
 }
@@ -97,6 +177,50 @@ void WriteBatchInternal::SetSequence(WriteBatch* b, SequenceNumber seq) {
 
 void WriteBatch::Put(const Slice& key, const Slice& value) {
   WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  last_record_ = rep_.size();
+  rep_.push_back(static_cast<char>(kTypeValue));
+  PutLengthPrefixedSlice(&rep_, key);
+  PutLengthPrefixedSlice(&rep_, value);
+}
+
+void WriteBatch::AddPut(const Slice& key, const Slice& value) {
+  if (last_record_ != 0) {
+    Slice last(rep_.data() + last_record_ + 1,
+               rep_.size() - last_record_ - 1);
+    if (rep_[last_record_] == kTypeFixedRun) {
+      uint32_t key_width, value_width, n;
+      GetFixedRunHeader(&last, &key_width, &value_width, &n);
+      if (key.size() == key_width && value.size() == value_width) {
+        // Extend the trailing run in place.
+        EncodeFixed32(&rep_[last.data() - 4 - rep_.data()], n + 1);
+        rep_.append(key.data(), key.size());
+        rep_.append(value.data(), value.size());
+        return;
+      }
+    } else if (rep_[last_record_] == kTypeValue) {
+      Slice last_key, last_value;
+      GetLengthPrefixedSlice(&last, &last_key);
+      GetLengthPrefixedSlice(&last, &last_value);
+      if (key.size() == last_key.size() && value.size() == last_value.size() &&
+          key.size() + value.size() > 0) {
+        // Turn the trailing Put into a run holding both entries.  Entries
+        // without any bytes stay separate, since a run of them would be
+        // indistinguishable from a corrupted one.
+        std::string entry(last_key.data(), last_key.size());
+        entry.append(last_value.data(), last_value.size());
+        rep_.resize(last_record_);
+        rep_.push_back(kTypeFixedRun);
+        PutVarint32(&rep_, key.size());
+        PutVarint32(&rep_, value.size());
+        PutFixed32(&rep_, 2);
+        rep_.append(entry);
+        rep_.append(key.data(), key.size());
+        rep_.append(value.data(), value.size());
+        return;
+      }
+    }
+  }
+  last_record_ = rep_.size();
   rep_.push_back(static_cast<char>(kTypeValue));
   PutLengthPrefixedSlice(&rep_, key);
   PutLengthPrefixedSlice(&rep_, value);
@@ -104,16 +228,25 @@ void WriteBatch::Put(const Slice& key, const Slice& value) {
 
 void WriteBatch::Delete(const Slice& key) {
   WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  last_record_ = rep_.size();
   rep_.push_back(static_cast<char>(kTypeDeletion));
   PutLengthPrefixedSlice(&rep_, key);
 }
 
+void WriteBatch::DeleteRange(const Slice& begin_key, const Slice& end_key) {
+  WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  last_record_ = rep_.size();
+  rep_.push_back(static_cast<char>(kTypeRangeDeletion));
+  PutLengthPrefixedSlice(&rep_, begin_key);
+  PutLengthPrefixedSlice(&rep_, end_key);
+}
+
 void WriteBatch::Append(const WriteBatch& source) {
   WriteBatchInternal::Append(this, &source);
 }
 
 namespace {
-class MemTableInserter : public WriteBatch::Handler {
+class MemTableInserter final : public WriteBatch::Handler {
  public:
   SequenceNumber sequence_;
   MemTable* mem_;
@@ -126,6 +259,10 @@ class MemTableInserter : public WriteBatch::Handler {
     mem_->Add(sequence_, kTypeDeletion, key, Slice());
     sequence_++;
   }
+  void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+    mem_->Add(sequence_, kTypeRangeDeletion, begin_key, end_key);
+    sequence_++;
+  }
 };
 }  // namespace
 
@@ -133,18 +270,56 @@ Status WriteBatchInternal::InsertInto(const WriteBatch* b, MemTable* memtable) {
   MemTableInserter inserter;
   inserter.sequence_ = WriteBatchInternal::Sequence(b);
   inserter.mem_ = memtable;
-  return b->Iterate(&inserter);
+  Slice input(b->rep_);
+  if (input.size() < kHeader) {
+    return Status::Corruption("malformed WriteBatch (too small)");
+  }
+  input.remove_prefix(kHeader);
+  return IterateRecords(input, Count(b), &inserter);
 }
 
 void WriteBatchInternal::SetContents(WriteBatch* b, const Slice& contents) {
   assert(contents.size() >= kHeader);
   b->rep_.assign(contents.data(), contents.size());
+  b->last_record_ = 0;
 }
 
 void WriteBatchInternal::Append(WriteBatch* dst, const WriteBatch* src) {
   SetCount(dst, Count(dst) + Count(src));
   assert(src->rep_.size() >= kHeader);
+  if (src->last_record_ != 0) {
+    dst->last_record_ = dst->rep_.size() + (src->last_record_ - kHeader);
+  } else if (src->rep_.size() > kHeader) {
+    dst->last_record_ = 0;
+  }
   dst->rep_.append(src->rep_.data() + kHeader, src->rep_.size() - kHeader);
 }
 
+void WriteBatchInternal::AppendPacked(WriteBatch* dst, const WriteBatch* src) {
+  struct Packer {
+    WriteBatch* dst;
+    void Put(const Slice& key, const Slice& value) { dst->AddPut(key, value); }
+    void Delete(const Slice& key) { dst->Delete(key); }
+    void DeleteRange(const Slice& begin_key, const Slice& end_key) {
+      dst->DeleteRange(begin_key, end_key);
+    }
+  };
+
+  const int count = Count(dst);
+  const size_t size = dst->rep_.size();
+  const size_t last_record = dst->last_record_;
+  assert(src->rep_.size() >= kHeader);
+  Slice input(src->rep_.data() + kHeader, src->rep_.size() - kHeader);
+  Packer packer = {dst};
+  if (IterateRecords(input, Count(src), &packer).ok()) {
+    SetCount(dst, count + Count(src));
+  } else {
+    // Leave a malformed batch for InsertInto() to report.
+    dst->rep_.resize(size);
+    dst->last_record_ = last_record;
+    SetCount(dst, count);
+    Append(dst, src);
+  }
+}
+
 }  // namespace leveldb
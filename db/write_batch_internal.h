@@ -38,6 +38,11 @@ class WriteBatchInternal {
   static Status InsertInto(const WriteBatch* batch, MemTable* memtable);
 
   static void Append(WriteBatch* dst, const WriteBatch* src);
+
+  // Like Append(), but packs consecutive Puts of the same key and value
+  // widths into fixed-width runs, joining the trailing run of "dst".
+  // Logs holding such runs cannot be read by releases that predate them.
+  static void AppendPacked(WriteBatch* dst, const WriteBatch* src);
 };
 
 }  // namespace leveldb
@@ -2,11 +2,15 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
+#include <cstdio>
+
 #include "gtest/gtest.h"
 #include "db/memtable.h"
+#include "db/range_tombstone.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "util/coding.h"
 #include "util/logging.h"
 
 namespace leveldb {
@@ -37,11 +41,28 @@ static std::string PrintContents(WriteBatch* b) {
         state.append(")");
         count++;
         break;
+      case kTypeRangeDeletion:
+        // Listed from the range tombstone iterator below.
+        ADD_FAILURE() << "range tombstone among the point entries";
+        break;
     }
     state.append("@");
     state.append(NumberToString(ikey.sequence));
   }
   delete iter;
+  iter = mem->NewRangeTombstoneIterator();
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    RangeTombstone t;
+    EXPECT_TRUE(ParseRangeTombstone(iter->key(), iter->value(), &t));
+    state.append("DeleteRange(");
+    state.append(t.begin);
+    state.append(", ");
+    state.append(t.end);
+    state.append(")@");
+    state.append(NumberToString(t.seq));
+    count++;
+  }
+  delete iter;
   if (!s.ok()) {
     state.append("ParseError()");
   } else if (count != WriteBatchInternal::Count(b)) {
@@ -72,6 +93,22 @@ TEST(WriteBatchTest, Multiple) {
       PrintContents(&batch));
 }
 
+TEST(WriteBatchTest, DeleteRange) {
+  WriteBatch batch;
+  batch.Put(Slice("foo"), Slice("bar"));
+  batch.DeleteRange(Slice("a"), Slice("g"));
+  batch.Put(Slice("baz"), Slice("boo"));
+  batch.DeleteRange(Slice("b"), Slice("c"));
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ(4, WriteBatchInternal::Count(&batch));
+  ASSERT_EQ(
+      "Put(baz, boo)@102"
+      "Put(foo, bar)@100"
+      "DeleteRange(a, g)@101"
+      "DeleteRange(b, c)@103",
+      PrintContents(&batch));
+}
+
 TEST(WriteBatchTest, Corruption) {
   WriteBatch batch;
   batch.Put(Slice("foo"), Slice("bar"));
@@ -112,6 +149,114 @@ TEST(WriteBatchTest, Append) {
       PrintContents(&b1));
 }
 
+TEST(WriteBatchTest, FixedWidthRun) {
+  WriteBatch plain, packed;
+  for (int i = 0; i < 10; i++) {
+    char key[8], value[8];
+    std::snprintf(key, sizeof(key), "k%02d", i);
+    std::snprintf(value, sizeof(value), "v%02d", i);
+    plain.Put(key, value);
+  }
+  plain.Put("long", "value");
+  // Put() itself always writes one record per entry.
+  ASSERT_EQ(12 + 10 * 9 + 12, plain.ApproximateSize());
+
+  WriteBatchInternal::AppendPacked(&packed, &plain);
+  WriteBatchInternal::SetSequence(&packed, 100);
+  ASSERT_EQ(11, WriteBatchInternal::Count(&packed));
+  ASSERT_EQ(
+      "Put(k00, v00)@100Put(k01, v01)@101Put(k02, v02)@102"
+      "Put(k03, v03)@103Put(k04, v04)@104Put(k05, v05)@105"
+      "Put(k06, v06)@106Put(k07, v07)@107Put(k08, v08)@108"
+      "Put(k09, v09)@109Put(long, value)@110",
+      PrintContents(&packed));
+
+  // The run stores the widths once instead of once per entry.
+  ASSERT_EQ(12 + 7 + 10 * 6 + 12, packed.ApproximateSize());
+}
+
+TEST(WriteBatchTest, FixedWidthRunAppend) {
+  WriteBatch group, b;
+  WriteBatchInternal::SetSequence(&group, 200);
+  b.Put("a", "va");
+  b.Put("b", "vb");
+  WriteBatchInternal::AppendPacked(&group, &b);
+  b.Clear();
+  b.Put("c", "vc");
+  b.Put("d", "vd");
+  WriteBatchInternal::AppendPacked(&group, &b);
+  b.Clear();
+  b.Put("e", "ve");
+  WriteBatchInternal::AppendPacked(&group, &b);
+  // Every batch joined the run started by the first one.
+  ASSERT_EQ(5, WriteBatchInternal::Count(&group));
+  ASSERT_EQ(12 + 7 + 5 * 3, group.ApproximateSize());
+
+  b.Clear();
+  b.Delete("x");
+  b.Put("f", "vf");
+  WriteBatchInternal::AppendPacked(&group, &b);
+  ASSERT_EQ(7, WriteBatchInternal::Count(&group));
+  ASSERT_EQ(12 + 7 + 5 * 3 + 3 + 6, group.ApproximateSize());
+  ASSERT_EQ(
+      "Put(a, va)@200Put(b, vb)@201Put(c, vc)@202"
+      "Put(d, vd)@203Put(e, ve)@204Put(f, vf)@206"
+      "Delete(x)@205",
+      PrintContents(&group));
+
+  // A malformed batch is copied as is and fails when applied.
+  Slice contents = WriteBatchInternal::Contents(&b);
+  WriteBatchInternal::SetContents(&b,
+                                  Slice(contents.data(), contents.size() - 1));
+  WriteBatchInternal::AppendPacked(&group, &b);
+  ASSERT_EQ(9, WriteBatchInternal::Count(&group));
+  ASSERT_EQ(12 + 7 + 5 * 3 + 2 * (3 + 6) - 1, group.ApproximateSize());
+}
+
+TEST(WriteBatchTest, FixedWidthRunCorruption) {
+  WriteBatch plain, batch;
+  plain.Put(Slice("foo"), Slice("bar"));
+  plain.Delete(Slice("box"));
+  plain.Put(Slice("baz"), Slice("boo"));
+  plain.Put(Slice("bax"), Slice("bop"));
+  WriteBatchInternal::AppendPacked(&batch, &plain);
+  WriteBatchInternal::SetSequence(&batch, 200);
+  Slice contents = WriteBatchInternal::Contents(&batch);
+  WriteBatchInternal::SetContents(&batch,
+                                  Slice(contents.data(), contents.size() - 1));
+  ASSERT_EQ(
+      "Delete(box)@201"
+      "Put(foo, bar)@200"
+      "ParseError()",
+      PrintContents(&batch));
+}
+
+TEST(WriteBatchTest, FixedWidthRunBadHeader) {
+  // A run header claiming 2^32 - 1 entries without any bytes in them, or
+  // more entries than the input holds, is rejected without walking them.
+  for (uint32_t width : {0u, 1u}) {
+    std::string contents(12, '\0');
+    EncodeFixed32(&contents[8], 2);
+    contents.push_back(0x10);  // kTypeFixedRun
+    PutVarint32(&contents, width);
+    PutVarint32(&contents, width);
+    PutFixed32(&contents, 0xffffffffu);
+    contents.append("xy");
+    WriteBatch batch;
+    WriteBatchInternal::SetContents(&batch, contents);
+    ASSERT_EQ("ParseError()", PrintContents(&batch)) << width;
+  }
+
+  // Entries without any bytes are not packed into runs.
+  WriteBatch plain, batch;
+  plain.Put("", "");
+  plain.Put("", "");
+  WriteBatchInternal::AppendPacked(&batch, &plain);
+  ASSERT_EQ(12 + 2 * 3, batch.ApproximateSize());
+  WriteBatchInternal::SetSequence(&batch, 300);
+  ASSERT_EQ("Put(, )@301Put(, )@300", PrintContents(&batch));
+}
+
 TEST(WriteBatchTest, ApproximateSize) {
   WriteBatch batch;
   size_t empty_size = batch.ApproximateSize();
@@ -0,0 +1,84 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include <algorithm>
+
+#include "db/dbformat.h"
+
+namespace leveldb {
+
+// Writes are never slowed below this rate; level-0 stops are the backstop.
+static const uint64_t kMinWriteRate = 64 * 1024;
+
+// Unused bandwidth is banked for at most this long, which bounds the burst
+// a writer can issue after an idle period.
+static const uint64_t kMaxBurstMicros = 1000;
+
+WriteController::WriteController(uint64_t max_rate)
+    : max_rate_(std::max(max_rate, kMinWriteRate)),
+      delayed_(false),
+      rate_(max_rate_),
+      compaction_rate_(0),
+      next_write_micros_(0),
+      stall_micros_(0) {}
+
+void WriteController::Update(int level0_files,
+                             uint64_t pending_compaction_bytes) {
+  const bool l0_delay = level0_files >= config::kL0_SlowdownWritesTrigger;
+  const bool bytes_delay =
+      pending_compaction_bytes >= config::kSoftPendingCompactionBytesLimit;
+  if (!l0_delay && !bytes_delay) {
+    delayed_ = false;
+    return;
+  }
+  if (!delayed_) {
+    // Start with an empty bucket rather than credit from a previous episode.
+    next_write_micros_ = 0;
+    delayed_ = true;
+  }
+
+  // Start from what compactions have recently been able to sustain.
+  double rate = static_cast<double>(max_rate_);
+  if (compaction_rate_ > 0 && compaction_rate_ < max_rate_) {
+    rate = static_cast<double>(compaction_rate_);
+  }
+  // Halve the rate for every level-0 file past the slowdown trigger ...
+  if (l0_delay) {
+    const int excess = level0_files - config::kL0_SlowdownWritesTrigger;
+    rate /= static_cast<double>(1 << std::min(excess, 16));
+  }
+  // ... and scale it down in proportion to the compaction backlog.
+  if (bytes_delay) {
+    rate *= static_cast<double>(config::kSoftPendingCompactionBytesLimit) /
+            static_cast<double>(pending_compaction_bytes);
+  }
+  rate_ = std::max(static_cast<uint64_t>(rate), kMinWriteRate);
+}
+
+void WriteController::RecordCompaction(uint64_t bytes, uint64_t micros) {
+  if (micros == 0 || bytes == 0) {
+    return;
+  }
+  const uint64_t sample = bytes * 1000000 / micros;
+  if (compaction_rate_ == 0) {
+    compaction_rate_ = sample;
+  } else {
+    compaction_rate_ = (3 * compaction_rate_ + sample) / 4;
+  }
+}
+
+uint64_t WriteController::GetDelay(uint64_t now_micros, uint64_t bytes) {
+  if (!delayed_ || bytes == 0) {
+    return 0;
+  }
+  if (next_write_micros_ + kMaxBurstMicros < now_micros) {
+    next_write_micros_ = now_micros - kMaxBurstMicros;
+  }
+  next_write_micros_ += bytes * 1000000 / rate_;
+  return next_write_micros_ > now_micros ? next_write_micros_ - now_micros : 0;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,65 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// WriteController paces foreground writes when compactions fall behind.
+// Instead of sleeping a fixed amount per write once level-0 fills up, it
+// hands out write bandwidth from a token bucket whose rate follows the
+// measured compaction throughput and shrinks as the backlog grows, so the
+// delay per write grows smoothly instead of jumping from 0 to a stall.
+//
+// Not thread-safe: the DB calls it with its mutex held.
+
+#ifndef STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+#define STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+
+#include <cstdint>
+
+namespace leveldb {
+
+class WriteController {
+ public:
+  // "max_rate" is the write rate (in bytes per second) allowed when writes
+  // first start being delayed and no compaction throughput has been
+  // measured yet.  Measured rates are never allowed to exceed it.
+  explicit WriteController(uint64_t max_rate);
+
+  WriteController(const WriteController&) = delete;
+  WriteController& operator=(const WriteController&) = delete;
+
+  // Recompute whether writes must be delayed, and at what rate, from the
+  // number of level-0 files and the estimated number of bytes that must be
+  // compacted before the tree is back within its size targets.
+  void Update(int level0_files, uint64_t pending_compaction_bytes);
+
+  // Record that a compaction (or memtable flush) wrote "bytes" in "micros".
+  void RecordCompaction(uint64_t bytes, uint64_t micros);
+
+  // Returns the number of microseconds a write of "bytes" issued at time
+  // "now_micros" should be delayed.  Consumes the corresponding tokens.
+  uint64_t GetDelay(uint64_t now_micros, uint64_t bytes);
+
+  // Record time spent with writes blocked, whether delayed or stopped.
+  void AddStallMicros(uint64_t micros) { stall_micros_ += micros; }
+
+  bool IsDelayed() const { return delayed_; }
+
+  // Current delayed write rate in bytes per second, or 0 if writes are not
+  // being delayed.
+  uint64_t delayed_write_rate() const { return delayed_ ? rate_ : 0; }
+
+  // Total time writers have been blocked by delays and stops.
+  uint64_t stall_micros() const { return stall_micros_; }
+
+ private:
+  const uint64_t max_rate_;
+  bool delayed_;
+  uint64_t rate_;                   // Bytes per second while delayed
+  uint64_t compaction_rate_;        // Smoothed compaction output rate
+  uint64_t next_write_micros_;      // Time at which the bucket is empty
+  uint64_t stall_micros_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
@@ -0,0 +1,79 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include "gtest/gtest.h"
+#include "db/dbformat.h"
+
+namespace leveldb {
+
+static const uint64_t kMB = 1024 * 1024;
+
+TEST(WriteControllerTest, NoDelayBelowTriggers) {
+  WriteController controller(16 * kMB);
+  controller.Update(config::kL0_SlowdownWritesTrigger - 1, 0);
+  ASSERT_FALSE(controller.IsDelayed());
+  ASSERT_EQ(0, controller.delayed_write_rate());
+  ASSERT_EQ(0, controller.GetDelay(1000000, kMB));
+}
+
+TEST(WriteControllerTest, PacesAtRate) {
+  WriteController controller(kMB);
+  controller.Update(config::kL0_SlowdownWritesTrigger, 0);
+  ASSERT_TRUE(controller.IsDelayed());
+  ASSERT_EQ(kMB, controller.delayed_write_rate());
+
+  // Each 1KB write at 1MB/s needs ~977us of tokens.  The first one is
+  // covered by the burst allowance; later ones queue up behind it.
+  const uint64_t now = 1000000;
+  uint64_t delay = 0;
+  for (int i = 0; i < 100; i++) {
+    delay = controller.GetDelay(now, 1024);
+  }
+  ASSERT_GE(delay, 95000);
+  ASSERT_LE(delay, 100000);
+
+  // Once time catches up, writes flow without delay again.
+  ASSERT_EQ(0, controller.GetDelay(now + 200000, 1024));
+}
+
+TEST(WriteControllerTest, RateShrinksWithBacklog) {
+  WriteController controller(16 * kMB);
+  controller.Update(config::kL0_SlowdownWritesTrigger, 0);
+  const uint64_t base = controller.delayed_write_rate();
+  controller.Update(config::kL0_SlowdownWritesTrigger + 2, 0);
+  ASSERT_EQ(base / 4, controller.delayed_write_rate());
+
+  controller.Update(0, 2 * config::kSoftPendingCompactionBytesLimit);
+  ASSERT_TRUE(controller.IsDelayed());
+  ASSERT_EQ(base / 2, controller.delayed_write_rate());
+
+  controller.Update(0, 0);
+  ASSERT_FALSE(controller.IsDelayed());
+}
+
+TEST(WriteControllerTest, FollowsCompactionThroughput) {
+  WriteController controller(16 * kMB);
+  controller.RecordCompaction(4 * kMB, 1000000);
+  controller.Update(config::kL0_SlowdownWritesTrigger, 0);
+  ASSERT_EQ(4 * kMB, controller.delayed_write_rate());
+
+  // Throughput above the configured maximum is ignored.
+  for (int i = 0; i < 20; i++) {
+    controller.RecordCompaction(100 * kMB, 1000000);
+  }
+  controller.Update(config::kL0_SlowdownWritesTrigger, 0);
+  ASSERT_EQ(16 * kMB, controller.delayed_write_rate());
+}
+
+TEST(WriteControllerTest, StallMicros) {
+  WriteController controller(16 * kMB);
+  ASSERT_EQ(0, controller.stall_micros());
+  controller.AddStallMicros(10);
+  controller.AddStallMicros(5);
+  ASSERT_EQ(15, controller.stall_micros());
+}
+
+}  // namespace leveldb
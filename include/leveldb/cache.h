@@ -10,10 +10,11 @@
 // length strings, may use the length of the string as the charge for
 // the string.
 //
-// A builtin cache implementation with a least-recently-used eviction
-// policy is provided.  Clients may use their own implementations if
-// they want something more sophisticated (like scan-resistance, a
-// custom eviction policy, variable cache sizing, etc.)
+// Builtin cache implementations with a least-recently-used eviction
+// policy and with a scan-resistant CLOCK eviction policy are provided.
+// Clients may use their own implementations if they want something more
+// sophisticated (like a custom eviction policy, variable cache sizing,
+// etc.)
 
 #ifndef STORAGE_LEVELDB_INCLUDE_CACHE_H_
 #define STORAGE_LEVELDB_INCLUDE_CACHE_H_
@@ -31,6 +32,18 @@ class LEVELDB_EXPORT Cache;
 // of Cache uses a least-recently-used eviction policy.
 LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity);
 
+// Create a new cache with a fixed size capacity that uses a CLOCK
+// eviction policy.  Lookups that hit take no locks, so reads scale with
+// the number of threads, and entries that are only touched once (as in a
+// long scan) are evicted before entries that are hit repeatedly.
+//
+// The cache keeps its entries in a fixed-size table sized for entries of
+// about "estimated_entry_charge": use the block size for a block cache,
+// or 1 if every entry is charged 1.  Much smaller entries make the cache
+// evict before it reaches its capacity.
+LEVELDB_EXPORT Cache* NewClockCache(size_t capacity,
+                                    size_t estimated_entry_charge);
+
 class LEVELDB_EXPORT Cache {
  public:
   Cache() = default;
@@ -53,7 +66,9 @@ class LEVELDB_EXPORT Cache {
   // longer needed.
   //
   // When the inserted entry is no longer needed, the key and
-  // value will be passed to "deleter".
+  // value will be passed to "deleter".  The caches created by
+  // NewLRUCache() and NewClockCache() call "deleter" without holding
+  // any lock of their own.
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                          void (*deleter)(const Slice& key, void* value)) = 0;
 
@@ -7,10 +7,13 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <string>
+#include <vector>
 
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/table_properties.h"
 
 namespace leveldb {
 
@@ -72,6 +75,15 @@ class LEVELDB_EXPORT DB {
   // Note: consider setting options.sync = true.
   virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+  // Remove the database entries (if any) for the keys in
+  // ["begin_key", "end_key").  Returns OK on success, and a non-OK status
+  // on error.  The deletion is stored as a single range tombstone, whatever
+  // the number of keys it removes, and compactions drop the entries it
+  // covers.  The default implementation writes a batch holding the range.
+  // Note: consider setting options.sync = true.
+  virtual Status DeleteRange(const WriteOptions& options,
+                             const Slice& begin_key, const Slice& end_key);
+
   // Apply the specified updates to the database.
   // Returns OK on success, non-OK on failure.
   // Note: consider setting options.sync = true.
@@ -87,6 +99,16 @@ class LEVELDB_EXPORT DB {
   virtual Status Get(const ReadOptions& options, const Slice& key,
                      std::string* value) = 0;
 
+  // Look up each of "keys" as Get() would, all at the same snapshot.
+  // Resizes *values to keys.size() and stores the value of keys[i] in
+  // (*values)[i].  Returns the status of each lookup, in the same order.
+  //
+  // Prefer this to a loop of Get() calls when reading many keys at once:
+  // the implementation can probe each table once for all of them.
+  virtual std::vector<Status> MultiGet(const ReadOptions& options,
+                                       const std::vector<Slice>& keys,
+                                       std::vector<std::string>* values);
+
   // Return a heap-allocated iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -121,6 +143,14 @@ class LEVELDB_EXPORT DB {
   //     of the sstables that make up the db contents.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
+  //  "leveldb.num-immutable-memtables" - returns the number of full write
+  //     buffers waiting to be flushed.
+  //  "leveldb.delayed-write-rate" - returns the rate (in bytes per second)
+  //     writes are currently paced at, or 0 if writes are not being delayed.
+  //  "leveldb.write-stall-micros" - returns the total time writes have
+  //     spent delayed or stopped waiting for compactions.
+  //  "leveldb.write-amplification" - returns the bytes written to tables by
+  //     memtable flushes and compactions divided by the bytes flushed.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
   // For each i in [0,n-1], store in "sizes[i]", the approximate
@@ -134,6 +164,22 @@ class LEVELDB_EXPORT DB {
   virtual void GetApproximateSizes(const Range* range, int n,
                                    uint64_t* sizes) = 0;
 
+  // Store in "*props" the properties of every table file in the database,
+  // keyed by file name, without scanning their contents.  Files written
+  // before properties were recorded are left out.  The default
+  // implementation returns NotSupported.
+  virtual Status GetPropertiesOfAllTables(TablePropertiesCollection* props);
+
+  // Add the table files named in "files", written by SstFileWriter with
+  // the same comparator, key_length and value_length as the database, to
+  // the database.  The keys of every file are given a single new sequence
+  // number, so they replace earlier values of the same keys, and each
+  // file goes to the deepest level whose key range it can join without
+  // overlapping newer data.  The files must not overlap each other.
+  // Writes wait until the ingestion has finished.  The files themselves
+  // are left in place.  The default implementation returns NotSupported.
+  virtual Status IngestExternalFile(const std::vector<std::string>& files);
+
   // Compact the underlying storage for the key range [*begin,*end].
   // In particular, deleted and overwritten versions are discarded,
   // and the data is rearranged to reduce the cost of operations
@@ -19,6 +19,7 @@
 #include <vector>
 
 #include "leveldb/export.h"
+#include "leveldb/slice.h"
 #include "leveldb/status.h"
 
 // This workaround can be removed when leveldb::Env::DeleteFile is removed.
@@ -45,7 +46,6 @@ class FileLock;
 class Logger;
 class RandomAccessFile;
 class SequentialFile;
-class Slice;
 class WritableFile;
 
 class LEVELDB_EXPORT Env {
@@ -110,6 +110,20 @@ class LEVELDB_EXPORT Env {
   virtual Status NewAppendableFile(const std::string& fname,
                                    WritableFile** result);
 
+  // Like NewRandomAccessFile(), but the returned file reads with direct
+  // I/O (e.g. O_DIRECT), bypassing the operating system's page cache.
+  // The default implementation, used by Envs without direct I/O, returns
+  // NewRandomAccessFile().
+  virtual Status NewDirectRandomAccessFile(const std::string& fname,
+                                           RandomAccessFile** result);
+
+  // Like NewWritableFile(), but the returned file writes with direct I/O
+  // (e.g. O_DIRECT), bypassing the operating system's page cache.  The
+  // default implementation, used by Envs without direct I/O, returns
+  // NewWritableFile().
+  virtual Status NewDirectWritableFile(const std::string& fname,
+                                       WritableFile** result);
+
   // Returns true iff the named file exists.
   virtual bool FileExists(const std::string& fname) = 0;
 
@@ -269,6 +283,26 @@ class LEVELDB_EXPORT RandomAccessFile {
   // Safe for concurrent use by multiple threads.
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       char* scratch) const = 0;
+
+  // One read of a MultiRead() batch.  The caller fills in "offset", "n"
+  // and "scratch"; MultiRead() sets "result" and "status" as Read() would.
+  struct ReadRequest {
+    uint64_t offset;
+    size_t n;
+    char* scratch;
+    Slice result;
+    Status status;
+  };
+
+  // Perform the reads in reqs[0..num-1].  Implementations may submit them
+  // to the device together rather than one after another, which lets
+  // devices with deep queues serve them in parallel.  The outcome of each
+  // read is reported in its request.
+  //
+  // The default implementation calls Read() for each request in turn.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual void MultiRead(ReadRequest* reqs, size_t num) const;
 };
 
 // A file abstraction for sequential writing.  The implementation
@@ -287,6 +321,15 @@ class LEVELDB_EXPORT WritableFile {
   virtual Status Close() = 0;
   virtual Status Flush() = 0;
   virtual Status Sync() = 0;
+
+  // Make durable the data handed to the operating system by earlier
+  // Flush() calls, without touching data still buffered in this object.
+  // Unlike the other methods, this may be called from one thread while
+  // another thread is calling Append() or Flush(), which lets a
+  // dedicated thread sync a log file that is still being appended to.
+  //
+  // The default implementation returns a NotSupported error.
+  virtual Status SyncFlushed();
 };
 
 // An interface for writing log messages.
@@ -355,6 +398,14 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
   Status NewAppendableFile(const std::string& f, WritableFile** r) override {
     return target_->NewAppendableFile(f, r);
   }
+  Status NewDirectRandomAccessFile(const std::string& f,
+                                   RandomAccessFile** r) override {
+    return target_->NewDirectRandomAccessFile(f, r);
+  }
+  Status NewDirectWritableFile(const std::string& f,
+                               WritableFile** r) override {
+    return target_->NewDirectWritableFile(f, r);
+  }
   bool FileExists(const std::string& f) override {
     return target_->FileExists(f);
   }
@@ -47,6 +47,12 @@ class LEVELDB_EXPORT Iterator {
   // an entry that comes at or past target.
   virtual void Seek(const Slice& target) = 0;
 
+  // Like Seek(), for a caller that only wants the entries sharing the
+  // prefix of target (see ReadOptions::prefix_same_as_start): sources
+  // whose filters rule that prefix out may be skipped.  The default
+  // implementation is Seek(target).
+  virtual void SeekForPrefix(const Slice& target) { Seek(target); }
+
   // Moves to the next entry in the source.  After this call, Valid() is
   // true iff the iterator was not positioned at the last entry in the source.
   // REQUIRES: Valid()
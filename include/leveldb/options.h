@@ -16,6 +16,8 @@ class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class Slice;
+class SliceTransform;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -30,6 +32,19 @@ enum CompressionType {
   kZstdCompression = 0x2,
 };
 
+// How tables are compacted, see Options::compaction_style.
+enum CompactionStyle {
+  kCompactionStyleLevel = 0x0,
+  kCompactionStyleUniversal = 0x1,
+};
+
+// Which file of a level is compacted next, see Options::compaction_pri.
+enum CompactionPri {
+  kCompactPointerPri = 0x0,
+  kMinOverlappingRatioPri = 0x1,
+  kTombstoneDensityPri = 0x2,
+};
+
 // Options to control the behavior of a database (passed to DB::Open)
 struct LEVELDB_EXPORT Options {
   // Create an Options object with default values for all fields.
@@ -76,17 +91,47 @@ struct LEVELDB_EXPORT Options {
   // on disk) before converting to a sorted on-disk file.
   //
   // Larger values increase performance, especially during bulk loads.
-  // Up to two write buffers may be held in memory at the same time,
-  // so you may wish to adjust this parameter to control memory usage.
-  // Also, a larger write buffer will result in a longer recovery time
-  // the next time the database is opened.
+  // Up to max_write_buffer_number write buffers may be held in memory at
+  // the same time, so you may wish to adjust this parameter to control
+  // memory usage.  Also, a larger write buffer will result in a longer
+  // recovery time the next time the database is opened.
   size_t write_buffer_size = 4 * 1024 * 1024;
 
+  // Maximum number of write buffers held in memory, counting the one being
+  // written to and the full ones waiting to be flushed.  Writes stall when
+  // the current buffer fills up while this many are in memory.  Raising it
+  // lets bursty writers ride out slow flushes; all buffers waiting at the
+  // same time are flushed together into a single level-0 file.
+  int max_write_buffer_number = 2;
+
+  // If true, memtable memory is carved from 2MB regions instead of many
+  // small heap blocks.  Regions are backed by huge pages when the system
+  // has them reserved (or by transparent huge pages otherwise), are placed
+  // on the NUMA node of the writing thread, and are recycled across
+  // memtables rather than returned to the system.  This reduces TLB misses
+  // during skiplist traversal and allocator contention on write-heavy
+  // workloads, at the cost of holding on to freed memtable memory.
+  bool memtable_huge_pages = false;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
   int max_open_files = 1000;
 
+  // If true, open tables are cached in a CLOCK cache (see NewClockCache())
+  // instead of an LRU cache, so that table lookups from many threads do
+  // not contend on a mutex.
+  bool clock_table_cache = false;
+
+  // If positive, DB::Open opens the tables of every level below this value
+  // before it returns, on preload_table_threads threads, so that the first
+  // reads after a restart do not pay for opening them.  E.g. 3 opens the
+  // tables of levels 0 to 2.  No more tables are opened than the table
+  // cache holds.  With paranoid_checks, a table that cannot be opened makes
+  // DB::Open fail.
+  int preload_table_levels = 0;
+  int preload_table_threads = 4;
+
   // Control over blocks (user data is stored in a set of blocks, and
   // a block is the unit of reading from disk).
 
@@ -94,6 +139,47 @@ struct LEVELDB_EXPORT Options {
   // If null, leveldb will automatically create and use an 8MB internal cache.
   Cache* block_cache = nullptr;
 
+  // If non-null, blocks that block_cache evicts move here as they are
+  // stored in the table file, compressed if the file compressed them, and
+  // a block missing from block_cache is rebuilt from this cache, moving
+  // back into block_cache, instead of being read from the file again.
+  // Since compressed blocks are smaller, a given memory budget holds more
+  // of the working set here than in block_cache.  The charge of each entry
+  // is its compressed size.  To move without recompressing, a compressed
+  // block keeps its compressed bytes while in block_cache, and they are
+  // charged there too.
+  //
+  // Blocks of tables that the Env serves straight from memory (e.g. mmap)
+  // are never kept here, since rebuilding them needs no read.  Blocks of
+  // closed tables are not moved either.  This cache is only used together
+  // with a different block_cache, and must outlive it.
+  Cache* compressed_block_cache = nullptr;
+
+  // If true, the index and filter blocks of each table are kept in
+  // block_cache and charged against its capacity, instead of being held
+  // outside of it for as long as the table is open.  This bounds the memory
+  // used by a large number of open tables, at the cost of rereading index
+  // and filter blocks that have been evicted.
+  bool cache_index_and_filter_blocks = false;
+
+  // With cache_index_and_filter_blocks, tables that are opened while they
+  // are at a level below this value keep their index and filter blocks
+  // pinned in block_cache until the table is closed.  E.g. 2 pins them for
+  // level-0 and level-1 tables, which are consulted most often.
+  int pin_index_and_filter_levels = 0;
+
+  // If true, tables are read with direct I/O (see
+  // Env::NewDirectRandomAccessFile()), so that their blocks are cached in
+  // block_cache only rather than also in the operating system's page cache.
+  // Size block_cache accordingly, since reads it misses go to storage.
+  bool use_direct_reads = false;
+
+  // If true, the tables written by memtable flushes and compactions are
+  // written with direct I/O (see Env::NewDirectWritableFile()), so that
+  // background writes do not evict the working set from the operating
+  // system's page cache.
+  bool use_direct_io_for_flush_and_compaction = false;
+
   // Approximate size of user data packed per block.  Note that the
   // block size specified here corresponds to uncompressed data.  The
   // actual size of the unit read from disk may be smaller if
@@ -109,6 +195,13 @@ struct LEVELDB_EXPORT Options {
   int key_length = 64;
   int value_length = 64;
 
+  // Once compactions fall behind (too many level-0 files, or too many
+  // bytes waiting to be compacted), writes are paced by a token bucket
+  // instead of proceeding at full speed until they hit a hard stop.  The
+  // pacing rate follows the measured compaction throughput and shrinks as
+  // the backlog grows, but never exceeds this many bytes per second.
+  size_t delayed_write_rate = 16 * 1024 * 1024;
+
   // Leveldb will write up to this amount of bytes to a file before
   // switching to a new one.
   // Most clients should leave this parameter alone.  However if your
@@ -119,6 +212,67 @@ struct LEVELDB_EXPORT Options {
   // initially populating a large database.
   size_t max_file_size = 2 * 1024 * 1024;
 
+  // Level-1 is compacted into level-2 once it holds more than
+  // max_bytes_for_level_base bytes, and every level after it may hold
+  // max_bytes_for_level_multiplier times as much as the one before.
+  size_t max_bytes_for_level_base = 10 * 1024 * 1024;
+  double max_bytes_for_level_multiplier = 10;
+
+  // If true, the level sizes are instead derived from the size of the
+  // largest level, which is kept at the bottom: each level above it aims at
+  // 1/max_bytes_for_level_multiplier of the level below, down to
+  // max_bytes_for_level_base.  Level-0 is compacted straight into the first
+  // level with such a target, and the levels above that stay empty.  The
+  // ratio between adjacent levels, and so the write amplification, then
+  // stays the same however large or small the database is.  Memtables are
+  // always flushed to level-0 in this mode.
+  bool level_compaction_dynamic_level_bytes = false;
+
+  // kCompactionStyleLevel keeps every level after level-0 a single sorted
+  // run within its target size, so each byte is rewritten about
+  // max_bytes_for_level_multiplier times per level.
+  //
+  // kCompactionStyleUniversal treats every level-0 file and every non-empty
+  // level as a sorted run, and only merges runs of similar size with each
+  // other.  Each byte is rewritten far fewer times, at the cost of more
+  // runs to search on reads and of space held by overwritten data until
+  // the runs holding it are merged.  The level sizes above do not apply.
+  CompactionStyle compaction_style = kCompactionStyleLevel;
+
+  // Universal compaction: runs are merged once level-0 holds four files.
+  // A run joins the runs newer than it if it is at most
+  // universal_size_ratio percent larger than their total size, and at
+  // least universal_min_merge_width runs must be found to merge them.
+  int universal_size_ratio = 1;
+  int universal_min_merge_width = 2;
+
+  // Universal compaction: once the runs other than the oldest hold more
+  // than this percentage of the size of the oldest, all runs are merged
+  // into one.  This bounds the space overwritten data can take.
+  int universal_max_size_amplification_percent = 200;
+
+  // Once a level is picked for compaction because it is too large, one of
+  // its files is moved into the next level.
+  //
+  // kCompactPointerPri takes the files of the level in key order, wrapping
+  // around at the end.
+  //
+  // kMinOverlappingRatioPri takes the file that overlaps the fewest bytes
+  // of the next level per byte of its own, so each compaction rewrites as
+  // little of the next level as possible.
+  //
+  // kTombstoneDensityPri takes the file with the largest share of deletion
+  // markers, so that the space of deleted keys is reclaimed first, and
+  // falls back to kMinOverlappingRatioPri among files without any.
+  CompactionPri compaction_pri = kCompactPointerPri;
+
+  // If true, every Version models where the keys of each level (other than
+  // level-0) fall with a small learned index, which finds the file that may
+  // hold a key in a few comparisons instead of a binary search over the
+  // level.  Works best when keys are spread evenly, and on levels of many
+  // files.  Ignored unless comparator is BytewiseComparator().
+  bool learned_file_index = false;
+
   // Compress blocks using the specified compression algorithm.  This
   // parameter can be changed dynamically.
   //
@@ -141,12 +295,47 @@ struct LEVELDB_EXPORT Options {
   // Default: currently false, but may become true later.
   bool reuse_logs = false;
 
+  // Once the MANIFEST, which logs every change to the set of table files,
+  // grows past this many bytes, a new one is started from a snapshot of
+  // the current files.  This bounds the time DB::Open takes to replay it
+  // for a database that stays open for a long time.
+  size_t max_manifest_file_size = 4 * 1024 * 1024;
+
+  // If true, log syncs requested by WriteOptions::sync are performed by a
+  // dedicated background thread instead of by the writer holding the write
+  // queue.  Consecutive write groups that ask for a sync are covered by a
+  // single fdatasync, and later groups keep appending to the log while a
+  // sync is in progress.  A synced write still does not return until the
+  // log record holding it is durable.
+  //
+  // REQUIRES: the Env's log files implement WritableFile::SyncFlushed().
+  // DB::Open() returns an InvalidArgument error if they do not.
+  bool background_wal_sync = false;
+
+  // If true, consecutive Puts of a write group whose keys and values have
+  // the same widths are logged as one fixed-width run, which stores the
+  // widths once per run instead of once per entry.
+  //
+  // This changes the log format one way: releases that predate it report
+  // a corruption for logs holding such runs, so a database that was not
+  // cleanly closed cannot be reopened by them.
+  bool pack_fixed_width_writes = false;
+
   // If non-null, use the specified filter policy to reduce disk reads.
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
   const FilterPolicy* filter_policy = nullptr;
 
-  
+  // If non-null (and filter_policy is non-null), the prefix of every user
+  // key in the domain of this transformation is added to the filters next
+  // to the key itself.  Iterators opened with
+  // ReadOptions::prefix_same_as_start then skip the table files and blocks
+  // whose filters do not contain the prefix they seek to.
+  //
+  // Filters built with a prefix extractor are only used by databases
+  // opened with the same extractor; table files written without it, or
+  // with a different one, are read as if they had no filter.
+  const SliceTransform* prefix_extractor = nullptr;
 };
 
 // Options that control read operations
@@ -164,6 +353,35 @@ struct LEVELDB_EXPORT ReadOptions {
   // not have been released).  If "snapshot" is null, use an implicit
   // snapshot of the state at the beginning of this read operation.
   const Snapshot* snapshot = nullptr;
+
+  // If non-null, iterators only return keys that are no less than
+  // "*iterate_lower_bound", and Seek() to an earlier key moves to the
+  // bound.  Table files and blocks that lie wholly before the bound are not
+  // read when iterating backwards.  The bound is copied when the iterator
+  // is created.  Ignored by Get().
+  const Slice* iterate_lower_bound = nullptr;
+
+  // If non-null, iterators only return keys that are less than
+  // "*iterate_upper_bound", and stop as soon as they reach it instead of
+  // going on to read the table files and blocks that follow.  The bound is
+  // copied when the iterator is created.  Ignored by Get().
+  const Slice* iterate_upper_bound = nullptr;
+
+  // If true, and the database has a prefix_extractor, an iterator positioned
+  // by Seek(target) only returns keys with the same prefix as "target", and
+  // skips the table files and blocks whose filters exclude that prefix.
+  // The iterator becomes invalid once it moves past the prefix.  Has no
+  // effect after SeekToFirst() and SeekToLast(), or when "target" is
+  // outside the extractor's domain.  Ignored by Get().
+  bool prefix_same_as_start = false;
+
+  // Number of bytes an iterator reads ahead of its position in a table
+  // once it moves through the table sequentially, so that long scans issue
+  // a few large reads instead of one read per block.  Zero selects
+  // automatic readahead, which starts after a few consecutive block reads
+  // and grows to 256KB.  Tables that the Env serves from memory (e.g. via
+  // mmap) are never read ahead.
+  size_t readahead_size = 0;
 };
 
 // Options that control write operations
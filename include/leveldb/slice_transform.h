@@ -0,0 +1,52 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A SliceTransform maps a user key to a shorter key, such as its prefix.
+// A database configured with Options::prefix_extractor adds the prefix of
+// every key to its filters, so that iterators opened with
+// ReadOptions::prefix_same_as_start can skip the table files and blocks
+// that hold no key with the prefix they seek to.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+#define STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT SliceTransform {
+ public:
+  virtual ~SliceTransform();
+
+  // Return the name of this transformation.  It is recorded with the
+  // filters built using the transformation, so the name must change if the
+  // transformation changes in an incompatible way.
+  virtual const char* Name() const = 0;
+
+  // Return the prefix of "key".
+  // REQUIRES: InDomain(key)
+  virtual Slice Transform(const Slice& key) const = 0;
+
+  // Return true iff "key" has a prefix.  Keys outside the domain are not
+  // indexed by prefix and do not enable prefix filtering when sought to.
+  //
+  // For a given comparator, all keys with the same prefix must form one
+  // contiguous range of the key space.
+  virtual bool InDomain(const Slice& key) const = 0;
+};
+
+// Return a new transformation that maps each key of at least "prefix_len"
+// bytes to its first "prefix_len" bytes.  This suits the default bytewise
+// comparator, and the fixed-width keys of a table file, where a prefix
+// is a leading byte range of every key.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const SliceTransform* NewFixedPrefixTransform(
+    size_t prefix_len);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
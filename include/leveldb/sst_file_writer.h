@@ -0,0 +1,58 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// SstFileWriter writes a sorted table file outside of any database, which
+// DB::IngestExternalFile() can then add to a database opened with the same
+// options.  This loads data without passing it through the log, the
+// memtable and the compactions that writes normally go through.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+#define STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/export.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT SstFileWriter {
+ public:
+  // "options" must agree with the options of the database the file is
+  // ingested into on comparator, key_length and value_length.
+  explicit SstFileWriter(const Options& options);
+
+  SstFileWriter(const SstFileWriter&) = delete;
+  SstFileWriter& operator=(const SstFileWriter&) = delete;
+
+  ~SstFileWriter();
+
+  // Create the file "fname" and start writing to it.
+  Status Open(const std::string& fname);
+
+  // Add "key" with "value", or a deletion of "key", to the file.  Keys
+  // must be added in increasing order, each at most once, and must be
+  // options.key_length - 8 bytes long; values must be options.value_length
+  // bytes long.
+  Status Put(const Slice& key, const Slice& value);
+  Status Delete(const Slice& key);
+
+  // Finish the file and close it.  Stores its size in *file_size if that
+  // is non-null.
+  Status Finish(uint64_t* file_size = nullptr);
+
+ private:
+  struct Rep;
+
+  Status Add(const Slice& key, const Slice& value, bool deletion);
+
+  Rep* rep_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
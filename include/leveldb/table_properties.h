@@ -0,0 +1,57 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// TableProperties summarizes the contents of a table file.  They are
+// computed while the table is built and stored in a meta block of the
+// file, so they can be read without scanning its data.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_TABLE_PROPERTIES_H_
+#define STORAGE_LEVELDB_INCLUDE_TABLE_PROPERTIES_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+struct LEVELDB_EXPORT TableProperties {
+  // Number of entries in the table, including deletion markers.
+  uint64_t num_entries = 0;
+
+  // Number of deletion markers in the table.
+  uint64_t num_deletions = 0;
+
+  // Number of range tombstones in the table.  They are not entries.
+  uint64_t num_range_deletions = 0;
+
+  // Total size of the keys and of the values added to the table, before
+  // any padding or compression.
+  uint64_t raw_key_size = 0;
+  uint64_t raw_value_size = 0;
+
+  // Total size of the data blocks as stored in the file, after any
+  // compression, and their number.
+  uint64_t data_size = 0;
+  uint64_t num_data_blocks = 0;
+
+  // Width of every key and of every value in the data blocks.
+  uint64_t key_length = 0;
+  uint64_t value_length = 0;
+
+  // Smallest and largest sequence number of the entries.
+  uint64_t smallest_seqno = 0;
+  uint64_t largest_seqno = 0;
+
+  // Time the table was written, in seconds since the epoch.
+  uint64_t creation_time = 0;
+};
+
+// Properties of table files, keyed by file name.
+typedef std::map<std::string, TableProperties> TablePropertiesCollection;
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_TABLE_PROPERTIES_H_
@@ -37,6 +37,9 @@ class LEVELDB_EXPORT WriteBatch {
     virtual ~Handler();
     virtual void Put(const Slice& key, const Slice& value) = 0;
     virtual void Delete(const Slice& key) = 0;
+    // Called for a DeleteRange() record.  The default implementation
+    // ignores the record.
+    virtual void DeleteRange(const Slice& begin_key, const Slice& end_key);
   };
 
   WriteBatch();
@@ -53,6 +56,10 @@ class LEVELDB_EXPORT WriteBatch {
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   void Delete(const Slice& key);
 
+  // Erase every mapping whose key is in ["begin_key", "end_key"), as
+  // ordered by the comparator of the database the batch is written to.
+  void DeleteRange(const Slice& begin_key, const Slice& end_key);
+
   // Clear all updates buffered in this batch.
   void Clear();
 
@@ -75,7 +82,15 @@ class LEVELDB_EXPORT WriteBatch {
  private:
   friend class WriteBatchInternal;
 
+  // Appends a Put record without counting it, packing it into the trailing
+  // fixed-width run when the key and value widths allow it.
+  void AddPut(const Slice& key, const Slice& value);
+
   std::string rep_;  // See comment in write_batch.cc for the format of rep_
+
+  // Offset in rep_ of the last record, or 0 if unknown.  Used to extend a
+  // trailing fixed-width run in place.
+  size_t last_record_;
 };
 
 }  // namespace leveldb
@@ -4,11 +4,17 @@
 
 #include "merge_test/fix_table.h"
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "db/dbformat.h"
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -17,27 +23,223 @@
 #include "merge_test/fix_block.h"
 
 namespace leveldb {
+
+namespace {
+
+// Automatic readahead, see ReadOptions::readahead_size.
+const size_t kInitialReadahead = 8 * 1024;
+const size_t kMaxReadahead = 256 * 1024;
+const int kMinSequentialReads = 2;
+
+// Serves the data block reads of one iterator, reading ahead of them once
+// they turn out to be sequential.
+//
+// Not thread-safe, since an iterator is only used by one thread at a time.
+class ReadaheadFile final : public RandomAccessFile {
+ public:
+  // Reads ahead "readahead_size" bytes at a time or, if zero, an amount
+  // that grows from kInitialReadahead to kMaxReadahead once
+  // kMinSequentialReads sequential reads have been seen.  Never reads past
+  // "file_size", which some files reject.
+  ReadaheadFile(RandomAccessFile* file, uint64_t file_size,
+                size_t readahead_size)
+      : file_(file),
+        file_size_(file_size),
+        fixed_readahead_(readahead_size),
+        buf_capacity_(0),
+        buf_offset_(0),
+        buf_size_(0),
+        next_offset_(0),
+        sequential_reads_(0),
+        readahead_(kInitialReadahead),
+        in_memory_(false) {}
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    if (in_memory_) {
+      return file_->Read(offset, n, result, scratch);
+    }
+    if (offset >= buf_offset_ && offset + n <= buf_offset_ + buf_size_) {
+      std::memcpy(scratch, buf_.get() + (offset - buf_offset_), n);
+      *result = Slice(scratch, n);
+      next_offset_ = offset + n;
+      return Status::OK();
+    }
+
+    if (offset == next_offset_) {
+      sequential_reads_++;
+    } else {
+      sequential_reads_ = 0;
+      readahead_ = kInitialReadahead;
+    }
+    next_offset_ = offset + n;
+    size_t size = fixed_readahead_;
+    if (size == 0 && sequential_reads_ >= kMinSequentialReads) {
+      size = readahead_;
+      readahead_ = std::min(2 * readahead_, kMaxReadahead);
+    }
+    if (offset < file_size_) {
+      size = std::min<uint64_t>(size, file_size_ - offset);
+    }
+    if (size <= n) {
+      return file_->Read(offset, n, result, scratch);
+    }
+
+    if (buf_capacity_ < size) {
+      buf_.reset(new char[size]);
+      buf_capacity_ = size;
+    }
+    buf_size_ = 0;
+    Slice data;
+    Status s = file_->Read(offset, size, &data, buf_.get());
+    if (!s.ok()) {
+      return s;
+    }
+    if (data.data() != buf_.get()) {
+      // The file hands out its contents directly, so copying them through
+      // a buffer would only cost time.
+      in_memory_ = true;
+      *result = Slice(data.data(), std::min(n, data.size()));
+      return Status::OK();
+    }
+    buf_offset_ = offset;
+    buf_size_ = data.size();
+    const size_t available = std::min(n, buf_size_);  // Short at end of file
+    std::memcpy(scratch, buf_.get(), available);
+    *result = Slice(scratch, available);
+    return Status::OK();
+  }
+
+ private:
+  RandomAccessFile* const file_;
+  const uint64_t file_size_;
+  const size_t fixed_readahead_;
+
+  // buf_[0, buf_size_ - 1] holds the file's contents at buf_offset_.
+  mutable std::unique_ptr<char[]> buf_;
+  mutable size_t buf_capacity_;
+  mutable uint64_t buf_offset_;
+  mutable size_t buf_size_;
+
+  mutable uint64_t next_offset_;  // Where a sequential read would start
+  mutable int sequential_reads_;
+  mutable size_t readahead_;
+  mutable bool in_memory_;  // If true, reads go straight to file_
+};
+
+}  // namespace
+
 struct FixTable::Rep {
   ~Rep() {
-    delete filter;
-    delete[] filter_data;
-    delete index_block;
+    if (filter_cache_handle != nullptr) {
+      options.block_cache->Release(filter_cache_handle);
+    } else {
+      delete filter;
+      delete[] filter_data;
+    }
+    if (index_cache_handle != nullptr) {
+      options.block_cache->Release(index_cache_handle);
+    } else {
+      delete index_block;
+    }
+    delete range_del_block;
+    if (raw_tier != nullptr) {
+      raw_tier->Close();
+    }
   }
 
   Options options;
   Status status;
   RandomAccessFile* file;
+  uint64_t file_size;
   uint64_t cache_id;
+  RawBlockTier* raw_tier;  // Null if blocks do not move on eviction
   FilterBlockReader* filter;
   const char* filter_data;
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
   Block* index_block;
+  Block* range_del_block;  // nullptr if the table has no range tombstones
+
+  // Set if the index and filter blocks live in options.block_cache.  Then
+  // index_block and filter are only set while they are pinned, and the
+  // cache handles that pin them are released with the table.
+  bool cache_meta_blocks;
+  BlockHandle index_handle;
+  BlockHandle filter_handle;
+  bool has_filter;
+  Cache::Handle* index_cache_handle;
+  Cache::Handle* filter_cache_handle;
+};
+
+// The block reader argument of an iterator over a FixTable.
+struct FixTable::ScanState {
+  ScanState(const FixTable* t, size_t readahead_size)
+      : table(t), file(t->rep_->file, t->rep_->file_size, readahead_size) {}
+
+  const FixTable* const table;
+  ReadaheadFile file;
 };
 
+// Iterator of a prefix seek, see ReadOptions::prefix_same_as_start.  A
+// SeekForPrefix() to a key whose prefix the table's filter excludes leaves
+// the iterator invalid without reading any data block.  Plain Seek()s, such
+// as those for the iterate bounds or for a change of direction, must see
+// the whole table.
+class FixTable::PrefixSeekIterator : public Iterator {
+ public:
+  PrefixSeekIterator(const FixTable* table, Iterator* iter)
+      : table_(table), iter_(iter), filtered_(false) {}
+
+  ~PrefixSeekIterator() override { delete iter_; }
+
+  bool Valid() const override { return !filtered_ && iter_->Valid(); }
+  void Seek(const Slice& target) override {
+    filtered_ = false;
+    iter_->Seek(target);
+  }
+  void SeekForPrefix(const Slice& target) override {
+    filtered_ = !table_->PrefixMayMatch(target);
+    if (!filtered_) {
+      iter_->Seek(target);
+    }
+  }
+  void SeekToFirst() override {
+    filtered_ = false;
+    iter_->SeekToFirst();
+  }
+  void SeekToLast() override {
+    filtered_ = false;
+    iter_->SeekToLast();
+  }
+  void Next() override {
+    assert(Valid());
+    iter_->Next();
+  }
+  void Prev() override {
+    assert(Valid());
+    iter_->Prev();
+  }
+  Slice key() const override {
+    assert(Valid());
+    return iter_->key();
+  }
+  Slice value() const override {
+    assert(Valid());
+    return iter_->value();
+  }
+  Status status() const override {
+    return filtered_ ? Status::OK() : iter_->status();
+  }
+
+ private:
+  const FixTable* const table_;
+  Iterator* const iter_;
+  bool filtered_;  // Last Seek() target's prefix is not in the table
+};
 
 Status FixTable::Open(const Options& options, RandomAccessFile* file,
-                   uint64_t size, FixTable** fixtable) {
+                   uint64_t size, FixTable** fixtable, bool pin_meta_blocks) {
   *fixtable = nullptr;
   if (size < Footer::kEncodedLength) {
     return Status::Corruption("file is too short to be an sstable");
@@ -53,40 +255,79 @@ Status FixTable::Open(const Options& options, RandomAccessFile* file,
   s = footer.DecodeFrom(&footer_input);
   if (!s.ok()) return s;
 
-  // Read the index block
-  BlockContents index_block_contents;
-  ReadOptions opt;
-  if (options.paranoid_checks) {
-    opt.verify_checksums = true;
+  Rep* rep = new FixTable::Rep;
+  rep->options = options;
+  rep->file = file;
+  rep->file_size = size;
+  rep->metaindex_handle = footer.metaindex_handle();
+  rep->index_block = nullptr;
+  rep->range_del_block = nullptr;
+  rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
+  if (options.block_cache == nullptr ||
+      options.compressed_block_cache == options.block_cache) {
+    // Blocks only reach the compressed cache by leaving the block cache.
+    rep->options.compressed_block_cache = nullptr;
   }
-  s = ReadBlock(file, opt, footer.index_handle(), &index_block_contents);
+  Cache* compressed_cache = rep->options.compressed_block_cache;
+  rep->raw_tier =
+      (compressed_cache
+           ? new RawBlockTier(compressed_cache, compressed_cache->NewId())
+           : nullptr);
+  rep->filter_data = nullptr;
+  rep->filter = nullptr;
+  rep->cache_meta_blocks =
+      options.cache_index_and_filter_blocks && options.block_cache != nullptr;
+  rep->index_handle = footer.index_handle();
+  rep->has_filter = false;
+  rep->index_cache_handle = nullptr;
+  rep->filter_cache_handle = nullptr;
+  FixTable* table = new FixTable(rep);
 
-  if (s.ok()) {
-    // We've successfully read the footer and the index block: we're
-    // ready to serve requests.
-    Block* index_block = new Block(index_block_contents);
-    Rep* rep = new FixTable::Rep;
-    rep->options = options;
-    rep->file = file;
-    rep->metaindex_handle = footer.metaindex_handle();
+  // Read the index block.  When it goes to the block cache, this still
+  // makes Open() fail on an unreadable index and warms the cache.
+  Block* index_block;
+  Cache::Handle* index_cache_handle;
+  s = table->GetIndexBlock(&index_block, &index_cache_handle);
+  if (!s.ok()) {
+    delete table;
+    return s;
+  }
+  if (!rep->cache_meta_blocks) {
     rep->index_block = index_block;
-    rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
-    rep->filter_data = nullptr;
-    rep->filter = nullptr;
-    *fixtable = new FixTable(rep);
-    (*fixtable)->ReadMeta(footer);
+  } else if (pin_meta_blocks) {
+    rep->index_block = index_block;
+    rep->index_cache_handle = index_cache_handle;
+  } else {
+    options.block_cache->Release(index_cache_handle);
   }
 
+  // We've successfully read the footer and the index block: we're
+  // ready to serve requests.
+  table->ReadMeta(footer);
+  if (!rep->status.ok()) {
+    s = rep->status;
+    delete table;
+    return s;
+  }
+  if (rep->cache_meta_blocks) {
+    Cache::Handle* filter_cache_handle;
+    FilterBlockReader* filter = table->GetFilter(&filter_cache_handle);
+    if (filter_cache_handle == nullptr) {
+      // No filter, or it could not be read.
+    } else if (pin_meta_blocks) {
+      rep->filter = filter;
+      rep->filter_cache_handle = filter_cache_handle;
+    } else {
+      options.block_cache->Release(filter_cache_handle);
+    }
+  }
+  *fixtable = table;
   return s;
 }
 
 void FixTable::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
-    return;  // Do not need any metadata
-  }
-
-  // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
-  // it is an empty block.
+  // The metaindex is read even without a filter policy, to find the range
+  // tombstones.
   ReadOptions opt;
   if (rep_->options.paranoid_checks) {
     opt.verify_checksums = true;
@@ -99,22 +340,114 @@ void FixTable::ReadMeta(const Footer& footer) {
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
-  key.append(rep_->options.filter_policy->Name());
-  iter->Seek(key);
-  if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+  if (rep_->options.filter_policy != nullptr) {
+    std::string key = "filter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) {
+      ReadFilter(iter->value());
+    }
+  }
+  iter->Seek(kRangeDelBlock);
+  if (iter->Valid() && iter->key() == Slice(kRangeDelBlock)) {
+    ReadRangeDelBlock(opt, iter->value());
   }
   delete iter;
   delete meta;
 }
 
+void FixTable::ReadRangeDelBlock(const ReadOptions& options,
+                                 const Slice& handle_value) {
+  // Unlike the filter, the tombstones are needed for correct reads, so a
+  // table whose tombstones cannot be read fails to open.
+  Slice v = handle_value;
+  BlockHandle handle;
+  Status s = handle.DecodeFrom(&v);
+  BlockContents contents;
+  if (s.ok()) {
+    s = ReadBlock(rep_->file, options, handle, &contents);
+  }
+  if (s.ok()) {
+    rep_->range_del_block = new Block(contents);
+  } else {
+    rep_->status = s;
+  }
+}
+
+Iterator* FixTable::NewRangeTombstoneIterator() const {
+  if (rep_->range_del_block == nullptr) {
+    return NewEmptyIterator();
+  }
+  return rep_->range_del_block->NewIterator(rep_->options.comparator);
+}
+
+Status FixTable::ReadProperties(TableProperties* props) const {
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  BlockContents contents;
+  Status s = ReadBlock(rep_->file, opt, rep_->metaindex_handle, &contents);
+  if (!s.ok()) {
+    return s;
+  }
+  Block meta(contents);
+  Iterator* iter = meta.NewIterator(BytewiseComparator());
+  iter->Seek(kPropertiesBlock);
+  BlockHandle handle;
+  if (!iter->Valid() || iter->key() != Slice(kPropertiesBlock)) {
+    s = Status::NotFound("no table properties");
+  } else {
+    Slice v = iter->value();
+    s = handle.DecodeFrom(&v);
+  }
+  delete iter;
+  if (!s.ok()) {
+    return s;
+  }
+
+  s = ReadBlock(rep_->file, opt, handle, &contents);
+  if (!s.ok()) {
+    return s;
+  }
+  Block block(contents);
+  iter = block.NewIterator(BytewiseComparator());
+  *props = TableProperties();
+  // Names this version does not know are skipped, so that properties can
+  // be added without breaking older readers.
+  int i = 0;
+  for (iter->SeekToFirst(); iter->Valid() && s.ok(); iter->Next()) {
+    while (i < kNumTablePropertyFields &&
+           iter->key().compare(kTablePropertyFields[i].name) > 0) {
+      i++;
+    }
+    if (i < kNumTablePropertyFields &&
+        iter->key() == Slice(kTablePropertyFields[i].name)) {
+      Slice v = iter->value();
+      if (!GetVarint64(&v, &(props->*kTablePropertyFields[i].field))) {
+        s = Status::Corruption("bad table property", iter->key());
+      }
+    }
+  }
+  if (s.ok()) {
+    s = iter->status();
+  }
+  delete iter;
+  return s;
+}
+
 void FixTable::ReadFilter(const Slice& filter_handle_value) {
   Slice v = filter_handle_value;
   BlockHandle filter_handle;
   if (!filter_handle.DecodeFrom(&v).ok()) {
     return;
   }
+  if (rep_->cache_meta_blocks) {
+    // Read on demand through the block cache; see GetFilter().
+    rep_->filter_handle = filter_handle;
+    rep_->has_filter = true;
+    return;
+  }
 
   // We might want to unify with ReadBlock() if we start
   // requiring checksum verification in Table::Open.
@@ -135,12 +468,11 @@ void FixTable::ReadFilter(const Slice& filter_handle_value) {
 FixTable::~FixTable() { delete rep_; }
 
 static void DeleteBlock(void* arg, void* ignored) {
-  delete reinterpret_cast<Block*>(arg);
+  delete reinterpret_cast<FixBlock*>(arg);
 }
 
-static void DeleteCachedBlock(const Slice& key, void* value) {
-  Block* block = reinterpret_cast<Block*>(value);
-  delete block;
+static void DeleteCachedBlock(void* block) {
+  delete reinterpret_cast<FixBlock*>(block);
 }
 
 static void ReleaseBlock(void* arg, void* h) {
@@ -149,15 +481,209 @@ static void ReleaseBlock(void* arg, void* h) {
   cache->Release(handle);
 }
 
-// Convert an index iterator value (i.e., an encoded BlockHandle)
-// into an iterator over the contents of the corresponding block.
-Iterator* FixTable::BlockReader(void* arg, const ReadOptions& options,
-                             const Slice& index_value) {
-  FixTable* fixtable = reinterpret_cast<FixTable*>(arg);
-  Cache* block_cache = fixtable->rep_->options.block_cache;
-  FixBlock* block = nullptr;
+// A filter block held in the block cache.
+struct CachedFilter {
+  FilterBlockReader* reader;
+  const char* data;  // Owned if non-null
+};
+
+static void DeleteCachedIndexBlock(const Slice& key, void* value) {
+  delete reinterpret_cast<Block*>(value);
+}
+
+static void DeleteCachedFilter(const Slice& key, void* value) {
+  CachedFilter* filter = reinterpret_cast<CachedFilter*>(value);
+  delete filter->reader;
+  delete[] filter->data;
+  delete filter;
+}
+
+static void MetaBlockCacheKey(uint64_t cache_id, const BlockHandle& handle,
+                              char* buf) {
+  EncodeFixed64(buf, cache_id);
+  EncodeFixed64(buf + 8, handle.offset());
+}
+
+Status FixTable::GetIndexBlock(Block** block,
+                               Cache::Handle** cache_handle) const {
+  *cache_handle = nullptr;
+  if (rep_->index_block != nullptr) {
+    *block = rep_->index_block;
+    return Status::OK();
+  }
+
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  if (!rep_->cache_meta_blocks) {
+    BlockContents contents;
+    Status s = ReadBlock(rep_->file, opt, rep_->index_handle, &contents);
+    if (s.ok()) {
+      *block = new Block(contents);
+    }
+    return s;
+  }
+
+  Cache* block_cache = rep_->options.block_cache;
+  char cache_key_buffer[16];
+  MetaBlockCacheKey(rep_->cache_id, rep_->index_handle, cache_key_buffer);
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  *cache_handle = block_cache->Lookup(key);
+  if (*cache_handle != nullptr) {
+    *block = reinterpret_cast<Block*>(block_cache->Value(*cache_handle));
+    return Status::OK();
+  }
+  BlockContents contents;
+  Status s = ReadBlock(rep_->file, opt, rep_->index_handle, &contents);
+  if (s.ok()) {
+    *block = new Block(contents);
+    *cache_handle = block_cache->Insert(key, *block, (*block)->size(),
+                                        &DeleteCachedIndexBlock);
+  }
+  return s;
+}
+
+FilterBlockReader* FixTable::GetFilter(Cache::Handle** cache_handle) const {
+  *cache_handle = nullptr;
+  if (rep_->filter != nullptr || !rep_->has_filter) {
+    return rep_->filter;
+  }
+
+  Cache* block_cache = rep_->options.block_cache;
+  char cache_key_buffer[16];
+  MetaBlockCacheKey(rep_->cache_id, rep_->filter_handle, cache_key_buffer);
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  *cache_handle = block_cache->Lookup(key);
+  if (*cache_handle == nullptr) {
+    ReadOptions opt;
+    if (rep_->options.paranoid_checks) {
+      opt.verify_checksums = true;
+    }
+    BlockContents block;
+    if (!ReadBlock(rep_->file, opt, rep_->filter_handle, &block).ok()) {
+      // Lookups proceed without the filter, as if the table had none.
+      return nullptr;
+    }
+    CachedFilter* filter = new CachedFilter;
+    filter->reader =
+        new FilterBlockReader(rep_->options.filter_policy, block.data);
+    filter->data = block.heap_allocated ? block.data.data() : nullptr;
+    *cache_handle = block_cache->Insert(key, filter, block.data.size(),
+                                        &DeleteCachedFilter);
+  }
+  return reinterpret_cast<CachedFilter*>(block_cache->Value(*cache_handle))
+      ->reader;
+}
+
+Iterator* FixTable::NewIndexIterator() const {
+  Block* index_block;
+  Cache::Handle* cache_handle;
+  Status s = GetIndexBlock(&index_block, &cache_handle);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+  Iterator* iter = index_block->NewIterator(rep_->options.comparator);
+  if (cache_handle != nullptr) {
+    iter->RegisterCleanup(&ReleaseBlock, rep_->options.block_cache,
+                          cache_handle);
+  }
+  return iter;
+}
+
+bool FixTable::PrefixMayMatch(const Slice& target) const {
+  const SliceTransform* prefix_extractor = rep_->options.prefix_extractor;
+  const Slice user_key = ExtractUserKey(target);
+  if (!prefix_extractor->InDomain(user_key)) {
+    return true;
+  }
+  Cache::Handle* filter_cache_handle;
+  FilterBlockReader* filter = GetFilter(&filter_cache_handle);
+  if (filter == nullptr) {
+    return true;
+  }
+
+  // The filter policy strips internal keys down to user keys.
+  std::string prefix_key;
+  AppendInternalKey(&prefix_key,
+                    ParsedInternalKey(prefix_extractor->Transform(user_key),
+                                      kMaxSequenceNumber, kValueTypeForSeek));
+  // Keys sharing a prefix are contiguous, so if neither the block holding
+  // "target" nor the block after it has a key with the prefix, no later
+  // block has one either.  The first check alone is not enough, since
+  // "target" may sort after the last key of its block.
+  int excluded = 0;
+  Iterator* iiter = NewIndexIterator();
+  iiter->Seek(target);
+  while (excluded < 2 && iiter->Valid()) {
+    Slice handle_value = iiter->value();
+    BlockHandle handle;
+    if (!handle.DecodeFrom(&handle_value).ok() ||
+        filter->KeyMayMatch(handle.offset(), prefix_key)) {
+      break;
+    }
+    excluded++;
+    iiter->Next();
+  }
+  const bool may_match =
+      excluded == 0 ||
+      (excluded == 1 && (iiter->Valid() || !iiter->status().ok()));
+  delete iiter;
+  if (filter_cache_handle != nullptr) {
+    rep_->options.block_cache->Release(filter_cache_handle);
+  }
+  return may_match;
+}
+
+Iterator* FixTable::CachedBlockIterator(const BlockHandle& handle) const {
+  Cache* block_cache = rep_->options.block_cache;
+  if (block_cache == nullptr) {
+    return nullptr;
+  }
+  char cache_key_buffer[16];
+  EncodeFixed64(cache_key_buffer, rep_->cache_id);
+  EncodeFixed64(cache_key_buffer + 8, handle.offset());
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  Cache::Handle* cache_handle = block_cache->Lookup(key);
+  if (cache_handle == nullptr) {
+    return nullptr;
+  }
+  FixBlock* block =
+      reinterpret_cast<FixBlock*>(CachedBlockValue(block_cache, cache_handle));
+  Iterator* iter = block->NewIterator(rep_->options.comparator);
+  iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
+  return iter;
+}
+
+Iterator* FixTable::NewBlockIterator(const ReadOptions& options,
+                                     const BlockHandle& handle,
+                                     BlockContents* contents) const {
+  Cache* block_cache = rep_->options.block_cache;
+  FixBlock* block = new FixBlock(*contents, rep_->options.key_length,
+                                 rep_->options.value_length);  //键值长度
   Cache::Handle* cache_handle = nullptr;
+  if (block_cache != nullptr && contents->cachable && options.fill_cache) {
+    char cache_key_buffer[16];
+    EncodeFixed64(cache_key_buffer, rep_->cache_id);
+    EncodeFixed64(cache_key_buffer + 8, handle.offset());
+    Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+    cache_handle =
+        InsertCachedBlock(block_cache, key, block, &DeleteCachedBlock,
+                          block->size(), contents, rep_->raw_tier,
+                          handle.offset());
+  }
+  Iterator* iter = block->NewIterator(rep_->options.comparator);
+  if (cache_handle == nullptr) {
+    iter->RegisterCleanup(&DeleteBlock, block, nullptr);
+  } else {
+    iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
+  }
+  return iter;
+}
 
+Iterator* FixTable::ReadDataBlock(const ReadOptions& options,
+                                  const Slice& index_value,
+                                  RandomAccessFile* file) const {
   BlockHandle handle;
   Slice input = index_value;
   Status s = handle.DecodeFrom(&input);
@@ -165,62 +691,62 @@ Iterator* FixTable::BlockReader(void* arg, const ReadOptions& options,
   // can add more features in the future.
 
   if (s.ok()) {
+    Iterator* iter = CachedBlockIterator(handle);
+    if (iter != nullptr) {
+      return iter;
+    }
     BlockContents contents;
-    if (block_cache != nullptr) {
-      char cache_key_buffer[16];
-      EncodeFixed64(cache_key_buffer, fixtable->rep_->cache_id);
-      EncodeFixed64(cache_key_buffer + 8, handle.offset());
-      Slice key(cache_key_buffer, sizeof(cache_key_buffer));
-      cache_handle = block_cache->Lookup(key);
-      if (cache_handle != nullptr) {
-        block = reinterpret_cast<FixBlock*>(block_cache->Value(cache_handle));
-      } else {
-        s = ReadBlock(fixtable->rep_->file, options, handle, &contents);
-        if (s.ok()) {
-          block = new FixBlock(contents, fixtable->rep_->options.key_length, fixtable->rep_->options.value_length); //键值长度
-          if (contents.cachable && options.fill_cache) {
-            cache_handle = block_cache->Insert(key, block, block->size(),
-                                               &DeleteCachedBlock);
-          }
-        }
-      }
-    } else {
-      s = ReadBlock(fixtable->rep_->file, options, handle, &contents);
-      if (s.ok()) {
-        block = new FixBlock(contents, fixtable->rep_->options.key_length, fixtable->rep_->options.value_length);
-      }
+    s = ReadBlockThroughCache(rep_->raw_tier, file, options, handle,
+                              &contents);
+    if (s.ok()) {
+      return NewBlockIterator(options, handle, &contents);
     }
   }
+  return NewErrorIterator(s);
+}
 
-  Iterator* iter;
-  if (block != nullptr) {
-    iter = block->NewIterator(fixtable->rep_->options.comparator);
-    if (cache_handle == nullptr) {
-      iter->RegisterCleanup(&DeleteBlock, block, nullptr);
-    } else {
-      iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
-    }
-  } else {
-    iter = NewErrorIterator(s);
-  }
-  return iter;
+// Convert an index iterator value (i.e., an encoded BlockHandle)
+// into an iterator over the contents of the corresponding block.
+Iterator* FixTable::BlockReader(void* arg, const ReadOptions& options,
+                             const Slice& index_value) {
+  FixTable* fixtable = reinterpret_cast<FixTable*>(arg);
+  return fixtable->ReadDataBlock(options, index_value, fixtable->rep_->file);
+}
+
+// Like BlockReader(), for the blocks of a scan, which reads ahead.
+Iterator* FixTable::ScanBlockReader(void* arg, const ReadOptions& options,
+                                    const Slice& index_value) {
+  ScanState* state = reinterpret_cast<ScanState*>(arg);
+  return state->table->ReadDataBlock(options, index_value, &state->file);
 }
 
 Iterator* FixTable::NewIterator(const ReadOptions& options) const {
-  return NewTwoLevelIterator(
-      rep_->index_block->NewIterator(rep_->options.comparator),
-      &FixTable::BlockReader, const_cast<FixTable*>(this), options);
+  ScanState* state = new ScanState(this, options.readahead_size);
+  // Tables hold internal keys, so blocks outside the iterate bounds can
+  // be skipped.
+  Iterator* iter =
+      NewTwoLevelIterator(NewIndexIterator(), &FixTable::ScanBlockReader,
+                          state, options, rep_->options.comparator);
+  iter->RegisterCleanup(
+      [](void* arg, void* ignored) { delete reinterpret_cast<ScanState*>(arg); },
+      state, nullptr);
+  if (options.prefix_same_as_start && rep_->options.prefix_extractor != nullptr &&
+      rep_->options.filter_policy != nullptr) {
+    iter = new PrefixSeekIterator(this, iter);
+  }
+  return iter;
 }
 
 Status FixTable::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
                           void (*handle_result)(void*, const Slice&,
                                                 const Slice&)) {
   Status s;
-  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* iiter = NewIndexIterator();
+  Cache::Handle* filter_cache_handle = nullptr;
   iiter->Seek(k);
   if (iiter->Valid()) {
     Slice handle_value = iiter->value();
-    FilterBlockReader* filter = rep_->filter;
+    FilterBlockReader* filter = GetFilter(&filter_cache_handle);
     BlockHandle handle;
     if (filter != nullptr && handle.DecodeFrom(&handle_value).ok() &&
         !filter->KeyMayMatch(handle.offset(), k)) {
@@ -238,13 +764,106 @@ Status FixTable::InternalGet(const ReadOptions& options, const Slice& k, void* a
   if (s.ok()) {
     s = iiter->status();
   }
+  if (filter_cache_handle != nullptr) {
+    rep_->options.block_cache->Release(filter_cache_handle);
+  }
   delete iiter;
   return s;
 }
 
+void FixTable::InternalMultiGet(const ReadOptions& options,
+                                const std::vector<Slice>& keys,
+                                const std::vector<void*>& args,
+                                void (*handle_result)(void*, const Slice&,
+                                                      const Slice&),
+                                std::vector<Status>* statuses) {
+  const size_t n = keys.size();
+  statuses->assign(n, Status::OK());
+  const Comparator* cmp = rep_->options.comparator;
+  Iterator* iiter = NewIndexIterator();
+  Cache::Handle* filter_cache_handle;
+  FilterBlockReader* filter = GetFilter(&filter_cache_handle);
+
+  // First find the data block each key may be in, so that every block is
+  // read once however many of the keys it holds.  Since the keys are
+  // sorted, keys in the same block are adjacent.
+  std::vector<std::string> blocks;  // Encoded handles of the blocks to read
+  std::vector<int> key_block(n, -1);  // Index into "blocks" of each key
+  for (size_t i = 0; i < n; i++) {
+    // The index entry of the previous key also covers this one as long as
+    // the key does not pass the entry's separator.
+    if (i == 0 || !iiter->Valid() || cmp->Compare(keys[i], iiter->key()) > 0) {
+      iiter->Seek(keys[i]);
+    }
+    if (!iiter->Valid()) {
+      (*statuses)[i] = iiter->status();
+      continue;
+    }
+    Slice handle_value = iiter->value();
+    BlockHandle handle;
+    if (filter != nullptr && handle.DecodeFrom(&handle_value).ok() &&
+        !filter->KeyMayMatch(handle.offset(), keys[i])) {
+      continue;  // Not found
+    }
+    if (blocks.empty() || Slice(blocks.back()) != iiter->value()) {
+      blocks.push_back(iiter->value().ToString());
+    }
+    key_block[i] = static_cast<int>(blocks.size()) - 1;
+  }
+  if (filter_cache_handle != nullptr) {
+    rep_->options.block_cache->Release(filter_cache_handle);
+  }
+  delete iiter;
+
+  // Take the blocks that are cached, then read all the others together so
+  // that their reads overlap.
+  std::vector<Iterator*> block_iters(blocks.size(), nullptr);
+  std::vector<BlockHandle> handles;
+  std::vector<size_t> missing;
+  for (size_t b = 0; b < blocks.size(); b++) {
+    BlockHandle handle;
+    Slice input = blocks[b];
+    Status s = handle.DecodeFrom(&input);
+    if (!s.ok()) {
+      block_iters[b] = NewErrorIterator(s);
+    } else if ((block_iters[b] = CachedBlockIterator(handle)) == nullptr) {
+      handles.push_back(handle);
+      missing.push_back(b);
+    }
+  }
+  if (!missing.empty()) {
+    std::vector<BlockContents> contents(missing.size());
+    std::vector<Status> read_statuses(missing.size());
+    ReadBlocksThroughCache(rep_->raw_tier, rep_->file, options,
+                           handles.data(), handles.size(), contents.data(),
+                           read_statuses.data());
+    for (size_t m = 0; m < missing.size(); m++) {
+      block_iters[missing[m]] =
+          read_statuses[m].ok()
+              ? NewBlockIterator(options, handles[m], &contents[m])
+              : NewErrorIterator(read_statuses[m]);
+    }
+  }
+
+  size_t i = 0;
+  for (size_t b = 0; b < blocks.size(); b++) {
+    Iterator* block_iter = block_iters[b];
+    for (; i < n && key_block[i] <= static_cast<int>(b); i++) {
+      if (key_block[i] < 0) {
+        continue;
+      }
+      block_iter->Seek(keys[i]);
+      if (block_iter->Valid()) {
+        (*handle_result)(args[i], block_iter->key(), block_iter->value());
+      }
+      (*statuses)[i] = block_iter->status();
+    }
+    delete block_iter;
+  }
+}
+
 uint64_t FixTable::ApproximateOffsetOf(const Slice& key) const {
-  Iterator* index_iter =
-      rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* index_iter = NewIndexIterator();
   index_iter->Seek(key);
   uint64_t result;
   if (index_iter->Valid()) {
@@ -6,14 +6,19 @@
 #define STORAGE_LEVELDB_MERGE_TEST_FIX_TABLE_H_
 
 #include <cstdint>
+#include <vector>
 
+#include "leveldb/cache.h"
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
+#include "leveldb/table_properties.h"
 
 namespace leveldb {
 
 class Block;
+struct BlockContents;
 class BlockHandle;
+class FilterBlockReader;
 class Footer;
 struct Options;
 class RandomAccessFile;
@@ -37,8 +42,13 @@ class LEVELDB_EXPORT FixTable {
   // for the duration of the returned table's lifetime.
   //
   // *file must remain live while this Table is in use.
+  //
+  // If options.cache_index_and_filter_blocks is set and "pin_meta_blocks"
+  // is true, the index and filter blocks stay pinned in the block cache
+  // until the table is deleted.
   static Status Open(const Options& options, RandomAccessFile* file,
-                     uint64_t file_size, FixTable** FixTable);
+                     uint64_t file_size, FixTable** FixTable,
+                     bool pin_meta_blocks = false);
 
   FixTable(const FixTable&) = delete;
   FixTable& operator=(const FixTable&) = delete;
@@ -58,13 +68,22 @@ class LEVELDB_EXPORT FixTable {
   // be close to the file length.
   uint64_t ApproximateOffsetOf(const Slice& key) const;
 
-  
+  // Reads the properties stored with the table into *props.  Returns
+  // NotFound if the table was written without them.  Reads the file on
+  // every call; the properties are not kept with the open table.
+  Status ReadProperties(TableProperties* props) const;
+
+  // Returns a new iterator over the range tombstones of the table, stored
+  // as described in db/range_tombstone.h.  The table must outlive it.
+  Iterator* NewRangeTombstoneIterator() const;
 
  private:
   friend class TableCache;
   //friend class SSTMergeTester;
   //将这几个改成public就能使用时间记录
   struct Rep;
+  struct ScanState;
+  class PrefixSeekIterator;
   explicit FixTable(Rep* rep) : rep_(rep) {}
   void ReadMeta(const Footer& footer);
   
@@ -72,6 +91,39 @@ class LEVELDB_EXPORT FixTable {
   
 
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+  static Iterator* ScanBlockReader(void*, const ReadOptions&, const Slice&);
+
+  // Returns an iterator over the data block whose handle is "index_value",
+  // reading it from "file" if it is not cached.
+  Iterator* ReadDataBlock(const ReadOptions&, const Slice& index_value,
+                          RandomAccessFile* file) const;
+
+  // Returns an iterator over the data block at "handle" if it is in the
+  // block cache, else nullptr.
+  Iterator* CachedBlockIterator(const BlockHandle& handle) const;
+
+  // Returns an iterator over the data block at "handle" read into
+  // "*contents", adding the block to the block cache where allowed.  Takes
+  // the bytes kept in contents->raw.
+  Iterator* NewBlockIterator(const ReadOptions&, const BlockHandle& handle,
+                             BlockContents* contents) const;
+
+  // Sets "*block" to the index block.  If "*cache_handle" is set on
+  // return, the block is held in the block cache and the caller must
+  // release the handle when done with it.
+  Status GetIndexBlock(Block** block, Cache::Handle** cache_handle) const;
+
+  // Returns the filter, or nullptr if the table has none.  Releasing
+  // "*cache_handle" works as for GetIndexBlock().
+  FilterBlockReader* GetFilter(Cache::Handle** cache_handle) const;
+
+  // Returns an iterator over the index block.
+  Iterator* NewIndexIterator() const;
+
+  // Returns false if the filter shows that no key at or after the internal
+  // key "target" shares the prefix of its user key, see
+  // Options::prefix_extractor.
+  bool PrefixMayMatch(const Slice& target) const;
 
   
 
@@ -83,8 +135,19 @@ class LEVELDB_EXPORT FixTable {
                      void (*handle_result)(void* arg, const Slice& k,
                                            const Slice& v));
 
+  // Like InternalGet() for each of "keys", which must be sorted, passing
+  // args[i] to the call for keys[i] and setting (*statuses)[i].  Each data
+  // block is read once for all the keys it may hold.
+  void InternalMultiGet(const ReadOptions&, const std::vector<Slice>& keys,
+                        const std::vector<void*>& args,
+                        void (*handle_result)(void* arg, const Slice& k,
+                                              const Slice& v),
+                        std::vector<Status>* statuses);
+
   
   void ReadFilter(const Slice& filter_handle_value);
+  void ReadRangeDelBlock(const ReadOptions& options,
+                         const Slice& handle_value);
 
   Rep* const rep_;
 };
@@ -4,11 +4,13 @@
 
 #include "merge_test/fix_table_builder.h"
 
+#include <algorithm>
 #include <cassert>
 #include <string>
 #include <iostream>
 using namespace std;
 
+#include "db/dbformat.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
@@ -23,7 +25,6 @@ using namespace std;
 
 namespace leveldb {
 
-
 struct FixTableBuilder::Rep {
   Rep(const Options& opt, WritableFile* f)
       : options(opt),
@@ -52,6 +53,8 @@ struct FixTableBuilder::Rep {
   int64_t num_entries;
   bool closed;  // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
+  TableProperties props;
+  std::vector<std::pair<std::string, std::string>> range_tombstones;
 
   // We do not emit the index entry for a block until we have seen the
   // first key for the next data block.  This allows us to use shorter
@@ -120,7 +123,33 @@ void FixTableBuilder::Add(const Slice& key, const Slice& value) {
 
   r->last_key.assign(key.data(), key.size());
   r->num_entries++;
-  r->data_block.Add(key, value);
+  r->props.raw_key_size += key.size();
+  r->props.raw_value_size += value.size();
+
+  ParsedInternalKey ikey;
+  bool deletion = false;
+  if (ParseInternalKey(key, &ikey)) {
+    if (r->num_entries == 1 || ikey.sequence < r->props.smallest_seqno) {
+      r->props.smallest_seqno = ikey.sequence;
+    }
+    if (ikey.sequence > r->props.largest_seqno) {
+      r->props.largest_seqno = ikey.sequence;
+    }
+    deletion = (ikey.type == kTypeDeletion);
+  }
+  if (deletion) {
+    r->props.num_deletions++;
+    // Deletion markers carry no value, but every entry of a data block
+    // must be value_length bytes wide.  The padding is never read back.
+    if (value.size() != r->options.value_length) {
+      const std::string padding(r->options.value_length, '\0');
+      r->data_block.Add(key, padding);
+    } else {
+      r->data_block.Add(key, value);
+    }
+  } else {
+    r->data_block.Add(key, value);
+  }
 
   const size_t estimated_block_size = r->data_block.CurrentSizeEstimate();
   if (estimated_block_size >= r->options.block_size) {
@@ -128,6 +157,13 @@ void FixTableBuilder::Add(const Slice& key, const Slice& value) {
   }
 }
 
+void FixTableBuilder::AddRangeTombstone(const Slice& key, const Slice& value) {
+  Rep* r = rep_;
+  assert(!r->closed);
+  if (!ok()) return;
+  r->range_tombstones.emplace_back(key.ToString(), value.ToString());
+}
+
 void FixTableBuilder::Flush() {
   Rep* r = rep_;
   assert(!r->closed);
@@ -136,6 +172,8 @@ void FixTableBuilder::Flush() {
   assert(!r->pending_index_entry);
   WriteBlock(&r->data_block, &r->pending_handle);
   if (ok()) {
+    r->props.data_size += r->pending_handle.size() + kBlockTrailerSize;
+    r->props.num_data_blocks++;
     r->pending_index_entry = true;
     r->status = r->file->Flush();
   }
@@ -272,7 +310,8 @@ Status FixTableBuilder::Finish() {
   assert(!r->closed);
   r->closed = true;
 
-  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  BlockHandle filter_block_handle, properties_block_handle,
+      range_del_block_handle, metaindex_block_handle, index_block_handle;
 
   // Write filter block
   if (ok() && r->filter_block != nullptr) {
@@ -280,9 +319,51 @@ Status FixTableBuilder::Finish() {
                   &filter_block_handle);
   }
 
+  // Meta blocks are keyed by plain strings, whatever the table's comparator.
+  Options meta_options = r->options;
+  meta_options.comparator = BytewiseComparator();
+
+  // Write range deletion block, keyed like the data blocks
+  std::vector<std::pair<std::string, std::string>>& tombstones =
+      r->range_tombstones;
+  if (ok() && !tombstones.empty()) {
+    const Comparator* cmp = r->options.comparator;
+    std::sort(tombstones.begin(), tombstones.end(),
+              [cmp](const std::pair<std::string, std::string>& a,
+                    const std::pair<std::string, std::string>& b) {
+                return cmp->Compare(a.first, b.first) < 0;
+              });
+    BlockBuilder range_del_block(&r->options);
+    for (size_t i = 0; i < tombstones.size(); i++) {
+      // The same tombstone may come from several inputs of a compaction.
+      if (i > 0 && cmp->Compare(tombstones[i].first,
+                                tombstones[i - 1].first) == 0) {
+        continue;
+      }
+      range_del_block.Add(tombstones[i].first, tombstones[i].second);
+      r->props.num_range_deletions++;
+    }
+    WriteBlock(&range_del_block, &range_del_block_handle);
+  }
+
+  // Write properties block
+  if (ok()) {
+    r->props.num_entries = r->num_entries;
+    r->props.key_length = r->options.key_length;
+    r->props.value_length = r->options.value_length;
+    r->props.creation_time = r->options.env->NowMicros() / 1000000;
+    BlockBuilder properties_block(&meta_options);
+    for (int i = 0; i < kNumTablePropertyFields; i++) {
+      std::string encoding;
+      PutVarint64(&encoding, r->props.*kTablePropertyFields[i].field);
+      properties_block.Add(kTablePropertyFields[i].name, encoding);
+    }
+    WriteBlock(&properties_block, &properties_block_handle);
+  }
+
   // Write metaindex block
   if (ok()) {
-    BlockBuilder meta_index_block(&r->options);
+    BlockBuilder meta_index_block(&meta_options);
     if (r->filter_block != nullptr) {
       // Add mapping from "filter.Name" to location of filter data
       std::string key = "filter.";
@@ -292,7 +373,16 @@ Status FixTableBuilder::Finish() {
       meta_index_block.Add(key, handle_encoding);
     }
 
-    // TODO(postrelease): Add stats and other meta blocks
+    std::string handle_encoding;
+    properties_block_handle.EncodeTo(&handle_encoding);
+    meta_index_block.Add(kPropertiesBlock, handle_encoding);
+
+    if (r->props.num_range_deletions > 0) {
+      handle_encoding.clear();
+      range_del_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add(kRangeDelBlock, handle_encoding);
+    }
+
     WriteBlock(&meta_index_block, &metaindex_block_handle);
   }
 
@@ -333,5 +423,9 @@ uint64_t FixTableBuilder::NumEntries() const { return rep_->num_entries; }
 
 uint64_t FixTableBuilder::FileSize() const { return rep_->offset; }
 
+const TableProperties& FixTableBuilder::GetTableProperties() const {
+  return rep_->props;
+}
+
 }  // namespace leveldb
 
@@ -14,10 +14,14 @@
 #define STORAGE_LEVELDB_MERGE_TEST_FIX_TABLE_BUILDER_H_
 
 #include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "leveldb/export.h"
 #include "leveldb/options.h"
 #include "leveldb/status.h"
+#include "leveldb/table_properties.h"
 #include "merge_test/fix_block_builder.h"
 #include "table/block_builder.h"
 
@@ -55,6 +59,12 @@ class LEVELDB_EXPORT FixTableBuilder {
   // REQUIRES: Finish(), Abandon() have not been called
   void Add(const Slice& key, const Slice& value);
 
+  // Add the range tombstone stored as "key", "value" (see
+  // db/range_tombstone.h) to the table being constructed.  Tombstones may
+  // be added in any order and are not counted by NumEntries().
+  // REQUIRES: Finish(), Abandon() have not been called
+  void AddRangeTombstone(const Slice& key, const Slice& value);
+
   // Advanced operation: flush any buffered key/value pairs to file.
   // Can be used to ensure that two adjacent entries never live in
   // the same data block.  Most clients should not need to use this method.
@@ -83,6 +93,10 @@ class LEVELDB_EXPORT FixTableBuilder {
   // Finish() call, returns the size of the final generated file.
   uint64_t FileSize() const;
 
+  // Properties of the entries added so far.  Complete once Finish() has
+  // been called.
+  const TableProperties& GetTableProperties() const;
+
  private:
   bool ok() const { return status().ok(); }
   void WriteBlock(BlockBuilder* block, BlockHandle* handle);
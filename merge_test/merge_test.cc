@@ -268,7 +268,7 @@ private:
             if (s.ok()) {
             // Verify that the table is usable
             Iterator* it = table_cache->NewIterator(ReadOptions(), meta->number,
-                                                    meta->file_size);
+                                                    meta->file_size, 0);
             s = it->status();
             delete it;
             }
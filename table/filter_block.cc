@@ -15,10 +15,17 @@ namespace leveldb {
 static const size_t kFilterBaseLg = 11;
 static const size_t kFilterBase = 1 << kFilterBaseLg;
 
+// Encoding parameter of a block holding one filter for the whole table:
+// every block offset maps to filter 0.
+static const size_t kWholeTableFilterBaseLg = 63;
+
 FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy* policy)
-    : policy_(policy) {}
+    : policy_(policy), whole_table_(policy->WholeTableFilter()) {}
 
 void FilterBlockBuilder::StartBlock(uint64_t block_offset) {
+  if (whole_table_) {
+    return;  // All keys go to the filter generated by Finish().
+  }
   uint64_t filter_index = (block_offset / kFilterBase);
   assert(filter_index >= filter_offsets_.size());
   while (filter_index > filter_offsets_.size()) {
@@ -44,7 +51,8 @@ Slice FilterBlockBuilder::Finish() {
   }
 
   PutFixed32(&result_, array_offset);
-  result_.push_back(kFilterBaseLg);  // Save encoding parameter in result
+  // Save encoding parameter in result
+  result_.push_back(whole_table_ ? kWholeTableFilterBaseLg : kFilterBaseLg);
   return Slice(result_);
 }
 
@@ -36,6 +36,12 @@ class TestHashFilter : public FilterPolicy {
   }
 };
 
+// For testing: a TestHashFilter kept over the whole table
+class TestWholeTableHashFilter : public TestHashFilter {
+ public:
+  bool WholeTableFilter() const override { return true; }
+};
+
 class FilterBlockTest : public testing::Test {
  public:
   TestHashFilter policy_;
@@ -119,4 +125,26 @@ TEST_F(FilterBlockTest, MultiChunk) {
   ASSERT_TRUE(!reader.KeyMayMatch(9000, "bar"));
 }
 
+TEST_F(FilterBlockTest, WholeTable) {
+  TestWholeTableHashFilter policy;
+  FilterBlockBuilder builder(&policy);
+  builder.StartBlock(0);
+  builder.AddKey("foo");
+  builder.StartBlock(3100);
+  builder.AddKey("box");
+  builder.StartBlock(9000);
+  builder.AddKey("hello");
+  Slice block = builder.Finish();
+  // One filter of three hashes, its offset, the array offset, and lg(base).
+  ASSERT_EQ(12 + 4 + 4 + 1, block.size());
+  FilterBlockReader reader(&policy, block);
+
+  for (uint64_t offset : {0, 3100, 9000, 1 << 30}) {
+    ASSERT_TRUE(reader.KeyMayMatch(offset, "foo"));
+    ASSERT_TRUE(reader.KeyMayMatch(offset, "box"));
+    ASSERT_TRUE(reader.KeyMayMatch(offset, "hello"));
+    ASSERT_TRUE(!reader.KeyMayMatch(offset, "bar"));
+  }
+}
+
 }  // namespace leveldb
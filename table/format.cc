@@ -4,6 +4,10 @@
 
 #include "table/format.h"
 
+#include <cstring>
+#include <vector>
+
+#include "leveldb/cache.h"
 #include "leveldb/env.h"
 #include "leveldb/options.h"
 #include "port/port.h"
@@ -62,22 +66,30 @@ Status Footer::DecodeFrom(Slice* input) {
   return result;
 }
 
-Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
-                 const BlockHandle& handle, BlockContents* result) {
-  result->data = Slice();
-  result->cachable = false;
-  result->heap_allocated = false;
+const TablePropertyField kTablePropertyFields[] = {
+    {"leveldb.creation.time", &TableProperties::creation_time},
+    {"leveldb.data.size", &TableProperties::data_size},
+    {"leveldb.key.length", &TableProperties::key_length},
+    {"leveldb.largest.seqno", &TableProperties::largest_seqno},
+    {"leveldb.num.data.blocks", &TableProperties::num_data_blocks},
+    {"leveldb.num.deletions", &TableProperties::num_deletions},
+    {"leveldb.num.entries", &TableProperties::num_entries},
+    {"leveldb.num.range.deletions", &TableProperties::num_range_deletions},
+    {"leveldb.raw.key.size", &TableProperties::raw_key_size},
+    {"leveldb.raw.value.size", &TableProperties::raw_value_size},
+    {"leveldb.smallest.seqno", &TableProperties::smallest_seqno},
+    {"leveldb.value.length", &TableProperties::value_length},
+};
 
-  // Read the block contents as well as the type/crc footer.
-  // See table_builder.cc for the code that built this structure.
-  size_t n = static_cast<size_t>(handle.size());
-  char* buf = new char[n + kBlockTrailerSize];
-  Slice contents;
-  Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
-  if (!s.ok()) {
-    delete[] buf;
-    return s;
-  }
+const int kNumTablePropertyFields =
+    sizeof(kTablePropertyFields) / sizeof(kTablePropertyFields[0]);
+
+namespace {
+
+// Checks the n contents bytes plus trailer that a read of a block into the
+// new[] buffer "buf" returned in "contents".  Deletes "buf" on failure.
+Status CheckRawBlock(const ReadOptions& options, size_t n, char* buf,
+                     const Slice& contents) {
   if (contents.size() != n + kBlockTrailerSize) {
     delete[] buf;
     return Status::Corruption("truncated block read");
@@ -90,11 +102,35 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
     const uint32_t actual = crc32c::Value(data, n + 1);
     if (actual != crc) {
       delete[] buf;
-      s = Status::Corruption("block checksum mismatch");
-      return s;
+      return Status::Corruption("block checksum mismatch");
     }
   }
+  return Status::OK();
+}
 
+// Reads the contents of the block identified by "handle" together with
+// its type/crc trailer.  On success, *contents points at the n contents
+// bytes followed by the trailer, and *buf holds a new[] buffer that the
+// caller must delete (it may or may not be where *contents points).
+Status ReadRawBlock(RandomAccessFile* file, const ReadOptions& options,
+                    const BlockHandle& handle, char** buf, Slice* contents) {
+  // Read the block contents as well as the type/crc footer.
+  // See table_builder.cc for the code that built this structure.
+  size_t n = static_cast<size_t>(handle.size());
+  *buf = new char[n + kBlockTrailerSize];
+  Status s = file->Read(handle.offset(), n + kBlockTrailerSize, contents, *buf);
+  if (!s.ok()) {
+    delete[] *buf;
+    return s;
+  }
+  return CheckRawBlock(options, n, *buf, *contents);
+}
+
+// Fills *result from the n raw block bytes at "data", followed by the
+// compression type byte.  Takes ownership of "buf", which is either
+// nullptr or a new[] buffer that may hold "data" itself.
+Status DecodeBlock(const char* data, size_t n, char* buf,
+                   BlockContents* result) {
   switch (data[n]) {
     case kNoCompression:
       if (data != buf) {
@@ -157,4 +193,225 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
   return Status::OK();
 }
 
+void DeleteRawBlock(const Slice& key, void* value) {
+  delete reinterpret_cast<std::string*>(value);
+}
+
+// Looks up the raw bytes of the block cached under "key".  On a hit,
+// decodes them into *result, stores the outcome in *status and returns
+// true.  The entry is erased if options.fill_cache is set, since the
+// caller's block cache holds the block from then on; the bytes of a
+// compressed block are then kept in result->raw.
+bool LookupRawBlock(Cache* raw_cache, const Slice& key,
+                    const ReadOptions& options, BlockContents* result,
+                    Status* status) {
+  Cache::Handle* cache_handle = raw_cache->Lookup(key);
+  if (cache_handle == nullptr) {
+    return false;
+  }
+  // The cached bytes were checksummed when they were read from the file.
+  const std::string* raw =
+      reinterpret_cast<std::string*>(raw_cache->Value(cache_handle));
+  const size_t n = raw->size() - 1;
+  if ((*raw)[n] == kNoCompression) {
+    // The block must outlive the cache handle, so copy it out.
+    char* buf = new char[n + 1];
+    std::memcpy(buf, raw->data(), n + 1);
+    *status = DecodeBlock(buf, n, buf, result);
+  } else {
+    *status = DecodeBlock(raw->data(), n, nullptr, result);
+    if (options.fill_cache) {
+      result->raw = *raw;
+    }
+  }
+  result->raw_cachable = true;
+  raw_cache->Release(cache_handle);
+  if (options.fill_cache) {
+    raw_cache->Erase(key);
+  }
+  return true;
+}
+
+// Decodes the n bytes at "data" read from a file into "buf", like
+// DecodeBlock(), and keeps the bytes of a compressed block in result->raw
+// if the block is going to a block cache backed by a raw block cache.
+Status DecodeReadBlock(const RawBlockTier* tier, const ReadOptions& options,
+                       const char* data, size_t n, char* buf,
+                       BlockContents* result) {
+  // Blocks the file implementation hands out directly (e.g. mmap) are
+  // already in memory, so only blocks copied into "buf" are worth caching.
+  const bool raw_cachable = (data == buf);
+  if (tier != nullptr && raw_cachable && options.fill_cache &&
+      data[n] != kNoCompression) {
+    result->raw.assign(data, n + 1);
+  }
+  Status s = DecodeBlock(data, n, buf, result);
+  result->raw_cachable = raw_cachable;
+  return s;
+}
+
+// A block in the primary block cache, with what it takes to move it to its
+// raw block cache.
+struct CachedBlock {
+  void* block;
+  void (*delete_block)(void*);
+  Slice contents;
+  std::string raw;     // See BlockContents::raw
+  RawBlockTier* tier;  // Null if the block is not moved on eviction
+  uint64_t offset;
+};
+
+// Block caches call deleters without holding their own locks, so moving
+// the block does not hold up other users of the block cache.
+void DeleteCachedBlock(const Slice& key, void* value) {
+  CachedBlock* cached = reinterpret_cast<CachedBlock*>(value);
+  RawBlockTier* tier = cached->tier;
+  if (tier != nullptr) {
+    if (!tier->closed()) {
+      char raw_key[16];
+      EncodeFixed64(raw_key, tier->cache_id());
+      EncodeFixed64(raw_key + 8, cached->offset);
+      std::string* raw = new std::string;
+      if (cached->raw.empty()) {
+        raw->reserve(cached->contents.size() + 1);
+        raw->assign(cached->contents.data(), cached->contents.size());
+        raw->push_back(static_cast<char>(kNoCompression));
+      } else {
+        raw->swap(cached->raw);
+      }
+      Cache* raw_cache = tier->cache();
+      raw_cache->Release(raw_cache->Insert(Slice(raw_key, sizeof(raw_key)),
+                                           raw, raw->size(), &DeleteRawBlock));
+    }
+    tier->Unref();
+  }
+  (*cached->delete_block)(cached->block);
+  delete cached;
+}
+
+}  // namespace
+
+Cache::Handle* InsertCachedBlock(Cache* block_cache, const Slice& key,
+                                 void* block, void (*delete_block)(void*),
+                                 size_t charge, BlockContents* contents,
+                                 RawBlockTier* tier, uint64_t offset) {
+  CachedBlock* cached = new CachedBlock;
+  cached->block = block;
+  cached->delete_block = delete_block;
+  cached->contents = contents->data;
+  cached->raw.swap(contents->raw);
+  cached->tier = contents->raw_cachable ? tier : nullptr;
+  cached->offset = offset;
+  if (cached->tier != nullptr) {
+    cached->tier->Ref();
+  }
+  return block_cache->Insert(key, cached, charge + cached->raw.size(),
+                             &DeleteCachedBlock);
+}
+
+void* CachedBlockValue(Cache* block_cache, Cache::Handle* handle) {
+  return reinterpret_cast<CachedBlock*>(block_cache->Value(handle))->block;
+}
+
+Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
+                 const BlockHandle& handle, BlockContents* result) {
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+  result->raw_cachable = false;
+
+  char* buf;
+  Slice contents;
+  Status s = ReadRawBlock(file, options, handle, &buf, &contents);
+  if (!s.ok()) {
+    return s;
+  }
+  return DecodeBlock(contents.data(), static_cast<size_t>(handle.size()), buf,
+                     result);
+}
+
+Status ReadBlockThroughCache(const RawBlockTier* tier, RandomAccessFile* file,
+                             const ReadOptions& options,
+                             const BlockHandle& handle, BlockContents* result) {
+  if (tier == nullptr) {
+    return ReadBlock(file, options, handle, result);
+  }
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+  result->raw_cachable = false;
+
+  char cache_key_buffer[16];
+  EncodeFixed64(cache_key_buffer, tier->cache_id());
+  EncodeFixed64(cache_key_buffer + 8, handle.offset());
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  Status s;
+  if (LookupRawBlock(tier->cache(), key, options, result, &s)) {
+    return s;
+  }
+
+  char* buf;
+  Slice contents;
+  s = ReadRawBlock(file, options, handle, &buf, &contents);
+  if (!s.ok()) {
+    return s;
+  }
+  return DecodeReadBlock(tier, options, contents.data(),
+                         static_cast<size_t>(handle.size()), buf, result);
+}
+
+void ReadBlocksThroughCache(const RawBlockTier* tier, RandomAccessFile* file,
+                            const ReadOptions& options,
+                            const BlockHandle* handles, size_t num,
+                            BlockContents* results, Status* statuses) {
+  std::vector<RandomAccessFile::ReadRequest> reqs;
+  std::vector<size_t> req_blocks;
+  reqs.reserve(num);
+  req_blocks.reserve(num);
+  char cache_key_buffer[16];
+  EncodeFixed64(cache_key_buffer, tier != nullptr ? tier->cache_id() : 0);
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  for (size_t i = 0; i < num; i++) {
+    results[i].data = Slice();
+    results[i].cachable = false;
+    results[i].heap_allocated = false;
+    results[i].raw_cachable = false;
+    if (tier != nullptr) {
+      EncodeFixed64(cache_key_buffer + 8, handles[i].offset());
+      if (LookupRawBlock(tier->cache(), key, options, &results[i],
+                         &statuses[i])) {
+        continue;
+      }
+    }
+    RandomAccessFile::ReadRequest req;
+    req.offset = handles[i].offset();
+    req.n = static_cast<size_t>(handles[i].size()) + kBlockTrailerSize;
+    req.scratch = new char[req.n];
+    reqs.push_back(req);
+    req_blocks.push_back(i);
+  }
+  if (reqs.empty()) {
+    return;
+  }
+
+  // Issue the reads of all the missing blocks together.
+  file->MultiRead(reqs.data(), reqs.size());
+  for (size_t r = 0; r < reqs.size(); r++) {
+    const size_t i = req_blocks[r];
+    const size_t n = static_cast<size_t>(handles[i].size());
+    char* buf = reqs[r].scratch;
+    if (!reqs[r].status.ok()) {
+      delete[] buf;
+      statuses[i] = reqs[r].status;
+      continue;
+    }
+    statuses[i] = CheckRawBlock(options, n, buf, reqs[r].result);
+    if (!statuses[i].ok()) {
+      continue;
+    }
+    statuses[i] = DecodeReadBlock(tier, options, reqs[r].result.data(), n,
+                                  buf, &results[i]);
+  }
+}
+
 }  // namespace leveldb
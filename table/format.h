@@ -5,12 +5,15 @@
 #ifndef STORAGE_LEVELDB_TABLE_FORMAT_H_
 #define STORAGE_LEVELDB_TABLE_FORMAT_H_
 
+#include <atomic>
 #include <cstdint>
 #include <string>
 
+#include "leveldb/cache.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 #include "leveldb/table_builder.h"
+#include "leveldb/table_properties.h"
 
 namespace leveldb {
 
@@ -78,10 +81,72 @@ static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// The metaindex maps kPropertiesBlock to a block that maps the name of
+// each TableProperties field to its value, encoded as a varint64.
+static const char kPropertiesBlock[] = "leveldb.properties";
+
+// The metaindex maps kRangeDelBlock to a block of the range tombstones of
+// the table, as described in db/range_tombstone.h, if it has any.
+static const char kRangeDelBlock[] = "leveldb.range_del";
+
+struct TablePropertyField {
+  const char* name;
+  uint64_t TableProperties::*field;
+};
+
+// The fields of TableProperties, in the order of their names.
+extern const TablePropertyField kTablePropertyFields[];
+extern const int kNumTablePropertyFields;
+
 struct BlockContents {
   Slice data;           // Actual contents of data
   bool cachable;        // True iff data can be cached
   bool heap_allocated;  // True iff caller should delete[] data.data()
+  bool raw_cachable;    // True iff a raw block cache saves rereading data
+
+  // The bytes of a compressed block as stored in the file, followed by the
+  // compression type, if they were kept so that the block can move to a
+  // raw block cache without being recompressed.  Empty otherwise.
+  std::string raw;
+};
+
+// The raw block cache that the blocks of one table move to when the block
+// cache evicts them.  The table and each of its blocks in the block cache
+// hold a reference.  The table closes the tier when it goes away, since
+// nothing can look up its blocks after that.
+class RawBlockTier {
+ public:
+  // Starts with a single reference, for the table.
+  RawBlockTier(Cache* cache, uint64_t cache_id)
+      : cache_(cache), cache_id_(cache_id), closed_(false), refs_(1) {}
+
+  RawBlockTier(const RawBlockTier&) = delete;
+  RawBlockTier& operator=(const RawBlockTier&) = delete;
+
+  Cache* cache() const { return cache_; }
+  uint64_t cache_id() const { return cache_id_; }
+  bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+  void Ref() { refs_.fetch_add(1, std::memory_order_relaxed); }
+  void Unref() {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  // Stops moving blocks to the tier and drops the table's reference.
+  void Close() {
+    closed_.store(true, std::memory_order_release);
+    Unref();
+  }
+
+ private:
+  ~RawBlockTier() = default;
+
+  Cache* const cache_;
+  const uint64_t cache_id_;
+  std::atomic<bool> closed_;
+  std::atomic<int> refs_;
 };
 
 // Read the block identified by "handle" from "file".  On failure
@@ -89,6 +154,42 @@ struct BlockContents {
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
                  const BlockHandle& handle, BlockContents* result);
 
+// Like ReadBlock(), but first looks for the block's raw (possibly
+// compressed) bytes in the cache of "tier".  Blocks get there only when the
+// caller's block cache evicts them (see InsertCachedBlock()), and a block
+// found there is taken out of it if options.fill_cache is set, since the
+// caller then holds it in its block cache.  A null "tier" behaves exactly
+// like ReadBlock().
+Status ReadBlockThroughCache(const RawBlockTier* tier, RandomAccessFile* file,
+                             const ReadOptions& options,
+                             const BlockHandle& handle, BlockContents* result);
+
+// Like ReadBlockThroughCache() for the "num" blocks identified by
+// handles[0..num-1], storing each block in results[i] and the outcome of
+// reading it in statuses[i].  The blocks missing from the cache of "tier"
+// are read from "file" with a single MultiRead() call, so that storage can
+// serve them in parallel.
+void ReadBlocksThroughCache(const RawBlockTier* tier, RandomAccessFile* file,
+                            const ReadOptions& options,
+                            const BlockHandle* handles, size_t num,
+                            BlockContents* results, Status* statuses);
+
+// Inserts "block", which was built from "contents" and is deleted with
+// "delete_block", into "block_cache" under "key" and returns its handle.
+// When block_cache evicts it, the block moves to "tier" as the file stores
+// it, so that a later ReadBlockThroughCache() of the block at "offset"
+// finds it there.  Blocks the file serves from memory (see
+// BlockContents::raw_cachable) are not moved, nor is anything if "tier" is
+// null or closed.  The bytes kept in contents.raw are charged on top of
+// "charge".
+Cache::Handle* InsertCachedBlock(Cache* block_cache, const Slice& key,
+                                 void* block, void (*delete_block)(void*),
+                                 size_t charge, BlockContents* contents,
+                                 RawBlockTier* tier, uint64_t offset);
+
+// Returns the block held by an entry that InsertCachedBlock() added.
+void* CachedBlockValue(Cache* block_cache, Cache::Handle* handle);
+
 // Implementation details follow.  Clients should ignore,
 
 inline BlockHandle::BlockHandle()
@@ -24,7 +24,7 @@ class IteratorWrapper {
   // Takes ownership of "iter" and will delete it when destroyed, or
   // when Set() is invoked again.
   void Set(Iterator* iter) {
-    //delete iter_; //????
+    delete iter_;
     iter_ = iter;
     if (iter_ == nullptr) {
       valid_ = false;
@@ -63,6 +63,11 @@ class IteratorWrapper {
     iter_->Seek(k);
     Update();
   }
+  void SeekForPrefix(const Slice& k) {
+    assert(iter_);
+    iter_->SeekForPrefix(k);
+    Update();
+  }
   void SeekToFirst() {
     assert(iter_);
     iter_->SeekToFirst();
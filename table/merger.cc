@@ -52,6 +52,14 @@ class MergingIterator : public Iterator {
     direction_ = kForward;
   }
 
+  void SeekForPrefix(const Slice& target) override {
+    for (int i = 0; i < n_; i++) {
+      children_[i].SeekForPrefix(target);
+    }
+    FindSmallest();
+    direction_ = kForward;
+  }
+
   void Next() override {
     assert(Valid());
 
@@ -22,12 +22,16 @@ struct Table::Rep {
     delete filter;
     delete[] filter_data;
     delete index_block;
+    if (raw_tier != nullptr) {
+      raw_tier->Close();
+    }
   }
 
   Options options;
   Status status;
   RandomAccessFile* file;
   uint64_t cache_id;
+  RawBlockTier* raw_tier;  // Null if blocks do not move on eviction
   FilterBlockReader* filter;
   const char* filter_data;
 
@@ -70,6 +74,16 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     rep->metaindex_handle = footer.metaindex_handle();
     rep->index_block = index_block;
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
+    if (options.block_cache == nullptr ||
+        options.compressed_block_cache == options.block_cache) {
+      // Blocks only reach the compressed cache by leaving the block cache.
+      rep->options.compressed_block_cache = nullptr;
+    }
+    Cache* compressed_cache = rep->options.compressed_block_cache;
+    rep->raw_tier =
+        (compressed_cache ? new RawBlockTier(compressed_cache,
+                                             compressed_cache->NewId())
+                          : nullptr);
     rep->filter_data = nullptr;
     rep->filter = nullptr;
     *table = new Table(rep);
@@ -137,9 +151,8 @@ static void DeleteBlock(void* arg, void* ignored) {
   delete reinterpret_cast<Block*>(arg);
 }
 
-static void DeleteCachedBlock(const Slice& key, void* value) {
-  Block* block = reinterpret_cast<Block*>(value);
-  delete block;
+static void DeleteCachedBlock(void* block) {
+  delete reinterpret_cast<Block*>(block);
 }
 
 static void ReleaseBlock(void* arg, void* h) {
@@ -172,14 +185,17 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
       Slice key(cache_key_buffer, sizeof(cache_key_buffer));
       cache_handle = block_cache->Lookup(key);
       if (cache_handle != nullptr) {
-        block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
+        block = reinterpret_cast<Block*>(
+            CachedBlockValue(block_cache, cache_handle));
       } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        s = ReadBlockThroughCache(table->rep_->raw_tier, table->rep_->file,
+                                  options, handle, &contents);
         if (s.ok()) {
           block = new Block(contents);
           if (contents.cachable && options.fill_cache) {
-            cache_handle = block_cache->Insert(key, block, block->size(),
-                                               &DeleteCachedBlock);
+            cache_handle = InsertCachedBlock(
+                block_cache, key, block, &DeleteCachedBlock, block->size(),
+                &contents, table->rep_->raw_tier, handle.offset());
           }
         }
       }
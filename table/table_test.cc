@@ -4,6 +4,7 @@
 
 #include "leveldb/table.h"
 
+#include <cstdio>
 #include <map>
 #include <string>
 
@@ -11,6 +12,7 @@
 #include "db/dbformat.h"
 #include "db/memtable.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
@@ -785,6 +787,151 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 610000, 612000));
 }
 
+// Counts the reads issued against a StringSource.  If "in_place" is set,
+// reads point into the contents, as they do for mmap'd files.
+class CountingSource : public StringSource {
+ public:
+  explicit CountingSource(const Slice& contents, bool in_place = false)
+      : StringSource(contents), contents_(contents), in_place_(in_place),
+        reads_(0) {}
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    reads_++;
+    if (in_place_) {
+      *result = Slice(contents_.data() + offset, n);
+      return Status::OK();
+    }
+    return StringSource::Read(offset, n, result, scratch);
+  }
+
+  int reads() const { return reads_; }
+
+ private:
+  const Slice contents_;
+  const bool in_place_;
+  mutable int reads_;
+};
+
+TEST(TableTest, CompressedBlockCache) {
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[16];
+  for (int i = 0; i < 200; i++) {
+    std::snprintf(key, sizeof(key), "k%06d", i);
+    builder.Add(key, std::string(100, 'a' + (i % 26)));
+  }
+  ASSERT_LEVELDB_OK(builder.Finish());
+
+  // An uncached primary tier, so every block moves to the secondary tier
+  // as soon as it is released.
+  Cache* block_cache = NewLRUCache(0);
+  Cache* compressed_cache = NewLRUCache(1 << 20);
+  options.block_cache = block_cache;
+  options.compressed_block_cache = compressed_cache;
+  CountingSource source(sink.contents());
+  Table* table;
+  ASSERT_LEVELDB_OK(
+      Table::Open(options, &source, sink.contents().size(), &table));
+
+  const int open_reads = source.reads();
+  int first_pass_reads = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    Iterator* iter = table->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      std::snprintf(key, sizeof(key), "k%06d", count);
+      ASSERT_EQ(key, iter->key().ToString());
+      ASSERT_EQ(std::string(100, 'a' + (count % 26)), iter->value().ToString());
+      count++;
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    ASSERT_EQ(200, count);
+    delete iter;
+    if (pass == 0) {
+      first_pass_reads = source.reads();
+    }
+  }
+  // The first pass reads each data block once; the second pass is served
+  // entirely from the secondary tier.
+  ASSERT_EQ(first_pass_reads, source.reads());
+  const int data_block_reads = source.reads() - open_reads;
+  ASSERT_GT(data_block_reads, 10);
+  ASSERT_LE(compressed_cache->TotalCharge(), sink.contents().size());
+
+  // Without fill_cache nothing new is admitted.
+  compressed_cache->Prune();
+  ASSERT_EQ(0, compressed_cache->TotalCharge());
+  ReadOptions no_fill;
+  no_fill.fill_cache = false;
+  Iterator* iter = table->NewIterator(no_fill);
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+  }
+  delete iter;
+  ASSERT_EQ(0, compressed_cache->TotalCharge());
+  ASSERT_EQ(2 * data_block_reads, source.reads() - open_reads);
+  delete table;
+  delete block_cache;
+
+  // Blocks held by the primary tier are not also held by the secondary
+  // tier; they move there when the primary tier evicts them.
+  for (bool in_place : {false, true}) {
+    block_cache = NewLRUCache(1 << 20);
+    options.block_cache = block_cache;
+    CountingSource cached_source(sink.contents(), in_place);
+    ASSERT_LEVELDB_OK(
+        Table::Open(options, &cached_source, sink.contents().size(), &table));
+    iter = table->NewIterator(ReadOptions());
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    delete iter;
+    ASSERT_EQ(0, compressed_cache->TotalCharge());
+    block_cache->Prune();
+    if (in_place) {
+      // Blocks served from memory are never worth keeping.
+      ASSERT_EQ(0, compressed_cache->TotalCharge());
+    } else {
+      ASSERT_GT(compressed_cache->TotalCharge(), 0);
+      ASSERT_LE(compressed_cache->TotalCharge(), sink.contents().size());
+    }
+    compressed_cache->Prune();
+    delete table;
+    delete block_cache;
+  }
+
+  // Blocks of a closed table are not moved, since nothing can look them up.
+  block_cache = NewLRUCache(1 << 20);
+  options.block_cache = block_cache;
+  ASSERT_LEVELDB_OK(
+      Table::Open(options, &source, sink.contents().size(), &table));
+  iter = table->NewIterator(ReadOptions());
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+  }
+  delete iter;
+  delete table;
+  ASSERT_GT(block_cache->TotalCharge(), 0);
+  block_cache->Prune();
+  ASSERT_EQ(0, compressed_cache->TotalCharge());
+
+  // A block cache is not also used as its own compressed cache.
+  options.compressed_block_cache = block_cache;
+  ASSERT_LEVELDB_OK(
+      Table::Open(options, &source, sink.contents().size(), &table));
+  iter = table->NewIterator(ReadOptions());
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+  }
+  delete iter;
+  block_cache->Prune();
+  ASSERT_EQ(0, block_cache->TotalCharge());
+  delete table;
+  delete block_cache;
+  delete compressed_cache;
+}
+
 static bool CompressionSupported(CompressionType type) {
   std::string out;
   Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
@@ -4,6 +4,8 @@
 
 #include "table/two_level_iterator.h"
 
+#include "db/dbformat.h"
+#include "leveldb/comparator.h"
 #include "leveldb/table.h"
 #include "table/block.h"
 #include "table/format.h"
@@ -18,11 +20,13 @@ typedef Iterator* (*BlockFunction)(void*, const ReadOptions&, const Slice&);
 class TwoLevelIterator : public Iterator {
  public:
   TwoLevelIterator(Iterator* index_iter, BlockFunction block_function,
-                   void* arg, const ReadOptions& options);
+                   void* arg, const ReadOptions& options,
+                   const Comparator* internal_comparator);
 
   ~TwoLevelIterator() override;
 
   void Seek(const Slice& target) override;
+  void SeekForPrefix(const Slice& target) override;
   void SeekToFirst() override;
   void SeekToLast() override;
   void Next() override;
@@ -52,14 +56,32 @@ class TwoLevelIterator : public Iterator {
   void SaveError(const Status& s) {
     if (status_.ok() && !s.ok()) status_ = s;
   }
-  void SkipEmptyDataBlocksForward();
+  void SkipEmptyDataBlocksForward(bool stop_at_upper_bound);
   void SkipEmptyDataBlocksBackward();
   void SetDataIterator(Iterator* data_iter);
   void InitDataBlock();
 
+  // True if the blocks after the current one are all past the upper bound.
+  bool NextBlocksPastUpperBound() {
+    return has_upper_bound_ && index_iter_.Valid() &&
+           cmp_->Compare(index_iter_.key(), upper_bound_) >= 0;
+  }
+
+  // True if the current block is all before the lower bound.
+  bool BlockBeforeLowerBound() {
+    return has_lower_bound_ && index_iter_.Valid() &&
+           cmp_->Compare(index_iter_.key(), lower_bound_) < 0;
+  }
+
   BlockFunction block_function_;
   void* arg_;
   const ReadOptions options_;
+  const Comparator* const cmp_;
+  // The smallest internal keys with the bounds' user keys, if set.
+  bool has_lower_bound_;
+  bool has_upper_bound_;
+  std::string lower_bound_;
+  std::string upper_bound_;
   Status status_;
   IteratorWrapper index_iter_;
   IteratorWrapper data_iter_;  // May be nullptr
@@ -70,12 +92,27 @@ class TwoLevelIterator : public Iterator {
 
 TwoLevelIterator::TwoLevelIterator(Iterator* index_iter,
                                    BlockFunction block_function, void* arg,
-                                   const ReadOptions& options)
+                                   const ReadOptions& options,
+                                   const Comparator* internal_comparator)
     : block_function_(block_function),
       arg_(arg),
       options_(options),
+      cmp_(internal_comparator),
+      has_lower_bound_(cmp_ != nullptr && options.iterate_lower_bound != nullptr),
+      has_upper_bound_(cmp_ != nullptr && options.iterate_upper_bound != nullptr),
       index_iter_(index_iter),
-      data_iter_(nullptr) {}
+      data_iter_(nullptr) {
+  if (has_lower_bound_) {
+    AppendInternalKey(&lower_bound_,
+                      ParsedInternalKey(*options.iterate_lower_bound,
+                                        kMaxSequenceNumber, kValueTypeForSeek));
+  }
+  if (has_upper_bound_) {
+    AppendInternalKey(&upper_bound_,
+                      ParsedInternalKey(*options.iterate_upper_bound,
+                                        kMaxSequenceNumber, kValueTypeForSeek));
+  }
+}
 
 TwoLevelIterator::~TwoLevelIterator() = default;
 
@@ -83,14 +120,23 @@ void TwoLevelIterator::Seek(const Slice& target) {
   index_iter_.Seek(target);
   InitDataBlock();
   if (data_iter_.iter() != nullptr) data_iter_.Seek(target);
-  SkipEmptyDataBlocksForward();
+  // The entry at or after "target" is found even past the upper bound, so
+  // that callers can step back from it, as DBIter::SeekToLast() does.
+  SkipEmptyDataBlocksForward(false);
+}
+
+void TwoLevelIterator::SeekForPrefix(const Slice& target) {
+  index_iter_.Seek(target);
+  InitDataBlock();
+  if (data_iter_.iter() != nullptr) data_iter_.SeekForPrefix(target);
+  SkipEmptyDataBlocksForward(false);
 }
 
 void TwoLevelIterator::SeekToFirst() {
   index_iter_.SeekToFirst();
   InitDataBlock();
   if (data_iter_.iter() != nullptr) data_iter_.SeekToFirst();
-  SkipEmptyDataBlocksForward();
+  SkipEmptyDataBlocksForward(true);
 }
 
 void TwoLevelIterator::SeekToLast() {
@@ -103,7 +149,7 @@ void TwoLevelIterator::SeekToLast() {
 void TwoLevelIterator::Next() {
   assert(Valid());
   data_iter_.Next();
-  SkipEmptyDataBlocksForward();
+  SkipEmptyDataBlocksForward(true);
 }
 
 void TwoLevelIterator::Prev() {
@@ -112,10 +158,11 @@ void TwoLevelIterator::Prev() {
   SkipEmptyDataBlocksBackward();
 }
 
-void TwoLevelIterator::SkipEmptyDataBlocksForward() {
+void TwoLevelIterator::SkipEmptyDataBlocksForward(bool stop_at_upper_bound) {
   while (data_iter_.iter() == nullptr || !data_iter_.Valid()) {
     // Move to next block
-    if (!index_iter_.Valid()) {
+    if (!index_iter_.Valid() ||
+        (stop_at_upper_bound && NextBlocksPastUpperBound())) {
       SetDataIterator(nullptr);
       return;
     }
@@ -133,6 +180,10 @@ void TwoLevelIterator::SkipEmptyDataBlocksBackward() {
       return;
     }
     index_iter_.Prev();
+    if (BlockBeforeLowerBound()) {
+      SetDataIterator(nullptr);
+      return;
+    }
     InitDataBlock();
     if (data_iter_.iter() != nullptr) data_iter_.SeekToLast();
   }
@@ -164,8 +215,10 @@ void TwoLevelIterator::InitDataBlock() {
 
 Iterator* NewTwoLevelIterator(Iterator* index_iter,
                               BlockFunction block_function, void* arg,
-                              const ReadOptions& options) {
-  return new TwoLevelIterator(index_iter, block_function, arg, options);
+                              const ReadOptions& options,
+                              const Comparator* internal_comparator) {
+  return new TwoLevelIterator(index_iter, block_function, arg, options,
+                              internal_comparator);
 }
 
 }  // namespace leveldb
@@ -9,6 +9,7 @@
 
 namespace leveldb {
 
+class Comparator;
 struct ReadOptions;
 
 // Return a new two level iterator.  A two-level iterator contains an
@@ -20,11 +21,18 @@ struct ReadOptions;
 //
 // Uses a supplied function to convert an index_iter value into
 // an iterator over the contents of the corresponding block.
+//
+// If "internal_comparator" is non-null, the keys of the index and of the
+// blocks are internal keys ordered by it, and each index key is no less
+// than the keys of its block and less than those of the next block.  The
+// iterator then does not load blocks that lie wholly outside
+// options.iterate_lower_bound and options.iterate_upper_bound.
 Iterator* NewTwoLevelIterator(
     Iterator* index_iter,
     Iterator* (*block_function)(void* arg, const ReadOptions& options,
                                 const Slice& index_value),
-    void* arg, const ReadOptions& options);
+    void* arg, const ReadOptions& options,
+    const Comparator* internal_comparator = nullptr);
 
 }  // namespace leveldb
 
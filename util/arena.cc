@@ -4,17 +4,159 @@
 
 #include "util/arena.h"
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // defined(__linux__)
+
+#include "util/mutexlock.h"
+
 namespace leveldb {
 
 static const int kBlockSize = 4096;
 
-Arena::Arena()
-    : alloc_ptr_(nullptr), alloc_bytes_remaining_(0), memory_usage_(0) {}
+namespace {
+
+// Returns the NUMA node of the calling thread, or -1 if unknown.
+int CurrentNumaNode() {
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned int cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+    return static_cast<int>(node);
+  }
+#endif  // defined(__linux__) && defined(SYS_getcpu)
+  return -1;
+}
+
+// Maps "size" bytes (a multiple of the huge page size) for an arena region,
+// backed by huge pages and placed on NUMA node "node" where possible.
+// Returns nullptr on failure.
+char* MapRegion(size_t size, int node) {
+#if defined(__linux__)
+  // Explicitly reserved huge pages first.  Mapping fails up front if none
+  // are available, in which case we fall back to regular pages.
+  void* result = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+  result = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif  // defined(MAP_HUGETLB)
+  if (result == MAP_FAILED) {
+    // Over-map so the region can be aligned to its size, which transparent
+    // huge pages need in order to back it, then trim the excess.
+    const size_t mapped_size = 2 * size;
+    void* mapped = ::mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+      return nullptr;
+    }
+    char* base = reinterpret_cast<char*>(mapped);
+    char* aligned = reinterpret_cast<char*>(
+        (reinterpret_cast<uintptr_t>(base) + size - 1) & ~(size - 1));
+    if (aligned > base) {
+      ::munmap(base, aligned - base);
+    }
+    if (aligned + size < base + mapped_size) {
+      ::munmap(aligned + size, base + mapped_size - (aligned + size));
+    }
+    result = aligned;
+#if defined(MADV_HUGEPAGE)
+    ::madvise(result, size, MADV_HUGEPAGE);
+#endif  // defined(MADV_HUGEPAGE)
+  }
+#if defined(SYS_mbind)
+  if (node >= 0 && node < static_cast<int>(8 * sizeof(unsigned long))) {
+    // Prefer the writer's node; pages are placed when first touched.
+    static const int kMpolPreferred = 1;
+    unsigned long node_mask = 1UL << node;
+    syscall(SYS_mbind, result, size, kMpolPreferred, &node_mask,
+            8 * sizeof(node_mask) + 1, 0);
+  }
+#endif  // defined(SYS_mbind)
+  return reinterpret_cast<char*>(result);
+#else
+  (void)node;
+  return new char[size];
+#endif  // defined(__linux__)
+}
+
+void UnmapRegion(char* region, size_t size) {
+#if defined(__linux__)
+  ::munmap(region, size);
+#else
+  (void)size;
+  delete[] region;
+#endif  // defined(__linux__)
+}
+
+}  // namespace
+
+ArenaRegionPool::ArenaRegionPool(size_t max_free_regions)
+    : max_free_regions_(max_free_regions) {}
+
+ArenaRegionPool::~ArenaRegionPool() {
+  for (size_t i = 0; i < free_.size(); i++) {
+    UnmapRegion(free_[i].data, kRegionSize);
+  }
+}
+
+bool ArenaRegionPool::Acquire(Region* region) {
+  const int node = CurrentNumaNode();
+  {
+    MutexLock l(&mu_);
+    if (!free_.empty()) {
+      // Prefer a region on our node, otherwise reuse any free one.
+      size_t pick = free_.size() - 1;
+      for (size_t i = 0; i < free_.size(); i++) {
+        if (free_[i].node == node) {
+          pick = i;
+          break;
+        }
+      }
+      *region = free_[pick];
+      free_[pick] = free_.back();
+      free_.pop_back();
+      return true;
+    }
+  }
+  region->data = MapRegion(kRegionSize, node);
+  region->node = node;
+  return region->data != nullptr;
+}
+
+void ArenaRegionPool::Release(const Region& region) {
+  {
+    MutexLock l(&mu_);
+    if (free_.size() < max_free_regions_) {
+      free_.push_back(region);
+      return;
+    }
+  }
+  UnmapRegion(region.data, kRegionSize);
+}
+
+size_t ArenaRegionPool::NumFreeRegions() {
+  MutexLock l(&mu_);
+  return free_.size();
+}
+
+Arena::Arena() : Arena(nullptr) {}
+
+Arena::Arena(ArenaRegionPool* pool)
+    : alloc_ptr_(nullptr),
+      alloc_bytes_remaining_(0),
+      pool_(pool),
+      region_ptr_(nullptr),
+      region_bytes_remaining_(0),
+      memory_usage_(0) {}
 
 Arena::~Arena() {
   for (size_t i = 0; i < blocks_.size(); i++) {
     delete[] blocks_[i];
   }
+  for (size_t i = 0; i < regions_.size(); i++) {
+    pool_->Release(regions_[i]);
+  }
 }
 
 char* Arena::AllocateFallback(size_t bytes) {
@@ -56,11 +198,38 @@ char* Arena::AllocateAligned(size_t bytes) {
 }
 
 char* Arena::AllocateNewBlock(size_t block_bytes) {
-  char* result = new char[block_bytes];
-  blocks_.push_back(result);
+  char* result = (pool_ != nullptr) ? AllocateFromRegion(block_bytes) : nullptr;
+  if (result == nullptr) {
+    result = new char[block_bytes];
+    blocks_.push_back(result);
+  }
   memory_usage_.fetch_add(block_bytes + sizeof(char*),
                           std::memory_order_relaxed);
   return result;
 }
 
+char* Arena::AllocateFromRegion(size_t block_bytes) {
+  // Keep region_ptr_ aligned, since blocks must be.
+  const size_t align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+  const size_t needed = (block_bytes + align - 1) & ~(align - 1);
+  if (needed > region_bytes_remaining_) {
+    if (needed > ArenaRegionPool::kRegionSize / 4) {
+      // Rather than wasting the rest of the current region, give large
+      // blocks their own allocation.
+      return nullptr;
+    }
+    ArenaRegionPool::Region region;
+    if (!pool_->Acquire(&region)) {
+      return nullptr;
+    }
+    regions_.push_back(region);
+    region_ptr_ = region.data;
+    region_bytes_remaining_ = ArenaRegionPool::kRegionSize;
+  }
+  char* result = region_ptr_;
+  region_ptr_ += needed;
+  region_bytes_remaining_ -= needed;
+  return result;
+}
+
 }  // namespace leveldb
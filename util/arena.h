@@ -11,12 +11,61 @@
 #include <cstdint>
 #include <vector>
 
+#include "port/port.h"
+#include "port/thread_annotations.h"
+
 namespace leveldb {
 
+// A pool of large memory regions that arenas carve their blocks from.
+// Regions are backed by huge pages when the system allows it, are placed
+// on the NUMA node of the thread that first needs them, and are handed
+// back to the pool when the owning arena is destroyed so that the next
+// memtable can reuse them without going back to the kernel.
+//
+// Thread-safe (provides internal synchronization).
+class ArenaRegionPool {
+ public:
+  // Size of each region: one 2MB huge page on common platforms.
+  static const size_t kRegionSize = 2 << 20;
+
+  struct Region {
+    char* data;  // kRegionSize bytes
+    int node;    // NUMA node the region was placed on, or -1 if unknown
+  };
+
+  // Keeps at most "max_free_regions" unused regions around for reuse.
+  explicit ArenaRegionPool(size_t max_free_regions);
+
+  ArenaRegionPool(const ArenaRegionPool&) = delete;
+  ArenaRegionPool& operator=(const ArenaRegionPool&) = delete;
+
+  ~ArenaRegionPool();
+
+  // Store a region in *region, preferring one on the NUMA node of the
+  // calling thread.  Returns false if no region could be mapped.  The
+  // caller must eventually pass the region to Release().
+  bool Acquire(Region* region);
+
+  // Return a region obtained from Acquire() to the pool.
+  void Release(const Region& region);
+
+  // Number of unused regions currently held by the pool.
+  size_t NumFreeRegions();
+
+ private:
+  const size_t max_free_regions_;
+  port::Mutex mu_;
+  std::vector<Region> free_ GUARDED_BY(mu_);
+};
+
 class Arena {
  public:
   Arena();
 
+  // Carve blocks from regions of "pool" instead of allocating them
+  // individually.  "pool" must outlive the arena.
+  explicit Arena(ArenaRegionPool* pool);
+
   Arena(const Arena&) = delete;
   Arena& operator=(const Arena&) = delete;
 
@@ -37,6 +86,7 @@ class Arena {
  private:
   char* AllocateFallback(size_t bytes);
   char* AllocateNewBlock(size_t block_bytes);
+  char* AllocateFromRegion(size_t block_bytes);
 
   // Allocation state
   char* alloc_ptr_;
@@ -45,6 +95,14 @@ class Arena {
   // Array of new[] allocated memory blocks
   std::vector<char*> blocks_;
 
+  // Pool that blocks are carved from, or nullptr to use new[] only.
+  ArenaRegionPool* const pool_;
+
+  // Regions obtained from pool_, and the unused tail of the last one.
+  std::vector<ArenaRegionPool::Region> regions_;
+  char* region_ptr_;
+  size_t region_bytes_remaining_;
+
   // Total memory usage of the arena.
   //
   // TODO(costan): This member is accessed via atomics, but the others are
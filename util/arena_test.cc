@@ -4,6 +4,8 @@
 
 #include "util/arena.h"
 
+#include <cstring>
+
 #include "gtest/gtest.h"
 #include "util/random.h"
 
@@ -58,4 +60,33 @@ TEST(ArenaTest, Simple) {
   }
 }
 
+TEST(ArenaTest, RegionPool) {
+  ArenaRegionPool pool(1);
+  {
+    Arena arena(&pool);
+    char* small = arena.Allocate(100);
+    char* aligned = arena.AllocateAligned(3000);
+    char* large = arena.Allocate(ArenaRegionPool::kRegionSize);
+    std::memset(small, 1, 100);
+    std::memset(aligned, 2, 3000);
+    std::memset(large, 3, ArenaRegionPool::kRegionSize);
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(aligned) & 7);
+    ASSERT_GE(arena.MemoryUsage(), ArenaRegionPool::kRegionSize + 3100);
+
+    // Spill over into a second region.
+    for (size_t i = 0; i < ArenaRegionPool::kRegionSize / 1000; i++) {
+      std::memset(arena.Allocate(1000), 4, 1000);
+    }
+    ASSERT_EQ(0, pool.NumFreeRegions());
+  }
+  // Only one of the two regions is kept for reuse.
+  ASSERT_EQ(1, pool.NumFreeRegions());
+  {
+    Arena arena(&pool);
+    arena.Allocate(100);
+    ASSERT_EQ(0, pool.NumFreeRegions());
+  }
+  ASSERT_EQ(1, pool.NumFreeRegions());
+}
+
 }  // namespace leveldb
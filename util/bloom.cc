@@ -4,6 +4,11 @@
 
 #include "leveldb/filter_policy.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define LEVELDB_BLOOM_AVX2 1
+#endif  // defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+
 #include "leveldb/slice.h"
 #include "util/hash.h"
 
@@ -83,10 +88,171 @@ class BloomFilterPolicy : public FilterPolicy {
   size_t bits_per_key_;
   size_t k_;
 };
+
+// Bytes per cache line, and the most probes a key may set in one line.
+const size_t kLineBytes = 64;
+const size_t kMaxBlockedProbes = 16;
+
+// A line is an array of up to kLineWords 32-bit little-endian words.  The k
+// probes of a key with hash h go to k consecutive slots t of the line,
+// starting at slot h % kLineWords and wrapping around.  Slot t is bit
+// ProbeBit(h * multipliers[t]) of word t, where multipliers[t] is the
+// (t+1)-th power of the golden ratio constant.  Filters shorter than a line
+// have fewer words, and map slot t to word t % (number of words).
+const size_t kLineWords = kLineBytes / 4;
+
+inline uint32_t FirstSlot(uint32_t h) { return h % kLineWords; }
+
+inline uint32_t ProbeBit(uint32_t probe_hash) { return probe_hash >> 27; }
+
+#if defined(LEVELDB_BLOOM_AVX2)
+// Checks all the probes of a full line at once: the masks of all 16 slots
+// are computed side by side, those outside the key's k slots are cleared,
+// and the line is tested against them.
+__attribute__((target("avx2"))) bool LineMayMatchAVX2(
+    const char* line, uint32_t h, size_t k, const uint32_t* multipliers) {
+  const __m256i hash = _mm256_set1_epi32(h);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i first = _mm256_set1_epi32(FirstSlot(h));
+  const __m256i probes = _mm256_set1_epi32(static_cast<int>(k));
+  const __m256i wrap = _mm256_set1_epi32(kLineWords - 1);
+  for (int i = 0; i < 2; i++) {
+    const __m256i slots =
+        _mm256_setr_epi32(8 * i + 0, 8 * i + 1, 8 * i + 2, 8 * i + 3,
+                          8 * i + 4, 8 * i + 5, 8 * i + 6, 8 * i + 7);
+    const __m256i probe_hashes = _mm256_mullo_epi32(
+        hash, _mm256_loadu_si256(
+                  reinterpret_cast<const __m256i*>(multipliers + 8 * i)));
+    __m256i masks =
+        _mm256_sllv_epi32(one, _mm256_srli_epi32(probe_hashes, 27));
+    // Slot t is probed iff (t - first) mod kLineWords < k.
+    const __m256i distance =
+        _mm256_and_si256(_mm256_sub_epi32(slots, first), wrap);
+    masks = _mm256_and_si256(masks, _mm256_cmpgt_epi32(probes, distance));
+    const __m256i words = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(line + 32 * i));
+    if (!_mm256_testc_si256(words, masks)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool HaveAVX2() {
+  static const bool have_avx2 = __builtin_cpu_supports("avx2");
+  return have_avx2;
+}
+#endif  // defined(LEVELDB_BLOOM_AVX2)
+
+// A bloom filter that sets all the probes of a key within one 64-byte line
+// of the filter, chosen by the key's hash, so that a lookup touches one
+// cache line instead of k of them.  Each probe sets a bit in a word of its
+// own, so all probes can be checked at once with SIMD instructions.  The
+// lower false positive rate of spreading the probes over the whole filter
+// is traded for speed.
+class BlockedBloomFilterPolicy : public FilterPolicy {
+ public:
+  explicit BlockedBloomFilterPolicy(int bits_per_key)
+      : bits_per_key_(bits_per_key) {
+    k_ = static_cast<size_t>(bits_per_key * 0.69);  // 0.69 =~ ln(2)
+    if (k_ < 1) k_ = 1;
+    if (k_ > kMaxBlockedProbes) k_ = kMaxBlockedProbes;
+    uint32_t multiplier = 1;
+    for (size_t j = 0; j < kMaxBlockedProbes; j++) {
+      multiplier *= 0x9e3779b9;
+      multipliers_[j] = multiplier;
+    }
+  }
+
+  const char* Name() const override { return "leveldb.BlockedBloomFilter"; }
+
+  // Per-block filters would be shorter than a line.
+  bool WholeTableFilter() const override { return true; }
+
+  void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
+    // A filter is a single line of whole 64-bit words, or whole lines.
+    size_t bytes = (n * bits_per_key_ + 7) / 8;
+    if (bytes < 8) bytes = 8;
+    if (bytes <= kLineBytes) {
+      bytes = (bytes + 7) / 8 * 8;
+    } else {
+      bytes = (bytes + kLineBytes - 1) / kLineBytes * kLineBytes;
+    }
+
+    const size_t init_size = dst->size();
+    dst->resize(init_size + bytes, 0);
+    dst->push_back(static_cast<char>(k_));  // Remember # of probes in filter
+    char* array = &(*dst)[init_size];
+    const size_t line_words = LineWords(bytes);
+    const size_t num_lines = NumLines(bytes);
+    for (int i = 0; i < n; i++) {
+      const uint32_t h = BloomHash(keys[i]);
+      char* line = array + LineIndex(h, num_lines) * kLineBytes;
+      for (size_t j = 0; j < k_; j++) {
+        const size_t slot = (FirstSlot(h) + j) % kLineWords;
+        const uint32_t bit = ProbeBit(h * multipliers_[slot]);
+        line[4 * (slot % line_words) + bit / 8] |= (1 << (bit % 8));
+      }
+    }
+  }
+
+  bool KeyMayMatch(const Slice& key, const Slice& bloom_filter) const override {
+    const size_t len = bloom_filter.size();
+    if (len < 2) return false;
+
+    const char* array = bloom_filter.data();
+    const size_t k = array[len - 1];
+    const size_t bytes = len - 1;
+    if (k > kMaxBlockedProbes || bytes < 8) {
+      // Reserved for potentially new encodings.  Consider it a match.
+      return true;
+    }
+    const size_t line_words = LineWords(bytes);
+
+    const uint32_t h = BloomHash(key);
+    const char* line = array + LineIndex(h, NumLines(bytes)) * kLineBytes;
+#if defined(LEVELDB_BLOOM_AVX2)
+    if (line_words == kLineWords && HaveAVX2()) {
+      return LineMayMatchAVX2(line, h, k, multipliers_);
+    }
+#endif  // defined(LEVELDB_BLOOM_AVX2)
+    for (size_t j = 0; j < k; j++) {
+      const size_t slot = (FirstSlot(h) + j) % kLineWords;
+      const uint32_t bit = ProbeBit(h * multipliers_[slot]);
+      if ((line[4 * (slot % line_words) + bit / 8] & (1 << (bit % 8))) == 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  // Returns the number of 32-bit words per line of a filter of "bytes"
+  // bytes, excluding the trailing probe count.
+  static size_t LineWords(size_t bytes) {
+    return bytes < kLineBytes ? bytes / 4 : kLineWords;
+  }
+
+  static size_t NumLines(size_t bytes) {
+    return bytes < kLineBytes ? 1 : bytes / kLineBytes;
+  }
+
+  static size_t LineIndex(uint32_t h, size_t num_lines) {
+    return (static_cast<uint64_t>(h) * num_lines) >> 32;
+  }
+
+  size_t bits_per_key_;
+  size_t k_;
+  uint32_t multipliers_[kMaxBlockedProbes];
+};
 }  // namespace
 
 const FilterPolicy* NewBloomFilterPolicy(int bits_per_key) {
   return new BloomFilterPolicy(bits_per_key);
 }
 
+const FilterPolicy* NewBlockedBloomFilterPolicy(int bits_per_key) {
+  return new BlockedBloomFilterPolicy(bits_per_key);
+}
+
 }  // namespace leveldb
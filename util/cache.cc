@@ -37,6 +37,11 @@ namespace {
 // Elements are moved between these lists by the Ref() and Unref() methods,
 // when they detect an element in the cache acquiring or losing its only
 // external reference.
+//
+// Entries whose last reference goes away under the mutex are collected on
+// a list and passed to their deleters after the mutex is released, so that
+// deleters neither hold up other users of the shard nor deadlock if they
+// use a cache themselves.
 
 // An entry is a variable length heap-allocated structure.  Entries
 // are kept in a circular doubly linked list ordered by access time.
@@ -173,8 +178,13 @@ class LRUCache {
   void LRU_Remove(LRUHandle* e);
   void LRU_Append(LRUHandle* list, LRUHandle* e);
   void Ref(LRUHandle* e);
-  void Unref(LRUHandle* e);
-  bool FinishErase(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Adds "e" to "*garbage" instead of deleting it when its last reference
+  // goes away.
+  void Unref(LRUHandle* e, LRUHandle** garbage);
+  bool FinishErase(LRUHandle* e, LRUHandle** garbage)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Passes the entries on "garbage" to their deleters and frees them.
+  static void FreeGarbage(LRUHandle* garbage);
 
   // Initialized before use.
   size_t capacity_;
@@ -205,14 +215,16 @@ LRUCache::LRUCache() : capacity_(0), usage_(0) {
 
 LRUCache::~LRUCache() {
   assert(in_use_.next == &in_use_);  // Error if caller has an unreleased handle
+  LRUHandle* garbage = nullptr;
   for (LRUHandle* e = lru_.next; e != &lru_;) {
     LRUHandle* next = e->next;
     assert(e->in_cache);
     e->in_cache = false;
     assert(e->refs == 1);  // Invariant of lru_ list.
-    Unref(e);
+    Unref(e, &garbage);
     e = next;
   }
+  FreeGarbage(garbage);
 }
 
 void LRUCache::Ref(LRUHandle* e) {
@@ -223,13 +235,14 @@ void LRUCache::Ref(LRUHandle* e) {
   e->refs++;
 }
 
-void LRUCache::Unref(LRUHandle* e) {
+void LRUCache::Unref(LRUHandle* e, LRUHandle** garbage) {
   assert(e->refs > 0);
   e->refs--;
-  if (e->refs == 0) {  // Deallocate.
+  if (e->refs == 0) {  // Deallocate once the mutex is released.
     assert(!e->in_cache);
-    (*e->deleter)(e->key(), e->value);
-    free(e);
+    // Not on either list, so "next" is free to link the garbage.
+    e->next = *garbage;
+    *garbage = e;
   } else if (e->in_cache && e->refs == 1) {
     // No longer in use; move to lru_ list.
     LRU_Remove(e);
@@ -237,6 +250,15 @@ void LRUCache::Unref(LRUHandle* e) {
   }
 }
 
+void LRUCache::FreeGarbage(LRUHandle* garbage) {
+  while (garbage != nullptr) {
+    LRUHandle* e = garbage;
+    garbage = e->next;
+    (*e->deleter)(e->key(), e->value);
+    free(e);
+  }
+}
+
 void LRUCache::LRU_Remove(LRUHandle* e) {
   e->next->prev = e->prev;
   e->prev->next = e->next;
@@ -260,16 +282,18 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
 }
 
 void LRUCache::Release(Cache::Handle* handle) {
-  MutexLock l(&mutex_);
-  Unref(reinterpret_cast<LRUHandle*>(handle));
+  LRUHandle* garbage = nullptr;
+  {
+    MutexLock l(&mutex_);
+    Unref(reinterpret_cast<LRUHandle*>(handle), &garbage);
+  }
+  FreeGarbage(garbage);
 }
 
 Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
                                 size_t charge,
                                 void (*deleter)(const Slice& key,
                                                 void* value)) {
-  MutexLock l(&mutex_);
-
   LRUHandle* e =
       reinterpret_cast<LRUHandle*>(malloc(sizeof(LRUHandle) - 1 + key.size()));
   e->value = value;
@@ -281,56 +305,69 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
   e->refs = 1;  // for the returned handle.
   std::memcpy(e->key_data, key.data(), key.size());
 
-  if (capacity_ > 0) {
-    e->refs++;  // for the cache's reference.
-    e->in_cache = true;
-    LRU_Append(&in_use_, e);
-    usage_ += charge;
-    FinishErase(table_.Insert(e));
-  } else {  // don't cache. (capacity_==0 is supported and turns off caching.)
-    // next is read by key() in an assert, so it must be initialized
-    e->next = nullptr;
-  }
-  while (usage_ > capacity_ && lru_.next != &lru_) {
-    LRUHandle* old = lru_.next;
-    assert(old->refs == 1);
-    bool erased = FinishErase(table_.Remove(old->key(), old->hash));
-    if (!erased) {  // to avoid unused variable when compiled NDEBUG
-      assert(erased);
+  LRUHandle* garbage = nullptr;
+  {
+    MutexLock l(&mutex_);
+    if (capacity_ > 0) {
+      e->refs++;  // for the cache's reference.
+      e->in_cache = true;
+      LRU_Append(&in_use_, e);
+      usage_ += charge;
+      FinishErase(table_.Insert(e), &garbage);
+    } else {  // don't cache. (capacity_==0 is supported and turns off caching.)
+      // next is read by key() in an assert, so it must be initialized
+      e->next = nullptr;
+    }
+    while (usage_ > capacity_ && lru_.next != &lru_) {
+      LRUHandle* old = lru_.next;
+      assert(old->refs == 1);
+      bool erased = FinishErase(table_.Remove(old->key(), old->hash), &garbage);
+      if (!erased) {  // to avoid unused variable when compiled NDEBUG
+        assert(erased);
+      }
     }
   }
+  FreeGarbage(garbage);
 
   return reinterpret_cast<Cache::Handle*>(e);
 }
 
 // If e != nullptr, finish removing *e from the cache; it has already been
 // removed from the hash table.  Return whether e != nullptr.
-bool LRUCache::FinishErase(LRUHandle* e) {
+bool LRUCache::FinishErase(LRUHandle* e, LRUHandle** garbage) {
   if (e != nullptr) {
     assert(e->in_cache);
     LRU_Remove(e);
     e->in_cache = false;
     usage_ -= e->charge;
-    Unref(e);
+    Unref(e, garbage);
   }
   return e != nullptr;
 }
 
 void LRUCache::Erase(const Slice& key, uint32_t hash) {
-  MutexLock l(&mutex_);
-  FinishErase(table_.Remove(key, hash));
+  LRUHandle* garbage = nullptr;
+  {
+    MutexLock l(&mutex_);
+    FinishErase(table_.Remove(key, hash), &garbage);
+  }
+  FreeGarbage(garbage);
 }
 
 void LRUCache::Prune() {
-  MutexLock l(&mutex_);
-  while (lru_.next != &lru_) {
-    LRUHandle* e = lru_.next;
-    assert(e->refs == 1);
-    bool erased = FinishErase(table_.Remove(e->key(), e->hash));
-    if (!erased) {  // to avoid unused variable when compiled NDEBUG
-      assert(erased);
+  LRUHandle* garbage = nullptr;
+  {
+    MutexLock l(&mutex_);
+    while (lru_.next != &lru_) {
+      LRUHandle* e = lru_.next;
+      assert(e->refs == 1);
+      bool erased = FinishErase(table_.Remove(e->key(), e->hash), &garbage);
+      if (!erased) {  // to avoid unused variable when compiled NDEBUG
+        assert(erased);
+      }
     }
   }
+  FreeGarbage(garbage);
 }
 
 static const int kNumShardBits = 4;
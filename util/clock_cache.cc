@@ -0,0 +1,415 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "leveldb/cache.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+namespace {
+
+// CLOCK cache implementation
+//
+// Entries live in a fixed-size open-addressing table whose slots are never
+// freed, so readers can probe it without locks: a lookup pins a slot by
+// bumping the reference count packed into the slot's atomic "meta" word,
+// and only then inspects the key.  Slots change owners only through
+// compare-and-swap on "meta", which requires the reference count to be
+// zero, so a pinned slot cannot be reused under a reader.
+//
+// Eviction uses the CLOCK algorithm with a small per-entry use counter.
+// Inserted entries start at zero and every hit raises the counter (up to
+// a maximum), while each pass of the clock hand lowers it.  An entry that
+// is read once, as in a long scan, is therefore evicted on the first pass,
+// and entries that are hit repeatedly survive several passes.
+//
+// Slot states:
+//   empty: no entry; may be claimed by an insert
+//   construction: exclusively owned by one thread that is filling or
+//     freeing the slot
+//   visible: holds an entry that Lookup() can return
+//   invisible: holds an erased or replaced entry that is still referenced
+//     by clients; freed when the last reference is released
+//
+// Probe sequences are linear.  Each slot counts how many entries were
+// placed past it on their probe sequence ("displacements"), so a lookup
+// can stop at the first non-matching slot with no displacements.
+
+struct ClockHandle {
+  // State (2 bits) | use counter (2 bits) | reference count (60 bits)
+  std::atomic<uint64_t> meta;
+  std::atomic<uint32_t> displacements;
+
+  // Written only while the slot is in the construction state.
+  uint32_t hash;
+  void* value;
+  void (*deleter)(const Slice&, void* value);
+  size_t charge;
+  size_t key_length;
+  char* key_data;
+
+  Slice key() const { return Slice(key_data, key_length); }
+};
+
+static const int kStateShift = 62;
+static const uint64_t kStateEmpty = 0;
+static const uint64_t kStateConstruction = uint64_t{1} << kStateShift;
+static const uint64_t kStateVisible = uint64_t{2} << kStateShift;
+static const uint64_t kStateInvisible = uint64_t{3} << kStateShift;
+static const uint64_t kStateMask = uint64_t{3} << kStateShift;
+
+static const int kUseShift = 60;
+static const uint64_t kOneUse = uint64_t{1} << kUseShift;
+static const uint64_t kUseMask = uint64_t{3} << kUseShift;
+
+static const uint64_t kOneRef = 1;
+static const uint64_t kRefMask = kOneUse - 1;
+
+// Aim for a load factor of 2/3 at the estimated entry charge.
+static const size_t kLoadFactorNumerator = 3;
+static const size_t kLoadFactorDenominator = 2;
+
+class ClockCache : public Cache {
+ public:
+  ClockCache(size_t capacity, size_t estimated_entry_charge);
+  ~ClockCache() override;
+
+  Handle* Insert(const Slice& key, void* value, size_t charge,
+                 void (*deleter)(const Slice& key, void* value)) override;
+  Handle* Lookup(const Slice& key) override;
+  void Release(Handle* handle) override;
+  void* Value(Handle* handle) override {
+    return reinterpret_cast<ClockHandle*>(handle)->value;
+  }
+  void Erase(const Slice& key) override;
+  uint64_t NewId() override {
+    return last_id_.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+  void Prune() override;
+  size_t TotalCharge() const override {
+    return usage_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  bool IsInTable(const ClockHandle* h) const {
+    return h >= slots_ && h < slots_ + num_slots_;
+  }
+
+  // Find a visible entry for key and return it with a reference held.
+  ClockHandle* FindAndRef(const Slice& key, uint32_t hash);
+
+  // Make every visible entry for key other than "keep" invisible.
+  void EraseMatching(const Slice& key, uint32_t hash, const ClockHandle* keep);
+
+  // Drop one reference, freeing the entry if it was the last reference to
+  // an invisible entry.
+  void Unref(ClockHandle* h);
+
+  // Make a visible entry invisible so Lookup() no longer finds it.
+  void MakeInvisible(ClockHandle* h);
+
+  // Free the entry in a slot owned by the caller (construction state) and
+  // return the slot to the empty state.
+  void FreeEntry(ClockHandle* h);
+
+  // Advance the clock hand until usage_ + charge fits in the capacity and,
+  // if "need_slot", at least one slot has been freed.  Every use counter
+  // drops to zero within four passes of the hand, which bounds the sweep.
+  // Returns true if a slot was freed.
+  bool Evict(size_t charge, bool need_slot);
+
+  // Try to evict a single unreferenced entry from slot h.
+  bool TryEvict(ClockHandle* h, bool force);
+
+  const size_t capacity_;
+  const size_t num_slots_;  // Power of two
+  ClockHandle* const slots_;
+  std::atomic<size_t> clock_hand_;
+  std::atomic<size_t> usage_;
+  std::atomic<uint64_t> last_id_;
+};
+
+static size_t TableSize(size_t capacity, size_t estimated_entry_charge) {
+  if (estimated_entry_charge == 0) {
+    estimated_entry_charge = 1;
+  }
+  const size_t entries = capacity / estimated_entry_charge;
+  const size_t wanted = entries * kLoadFactorNumerator / kLoadFactorDenominator;
+  size_t slots = 16;
+  while (slots < wanted) {
+    slots *= 2;
+  }
+  return slots;
+}
+
+ClockCache::ClockCache(size_t capacity, size_t estimated_entry_charge)
+    : capacity_(capacity),
+      num_slots_(TableSize(capacity, estimated_entry_charge)),
+      slots_(new ClockHandle[num_slots_]),
+      clock_hand_(0),
+      usage_(0),
+      last_id_(0) {
+  for (size_t i = 0; i < num_slots_; i++) {
+    slots_[i].meta.store(kStateEmpty, std::memory_order_relaxed);
+    slots_[i].displacements.store(0, std::memory_order_relaxed);
+  }
+}
+
+ClockCache::~ClockCache() {
+  for (size_t i = 0; i < num_slots_; i++) {
+    ClockHandle* h = &slots_[i];
+    const uint64_t state =
+        h->meta.load(std::memory_order_relaxed) & kStateMask;
+    if (state == kStateVisible || state == kStateInvisible) {
+      assert((h->meta.load(std::memory_order_relaxed) & kRefMask) == 0);
+      (*h->deleter)(h->key(), h->value);
+      delete[] h->key_data;
+    }
+  }
+  delete[] slots_;
+}
+
+ClockHandle* ClockCache::FindAndRef(const Slice& key, uint32_t hash) {
+  const size_t mask = num_slots_ - 1;
+  size_t index = hash & mask;
+  for (size_t probes = 0; probes < num_slots_; probes++) {
+    ClockHandle* h = &slots_[index];
+    uint64_t meta = h->meta.load(std::memory_order_acquire);
+    if ((meta & kStateMask) == kStateVisible) {
+      // Pin the slot before looking at its contents.
+      meta = h->meta.fetch_add(kOneRef, std::memory_order_acquire);
+      if ((meta & kStateMask) == kStateVisible && h->hash == hash &&
+          h->key() == key) {
+        return h;
+      }
+      Unref(h);
+    }
+    if (h->displacements.load(std::memory_order_relaxed) == 0) {
+      break;
+    }
+    index = (index + 1) & mask;
+  }
+  return nullptr;
+}
+
+void ClockCache::EraseMatching(const Slice& key, uint32_t hash,
+                               const ClockHandle* keep) {
+  // Concurrent inserts of the same key may each have published an entry,
+  // so keep going past the first match.
+  const size_t mask = num_slots_ - 1;
+  size_t index = hash & mask;
+  for (size_t probes = 0; probes < num_slots_; probes++) {
+    ClockHandle* h = &slots_[index];
+    if (h != keep &&
+        (h->meta.load(std::memory_order_acquire) & kStateMask) ==
+            kStateVisible) {
+      const uint64_t meta =
+          h->meta.fetch_add(kOneRef, std::memory_order_acquire);
+      if ((meta & kStateMask) == kStateVisible && h->hash == hash &&
+          h->key() == key) {
+        MakeInvisible(h);
+      }
+      Unref(h);
+    }
+    if (h->displacements.load(std::memory_order_relaxed) == 0) {
+      break;
+    }
+    index = (index + 1) & mask;
+  }
+}
+
+Cache::Handle* ClockCache::Lookup(const Slice& key) {
+  ClockHandle* h = FindAndRef(key, Hash(key.data(), key.size(), 0));
+  if (h != nullptr) {
+    // Record the hit, saturating the use counter.
+    uint64_t meta = h->meta.load(std::memory_order_relaxed);
+    while ((meta & kUseMask) != kUseMask &&
+           !h->meta.compare_exchange_weak(meta, meta + kOneUse,
+                                          std::memory_order_relaxed)) {
+    }
+  }
+  return reinterpret_cast<Cache::Handle*>(h);
+}
+
+void ClockCache::Release(Handle* handle) {
+  Unref(reinterpret_cast<ClockHandle*>(handle));
+}
+
+void ClockCache::Unref(ClockHandle* h) {
+  const uint64_t old_meta = h->meta.fetch_sub(kOneRef, std::memory_order_release);
+  assert((old_meta & kRefMask) > 0);
+  if ((old_meta & kStateMask) == kStateInvisible &&
+      (old_meta & kRefMask) == 1) {
+    // Last reference to an erased entry.  Take ownership unless someone
+    // else grabbed a transient reference in the meantime, in which case
+    // they will get here when they drop it.
+    uint64_t expected = old_meta - kOneRef;
+    if (h->meta.compare_exchange_strong(expected, kStateConstruction,
+                                        std::memory_order_acquire)) {
+      FreeEntry(h);
+    }
+  }
+}
+
+void ClockCache::MakeInvisible(ClockHandle* h) {
+  uint64_t meta = h->meta.load(std::memory_order_relaxed);
+  while ((meta & kStateMask) == kStateVisible) {
+    const uint64_t invisible = (meta & ~kStateMask) | kStateInvisible;
+    if (h->meta.compare_exchange_weak(meta, invisible,
+                                      std::memory_order_acq_rel)) {
+      break;
+    }
+  }
+}
+
+void ClockCache::FreeEntry(ClockHandle* h) {
+  (*h->deleter)(h->key(), h->value);
+  delete[] h->key_data;
+  usage_.fetch_sub(h->charge, std::memory_order_relaxed);
+
+  if (IsInTable(h)) {
+    // Undo the displacements recorded along this entry's probe sequence.
+    const size_t mask = num_slots_ - 1;
+    const size_t slot = h - slots_;
+    for (size_t i = h->hash & mask; i != slot; i = (i + 1) & mask) {
+      slots_[i].displacements.fetch_sub(1, std::memory_order_relaxed);
+    }
+    // Readers may hold transient references, so only clear the state.
+    h->meta.fetch_sub(kStateConstruction, std::memory_order_release);
+  } else {
+    delete h;
+  }
+}
+
+bool ClockCache::TryEvict(ClockHandle* h, bool force) {
+  uint64_t meta = h->meta.load(std::memory_order_relaxed);
+  if ((meta & kStateMask) != kStateVisible || (meta & kRefMask) != 0) {
+    return false;
+  }
+  if (!force && (meta & kUseMask) != 0) {
+    // Give the entry another pass of the clock hand.
+    h->meta.compare_exchange_strong(meta, meta - kOneUse,
+                                    std::memory_order_relaxed);
+    return false;
+  }
+  if (h->meta.compare_exchange_strong(meta, kStateConstruction,
+                                      std::memory_order_acquire)) {
+    FreeEntry(h);
+    return true;
+  }
+  return false;
+}
+
+bool ClockCache::Evict(size_t charge, bool need_slot) {
+  bool freed = false;
+  for (size_t step = 0; step < 4 * num_slots_; step++) {
+    if (usage_.load(std::memory_order_relaxed) + charge <= capacity_ &&
+        (freed || !need_slot)) {
+      break;
+    }
+    const size_t index =
+        clock_hand_.fetch_add(1, std::memory_order_relaxed) & (num_slots_ - 1);
+    if (TryEvict(&slots_[index], false)) {
+      freed = true;
+    }
+  }
+  return freed;
+}
+
+Cache::Handle* ClockCache::Insert(const Slice& key, void* value,
+                                  size_t charge,
+                                  void (*deleter)(const Slice& key,
+                                                  void* value)) {
+  const uint32_t hash = Hash(key.data(), key.size(), 0);
+
+  // An older entry for the same key is replaced.
+  EraseMatching(key, hash, nullptr);
+
+  // Make room.  If everything is pinned we go over capacity, just like the
+  // LRU cache.
+  if (usage_.load(std::memory_order_relaxed) + charge > capacity_) {
+    Evict(charge, false);
+  }
+
+  char* key_data = new char[key.size()];
+  std::memcpy(key_data, key.data(), key.size());
+  usage_.fetch_add(charge, std::memory_order_relaxed);
+
+  const size_t mask = num_slots_ - 1;
+  const size_t home = hash & mask;
+  ClockHandle* h = nullptr;
+  // A zero capacity turns off caching.
+  for (int attempt = 0; attempt < 2 && h == nullptr && capacity_ > 0;
+       attempt++) {
+    size_t index = home;
+    for (size_t probes = 0; probes < num_slots_; probes++) {
+      uint64_t expected = kStateEmpty;
+      if (slots_[index].meta.compare_exchange_strong(
+              expected, kStateConstruction, std::memory_order_acquire)) {
+        h = &slots_[index];
+        break;
+      }
+      slots_[index].displacements.fetch_add(1, std::memory_order_relaxed);
+      index = (index + 1) & mask;
+    }
+    if (h == nullptr) {
+      // The table is full of entries smaller than estimated.  Undo the
+      // displacements, evict something and try once more.
+      for (size_t i = 0; i < num_slots_; i++) {
+        slots_[(home + i) & mask].displacements.fetch_sub(
+            1, std::memory_order_relaxed);
+      }
+      if (!Evict(charge, true)) {
+        break;
+      }
+    }
+  }
+
+  uint64_t initial_state = kStateVisible;
+  if (h == nullptr) {
+    // No room in the table: hand out an entry that is not cached and is
+    // freed when released.
+    h = new ClockHandle;
+    h->meta.store(kStateConstruction, std::memory_order_relaxed);
+    h->displacements.store(0, std::memory_order_relaxed);
+    initial_state = kStateInvisible;
+  }
+  h->hash = hash;
+  h->value = value;
+  h->deleter = deleter;
+  h->charge = charge;
+  h->key_length = key.size();
+  h->key_data = key_data;
+  // Publish the entry with one reference for the caller.  Use an add so
+  // that transient references taken by concurrent readers are preserved.
+  h->meta.fetch_add(initial_state - kStateConstruction + kOneRef,
+                    std::memory_order_release);
+  // A concurrent Insert() of the same key may have published its entry
+  // since the check above; keep only this one.
+  EraseMatching(key, hash, h);
+  return reinterpret_cast<Cache::Handle*>(h);
+}
+
+void ClockCache::Erase(const Slice& key) {
+  EraseMatching(key, Hash(key.data(), key.size(), 0), nullptr);
+}
+
+void ClockCache::Prune() {
+  for (size_t i = 0; i < num_slots_; i++) {
+    TryEvict(&slots_[i], true);
+  }
+}
+
+}  // end anonymous namespace
+
+Cache* NewClockCache(size_t capacity, size_t estimated_entry_charge) {
+  return new ClockCache(capacity, estimated_entry_charge);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,308 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "leveldb/cache.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+static std::string EncodeKey(int k) {
+  std::string result;
+  PutFixed32(&result, k);
+  return result;
+}
+static int DecodeKey(const Slice& k) {
+  assert(k.size() == 4);
+  return DecodeFixed32(k.data());
+}
+static void* EncodeValue(uintptr_t v) { return reinterpret_cast<void*>(v); }
+static int DecodeValue(void* v) { return reinterpret_cast<uintptr_t>(v); }
+
+class ClockCacheTest : public testing::Test {
+ public:
+  static void Deleter(const Slice& key, void* v) {
+    current_->deleted_keys_.push_back(DecodeKey(key));
+    current_->deleted_values_.push_back(DecodeValue(v));
+  }
+
+  static constexpr int kCacheSize = 100;
+  std::vector<int> deleted_keys_;
+  std::vector<int> deleted_values_;
+  Cache* cache_;
+
+  ClockCacheTest() : cache_(NewClockCache(kCacheSize, 1)) { current_ = this; }
+
+  ~ClockCacheTest() { delete cache_; }
+
+  int Lookup(int key) {
+    Cache::Handle* handle = cache_->Lookup(EncodeKey(key));
+    const int r = (handle == nullptr) ? -1 : DecodeValue(cache_->Value(handle));
+    if (handle != nullptr) {
+      cache_->Release(handle);
+    }
+    return r;
+  }
+
+  void Insert(int key, int value, int charge = 1) {
+    cache_->Release(cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
+                                   &ClockCacheTest::Deleter));
+  }
+
+  Cache::Handle* InsertAndReturnHandle(int key, int value, int charge = 1) {
+    return cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
+                          &ClockCacheTest::Deleter);
+  }
+
+  void Erase(int key) { cache_->Erase(EncodeKey(key)); }
+  static ClockCacheTest* current_;
+};
+ClockCacheTest* ClockCacheTest::current_;
+
+TEST_F(ClockCacheTest, HitAndMiss) {
+  ASSERT_EQ(-1, Lookup(100));
+
+  Insert(100, 101);
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+
+  Insert(200, 201);
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+
+  Insert(100, 102);
+  ASSERT_EQ(102, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(100, deleted_keys_[0]);
+  ASSERT_EQ(101, deleted_values_[0]);
+}
+
+TEST_F(ClockCacheTest, Erase) {
+  Erase(200);
+  ASSERT_EQ(0, deleted_keys_.size());
+
+  Insert(100, 101);
+  Insert(200, 201);
+  Erase(100);
+  ASSERT_EQ(-1, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(100, deleted_keys_[0]);
+  ASSERT_EQ(101, deleted_values_[0]);
+
+  Erase(100);
+  ASSERT_EQ(1, deleted_keys_.size());
+}
+
+TEST_F(ClockCacheTest, EntriesArePinned) {
+  Insert(100, 101);
+  Cache::Handle* h1 = cache_->Lookup(EncodeKey(100));
+  ASSERT_EQ(101, DecodeValue(cache_->Value(h1)));
+
+  Insert(100, 102);
+  Cache::Handle* h2 = cache_->Lookup(EncodeKey(100));
+  ASSERT_EQ(102, DecodeValue(cache_->Value(h2)));
+  ASSERT_EQ(0, deleted_keys_.size());
+
+  cache_->Release(h1);
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(101, deleted_values_[0]);
+
+  Erase(100);
+  ASSERT_EQ(-1, Lookup(100));
+  ASSERT_EQ(1, deleted_keys_.size());
+
+  cache_->Release(h2);
+  ASSERT_EQ(2, deleted_keys_.size());
+  ASSERT_EQ(102, deleted_values_[1]);
+}
+
+TEST_F(ClockCacheTest, ScanResistance) {
+  // A small hot set that is hit repeatedly ...
+  for (int i = 0; i < 10; i++) {
+    Insert(i, i + 1000);
+    ASSERT_EQ(i + 1000, Lookup(i));
+    ASSERT_EQ(i + 1000, Lookup(i));
+  }
+  // ... survives a scan over many more keys than the cache holds.
+  for (int i = 100; i < 100 + 10 * kCacheSize; i++) {
+    Insert(i, i + 1000);
+    ASSERT_EQ(i + 1000, Lookup(i));
+    for (int j = 0; j < 10; j += 3) {
+      Lookup(j);
+    }
+  }
+  for (int i = 0; i < 10; i += 3) {
+    ASSERT_EQ(i + 1000, Lookup(i));
+  }
+  ASSERT_LE(cache_->TotalCharge(), kCacheSize);
+}
+
+TEST_F(ClockCacheTest, UseExceedsCacheSize) {
+  // Overfill the cache, keeping handles on all inserted entries.
+  std::vector<Cache::Handle*> h;
+  for (int i = 0; i < kCacheSize + 100; i++) {
+    h.push_back(InsertAndReturnHandle(1000 + i, 2000 + i));
+  }
+
+  // Check that all the entries can be found in the cache or are still
+  // usable through their handles.
+  for (size_t i = 0; i < h.size(); i++) {
+    ASSERT_EQ(2000 + static_cast<int>(i), DecodeValue(cache_->Value(h[i])));
+  }
+
+  for (size_t i = 0; i < h.size(); i++) {
+    cache_->Release(h[i]);
+  }
+}
+
+TEST_F(ClockCacheTest, HeavyEntries) {
+  // Add a bunch of light and heavy entries and then count the combined
+  // size of items still in the cache, which must be approximately the
+  // same as the total capacity.
+  const int kLight = 1;
+  const int kHeavy = 10;
+  int added = 0;
+  int index = 0;
+  while (added < 2 * kCacheSize) {
+    const int weight = (index & 1) ? kLight : kHeavy;
+    Insert(index, 1000 + index, weight);
+    added += weight;
+    index++;
+  }
+
+  int cached_weight = 0;
+  for (int i = 0; i < index; i++) {
+    const int weight = (i & 1 ? kLight : kHeavy);
+    int r = Lookup(i);
+    if (r >= 0) {
+      cached_weight += weight;
+      ASSERT_EQ(1000 + i, r);
+    }
+  }
+  ASSERT_LE(cached_weight, kCacheSize + kCacheSize / 10);
+}
+
+TEST_F(ClockCacheTest, NewId) {
+  uint64_t a = cache_->NewId();
+  uint64_t b = cache_->NewId();
+  ASSERT_NE(a, b);
+}
+
+TEST_F(ClockCacheTest, Prune) {
+  Insert(1, 100);
+  Insert(2, 200);
+
+  Cache::Handle* handle = cache_->Lookup(EncodeKey(1));
+  ASSERT_TRUE(handle);
+  cache_->Prune();
+  cache_->Release(handle);
+
+  ASSERT_EQ(100, Lookup(1));
+  ASSERT_EQ(-1, Lookup(2));
+}
+
+TEST_F(ClockCacheTest, ZeroSizeCache) {
+  delete cache_;
+  cache_ = NewClockCache(0, 1);
+
+  Insert(1, 100);
+  ASSERT_EQ(-1, Lookup(1));
+}
+
+TEST_F(ClockCacheTest, SmallerEntriesThanEstimated) {
+  // The table is sized for 10 entries of charge 10, but holds entries of
+  // charge 1.  Inserts must still succeed by evicting to free slots.
+  delete cache_;
+  cache_ = NewClockCache(kCacheSize, 10);
+  for (int i = 0; i < 10 * kCacheSize; i++) {
+    Insert(i, i + 1000);
+    ASSERT_EQ(i + 1000, Lookup(i));
+  }
+}
+
+static void NoopDeleter(const Slice& key, void* value) {}
+
+TEST(ClockCacheConcurrencyTest, ConcurrentLookupsAndInserts) {
+  Cache* cache = NewClockCache(1000, 1);
+  const int kThreads = 8;
+  const int kKeys = 2000;
+  std::atomic<int> errors(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([cache, t, &errors]() {
+      for (int i = 0; i < 20000; i++) {
+        const int k = (i * 7 + t * 13) % kKeys;
+        const std::string key = EncodeKey(k);
+        Cache::Handle* h = cache->Lookup(key);
+        if (h == nullptr) {
+          h = cache->Insert(key, EncodeValue(k), 1, &NoopDeleter);
+        }
+        if (DecodeValue(cache->Value(h)) != k) {
+          errors.fetch_add(1);
+        }
+        cache->Release(h);
+        if (i % 97 == 0) {
+          cache->Erase(key);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(0, errors.load());
+  ASSERT_LE(cache->TotalCharge(), 1000);
+  delete cache;
+}
+
+static std::atomic<int> live_entries(0);
+
+static void CountingDeleter(const Slice& key, void* value) {
+  live_entries.fetch_sub(1);
+}
+
+TEST(ClockCacheConcurrencyTest, ConcurrentInsertsOfSameKey) {
+  Cache* cache = NewClockCache(10000, 1);
+  const int kThreads = 8;
+  const int kRounds = 200;
+  std::atomic<int> arrived(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([cache, t, &arrived]() {
+      for (int r = 0; r < kRounds; r++) {
+        // Every thread inserts the same new key at about the same time.
+        arrived.fetch_add(1);
+        while (arrived.load() < (r + 1) * kThreads) {
+          std::this_thread::yield();
+        }
+        live_entries.fetch_add(1);
+        cache->Release(
+            cache->Insert(EncodeKey(r), EncodeValue(t), 1, &CountingDeleter));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Racing inserts leave at most one entry per key behind, and a single
+  // Erase() removes it.
+  ASSERT_LE(cache->TotalCharge(), kRounds);
+  for (int r = 0; r < kRounds; r++) {
+    cache->Erase(EncodeKey(r));
+    ASSERT_TRUE(cache->Lookup(EncodeKey(r)) == nullptr) << r;
+  }
+  ASSERT_EQ(0, cache->TotalCharge());
+  ASSERT_EQ(0, live_entries.load());
+  delete cache;
+}
+
+}  // namespace leveldb
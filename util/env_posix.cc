@@ -13,6 +13,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
 #include <cstddef>
@@ -21,12 +22,14 @@
 #include <cstdlib>
 #include <cstring>
 #include <limits>
+#include <memory>
 #include <queue>
 #include <set>
 #include <string>
 #include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "leveldb/env.h"
 #include "leveldb/slice.h"
@@ -36,6 +39,11 @@
 #include "util/env_posix_test_helper.h"
 #include "util/posix_logger.h"
 
+#if HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif  // HAVE_IO_URING
+
 namespace leveldb {
 
 namespace {
@@ -58,6 +66,19 @@ constexpr const int kOpenBaseFlags = 0;
 
 constexpr const size_t kWritableFileBufferSize = 65536;
 
+// Flag requesting direct I/O from open(), where the platform has one.
+#if defined(O_DIRECT)
+constexpr const int kDirectIOFlag = O_DIRECT;
+#else
+constexpr const int kDirectIOFlag = 0;
+#endif  // defined(O_DIRECT)
+
+// Alignment of the buffers, offsets and lengths of direct I/O.
+constexpr const size_t kDirectIOAlignment = 4096;
+
+// Must be a multiple of kDirectIOAlignment.
+constexpr const size_t kDirectWritableFileBufferSize = 1 << 20;
+
 Status PosixError(const std::string& context, int error_number) {
   if (error_number == ENOENT) {
     return Status::NotFound(context, std::strerror(error_number));
@@ -66,6 +87,45 @@ Status PosixError(const std::string& context, int error_number) {
   }
 }
 
+// Opens |filename| for direct I/O.  File systems that reject O_DIRECT
+// (e.g. tmpfs) get a regular file descriptor, which still works with the
+// aligned I/O done on direct files.
+int OpenDirect(const std::string& filename, int flags, mode_t mode = 0) {
+  int fd = ::open(filename.c_str(), flags | kDirectIOFlag, mode);
+  if (fd < 0 && errno == EINVAL && kDirectIOFlag != 0) {
+    fd = ::open(filename.c_str(), flags, mode);
+  }
+#if defined(F_NOCACHE)
+  if (fd >= 0) {
+    // macOS has no O_DIRECT, but can bypass the cache per file descriptor.
+    ::fcntl(fd, F_NOCACHE, 1);
+  }
+#endif  // defined(F_NOCACHE)
+  return fd;
+}
+
+// A heap buffer aligned for direct I/O.
+class AlignedBuffer {
+ public:
+  explicit AlignedBuffer(size_t size) : data_(nullptr) {
+    void* data;
+    if (::posix_memalign(&data, kDirectIOAlignment, size) == 0) {
+      data_ = reinterpret_cast<char*>(data);
+    }
+  }
+
+  AlignedBuffer(const AlignedBuffer&) = delete;
+  AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+  ~AlignedBuffer() { std::free(data_); }
+
+  // nullptr if the allocation failed.
+  char* data() const { return data_; }
+
+ private:
+  char* data_;
+};
+
 // Helper class to limit resource usage to avoid exhaustion.
 // Currently used to limit read-only file descriptors and mmap file usage
 // so that we do not run out of file descriptors or virtual memory, or run into
@@ -168,6 +228,203 @@ class PosixSequentialFile final : public SequentialFile {
   const std::string filename_;
 };
 
+#if HAVE_IO_URING
+// A per-thread io_uring instance, used to submit the reads of a
+// PosixRandomAccessFile::MultiRead() batch together.
+//
+// Instances are not thread-safe; each thread uses its own.
+class IoUring {
+ public:
+  // Returns the calling thread's ring, or nullptr if io_uring is not
+  // usable (e.g. disabled in the kernel), in which case callers fall back
+  // to pread().  A ring holds a file descriptor, so it is only created
+  // once |fd_limiter| grants one; the limiter must outlive the thread.
+  static IoUring* ForCurrentThread(Limiter* fd_limiter) {
+    static thread_local std::unique_ptr<IoUring> ring;
+    if (ring == nullptr) {
+      if (!fd_limiter->Acquire()) {
+        return nullptr;  // Try again on a later batch.
+      }
+      ring.reset(new IoUring(fd_limiter));
+    }
+    return ring->ring_fd_ >= 0 ? ring.get() : nullptr;
+  }
+
+  ~IoUring() {
+    if (ring_fd_ >= 0) {
+      Unmap();
+      ::close(ring_fd_);
+      fd_limiter_->Release();
+    }
+  }
+
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+
+  // Reads reqs[i].n bytes at reqs[i].offset of "fd" into reqs[i].scratch
+  // for each i < num, and waits for the reads it issued.  Stores the
+  // outcome of each read in res[i]: the number of bytes read, or a negated
+  // errno.  If io_uring_enter() keeps failing, the reads not issued yet
+  // are left at -ECANCELED, for the caller to issue some other way.
+  void Read(int fd, RandomAccessFile::ReadRequest* reqs, size_t num,
+            int* res) {
+    std::fill(res, res + num, -ECANCELED);
+    bool enter_failed = false;
+    size_t next = 0;
+    while (next < num && !enter_failed) {
+      // Queue as many reads as fit in the submission ring.  We are its only
+      // producer, so the tail only needs to be published to the kernel.
+      unsigned tail = *sq_tail_;
+      unsigned queued = 0;
+      for (; next < num && queued < sq_entries_; next++, queued++) {
+        const unsigned index = tail & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(reqs[next].scratch);
+        sqe->len = static_cast<uint32_t>(reqs[next].n);
+        sqe->off = reqs[next].offset;
+        sqe->user_data = next;
+        sq_array_[index] = index;
+        tail++;
+      }
+      __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+      unsigned to_submit = queued;
+      unsigned reaped = 0;
+      int retries = 0;
+      while (reaped < queued) {
+        if (!enter_failed) {
+          int ret = ::syscall(__NR_io_uring_enter, ring_fd_, to_submit, 1,
+                              IORING_ENTER_GETEVENTS, nullptr, 0);
+          if (ret >= 0) {
+            to_submit -= static_cast<unsigned>(ret);
+            retries = 0;
+          } else if (errno == EINTR || ((errno == EAGAIN || errno == EBUSY) &&
+                                        ++retries < kMaxRetries)) {
+            // Transient; try again.
+          } else {
+            // Withdraw the reads the kernel has not taken, which we can do
+            // as the ring's only producer, and stop issuing reads.
+            __atomic_store_n(sq_tail_, tail - to_submit, __ATOMIC_RELEASE);
+            queued -= to_submit;
+            to_submit = 0;
+            enter_failed = true;
+          }
+        } else {
+          // Reads in flight still target the caller's buffers, so block
+          // until they complete.  Submitting nothing only waits on the
+          // completion ring, which we drain below; failures here (EINTR,
+          // or a transient EAGAIN/EBUSY) just mean waiting again.
+          ::syscall(__NR_io_uring_enter, ring_fd_, 0, queued - reaped,
+                    IORING_ENTER_GETEVENTS, nullptr, 0);
+        }
+        reaped += ReapCompletions(res);
+      }
+    }
+  }
+
+ private:
+  // Reads submitted per io_uring_enter() call.
+  static constexpr unsigned kEntries = 64;
+
+  // Consecutive EAGAIN or EBUSY failures of io_uring_enter() tolerated.
+  static constexpr int kMaxRetries = 100;
+
+  // Stores the outcome of each completed read in res, and returns the
+  // number of reads completed.  We are the only consumer of the
+  // completion ring.
+  unsigned ReapCompletions(int* res) {
+    unsigned head = *cq_head_;
+    const unsigned cq_tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    unsigned reaped = 0;
+    for (; head != cq_tail; head++, reaped++) {
+      const io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+      res[cqe->user_data] = cqe->res;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return reaped;
+  }
+
+  // Takes ownership of a file descriptor acquired from |fd_limiter|, and
+  // releases it if io_uring cannot be set up.
+  explicit IoUring(Limiter* fd_limiter)
+      : fd_limiter_(fd_limiter),
+        ring_fd_(-1),
+        sq_ring_(MAP_FAILED),
+        cq_ring_(MAP_FAILED),
+        sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    const int fd = ::syscall(__NR_io_uring_setup, kEntries, &params);
+    if (fd < 0) {
+      fd_limiter_->Release();
+      return;
+    }
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ring_ != MAP_FAILED && !single_mmap) {
+      cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    }
+    void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+    char* cq_ring = static_cast<char*>(single_mmap ? sq_ring_ : cq_ring_);
+    if (sq_ring_ == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+      Unmap();
+      ::close(fd);
+      fd_limiter_->Release();
+      return;
+    }
+
+    char* sq_ring = static_cast<char*>(sq_ring_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq_ring + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.array);
+    sq_entries_ = params.sq_entries;
+    cq_head_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq_ring + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+    ring_fd_ = fd;
+  }
+
+  void Unmap() {
+    if (sqes_ != MAP_FAILED) ::munmap(sqes_, sqes_size_);
+    if (cq_ring_ != MAP_FAILED) ::munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_ != MAP_FAILED) ::munmap(sq_ring_, sq_ring_size_);
+  }
+
+  Limiter* const fd_limiter_;
+  int ring_fd_;  // -1 if io_uring is unavailable.
+  void* sq_ring_;
+  void* cq_ring_;  // MAP_FAILED if shared with sq_ring_.
+  io_uring_sqe* sqes_;
+  size_t sq_ring_size_;
+  size_t cq_ring_size_;
+  size_t sqes_size_;
+
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned* sq_array_;
+  unsigned sq_entries_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  io_uring_cqe* cqes_;
+};
+#endif  // HAVE_IO_URING
+
 // Implements random read access in a file using pread().
 //
 // Instances of this class are thread-safe, as required by the RandomAccessFile
@@ -176,11 +433,14 @@ class PosixSequentialFile final : public SequentialFile {
 class PosixRandomAccessFile final : public RandomAccessFile {
  public:
   // The new instance takes ownership of |fd|. |fd_limiter| must outlive this
-  // instance, and will be used to determine if .
-  PosixRandomAccessFile(std::string filename, int fd, Limiter* fd_limiter)
+  // instance, and will be used to determine if .  If |direct| is true, |fd|
+  // was opened with OpenDirect() and reads are done with aligned buffers.
+  PosixRandomAccessFile(std::string filename, int fd, Limiter* fd_limiter,
+                        bool direct = false)
       : has_permanent_fd_(fd_limiter->Acquire()),
         fd_(has_permanent_fd_ ? fd : -1),
         fd_limiter_(fd_limiter),
+        direct_(direct),
         filename_(std::move(filename)) {
     if (!has_permanent_fd_) {
       assert(fd_ == -1);
@@ -198,9 +458,19 @@ class PosixRandomAccessFile final : public RandomAccessFile {
 
   Status Read(uint64_t offset, size_t n, Slice* result,
               char* scratch) const override {
+    if (direct_) {
+      ReadRequest req;
+      req.offset = offset;
+      req.n = n;
+      req.scratch = scratch;
+      MultiRead(&req, 1);
+      *result = req.result;
+      return req.status;
+    }
+
     int fd = fd_;
     if (!has_permanent_fd_) {
-      fd = ::open(filename_.c_str(), O_RDONLY | kOpenBaseFlags);
+      fd = OpenTemporaryFd();
       if (fd < 0) {
         return PosixError(filename_, errno);
       }
@@ -223,10 +493,102 @@ class PosixRandomAccessFile final : public RandomAccessFile {
     return status;
   }
 
+  void MultiRead(ReadRequest* reqs, size_t num) const override {
+    int fd = fd_;
+    if (!has_permanent_fd_) {
+      fd = OpenTemporaryFd();
+      if (fd < 0) {
+        const Status status = PosixError(filename_, errno);
+        for (size_t i = 0; i < num; i++) {
+          reqs[i].result = Slice();
+          reqs[i].status = status;
+        }
+        return;
+      }
+    }
+
+    if (!direct_) {
+      ReadAll(fd, reqs, num);
+    } else {
+      // Direct I/O needs aligned buffers, offsets and lengths, so read the
+      // aligned blocks around each request into a shared aligned buffer.
+      std::vector<ReadRequest> aligned(num);
+      size_t total = 0;
+      for (size_t i = 0; i < num; i++) {
+        const uint64_t start = reqs[i].offset & ~(kDirectIOAlignment - 1);
+        const uint64_t limit = (reqs[i].offset + reqs[i].n +
+                                kDirectIOAlignment - 1) &
+                               ~(kDirectIOAlignment - 1);
+        aligned[i].offset = start;
+        aligned[i].n = static_cast<size_t>(limit - start);
+        total += aligned[i].n;
+      }
+      AlignedBuffer buf(total);
+      char* scratch = buf.data();
+      for (size_t i = 0; i < num && scratch != nullptr; i++) {
+        aligned[i].scratch = scratch;
+        scratch += aligned[i].n;
+      }
+      ReadAll(fd, aligned.data(), num);
+      for (size_t i = 0; i < num; i++) {
+        reqs[i].result = Slice();
+        reqs[i].status = aligned[i].status;
+        if (reqs[i].status.ok()) {
+          // Reads at the end of the file come back short.
+          const size_t skip =
+              static_cast<size_t>(reqs[i].offset - aligned[i].offset);
+          const size_t size = aligned[i].result.size();
+          const size_t n = (size > skip) ? std::min(size - skip, reqs[i].n) : 0;
+          std::memcpy(reqs[i].scratch, aligned[i].scratch + skip, n);
+          reqs[i].result = Slice(reqs[i].scratch, n);
+        }
+      }
+    }
+
+    if (!has_permanent_fd_) {
+      ::close(fd);
+    }
+  }
+
  private:
+  int OpenTemporaryFd() const {
+    return direct_ ? OpenDirect(filename_, O_RDONLY | kOpenBaseFlags)
+                   : ::open(filename_.c_str(), O_RDONLY | kOpenBaseFlags);
+  }
+
+  // Performs reqs[0..num-1] on |fd| as they are, submitting them together
+  // through io_uring where possible.
+  void ReadAll(int fd, ReadRequest* reqs, size_t num) const {
+    // Reads that io_uring did not issue are left at -ECANCELED.
+    std::vector<int> res(num, -ECANCELED);
+#if HAVE_IO_URING
+    IoUring* ring =
+        (num > 1) ? IoUring::ForCurrentThread(fd_limiter_) : nullptr;
+    if (ring != nullptr) {
+      ring->Read(fd, reqs, num, res.data());
+    }
+#endif  // HAVE_IO_URING
+    for (size_t i = 0; i < num; i++) {
+      if (reqs[i].scratch == nullptr) {
+        res[i] = -ENOMEM;  // Allocating an aligned buffer failed.
+      } else if (res[i] == -ECANCELED || res[i] == -EINVAL ||
+                 res[i] == -EOPNOTSUPP) {
+        // No io_uring, io_uring failed, or the kernel predates
+        // IORING_OP_READ.
+        res[i] = ::pread(fd, reqs[i].scratch, reqs[i].n,
+                         static_cast<off_t>(reqs[i].offset));
+        if (res[i] < 0) res[i] = -errno;
+      }
+      reqs[i].result = Slice(reqs[i].scratch, (res[i] < 0) ? 0 : res[i]);
+      reqs[i].status =
+          (res[i] < 0) ? PosixError(filename_, -res[i]) : Status::OK();
+    }
+  }
+
   const bool has_permanent_fd_;  // If false, the file is opened on every read.
   const int fd_;                 // -1 if has_permanent_fd_ is false.
   Limiter* const fd_limiter_;
+  const bool direct_;
   const std::string filename_;
 };
 
@@ -276,6 +638,8 @@ class PosixMmapReadableFile final : public RandomAccessFile {
 
 class PosixWritableFile final : public WritableFile {
  public:
+  friend class PosixDirectWritableFile;  // Shares SyncFd().
+
   PosixWritableFile(std::string filename, int fd)
       : pos_(0),
         fd_(fd),
@@ -350,6 +714,12 @@ class PosixWritableFile final : public WritableFile {
     return SyncFd(fd_, filename_);
   }
 
+  Status SyncFlushed() override {
+    // Only fd_ is read here, and it does not change until Close(), so this is
+    // safe to run concurrently with Append() and Flush().
+    return SyncFd(fd_, filename_);
+  }
+
  private:
   Status FlushBuffer() {
     Status status = WriteUnbuffered(buf_, pos_);
@@ -464,6 +834,136 @@ class PosixWritableFile final : public WritableFile {
   const std::string dirname_;  // The directory of filename_.
 };
 
+// Implements sequential writes using O_DIRECT.
+//
+// Direct I/O needs aligned buffers, offsets and lengths, so data is staged in
+// an aligned buffer and written in whole kDirectIOAlignment blocks.  The last,
+// partial block is written padded with zeros when the file is synced or
+// closed, kept in the buffer to be rewritten once more data arrives, and the
+// padding is truncated away.
+class PosixDirectWritableFile final : public WritableFile {
+ public:
+  PosixDirectWritableFile(std::string filename, int fd)
+      : buf_(kDirectWritableFileBufferSize),
+        pos_(0),
+        offset_(0),
+        fd_(fd),
+        filename_(std::move(filename)) {}
+
+  ~PosixDirectWritableFile() override {
+    if (fd_ >= 0) {
+      // Ignoring any potential errors
+      Close();
+    }
+  }
+
+  Status Append(const Slice& data) override {
+    if (buf_.data() == nullptr) {
+      return PosixError(filename_, ENOMEM);
+    }
+    const char* write_data = data.data();
+    size_t write_size = data.size();
+    while (write_size > 0) {
+      const size_t copy_size =
+          std::min(write_size, kDirectWritableFileBufferSize - pos_);
+      std::memcpy(buf_.data() + pos_, write_data, copy_size);
+      write_data += copy_size;
+      write_size -= copy_size;
+      pos_ += copy_size;
+      if (pos_ == kDirectWritableFileBufferSize) {
+        Status status = FlushBuffer();
+        if (!status.ok()) {
+          return status;
+        }
+      }
+    }
+    return Status::OK();
+  }
+
+  Status Close() override {
+    Status status = WriteTail();
+    if (status.ok() && ::ftruncate(fd_, offset_ + pos_) != 0) {
+      status = PosixError(filename_, errno);
+    }
+    const int close_result = ::close(fd_);
+    if (close_result < 0 && status.ok()) {
+      status = PosixError(filename_, errno);
+    }
+    fd_ = -1;
+    return status;
+  }
+
+  Status Flush() override { return FlushBuffer(); }
+
+  Status Sync() override {
+    Status status = FlushBuffer();
+    if (status.ok()) {
+      status = WriteTail();
+    }
+    if (status.ok() && ::ftruncate(fd_, offset_ + pos_) != 0) {
+      status = PosixError(filename_, errno);
+    }
+    if (!status.ok()) {
+      return status;
+    }
+    return PosixWritableFile::SyncFd(fd_, filename_);
+  }
+
+ private:
+  // Writes the whole blocks in the buffer, moving the partial block that
+  // follows them to its start.
+  Status FlushBuffer() {
+    const size_t size = pos_ & ~(kDirectIOAlignment - 1);
+    if (size == 0) {
+      return Status::OK();
+    }
+    Status status = WriteAt(buf_.data(), size, offset_);
+    if (status.ok()) {
+      std::memmove(buf_.data(), buf_.data() + size, pos_ - size);
+      pos_ -= size;
+      offset_ += size;
+    }
+    return status;
+  }
+
+  // Writes the buffered data padded to whole blocks, leaving it buffered.
+  Status WriteTail() {
+    if (pos_ == 0) {
+      return Status::OK();
+    }
+    const size_t size =
+        (pos_ + kDirectIOAlignment - 1) & ~(kDirectIOAlignment - 1);
+    std::memset(buf_.data() + pos_, 0, size - pos_);
+    return WriteAt(buf_.data(), size, offset_);
+  }
+
+  Status WriteAt(const char* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+      ssize_t write_result =
+          ::pwrite(fd_, data, size, static_cast<off_t>(offset));
+      if (write_result < 0) {
+        if (errno == EINTR) {
+          continue;  // Retry
+        }
+        return PosixError(filename_, errno);
+      }
+      data += write_result;
+      size -= write_result;
+      offset += write_result;
+    }
+    return Status::OK();
+  }
+
+  // buf_[0, pos_ - 1] contains data to be written to fd_ at offset_, which
+  // is a multiple of kDirectIOAlignment.
+  AlignedBuffer buf_;
+  size_t pos_;
+  uint64_t offset_;
+  int fd_;
+
+  const std::string filename_;
+};
+
 int LockOrUnlock(int fd, bool lock) {
   errno = 0;
   struct ::flock file_lock_info;
@@ -583,6 +1083,32 @@ class PosixEnv : public Env {
     return Status::OK();
   }
 
+  Status NewDirectRandomAccessFile(const std::string& filename,
+                                   RandomAccessFile** result) override {
+    int fd = OpenDirect(filename, O_RDONLY | kOpenBaseFlags);
+    if (fd < 0) {
+      *result = nullptr;
+      return PosixError(filename, errno);
+    }
+
+    *result = new PosixRandomAccessFile(filename, fd, &fd_limiter_,
+                                        /*direct=*/true);
+    return Status::OK();
+  }
+
+  Status NewDirectWritableFile(const std::string& filename,
+                               WritableFile** result) override {
+    int fd = OpenDirect(filename, O_TRUNC | O_WRONLY | O_CREAT | kOpenBaseFlags,
+                        0644);
+    if (fd < 0) {
+      *result = nullptr;
+      return PosixError(filename, errno);
+    }
+
+    *result = new PosixDirectWritableFile(filename, fd);
+    return Status::OK();
+  }
+
   Status NewAppendableFile(const std::string& filename,
                            WritableFile** result) override {
     int fd = ::open(filename.c_str(),
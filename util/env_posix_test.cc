@@ -212,6 +212,97 @@ TEST_F(EnvPosixTest, TestOpenOnRead) {
   ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
 }
 
+TEST_F(EnvPosixTest, TestMultiRead) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/multi_read.txt";
+  std::string data;
+  for (int i = 0; i < 10000; i++) {
+    data.push_back(static_cast<char>('a' + i % 26));
+  }
+  ASSERT_LEVELDB_OK(WriteStringToFile(env_, data, test_file));
+
+  // Cover mmap-ed, pread() and open-on-read files.
+  const int kNumFiles = kReadOnlyFileLimit + kMMapLimit + 2;
+  leveldb::RandomAccessFile* files[kNumFiles] = {0};
+  for (int i = 0; i < kNumFiles; i++) {
+    ASSERT_LEVELDB_OK(env_->NewRandomAccessFile(test_file, &files[i]));
+  }
+  const int kNumReads = 100;  // More than one io_uring submission
+  for (int i = 0; i < kNumFiles; i++) {
+    std::vector<std::string> scratch(kNumReads, std::string(100, '\0'));
+    leveldb::RandomAccessFile::ReadRequest reqs[kNumReads];
+    for (int r = 0; r < kNumReads; r++) {
+      reqs[r].offset = (r * 997) % (data.size() - 100);
+      reqs[r].n = 100;
+      reqs[r].scratch = &scratch[r][0];
+    }
+    files[i]->MultiRead(reqs, kNumReads);
+    for (int r = 0; r < kNumReads; r++) {
+      ASSERT_LEVELDB_OK(reqs[r].status);
+      ASSERT_EQ(data.substr(reqs[r].offset, 100), reqs[r].result.ToString());
+    }
+  }
+  for (int i = 0; i < kNumFiles; i++) {
+    delete files[i];
+  }
+  ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
+}
+
+TEST_F(EnvPosixTest, TestDirectIO) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/direct_io.txt";
+
+  // Unaligned appends spanning several write buffers, with syncs that
+  // write out partial blocks in between.
+  std::string data;
+  leveldb::WritableFile* writable_file;
+  ASSERT_LEVELDB_OK(env_->NewDirectWritableFile(test_file, &writable_file));
+  for (int i = 0; i < 3000; i++) {
+    std::string piece(1 + (i * 7919) % 2000, static_cast<char>('a' + i % 26));
+    ASSERT_LEVELDB_OK(writable_file->Append(piece));
+    data += piece;
+    if (i % 500 == 0) {
+      ASSERT_LEVELDB_OK(writable_file->Sync());
+    }
+  }
+  ASSERT_LEVELDB_OK(writable_file->Close());
+  delete writable_file;
+
+  uint64_t file_size;
+  ASSERT_LEVELDB_OK(env_->GetFileSize(test_file, &file_size));
+  ASSERT_EQ(data.size(), file_size);
+  std::string contents;
+  ASSERT_LEVELDB_OK(ReadFileToString(env_, test_file, &contents));
+  ASSERT_TRUE(contents == data);
+
+  leveldb::RandomAccessFile* file;
+  ASSERT_LEVELDB_OK(env_->NewDirectRandomAccessFile(test_file, &file));
+  const int kNumReads = 100;
+  std::vector<std::string> scratch(kNumReads, std::string(5000, '\0'));
+  leveldb::RandomAccessFile::ReadRequest reqs[kNumReads];
+  for (int r = 0; r < kNumReads; r++) {
+    reqs[r].offset = (r * 104729) % data.size();
+    reqs[r].n = 1 + (r * 31) % 5000;
+    reqs[r].scratch = &scratch[r][0];
+  }
+  file->MultiRead(reqs, kNumReads);
+  for (int r = 0; r < kNumReads; r++) {
+    ASSERT_LEVELDB_OK(reqs[r].status);
+    // Reads running past the end of the file come back short.
+    ASSERT_TRUE(data.substr(reqs[r].offset, reqs[r].n) ==
+                reqs[r].result.ToString());
+
+    Slice result;
+    ASSERT_LEVELDB_OK(
+        file->Read(reqs[r].offset, reqs[r].n, &result, &scratch[r][0]));
+    ASSERT_TRUE(data.substr(reqs[r].offset, reqs[r].n) == result.ToString());
+  }
+  delete file;
+  ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
+}
+
 #if HAVE_O_CLOEXEC
 
 TEST_F(EnvPosixTest, TestCloseOnExecSequentialFile) {